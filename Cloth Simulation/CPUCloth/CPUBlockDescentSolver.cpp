@@ -0,0 +1,328 @@
+// ------------------------------------------------
+// Class:	CPU Block Descent Solver Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUBlockDescentSolver.h"
+
+// Standard includes
+#include <cmath>
+#include <algorithm>
+
+// Namespaces
+using namespace std;
+
+// Smallest share of work handed to a thread
+#define PARTICLE_GRAIN 1024
+#define VERTEX_GRAIN 256
+
+// Constructor
+CPUBlockDescentSolver::CPUBlockDescentSolver()
+{
+	settings.stiffness[0] = 5000.0f;
+	settings.stiffness[1] = 500.0f;
+	settings.damping = 2.0f;
+	settings.mass = 1.0f;
+	settings.collisionStiffness = 1.0e5f;
+
+	colourCount = 0;
+	velocityTimeStep = 0.0f;
+
+	for(int c = 0; c < 10; ++c)
+		colourStart[c] = 0;
+}
+
+// Build
+bool CPUBlockDescentSolver::build(unsigned int width, unsigned int height, const CPUConstraintBatch* batches)
+{
+	unsigned int count = width * height;
+
+	// Incident springs, in batch order so the sums never depend on the thread count
+	neighbourStart.assign(count + 1, 0);
+
+	for(int b = 0; b < 8; ++b)
+	{
+		for(int c = 0; c < batches[b].count; ++c)
+		{
+			++neighbourStart[batches[b].start[c] + 1];
+			++neighbourStart[batches[b].end[c] + 1];
+		}
+	}
+
+	for(unsigned int i = 0; i < count; ++i)
+		neighbourStart[i + 1] += neighbourStart[i];
+
+	neighbour.resize(neighbourStart[count]);
+	neighbourDistance.resize(neighbourStart[count]);
+	neighbourType.resize(neighbourStart[count]);
+
+	vector<unsigned int> next(neighbourStart.begin(), neighbourStart.end() - 1);
+
+	for(int b = 0; b < 8; ++b)
+	{
+		const CPUConstraintBatch& batch = batches[b];
+		unsigned char type = b < 4 ? 0 : 1;
+
+		for(int c = 0; c < batch.count; ++c)
+		{
+			unsigned int a = batch.start[c];
+			unsigned int e = batch.end[c];
+
+			neighbour[next[a]] = e;
+			neighbourDistance[next[a]] = batch.distance[c];
+			neighbourType[next[a]++] = type;
+
+			neighbour[next[e]] = a;
+			neighbourDistance[next[e]] = batch.distance[c];
+			neighbourType[next[e]++] = type;
+		}
+	}
+
+	targetX.assign(count, 0.0f);
+	targetY.assign(count, 0.0f);
+	targetZ.assign(count, 0.0f);
+	velocityX.assign(count, 0.0f);
+	velocityY.assign(count, 0.0f);
+	velocityZ.assign(count, 0.0f);
+	velocityTimeStep = 0.0f;
+
+	// The fewest colours that keep every spring between two colours
+	if(buildColours(width, height, 2) || buildColours(width, height, 3))
+		return true;
+
+	colourCount = 0;
+	return false;
+}
+
+// Build Colours (colour of a particle is its column and row modulo the period)
+bool CPUBlockDescentSolver::buildColours(unsigned int width, unsigned int height, unsigned int period)
+{
+	unsigned int count = width * height;
+	vector<unsigned char> colour(count);
+
+	for(unsigned int i = 0; i < count; ++i)
+		colour[i] = (unsigned char)((i % width) % period + period * ((i / width) % period));
+
+	for(unsigned int i = 0; i < count; ++i)
+	{
+		for(unsigned int n = neighbourStart[i]; n < neighbourStart[i + 1]; ++n)
+		{
+			if(colour[neighbour[n]] == colour[i])
+				return false;
+		}
+	}
+
+	colourCount = (int)(period * period);
+	colourParticles.resize(count);
+
+	for(int c = 0; c <= colourCount; ++c)
+		colourStart[c] = 0;
+
+	for(unsigned int i = 0; i < count; ++i)
+		++colourStart[colour[i] + 1];
+
+	for(int c = 0; c < colourCount; ++c)
+		colourStart[c + 1] += colourStart[c];
+
+	vector<int> next(colourStart, colourStart + colourCount);
+
+	for(unsigned int i = 0; i < count; ++i)
+		colourParticles[next[colour[i]]++] = i;
+
+	return true;
+}
+
+// Step
+void CPUBlockDescentSolver::step(CPUParticles& particles, const CPUVector3& acceleration, const CPUVector3& sphereCentre,
+	float sphereRadius, float timeStep, int iterations, CPUThreadPool* threadPool)
+{
+	if(!colourCount || targetX.size() != particles.count)
+		return;
+
+	// Inertial target y = x + keep (x - x_old) + h^2 a, the previous positions become the old state
+	float keep = (float)verletKeep(timeStep);
+	float accelerationX = acceleration.x * timeStep * timeStep;
+	float accelerationY = acceleration.y * timeStep * timeStep;
+	float accelerationZ = acceleration.z * timeStep * timeStep;
+
+	// Initial guess x + keep (x - x_old) + h^2 a~, where a~ is the change in velocity over the
+	// last step projected on the acceleration and clamped to [0, |a|] (no history after a change
+	// of time step)
+	float accelerationLength = sqrtf(acceleration.x * acceleration.x + acceleration.y * acceleration.y + acceleration.z * acceleration.z);
+	float directionX = accelerationLength > 0.0f ? acceleration.x / accelerationLength : 0.0f;
+	float directionY = accelerationLength > 0.0f ? acceleration.y / accelerationLength : 0.0f;
+	float directionZ = accelerationLength > 0.0f ? acceleration.z / accelerationLength : 0.0f;
+	bool history = velocityTimeStep == timeStep;
+
+	threadPool->parallelFor(particles.count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			bool movable = particles.invMass[i] > 0.0f;
+
+			float moveX = movable ? keep * (particles.x[i] - particles.oldX[i]) : 0.0f;
+			float moveY = movable ? keep * (particles.y[i] - particles.oldY[i]) : 0.0f;
+			float moveZ = movable ? keep * (particles.z[i] - particles.oldZ[i]) : 0.0f;
+
+			targetX[i] = particles.x[i] + moveX + (movable ? accelerationX : 0.0f);
+			targetY[i] = particles.y[i] + moveY + (movable ? accelerationY : 0.0f);
+			targetZ[i] = particles.z[i] + moveZ + (movable ? accelerationZ : 0.0f);
+
+			// Gained velocity (times h) along the acceleration, in units of h^2 |a|
+			float gained = history ? ((moveX - velocityX[i]) * directionX + (moveY - velocityY[i]) * directionY
+				+ (moveZ - velocityZ[i]) * directionZ) / (accelerationLength * timeStep * timeStep) : 1.0f;
+			gained = accelerationLength > 0.0f ? min(max(gained, 0.0f), 1.0f) : 0.0f;
+
+			velocityX[i] = moveX;
+			velocityY[i] = moveY;
+			velocityZ[i] = moveZ;
+
+			particles.oldX[i] = particles.x[i];
+			particles.oldY[i] = particles.y[i];
+			particles.oldZ[i] = particles.z[i];
+
+			particles.x[i] += moveX + (movable ? gained * accelerationX : 0.0f);
+			particles.y[i] += moveY + (movable ? gained * accelerationY : 0.0f);
+			particles.z[i] += moveZ + (movable ? gained * accelerationZ : 0.0f);
+		}
+	});
+
+	velocityTimeStep = timeStep;
+
+	float inertia = settings.mass / (float)particles.count / (timeStep * timeStep);
+	float dampingScale = settings.damping / timeStep;
+
+	// Particles of one colour share no spring, so each colour is one parallel pass
+	for(int iteration = 0; iteration < iterations; ++iteration)
+	{
+		for(int c = 0; c < colourCount; ++c)
+		{
+			const unsigned int* colour = &colourParticles[colourStart[c]];
+
+			threadPool->parallelFor(getColourSize(c), VERTEX_GRAIN, [&](int first, int last)
+			{
+				for(int k = first; k < last; ++k)
+					solveParticle(colour[k], inertia, dampingScale, particles, sphereCentre, sphereRadius);
+			});
+		}
+	}
+}
+
+// Solve Particle (one Newton step on the particle's position, the rest of the cloth held fixed)
+void CPUBlockDescentSolver::solveParticle(unsigned int i, float inertia, float dampingScale, CPUParticles& particles,
+	const CPUVector3& sphereCentre, float sphereRadius) const
+{
+	float* x = particles.x;
+	float* y = particles.y;
+	float* z = particles.z;
+	const float* oldX = particles.oldX;
+	const float* oldY = particles.oldY;
+	const float* oldZ = particles.oldZ;
+
+	if(particles.invMass[i] <= 0.0f)
+		return;
+
+	// Inertia: force -m / h^2 (x - y), Hessian m / h^2 I
+	float mass = inertia / particles.invMass[i];
+	float fx = -mass * (x[i] - targetX[i]);
+	float fy = -mass * (y[i] - targetY[i]);
+	float fz = -mass * (z[i] - targetZ[i]);
+	float hxx = mass, hyy = mass, hzz = mass;
+	float hxy = 0.0f, hxz = 0.0f, hyz = 0.0f;
+
+	float moveX = x[i] - oldX[i];
+	float moveY = y[i] - oldY[i];
+	float moveZ = z[i] - oldZ[i];
+
+	for(unsigned int n = neighbourStart[i]; n < neighbourStart[i + 1]; ++n)
+	{
+		unsigned int j = neighbour[n];
+
+		float dx = x[i] - x[j];
+		float dy = y[i] - y[j];
+		float dz = z[i] - z[j];
+		float length = sqrtf(dx * dx + dy * dy + dz * dz);
+
+		if(length <= 1e-9f)
+			continue;
+
+		float ux = dx / length;
+		float uy = dy / length;
+		float uz = dz / length;
+		float stiffness = settings.stiffness[neighbourType[n]];
+
+		// Elastic force, and damping of the relative velocity along the spring
+		float relative = ux * (moveX - (x[j] - oldX[j])) + uy * (moveY - (y[j] - oldY[j])) + uz * (moveZ - (z[j] - oldZ[j]));
+		float magnitude = stiffness * (length - neighbourDistance[n]) + dampingScale * relative;
+
+		fx -= magnitude * ux;
+		fy -= magnitude * uy;
+		fz -= magnitude * uz;
+
+		// Hessian k (u u^T + (1 - rest / length) (I - u u^T)), the transverse part dropped while
+		// compressed so the block stays positive definite, plus the damping term
+		float transverse = stiffness * max(1.0f - neighbourDistance[n] / length, 0.0f);
+		float axial = stiffness - transverse + dampingScale;
+
+		hxx += axial * ux * ux + transverse;
+		hyy += axial * uy * uy + transverse;
+		hzz += axial * uz * uz + transverse;
+		hxy += axial * ux * uy;
+		hxz += axial * ux * uz;
+		hyz += axial * uy * uz;
+	}
+
+	// Sphere penalty k (r - d) along the normal while inside
+	float sx = x[i] - sphereCentre.x;
+	float sy = y[i] - sphereCentre.y;
+	float sz = z[i] - sphereCentre.z;
+	float distance = sqrtf(sx * sx + sy * sy + sz * sz);
+
+	if(distance < sphereRadius && distance > 1e-9f)
+	{
+		float nx = sx / distance;
+		float ny = sy / distance;
+		float nz = sz / distance;
+		float stiffness = settings.collisionStiffness;
+		float depth = stiffness * (sphereRadius - distance);
+
+		fx += depth * nx;
+		fy += depth * ny;
+		fz += depth * nz;
+
+		hxx += stiffness * nx * nx;
+		hyy += stiffness * ny * ny;
+		hzz += stiffness * nz * nz;
+		hxy += stiffness * nx * ny;
+		hxz += stiffness * nx * nz;
+		hyz += stiffness * ny * nz;
+	}
+
+	// Solve H dx = f through the adjugate
+	float cxx = hyy * hzz - hyz * hyz;
+	float cxy = hxz * hyz - hxy * hzz;
+	float cxz = hxy * hyz - hxz * hyy;
+	float determinant = hxx * cxx + hxy * cxy + hxz * cxz;
+
+	if(fabsf(determinant) <= 1e-20f)
+		return;
+
+	float cyy = hxx * hzz - hxz * hxz;
+	float cyz = hxy * hxz - hxx * hyz;
+	float czz = hxx * hyy - hxy * hxy;
+	float scale = 1.0f / determinant;
+
+	x[i] += scale * (cxx * fx + cxy * fy + cxz * fz);
+	y[i] += scale * (cxy * fx + cyy * fy + cyz * fz);
+	z[i] += scale * (cxz * fx + cyz * fy + czz * fz);
+}
+
+// Set Settings
+void CPUBlockDescentSolver::setSettings(const CPUBlockDescentSettings& newSettings)
+{
+	settings = newSettings;
+	settings.clamp();
+	settings.damping = max(settings.damping, 0.0f);
+	settings.collisionStiffness = max(settings.collisionStiffness, 0.0f);
+}
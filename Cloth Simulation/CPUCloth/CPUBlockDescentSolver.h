@@ -0,0 +1,94 @@
+// ------------------------------------------------
+// Class:	CPU Block Descent Solver Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUBLOCKDESCENTSOLVER
+#define CPUBLOCKDESCENTSOLVER
+
+// INCLUDES
+#include "CPUParticles.h"
+#include "CPUConstraintKernel.h"
+#include "CPUThreadPool.h"
+#include "CPUSolverCommon.h"
+
+// Standard includes
+#include <vector>
+
+// Settings of the vertex block descent solver
+struct CPUBlockDescentSettings : CPUSpringSettings
+{
+	float damping;				// Damping along each spring (N s/m)
+	float collisionStiffness;	// Penalty stiffness (N/m) of the sphere
+};
+
+// Vertex Block Descent (Chen et al.) for the cloth springs.
+// The particles are coloured so that no spring joins two particles of one colour, on the
+// lattice a 2 x 2 pattern (4 colours) does for structural and shear springs and a 3 x 3
+// pattern (9 colours) for anything reaching two particles further. Every iteration walks
+// the colours, each particle of a colour taking one Newton step on its own position against
+// inertia, its incident springs and the sphere (a 3 x 3 solve), with one barrier per colour.
+// The sweeps start from the adaptive guess of the paper: the previous velocity plus only as
+// much of the acceleration as the particle picked up last step, so resting cloth does not
+// fall a whole step into its springs and climb back out every step.
+// Like the other implicit solvers the step minimises the backward Euler energy, so it is
+// stable at a whole frame time step.
+class CPUBlockDescentSolver
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable
+	CPUBlockDescentSolver(const CPUBlockDescentSolver&);
+	CPUBlockDescentSolver& operator=(const CPUBlockDescentSolver&);
+
+	// Attributes
+	CPUBlockDescentSettings settings;
+
+	// Incident springs of every particle (compressed rows): other end, rest distance and type
+	std::vector<unsigned int> neighbourStart;
+	std::vector<unsigned int> neighbour;
+	std::vector<float> neighbourDistance;
+	std::vector<unsigned char> neighbourType;
+
+	// Particles packed colour after colour
+	int colourCount;
+	int colourStart[10];
+	std::vector<unsigned int> colourParticles;
+
+	// Inertial target (the positions at the start of the step are kept in oldX / oldY / oldZ)
+	// and the velocity the last step started with, for the initial guess
+	std::vector<float> targetX, targetY, targetZ;
+	std::vector<float> velocityX, velocityY, velocityZ;
+	float velocityTimeStep;
+
+	// Methods
+	bool buildColours(unsigned int width, unsigned int height, unsigned int period);
+	void solveParticle(unsigned int i, float inertia, float dampingScale, CPUParticles& particles,
+		const CPUVector3& sphereCentre, float sphereRadius) const;
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor
+	CPUBlockDescentSolver();
+
+	// Build the neighbour lists and the colouring of a width x height lattice (row major),
+	// returns false if neither pattern separates every spring
+	bool build(unsigned int width, unsigned int height, const CPUConstraintBatch* batches);
+
+	// One implicit step of timeStep seconds under a uniform acceleration, iterations sweeps
+	// over the colours (pinned particles, invMass 0, stay where they are)
+	void step(CPUParticles& particles, const CPUVector3& acceleration, const CPUVector3& sphereCentre,
+		float sphereRadius, float timeStep, int iterations, CPUThreadPool* threadPool);
+
+	// Settings
+	const CPUBlockDescentSettings& getSettings() const { return settings; }
+	void setSettings(const CPUBlockDescentSettings& newSettings);
+
+	// Accessors
+	int getColourCount() const { return colourCount; }
+	int getColourSize(int colour) const { return colourStart[colour + 1] - colourStart[colour]; }
+};
+
+#endif
@@ -0,0 +1,154 @@
+// ------------------------------------------------
+// Class:	CPU Chebyshev Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUChebyshev.h"
+#include "CPUSolverCommon.h"
+
+// Standard includes
+#include <algorithm>
+
+// Namespaces
+using namespace std;
+
+// Largest spectral radius used. The trial measures rho from whichever modes dominate its state,
+// and estimates above this (up to 0.98 with tethers) made 8 sweep substeps diverge slowly over
+// many substeps, too slowly for the growth check between iterates to catch.
+#define MAX_RADIUS 0.95f
+
+// Growth of the update between two iterates taken as divergence (over-relaxed iterates do
+// not shrink monotonically, so small rises are expected), and the share the stored radius
+// is scaled by after one
+#define DIVERGENCE_GROWTH 2.0
+#define RADIUS_BACKOFF 0.95f
+
+// Configurations kept, storing a new one once this many are kept forgets them all
+#define MAX_CONFIGURATIONS 64
+
+// Constructor
+CPUChebyshev::CPUChebyshev()
+{
+	key = 0;
+	radius = 0.0f;
+	iteration = 0;
+	omega = 1.0f;
+	accelerate = false;
+	lastUpdate = 0.0;
+	fallbacks = 0;
+}
+
+// Select
+bool CPUChebyshev::select(uint64_t newKey)
+{
+	map<uint64_t, float>::const_iterator found = radii.find(newKey);
+
+	if(found == radii.end())
+		return false;
+
+	key = newKey;
+	radius = found->second;
+
+	return true;
+}
+
+// Store
+void CPUChebyshev::store(uint64_t newKey, float newRadius)
+{
+	if(radii.size() >= MAX_CONFIGURATIONS && !radii.count(newKey))
+		radii.clear();
+
+	key = newKey;
+	radius = min(max(newRadius, 0.0f), MAX_RADIUS);
+	radii[key] = radius;
+}
+
+// Begin
+void CPUChebyshev::begin(const CPUParticles& particles, bool accelerated)
+{
+	unsigned int count = particles.count;
+
+	if(previousX.size() != count)
+	{
+		previousX.assign(count, 0.0f);
+		previousY.assign(count, 0.0f);
+		previousZ.assign(count, 0.0f);
+		olderX.assign(count, 0.0f);
+		olderY.assign(count, 0.0f);
+		olderZ.assign(count, 0.0f);
+	}
+
+	copy(particles.x, particles.x + count, previousX.begin());
+	copy(particles.y, particles.y + count, previousY.begin());
+	copy(particles.z, particles.z + count, previousZ.begin());
+
+	iteration = 0;
+	omega = 1.0f;
+	accelerate = accelerated && radius > 0.0f;
+	lastUpdate = 0.0;
+}
+
+// Mix
+double CPUChebyshev::mix(CPUParticles& particles, CPUThreadPool* threadPool, bool final)
+{
+	// Omega for this iterate (the first is a plain sweep, it has no iterate two sweeps back, and
+	// the final one is kept plain too, its overshoot would otherwise carry into the velocity)
+	float rhoSquared = radius * radius;
+
+	if(!accelerate || iteration == 0 || final)
+		omega = 1.0f;
+	else if(iteration == 1)
+		omega = 2.0f / (2.0f - rhoSquared);
+	else
+		omega = 4.0f / (4.0f - rhoSquared * omega);
+
+	float weight = omega;
+	bool plain = omega == 1.0f;
+	float* x = particles.x;
+	float* y = particles.y;
+	float* z = particles.z;
+
+	double update = blockSum((int)particles.count, [&](int first, int last)
+	{
+		double blockUpdate = 0.0;
+
+		for(int i = first; i < last; ++i)
+		{
+			// Plain iterates are kept exactly as the sweep left them
+			float mixedX = plain ? x[i] : weight * (x[i] - olderX[i]) + olderX[i];
+			float mixedY = plain ? y[i] : weight * (y[i] - olderY[i]) + olderY[i];
+			float mixedZ = plain ? z[i] : weight * (z[i] - olderZ[i]) + olderZ[i];
+
+			float dx = mixedX - previousX[i];
+			float dy = mixedY - previousY[i];
+			float dz = mixedZ - previousZ[i];
+
+			blockUpdate += dx * dx + dy * dy + dz * dz;
+
+			olderX[i] = previousX[i];
+			olderY[i] = previousY[i];
+			olderZ[i] = previousZ[i];
+
+			previousX[i] = x[i] = mixedX;
+			previousY[i] = y[i] = mixedY;
+			previousZ[i] = z[i] = mixedZ;
+		}
+
+		return blockUpdate;
+	}, partialSums, threadPool);
+
+	// A fast growing update means rho was too optimistic: plain sweeps for the rest of the
+	// substep, and a smaller rho for this configuration from now on
+	if(accelerate && iteration >= 2 && update > lastUpdate * DIVERGENCE_GROWTH)
+	{
+		accelerate = false;
+		++fallbacks;
+		store(key, radius * RADIUS_BACKOFF);
+	}
+
+	lastUpdate = update;
+	++iteration;
+
+	return update;
+}
@@ -0,0 +1,84 @@
+// ------------------------------------------------
+// Class:	CPU Chebyshev Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUCHEBYSHEV
+#define CPUCHEBYSHEV
+
+// INCLUDES
+#include "CPUParticles.h"
+#include "CPUThreadPool.h"
+
+// Standard includes
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Chebyshev semi-iterative acceleration of the constraint sweeps (Wang, A Chebyshev
+// Semi-Iterative Approach for Accelerating Projective and Position-based Dynamics).
+// After every sweep the new iterate is over-relaxed against the one two sweeps back,
+//		x(k+1) = omega(k+1) (sweep(x(k)) - x(k-1)) + x(k-1)
+// with omega(1) = 1, omega(2) = 2 / (2 - rho^2) and omega(k+1) = 4 / (4 - rho^2 omega(k)),
+// rho being the spectral radius of one plain sweep. The caller estimates rho once per cloth
+// configuration and stores it here under a key. If the update between iterates grows, the
+// rest of the substep falls back to plain sweeps and the stored rho is lowered.
+class CPUChebyshev
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable
+	CPUChebyshev(const CPUChebyshev&);
+	CPUChebyshev& operator=(const CPUChebyshev&);
+
+	// Iterates one and two sweeps back
+	std::vector<float> previousX, previousY, previousZ;
+	std::vector<float> olderX, olderY, olderZ;
+
+	// Spectral radius per configuration key, and the one in use
+	std::map<uint64_t, float> radii;
+	uint64_t key;
+	float radius;
+
+	// Substep state
+	int iteration;
+	float omega;
+	bool accelerate;
+	double lastUpdate;
+	int fallbacks;
+
+	// Block sums of the update norm (blockSum scratch)
+	std::vector<double> partialSums;
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor
+	CPUChebyshev();
+
+	// Look up the spectral radius stored for a configuration, returns false if there is none
+	bool select(uint64_t newKey);
+
+	// Store (and use) the spectral radius of a configuration, clamped to [0, 0.95]. At most
+	// 64 configurations are kept, past that the stored ones are forgotten.
+	void store(uint64_t newKey, float newRadius);
+
+	// Start a substep from the current positions, accelerated or plain (omega 1 throughout)
+	void begin(const CPUParticles& particles, bool accelerated);
+
+	// Mix the positions left by a sweep with the previous iterates (the last sweep of a substep,
+	// final, is left plain), returns the squared norm of the change from the previous iterate
+	double mix(CPUParticles& particles, CPUThreadPool* threadPool, bool final = false);
+
+	// Forget every stored spectral radius
+	void clear() { radii.clear(); }
+
+	// Accessors
+	float getRadius() const { return radius; }
+	float getOmega() const { return omega; }
+	int getFallbacks() const { return fallbacks; } // Substeps that fell back to plain sweeps
+	size_t getCachedCount() const { return radii.size(); }
+};
+
+#endif
@@ -0,0 +1,2745 @@
+// ------------------------------------------------
+// Class:	CPU Cloth Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUCloth.h"
+#include "CPUMemory.h"
+#include "CPUHash.h"
+#include "CPUSolverCommon.h"
+
+// Standard includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Debug includes
+#include <iostream>
+
+// Namespaces
+using namespace std;
+
+// Smallest share of work handed to a thread (multiples of the widest SIMD kernel)
+#define PARTICLE_GRAIN 1024
+#define CONSTRAINT_GRAIN 256
+
+// Particles per state hash block (fixed, so the block hashes never depend on the thread count)
+#define HASH_BLOCK 16384
+
+// Particles per sleeping tile side, and the energy (over the sleep threshold) at which a tile
+// wakes its sleeping neighbours (above 1, so tiles hovering at the threshold do not keep
+// waking the cloth around them)
+#define SLEEP_TILE 32
+#define WAKE_FACTOR 4.0f
+
+// Contact caching: scale on the distance a particle can travel (it may be pulled along faster
+// than it moved at the start of the frame), and the largest self collision skin in contact
+// distances (wider lists hold more candidates than the passes they save are worth)
+#define CONTACT_SAFETY 2.0f
+#define SELF_SKIN 1.0f
+
+// Plain sweeps run to estimate the spectral radius for Chebyshev, the radius is the
+// geometric mean of the update norm ratios over the last ESTIMATE_SPAN of them
+#define ESTIMATE_SWEEPS 32
+#define ESTIMATE_SPAN 8
+
+// RMS particle update (m) of the last trial sweep below which the ratios are float rounding
+// rather than convergence (a cloth at rest), the estimate is then retried on a later substep
+#define ESTIMATE_FLOOR 1e-6
+
+// Fewest sweeps (rounds when blocked) per substep Chebyshev is used for, with fewer the
+// over-relaxed iterates overshoot by more than they converge and the cloth gains energy every substep
+#define CHEBYSHEV_MIN_SWEEPS 8
+
+// Length of the vector between two particles
+static float distanceBetween(const CPUParticles& particles, unsigned int a, unsigned int b)
+{
+	float dx = particles.x[a] - particles.x[b];
+	float dy = particles.y[a] - particles.y[b];
+	float dz = particles.z[a] - particles.z[b];
+
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// Stretch of constraints [first, last) of a batch without projecting them (as the kernels measure it)
+static void measureStretchRange(const CPUConstraintBatch& batch, int first, int last, const CPUParticles& particles,
+	float& stretchMax, float& stretchSquares)
+{
+	stretchMax = 0.0f;
+	stretchSquares = 0.0f;
+
+	for(int i = first; i < last; ++i)
+	{
+		float distance = max(distanceBetween(particles, batch.start[i], batch.end[i]), 1e-7f);
+		float stretch = fabsf(distance - batch.distance[i]) / batch.distance[i];
+
+		stretchMax = max(stretchMax, stretch);
+		stretchSquares += stretch * stretch;
+	}
+}
+
+// Combine the block results of one batch in block order
+static void reduceStretchBlocks(const float* blockMax, const float* blockSquares, int blockCount, int count,
+	float& batchMax, float& batchRMS, double& batchSquares)
+{
+	batchMax = 0.0f;
+	batchSquares = 0.0;
+
+	for(int b = 0; b < blockCount; ++b)
+	{
+		batchMax = max(batchMax, blockMax[b]);
+		batchSquares += blockSquares[b];
+	}
+
+	batchRMS = count ? (float)sqrt(batchSquares / count) : 0.0f;
+}
+
+// Seconds on the steady clock (sweep deadlines)
+static double steadySeconds()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Face normals of one row of quads, a / d are read from the top vertex row and b / c from the bottom
+static void computeFaceRow(const float* CPU_RESTRICT topX, const float* CPU_RESTRICT topY, const float* CPU_RESTRICT topZ,
+	const float* CPU_RESTRICT bottomX, const float* CPU_RESTRICT bottomY, const float* CPU_RESTRICT bottomZ,
+	float* CPU_RESTRICT aX, float* CPU_RESTRICT aY, float* CPU_RESTRICT aZ,
+	float* CPU_RESTRICT bX, float* CPU_RESTRICT bY, float* CPU_RESTRICT bZ, int quads)
+{
+	for(int i = 0; i < quads; ++i)
+	{
+		// a = (i, j), b = (i, j + 1), c = (i + 1, j + 1), d = (i + 1, j)
+		float abX = bottomX[i] - topX[i], abY = bottomY[i] - topY[i], abZ = bottomZ[i] - topZ[i];
+		float adX = topX[i + 1] - topX[i], adY = topY[i + 1] - topY[i], adZ = topZ[i + 1] - topZ[i];
+		float bcX = bottomX[i + 1] - bottomX[i], bcY = bottomY[i + 1] - bottomY[i], bcZ = bottomZ[i + 1] - bottomZ[i];
+		float bdX = topX[i + 1] - bottomX[i], bdY = topY[i + 1] - bottomY[i], bdZ = topZ[i + 1] - bottomZ[i];
+
+		// (b - a) x (d - a)
+		aX[i] = abY * adZ - abZ * adY;
+		aY[i] = abZ * adX - abX * adZ;
+		aZ[i] = abX * adY - abY * adX;
+
+		// (c - b) x (d - b)
+		bX[i] = bcY * bdZ - bcZ * bdY;
+		bY[i] = bcZ * bdX - bcX * bdZ;
+		bZ[i] = bcX * bdY - bcY * bdX;
+	}
+}
+
+// Jacobi neighbours: left, right, up, down, up left, up right, down left, down right, and
+// which of the three rest distances (horizontal, vertical, diagonal) each one follows
+static const int jacobiColumn[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+static const int jacobiRow[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+static const int jacobiType[8] = { 0, 0, 1, 1, 2, 2, 2, 2 };
+
+// Vertex normals of one row from the face rows above and below it. A vertex is corner a of
+// quad (i, j), d of (i - 1, j), b of (i, j - 1) and c of (i - 1, j - 1), so it touches six
+// triangles; quad (i, j) sits at below[i + 1] and quad (i, j - 1) at above[i + 1].
+static void accumulateNormalRow(const float* CPU_RESTRICT aboveAX, const float* CPU_RESTRICT aboveAY, const float* CPU_RESTRICT aboveAZ,
+	const float* CPU_RESTRICT aboveBX, const float* CPU_RESTRICT aboveBY, const float* CPU_RESTRICT aboveBZ,
+	const float* CPU_RESTRICT belowAX, const float* CPU_RESTRICT belowAY, const float* CPU_RESTRICT belowAZ,
+	const float* CPU_RESTRICT belowBX, const float* CPU_RESTRICT belowBY, const float* CPU_RESTRICT belowBZ,
+	float* CPU_RESTRICT normalX, float* CPU_RESTRICT normalY, float* CPU_RESTRICT normalZ, int count)
+{
+	for(int i = 0; i < count; ++i)
+	{
+		// Larger triangles weigh more as the face normals are not normalised. The tiny
+		// upward bias makes a fully collapsed neighbourhood normalise to up without a branch.
+		float nx = belowAX[i + 1] + belowAX[i] + belowBX[i] + aboveAX[i + 1] + aboveBX[i + 1] + aboveBX[i];
+		float ny = belowAY[i + 1] + belowAY[i] + belowBY[i] + aboveAY[i + 1] + aboveBY[i + 1] + aboveBY[i] + 1e-18f;
+		float nz = belowAZ[i + 1] + belowAZ[i] + belowBZ[i] + aboveAZ[i + 1] + aboveBZ[i + 1] + aboveBZ[i];
+
+		float scale = 1.0f / sqrtf(nx * nx + ny * ny + nz * nz);
+
+		normalX[i] = nx * scale;
+		normalY[i] = ny * scale;
+		normalZ[i] = nz * scale;
+	}
+}
+
+// Constructor
+CPUCloth::CPUCloth(unsigned int newClothWidth, unsigned int newClothHeight, int threadCount,
+	const unsigned int* newAnchors, int newAnchorCount)
+{
+	// Set initial values
+	indices = nullptr;
+	constraintStart = nullptr;
+	constraintEnd = nullptr;
+	constraintDistance = nullptr;
+	constraintLambda = nullptr;
+	jacobiX = jacobiY = jacobiZ = nullptr;
+	tetherAnchor = nullptr;
+	tetherLength = nullptr;
+	faceAX = faceAY = faceAZ = nullptr;
+	faceBX = faceBY = faceBZ = nullptr;
+	width = newClothWidth;
+	height = newClothHeight;
+	particleOrder = CPU_ORDER_ROW_MAJOR;
+	wind = 0.0f;
+	anchored = true;
+	force = true;
+	tethered = false;
+	tetherScale = 1.0f;
+	constraintCount = 0;
+	stepIndex = 0;
+	hashInterval = 0;
+	multigridDirty = false;
+	implicitBuilt = false;
+	projectiveDirty = true;
+	blockDescentBuilt = false;
+	chebyshevEnabled = false;
+	chebyshevDirty = true;
+	stretchEnabled = false;
+	iterationTolerance = 0.0f;
+	iterationBudget = 0.0f;
+	sweepDeadline = 0.0;
+	memset(&stretch, 0, sizeof(stretch));
+	sleepEnabled = false;
+	sleepThreshold = 1e-3f;
+	sleepSteps = 60;
+	sleepDirty = true;
+	tileSize = SLEEP_TILE;
+	tileColumns = tileRows = 0;
+	awakeTileCount = 0;
+	activeInvMass = nullptr;
+	activeStart = activeEnd = nullptr;
+	activeDistance = nullptr;
+	blockedSweeps = 0;
+	blockStart = blockEnd = nullptr;
+	blockDistance = nullptr;
+	selfCollisionEnabled = false;
+	contactCaching = true;
+	continuousCollision = false;
+	motionStep = 0;
+	motionSteps = 0;
+	sweepTotal = 0;
+	contactSteps = 0;
+	contactSkin = 0.0f;
+	selfInterval = 1;
+	selfSteps = 0;
+	selfSkin = 0.0f;
+	contactFrames = 0;
+	contactRefreshes = 0;
+	normalsDirty = true;
+
+	// Solver defaults match DXCloth (one PBD sweep per substep)
+	solverMode = CPU_SOLVER_PBD;
+	compliance[CPU_CONSTRAINT_STRUCTURAL] = 0.0f;
+	compliance[CPU_CONSTRAINT_SHEAR] = 0.0f;
+	iterations = 1;
+	jacobiRelaxation = 1.0f;
+
+	for(int i = 0; i < 3; ++i)
+		jacobiRest[i] = 0.0f;
+
+	for(int i = 0; i < 8; ++i)
+	{
+		batchSize[i] = batchStart[i] = 0;
+		activeBatchSize[i] = activeBatchStart[i] = 0;
+		stretchSquares[i] = 0.0;
+	}
+
+	// Pick the widest constraint kernel the processor supports
+	setInstructionSet(detectInstructionSet());
+
+	// Start the worker threads
+	threadPool = new CPUThreadPool(threadCount);
+
+	// Setup buffers
+	setupBuffers();
+
+	// Every particle starts free with unit inverse mass (setupBuffers)
+	freeInvMass.assign(particles.count, 1.0f);
+
+	// Pin the anchors
+	if(newAnchors)
+	{
+		setAnchors(newAnchors, newAnchorCount);
+	}
+	else if(particles.count)
+	{
+		// Top left, top right and top middle
+		unsigned int defaultAnchors[3] = { 0, width - 1, width / 2 };
+		setAnchors(defaultAnchors, 3);
+	}
+}
+
+// Destructor
+CPUCloth::~CPUCloth()
+{
+	delete threadPool;
+
+	free(indices);
+	alignedFree(constraintStart);
+	alignedFree(constraintEnd);
+	alignedFree(constraintDistance);
+	alignedFree(constraintLambda);
+	alignedFree(activeInvMass);
+	alignedFree(activeStart);
+	alignedFree(activeEnd);
+	alignedFree(activeDistance);
+	alignedFree(blockStart);
+	alignedFree(blockEnd);
+	alignedFree(blockDistance);
+	alignedFree(jacobiX);
+	alignedFree(jacobiY);
+	alignedFree(jacobiZ);
+	alignedFree(tetherAnchor);
+	alignedFree(tetherLength);
+	alignedFree(faceAX);
+	alignedFree(faceAY);
+	alignedFree(faceAZ);
+	alignedFree(faceBX);
+	alignedFree(faceBY);
+	alignedFree(faceBZ);
+}
+
+// Setup Buffers
+void CPUCloth::setupBuffers()
+{
+	// Constraints are gathered per batch and packed into one buffer afterwards,
+	// the batch sizes are counted rather than derived so odd dimensions are safe
+	vector<CPUConstraint> batches[8];
+
+	try
+	{
+		// Check the dimensions describe at least one quad
+		if(width < 2 || height < 2)
+			throw("Invalid dimensions for cloth instantiation");
+
+		// Allocate memory for buffers
+		bool allocated = particles.allocate(width * height);
+		indices = (unsigned int*) malloc ((width - 1) * (height - 1) * 6 * sizeof(unsigned int));
+		tetherAnchor = (unsigned int*) alignedMalloc (particles.capacity * sizeof(unsigned int));
+		tetherLength = (float*) alignedMalloc (particles.capacity * sizeof(float));
+		jacobiX = (float*) alignedMalloc (particles.capacity * sizeof(float));
+		jacobiY = (float*) alignedMalloc (particles.capacity * sizeof(float));
+		jacobiZ = (float*) alignedMalloc (particles.capacity * sizeof(float));
+
+		if(!allocated || !indices || !tetherAnchor || !tetherLength || !jacobiX || !jacobiY || !jacobiZ)
+			throw("Cannot create cloth buffers");
+
+		// Face normals, zeroed once so the border stays zero
+		size_t faceBytes = (width + 1) * (height + 1) * sizeof(float);
+
+		faceAX = (float*) alignedMalloc (faceBytes);
+		faceAY = (float*) alignedMalloc (faceBytes);
+		faceAZ = (float*) alignedMalloc (faceBytes);
+		faceBX = (float*) alignedMalloc (faceBytes);
+		faceBY = (float*) alignedMalloc (faceBytes);
+		faceBZ = (float*) alignedMalloc (faceBytes);
+
+		if(!faceAX || !faceAY || !faceAZ || !faceBX || !faceBY || !faceBZ)
+			throw("Cannot create normal buffers");
+
+		memset(faceAX, 0, faceBytes);
+		memset(faceAY, 0, faceBytes);
+		memset(faceAZ, 0, faceBytes);
+		memset(faceBX, 0, faceBytes);
+		memset(faceBY, 0, faceBytes);
+		memset(faceBZ, 0, faceBytes);
+
+		// Setup sphere position and radius
+		CPUSphere sphere;
+		sphere.position.x	= 0.5f;
+		sphere.position.y	= -0.8f;
+		sphere.position.z	= 0.0f;
+		sphere.radius		= 0.2f;
+
+		colliders.clear();
+		colliders.add(sphere);
+
+		// Self collision hashes in cells of the closer lattice spacing
+		selfCollision.setLattice(width, 1.0f / (float)(max(width, height) - 1));
+
+		// Index pointer
+		unsigned int *iptr = indices;
+
+		for(unsigned int j = 0; j < height; ++j)
+		{
+			for(unsigned int i = 0; i < width; ++i)
+			{
+				// Compute index (2D to flat 1D)
+				unsigned int index = (j * width) + i;
+
+				#pragma region SETUP VERTEX INFORMATION
+				// --------------------------------------------------------------------------------------------
+
+				particles.x[index] = (float)i / (float)(width - 1);
+				particles.y[index] = 0.0f;
+				particles.z[index] = (float)j / (float)(height - 1);
+				particles.oldX[index] = particles.x[index];
+				particles.oldY[index] = particles.y[index];
+				particles.oldZ[index] = particles.z[index];
+				particles.invMass[index] = 1.0f;
+
+				particles.normalX[index] = 0.0f;
+				particles.normalY[index] = 1.0f;
+				particles.normalZ[index] = 0.0f;
+				particles.texCoord[index * 2] = (float)i / (float)(width - 1);
+				particles.texCoord[index * 2 + 1] = (float)j / (float)(height - 1);
+				particles.matDiffuse[index] = 0xFFFFFFFF;
+				particles.matSpecular[index] = 0x00000000;
+
+				// --------------------------------------------------------------------------------------------
+				#pragma endregion
+
+				#pragma region SETUP CONSTRAINT INFORMATION
+				// --------------------------------------------------------------------------------------------
+
+				CPUConstraint constraint;
+				constraint.end = index;
+
+				// Left constraint (horizontal odd / even)
+				if(i)
+				{
+					constraint.start = index - 1;
+					constraint.distance = distanceBetween(particles, index, constraint.start);
+					batches[(i & 1) ? 0 : 1].push_back(constraint);
+
+					// Up and left (diagonal even / odd)
+					if(j)
+					{
+						constraint.start = index - (width + 1);
+						constraint.distance = distanceBetween(particles, index, constraint.start);
+						batches[(j & 1) ? 4 : 5].push_back(constraint);
+					}
+				}
+
+				// Up constraint (vertical odd / even)
+				if(j)
+				{
+					constraint.start = index - width;
+					constraint.distance = distanceBetween(particles, index, constraint.start);
+					batches[(j & 1) ? 2 : 3].push_back(constraint);
+
+					// Up and right (diagonal odd / even, other)
+					if(i < (width - 1))
+					{
+						constraint.start = index - (width - 1);
+						constraint.distance = distanceBetween(particles, index, constraint.start);
+						batches[(j & 1) ? 6 : 7].push_back(constraint);
+					}
+				}
+
+				// --------------------------------------------------------------------------------------------
+				#pragma endregion
+
+				#pragma region SETUP INDEX INFORMATION
+				// --------------------------------------------------------------------------------------------
+
+				if(i < (width - 1) && j < (height - 1))
+				{
+					unsigned int a = index;
+					unsigned int b = a + width;
+					unsigned int c = b + 1;
+					unsigned int d = a + 1;
+
+					iptr[0] = a;
+					iptr[1] = b;
+					iptr[2] = d;
+
+					iptr[3] = b;
+					iptr[4] = c;
+					iptr[5] = d;
+
+					// Increment pointer
+					iptr += 6;
+				}
+
+				// --------------------------------------------------------------------------------------------
+				#pragma endregion
+			}
+		}
+
+		#pragma region PACK CONSTRAINT BATCHES
+		// --------------------------------------------------------------------------------------------
+
+		for(int i = 0; i < 8; ++i)
+		{
+			batchSize[i] = (int)batches[i].size();
+			batchStart[i] = constraintCount;
+			constraintCount += batchSize[i];
+		}
+
+		constraintStart = (unsigned int*) alignedMalloc (sizeof(unsigned int) * constraintCount);
+		constraintEnd = (unsigned int*) alignedMalloc (sizeof(unsigned int) * constraintCount);
+		constraintDistance = (float*) alignedMalloc (sizeof(float) * constraintCount);
+		constraintLambda = (float*) alignedMalloc (sizeof(float) * constraintCount);
+
+		// Active set while tiles sleep (at most every constraint)
+		activeInvMass = (float*) alignedMalloc (sizeof(float) * particles.capacity);
+		activeStart = (unsigned int*) alignedMalloc (sizeof(unsigned int) * constraintCount);
+		activeEnd = (unsigned int*) alignedMalloc (sizeof(unsigned int) * constraintCount);
+		activeDistance = (float*) alignedMalloc (sizeof(float) * constraintCount);
+
+		// Every constraint again, repacked by tile for the blocked sweeps
+		blockStart = (unsigned int*) alignedMalloc (sizeof(unsigned int) * constraintCount);
+		blockEnd = (unsigned int*) alignedMalloc (sizeof(unsigned int) * constraintCount);
+		blockDistance = (float*) alignedMalloc (sizeof(float) * constraintCount);
+
+		if(!constraintStart || !constraintEnd || !constraintDistance || !constraintLambda
+			|| !activeInvMass || !activeStart || !activeEnd || !activeDistance
+			|| !blockStart || !blockEnd || !blockDistance)
+			throw("Cannot create constraint buffers");
+
+		for(int i = 0; i < 8; ++i)
+		{
+			for(int c = 0; c < batchSize[i]; ++c)
+			{
+				constraintStart[batchStart[i] + c] = batches[i][c].start;
+				constraintEnd[batchStart[i] + c] = batches[i][c].end;
+				constraintDistance[batchStart[i] + c] = batches[i][c].distance;
+			}
+		}
+
+		// The grid is uniform, so the Jacobi pass takes one rest distance per direction
+		jacobiRest[0] = batches[0][0].distance;
+		jacobiRest[1] = batches[2][0].distance;
+		jacobiRest[2] = batches[4][0].distance;
+
+		buildTiles();
+
+		// --------------------------------------------------------------------------------------------
+		#pragma endregion
+	}
+	catch(const char* error)
+	{
+		cout << "Cloth could not be instantiated due to:\n";
+		cout << error << endl << endl;
+
+		particles.release();
+		free(indices);
+		alignedFree(constraintStart);
+		alignedFree(constraintEnd);
+		alignedFree(constraintDistance);
+		alignedFree(constraintLambda);
+		alignedFree(activeInvMass);
+		alignedFree(activeStart);
+		alignedFree(activeEnd);
+		alignedFree(activeDistance);
+		alignedFree(blockStart);
+		alignedFree(blockEnd);
+		alignedFree(blockDistance);
+		alignedFree(jacobiX);
+		alignedFree(jacobiY);
+		alignedFree(jacobiZ);
+		alignedFree(tetherAnchor);
+		alignedFree(tetherLength);
+		alignedFree(faceAX);
+		alignedFree(faceAY);
+		alignedFree(faceAZ);
+		alignedFree(faceBX);
+		alignedFree(faceBY);
+		alignedFree(faceBZ);
+
+		indices = nullptr;
+		constraintStart = nullptr;
+		constraintEnd = nullptr;
+		constraintDistance = nullptr;
+		constraintLambda = nullptr;
+		activeInvMass = nullptr;
+		activeStart = activeEnd = nullptr;
+		activeDistance = nullptr;
+		blockStart = blockEnd = nullptr;
+		blockDistance = nullptr;
+		jacobiX = jacobiY = jacobiZ = nullptr;
+		tetherAnchor = nullptr;
+		tetherLength = nullptr;
+		faceAX = faceAY = faceAZ = nullptr;
+		faceBX = faceBY = faceBZ = nullptr;
+		constraintCount = 0;
+		width = 0;
+		height = 0;
+	}
+}
+
+// Update
+int CPUCloth::update(float deltaTime)
+{
+	if(!particles.count)
+		return 0;
+
+	// Fixed update rate for deterministic simulation, bounded per frame
+	int stepCount = scheduler.advance(deltaTime);
+
+	// If forces are being applied - boolean
+	if(force)
+	{
+		// The sweep budget is shared out evenly over the substeps of the frame
+		double frameStart = steadySeconds();
+		bool budgeted = iterationBudget > 0.0f && !isDeterministic();
+
+		// Contacts are detected once for the frame where they can be, and the colliders move
+		// over its substeps
+		prepareContacts(stepCount);
+		motionStep = 0;
+		motionSteps = stepCount;
+
+		if(contactSteps)
+			++contactFrames;
+
+		for(int i = 0; i < stepCount; ++i)
+		{
+			sweepDeadline = budgeted ? frameStart + (double)iterationBudget * (i + 1) / stepCount : 0.0;
+			step();
+		}
+
+		sweepDeadline = 0.0;
+		contactSteps = 0;
+		selfSteps = 0;
+		motionSteps = 0;
+
+		// Normals are only needed for rendering, so once per frame rather than per substep
+		// (and not at all while every tile sleeps)
+		if(stepCount && normalsDirty)
+		{
+			updateNormals();
+			normalsDirty = false;
+		}
+	}
+
+	return stepCount;
+}
+
+// Step
+void CPUCloth::step()
+{
+	// Setup forces
+	forces.x = 0.0f;
+	forces.y = -9.8f;
+	forces.z = wind;
+
+	if(solverMode == CPU_SOLVER_IMPLICIT || solverMode == CPU_SOLVER_PROJECTIVE || solverMode == CPU_SOLVER_VBD)
+	{
+		// Forces and springs in one implicit solve, then the colliders push particles out
+		CPUConstraintBatch batches[8];
+
+		for(int i = 0; i < 8; ++i)
+			batches[i] = getBatch(i);
+
+		if(solverMode == CPU_SOLVER_IMPLICIT)
+		{
+			implicitSolver.step(particles, batches, forces, scheduler.getTimeStep(), threadPool);
+		}
+		else if(solverMode == CPU_SOLVER_VBD)
+		{
+			// The first sphere is a penalty inside the solve (a zero radius one when there is none)
+			int sphereId = colliders.find(CPU_COLLIDER_SPHERE);
+			CPUSphere sphere = { { 0.0f, 0.0f, 0.0f }, 0.0f };
+
+			if(sphereId >= 0)
+				sphere = colliders.get(sphereId).sphere;
+
+			blockDescentSolver.step(particles, forces, sphere.position, sphere.radius, scheduler.getTimeStep(), iterations, threadPool);
+		}
+		else
+		{
+			if(projectiveDirty || !projectiveSolver.isPrepared())
+			{
+				projectiveSolver.prepare(width, height, particles, batches, scheduler.getTimeStep());
+				projectiveDirty = false;
+			}
+
+			projectiveSolver.step(particles, batches, forces, scheduler.getTimeStep(), iterations, threadPool);
+		}
+
+		collideTiles(false);
+
+		if(selfCollisionEnabled)
+			collideSelf();
+
+		normalsDirty = true;
+	}
+	else
+	{
+		// Sleeping tiles are pinned for the step (their masses swapped out) and skipped
+		if(sleepDirty && isSleepActive())
+			updateActiveSet();
+
+		bool sleeping = isSleepActive();
+		bool awake = !sleeping || awakeTileCount > 0;
+
+		// Chebyshev needs a few sweeps per substep, and the spectral radius of this configuration
+		// (estimated once, then cached). Blocked sweeps run whole rounds of tile sweeps.
+		int roundSweeps = isBlocked() ? blockedSweeps : 1;
+		int rounds = (iterations + roundSweeps - 1) / roundSweeps;
+		bool accelerate = chebyshevEnabled && rounds >= CHEBYSHEV_MIN_SWEEPS && awake;
+
+		// The radius is keyed on the real masses and estimated only while every tile is awake.
+		// Pinning sleeping tiles can only speed the sweeps up, so it holds for any sleep pattern,
+		// and one missing while tiles sleep leaves the sweeps plain until they all wake.
+		if(accelerate && chebyshevDirty)
+		{
+			uint64_t key = chebyshevKey();
+
+			chebyshevDirty = !chebyshev.select(key) && (sleeping || !estimateSpectralRadius(key));
+			accelerate = !chebyshevDirty;
+		}
+
+		if(sleeping)
+			swap(particles.invMass, activeInvMass);
+
+		// Apply forces to the cloth and check collisions, both are per particle so they share
+		// one pass over each awake tile
+		if(awake)
+			collideTiles(true);
+
+		// XPBD multipliers accumulate over the iterations of one substep
+		if(solverMode == CPU_SOLVER_XPBD)
+			memset(constraintLambda, 0, sizeof(float) * constraintCount);
+
+		// Apply constraints to the cloth, Chebyshev over-relaxes the iterates of the substep
+		if(accelerate)
+			chebyshev.begin(particles, true);
+
+		// Stepped directly (not from update) the budget covers this substep alone
+		double deadline = sweepDeadline;
+
+		if(!deadline && iterationBudget > 0.0f && !isDeterministic())
+			deadline = steadySeconds() + iterationBudget;
+
+		int round = 0;
+
+		while(awake && round < rounds)
+		{
+			solveConstraints();
+			++round;
+
+			if(accelerate)
+				chebyshev.mix(particles, threadPool, round == rounds);
+
+			// Stop early once the residual is small enough or the time is spent
+			if(iterationTolerance > 0.0f && stretch.max <= iterationTolerance)
+				break;
+
+			if(deadline && steadySeconds() >= deadline)
+				break;
+		}
+
+		stretch.sweeps = round * roundSweeps;
+		stretch.totalSweeps += round * roundSweeps;
+
+		// Sleeping particles are still pinned here, so they only push the awake ones
+		if(selfCollisionEnabled && awake)
+			collideSelf();
+
+		if(sleeping)
+			swap(particles.invMass, activeInvMass);
+
+		normalsDirty = normalsDirty || awake;
+	}
+
+	// Remove the stretch left over from the sweeps in one pass (anchors are pinned, so
+	// reading them while other particles are written is safe)
+	if(tethered && anchored && !anchorIndices.empty())
+	{
+		forEachAwakeSpan([this](int first, int last)
+		{
+			applyTethers(first, last);
+		});
+	}
+
+	// Energy of the awake tiles, quiet ones go to sleep and moving ones wake their neighbours
+	if(sleepEnabled && isPositionBased())
+		updateTiles();
+
+	++stepIndex;
+
+	if(contactSteps > 0)
+	{
+		--contactSteps;
+		checkContacts();
+	}
+
+	// The colliders' motion ends with the frame's last substep (or this one, stepped directly)
+	if(++motionStep >= motionSteps)
+	{
+		colliders.settle();
+		motionStep = 0;
+	}
+
+	if(hashInterval && stepIndex % hashInterval == 0)
+	{
+		CPUStateHash stateHash;
+		stateHash.step = stepIndex;
+		stateHash.hash = hashState();
+
+		stateHashes.push_back(stateHash);
+	}
+}
+
+// Solve Constraints
+void CPUCloth::solveConstraints()
+{
+	if(!particles.count)
+		return;
+
+	// Every particle writes only itself into the second buffer, so the whole cloth is one pass
+	if(solverMode == CPU_SOLVER_JACOBI)
+	{
+		threadPool->parallelFor(height, max(1, PARTICLE_GRAIN / (int)width), [this](int first, int last)
+		{
+			applyJacobi(first, last);
+		});
+
+		swap(particles.x, jacobiX);
+		swap(particles.y, jacobiY);
+		swap(particles.z, jacobiZ);
+
+		// No batches are projected, so the stretch takes a pass of its own
+		if(isStretchCollected())
+			stretch = measureStretch();
+
+		return;
+	}
+
+	// One parallel pass (and barrier) per colour, or a round of tile sweeps
+	if(isBlocked())
+	{
+		applyBlocks();
+	}
+	else
+	{
+		for(int i = 0; i < 8; ++i)
+			applyConstraints(i);
+	}
+
+	if(isMultigridActive())
+	{
+		// The sweep has removed the high frequency error, the coarse levels take the low
+		// frequencies (long range stretch) that a sweep only moves one particle per colour
+		if(multigridDirty)
+		{
+			multigrid.updateMasses(particles.invMass);
+			multigridDirty = false;
+		}
+
+		multigrid.correct(particles, threadPool);
+
+		if(isBlocked())
+		{
+			applyBlocks();
+		}
+		else
+		{
+			for(int i = 0; i < 8; ++i)
+				applyConstraints(i);
+		}
+	}
+
+	// The blocked batches are not reduced, so their stretch takes a pass of its own
+	if(isStretchCollected() && isBlocked())
+	{
+		stretch = measureStretch();
+	}
+	else if(isStretchCollected())
+	{
+		int count = 0;
+
+		for(int i = 0; i < 8; ++i)
+			count += getActiveBatch(i).count;
+
+		finishStretch(stretch, stretchSquares, count);
+	}
+}
+
+// Measure Stretch
+CPUStretchMetrics CPUCloth::measureStretch() const
+{
+	CPUStretchMetrics metrics;
+	double squares[8];
+
+	metrics.sweeps = stretch.sweeps;
+	metrics.totalSweeps = stretch.totalSweeps;
+
+	for(int batch = 0; batch < 8; ++batch)
+	{
+		CPUConstraintBatch constraintBatch = getBatch(batch);
+		int blockCount = (batchSize[batch] + CONSTRAINT_GRAIN - 1) / CONSTRAINT_GRAIN;
+		vector<float> blockMax(blockCount), blockSquares(blockCount);
+
+		threadPool->parallelFor(blockCount, 1, [&](int first, int last)
+		{
+			for(int b = first; b < last; ++b)
+			{
+				measureStretchRange(constraintBatch, b * CONSTRAINT_GRAIN, min((b + 1) * CONSTRAINT_GRAIN, constraintBatch.count),
+					particles, blockMax[b], blockSquares[b]);
+			}
+		});
+
+		reduceStretchBlocks(blockMax.data(), blockSquares.data(), blockCount, batchSize[batch],
+			metrics.batchMax[batch], metrics.batchRMS[batch], squares[batch]);
+	}
+
+	finishStretch(metrics, squares, constraintCount);
+
+	return metrics;
+}
+
+// Finish Stretch (cloth totals from the batch results)
+void CPUCloth::finishStretch(CPUStretchMetrics& metrics, const double* squares, int count) const
+{
+	double total = 0.0;
+
+	metrics.max = 0.0f;
+
+	for(int batch = 0; batch < 8; ++batch)
+	{
+		metrics.max = max(metrics.max, metrics.batchMax[batch]);
+		total += squares[batch];
+	}
+
+	metrics.rms = count ? (float)sqrt(total / count) : 0.0f;
+}
+
+// Chebyshev Key (everything the spectral radius of a sweep depends on)
+uint64_t CPUCloth::chebyshevKey() const
+{
+	struct
+	{
+		uint32_t width, height;
+		int32_t solverMode;
+		int32_t levels, sweeps;
+		int32_t blockedSweeps;
+		float compliance[CPU_CONSTRAINT_TYPE_COUNT];
+		float timeStep;
+		float relaxation;
+	} configuration;
+
+	memset(&configuration, 0, sizeof(configuration));
+	configuration.width = width;
+	configuration.height = height;
+	configuration.solverMode = solverMode;
+	configuration.levels = isMultigridActive() ? multigrid.getLevelCount() : 1;
+	configuration.sweeps = isMultigridActive() ? multigrid.getSweeps() : 0;
+	configuration.blockedSweeps = isBlocked() ? blockedSweeps : 0;
+	configuration.compliance[CPU_CONSTRAINT_STRUCTURAL] = compliance[CPU_CONSTRAINT_STRUCTURAL];
+	configuration.compliance[CPU_CONSTRAINT_SHEAR] = compliance[CPU_CONSTRAINT_SHEAR];
+	configuration.timeStep = scheduler.getTimeStep();
+	configuration.relaxation = solverMode == CPU_SOLVER_JACOBI ? jacobiRelaxation : 0.0f;
+
+	// The inverse masses carry the anchor set (zero = pinned)
+	uint64_t seed = hashXX64(&configuration, sizeof(configuration));
+
+	return hashXX64(particles.invMass, particles.count * sizeof(float), seed);
+}
+
+// Estimate Spectral Radius (plain sweeps on a trial substep, the state is restored afterwards)
+bool CPUCloth::estimateSpectralRadius(uint64_t key)
+{
+	unsigned int count = particles.count;
+	float* arrays[6] = { particles.x, particles.y, particles.z, particles.oldX, particles.oldY, particles.oldZ };
+	vector<float> saved(count * 6);
+	vector<float> savedLambda(constraintLambda, constraintLambda + constraintCount);
+
+	for(int a = 0; a < 6; ++a)
+		memcpy(&saved[a * count], arrays[a], count * sizeof(float));
+
+	// The trial pass is left out of the collision statistics
+	vector<int> savedPairs(tileColliderPairs);
+	vector<int> savedHits(tileSweepHits);
+	long long savedSweepTotal = sweepTotal;
+
+	collideTiles(true);
+
+	if(solverMode == CPU_SOLVER_XPBD)
+		memset(constraintLambda, 0, sizeof(float) * constraintCount);
+
+	// Once the fast modes are gone the update shrinks by rho every sweep
+	double updates[ESTIMATE_SWEEPS];
+
+	chebyshev.begin(particles, false);
+
+	for(int sweep = 0; sweep < ESTIMATE_SWEEPS; ++sweep)
+	{
+		solveConstraints();
+		updates[sweep] = chebyshev.mix(particles, threadPool);
+	}
+
+	double first = updates[ESTIMATE_SWEEPS - 1 - ESTIMATE_SPAN];
+	double last = updates[ESTIMATE_SWEEPS - 1];
+	float radius = first > 0.0 ? (float)pow(last / first, 0.5 / ESTIMATE_SPAN) : 0.0f;
+	bool measured = last >= ESTIMATE_FLOOR * ESTIMATE_FLOOR * count;
+
+	// Jacobi swaps its buffers, so restore through the current pointers
+	arrays[0] = particles.x;
+	arrays[1] = particles.y;
+	arrays[2] = particles.z;
+
+	for(int a = 0; a < 6; ++a)
+		memcpy(arrays[a], &saved[a * count], count * sizeof(float));
+
+	copy(savedLambda.begin(), savedLambda.end(), constraintLambda);
+
+	tileColliderPairs.swap(savedPairs);
+	tileSweepHits.swap(savedHits);
+	sweepTotal = savedSweepTotal;
+
+	if(measured)
+		chebyshev.store(key, radius);
+
+	return measured;
+}
+
+// Get Iteration Cost
+double CPUCloth::getIterationCost() const
+{
+	// A blocked round sweeps the tile interiors blockedSweeps times and the boundaries once
+	double sweep = 1.0;
+
+	if(isBlocked() && constraintCount)
+		sweep = ((double)blockedSweeps * (constraintCount - getBoundaryConstraintCount()) + getBoundaryConstraintCount()) / constraintCount;
+
+	if(!isMultigridActive())
+		return sweep;
+
+	// Two fine sweeps, and two sweeps per cycle on every coarse level
+	double cost = 2.0 * sweep;
+
+	for(int l = 1; l < multigrid.getLevelCount(); ++l)
+		cost += 2.0 * multigrid.getSweeps() * multigrid.getConstraintCount(l) / constraintCount;
+
+	return cost;
+}
+
+// Get Collider Pairs
+int CPUCloth::getColliderPairs() const
+{
+	int pairs = 0;
+
+	for(size_t t = 0; t < tileColliderPairs.size(); ++t)
+		pairs += tileColliderPairs[t];
+
+	return pairs;
+}
+
+// Get Sweep Hits
+int CPUCloth::getSweepHits() const
+{
+	int hits = 0;
+
+	for(size_t t = 0; t < tileSweepHits.size(); ++t)
+		hits += tileSweepHits[t];
+
+	return hits;
+}
+
+// Hash State
+uint64_t CPUCloth::hashState() const
+{
+	if(!particles.count)
+		return 0;
+
+	const float* arrays[6] = { particles.x, particles.y, particles.z, particles.oldX, particles.oldY, particles.oldZ };
+	int blockCount = (int)((particles.count + HASH_BLOCK - 1) / HASH_BLOCK);
+	unsigned int count = particles.count;
+
+	// One hash per array per block, stored in a fixed order
+	vector<uint64_t> blockHashes(blockCount * 6);
+
+	threadPool->parallelFor(blockCount, 1, [&](int first, int last)
+	{
+		for(int b = first; b < last; ++b)
+		{
+			unsigned int start = b * HASH_BLOCK;
+			unsigned int length = min(count - start, (unsigned int)HASH_BLOCK);
+
+			for(int a = 0; a < 6; ++a)
+				blockHashes[b * 6 + a] = hashXX64(arrays[a] + start, length * sizeof(float), b);
+		}
+	});
+
+	return hashXX64(&blockHashes[0], blockHashes.size() * sizeof(uint64_t), count);
+}
+
+// Apply Forces (cloth_apply_forces.hlsl)
+void CPUCloth::applyForces(int first, int last)
+{
+	float timeStep = scheduler.getTimeStep();
+	float scale = 0.5f * timeStep * timeStep;
+	float forceX = forces.x * scale;
+	float forceY = forces.y * scale;
+	float forceZ = forces.z * scale;
+	double keep = verletKeep(timeStep);
+	float current = (float)(1.0 + keep);
+	float previous = (float)keep;
+
+	float* x = particles.x;
+	float* y = particles.y;
+	float* z = particles.z;
+	float* oldX = particles.oldX;
+	float* oldY = particles.oldY;
+	float* oldZ = particles.oldZ;
+	const float* invMass = particles.invMass;
+
+	for(int i = first; i < last; ++i)
+	{
+		// Verlet Integration (pinned particles stay put, selected rather than branched on)
+		bool movable = invMass[i] > 0.0f;
+		float nextX = movable ? (x[i] * current) - (oldX[i] * previous) + forceX : x[i];
+		float nextY = movable ? (y[i] * current) - (oldY[i] * previous) + forceY : y[i];
+		float nextZ = movable ? (z[i] * current) - (oldZ[i] * previous) + forceZ : z[i];
+
+		// Set old position
+		oldX[i] = x[i];
+		oldY[i] = y[i];
+		oldZ[i] = z[i];
+
+		x[i] = nextX;
+		y[i] = nextY;
+		z[i] = nextZ;
+	}
+}
+
+// Collide Tiles (cloth_collision_sphere.hlsl, for every collider whose bounds reach the tile)
+void CPUCloth::collideTiles(bool integrate)
+{
+	bool sleeping = isSleepActive();
+	bool cached = contactSteps > 0;
+
+	// Part of the colliders' motion this substep covers (discrete passes use the end pose)
+	bool sweeping = continuousCollision;
+	float motionFrom = motionSteps ? (float)motionStep / (float)motionSteps : 0.0f;
+	float motionTo = sweeping && motionSteps ? (float)(motionStep + 1) / (float)motionSteps : 1.0f;
+
+	threadPool->parallelFor((int)tiles.size(), 1, [&](int first, int last)
+	{
+		vector<int> overlaps;
+
+		for(int t = first; t < last; ++t)
+		{
+			tileColliderPairs[t] = 0;
+			tileSweepHits[t] = 0;
+
+			if(sleeping && tiles[t].asleep)
+				continue;
+
+			int runFirst = tileRunFirst[t];
+			int runLast = tileRunFirst[t + 1];
+
+			if(integrate)
+			{
+				for(int r = runFirst; r < runLast; ++r)
+					applyForces(tileRunStart[r], tileRunEnd[r]);
+			}
+
+			if(!colliders.getCount())
+				continue;
+
+			// Colliders found for the whole frame
+			if(cached)
+			{
+				tileColliderPairs[t] = (int)tileColliders[t].size();
+
+				for(size_t c = 0; c < tileColliders[t].size(); ++c)
+				{
+					for(int r = runFirst; r < runLast; ++r)
+					{
+						if(sweeping)
+							tileSweepHits[t] += colliders.sweep(tileColliders[t][c], particles, tileRunStart[r], tileRunEnd[r], motionFrom, motionTo);
+
+						colliders.collide(tileColliders[t][c], particles, tileRunStart[r], tileRunEnd[r], motionTo);
+					}
+				}
+
+				continue;
+			}
+
+			// Broadphase: the tile's bounds after the forces (and before them, for the swept
+			// paths) against every collider's
+			CPUVector3 boundsMin = particles.position(tileRunStart[runFirst]);
+			CPUVector3 boundsMax = boundsMin;
+
+			for(int r = runFirst; r < runLast; ++r)
+			{
+				for(unsigned int i = tileRunStart[r]; i < tileRunEnd[r]; ++i)
+				{
+					boundsMin.x = min(boundsMin.x, particles.x[i]);
+					boundsMin.y = min(boundsMin.y, particles.y[i]);
+					boundsMin.z = min(boundsMin.z, particles.z[i]);
+					boundsMax.x = max(boundsMax.x, particles.x[i]);
+					boundsMax.y = max(boundsMax.y, particles.y[i]);
+					boundsMax.z = max(boundsMax.z, particles.z[i]);
+				}
+
+				if(!sweeping)
+					continue;
+
+				for(unsigned int i = tileRunStart[r]; i < tileRunEnd[r]; ++i)
+				{
+					boundsMin.x = min(boundsMin.x, particles.oldX[i]);
+					boundsMin.y = min(boundsMin.y, particles.oldY[i]);
+					boundsMin.z = min(boundsMin.z, particles.oldZ[i]);
+					boundsMax.x = max(boundsMax.x, particles.oldX[i]);
+					boundsMax.y = max(boundsMax.y, particles.oldY[i]);
+					boundsMax.z = max(boundsMax.z, particles.oldZ[i]);
+				}
+			}
+
+			colliders.findOverlaps(boundsMin, boundsMax, overlaps);
+			tileColliderPairs[t] = (int)overlaps.size();
+
+			// Narrowphase, collider by collider in id order (each swept first)
+			for(size_t c = 0; c < overlaps.size(); ++c)
+			{
+				for(int r = runFirst; r < runLast; ++r)
+				{
+					if(sweeping)
+						tileSweepHits[t] += colliders.sweep(overlaps[c], particles, tileRunStart[r], tileRunEnd[r], motionFrom, motionTo);
+
+					colliders.collide(overlaps[c], particles, tileRunStart[r], tileRunEnd[r], motionTo);
+				}
+			}
+		}
+	});
+
+	if(sweeping)
+		sweepTotal += getSweepHits();
+}
+
+// Prepare Contacts (tile collider lists for the frame, and the self collision list interval)
+void CPUCloth::prepareContacts(int stepCount)
+{
+	contactSteps = 0;
+	contactSkin = 0.0f;
+	selfInterval = 1;
+	selfSteps = 0;
+	selfSkin = 0.0f;
+
+	// A single substep detects its contacts once anyway
+	if(!contactCaching || stepCount < 2 || !particles.count)
+		return;
+
+	// Bounds and fastest particle of every tile
+	float timeStep = scheduler.getTimeStep();
+	vector<CPUVector3> boundsMin(tiles.size()), boundsMax(tiles.size());
+	vector<float> tileMotion(tiles.size());
+
+	threadPool->parallelFor((int)tiles.size(), 1, [&](int first, int last)
+	{
+		for(int t = first; t < last; ++t)
+		{
+			CPUVector3 tileMin = particles.position(tileRunStart[tileRunFirst[t]]);
+			CPUVector3 tileMax = tileMin;
+			float motion = 0.0f;
+
+			for(unsigned int r = tileRunFirst[t]; r < tileRunFirst[t + 1]; ++r)
+			{
+				for(unsigned int i = tileRunStart[r]; i < tileRunEnd[r]; ++i)
+				{
+					tileMin.x = min(tileMin.x, particles.x[i]);
+					tileMin.y = min(tileMin.y, particles.y[i]);
+					tileMin.z = min(tileMin.z, particles.z[i]);
+					tileMax.x = max(tileMax.x, particles.x[i]);
+					tileMax.y = max(tileMax.y, particles.y[i]);
+					tileMax.z = max(tileMax.z, particles.z[i]);
+
+					float dx = particles.x[i] - particles.oldX[i];
+					float dy = particles.y[i] - particles.oldY[i];
+					float dz = particles.z[i] - particles.oldZ[i];
+
+					motion = max(motion, dx * dx + dy * dy + dz * dz);
+				}
+			}
+
+			boundsMin[t] = tileMin;
+			boundsMax[t] = tileMax;
+			tileMotion[t] = motion;
+		}
+	});
+
+	float speed = sqrtf(*max_element(tileMotion.begin(), tileMotion.end())) / timeStep;
+
+	// Colliders within the skin of every tile
+	contactSkin = getSkin(speed, stepCount);
+	tileColliders.resize(tiles.size());
+
+	threadPool->parallelFor((int)tiles.size(), 1, [&](int first, int last)
+	{
+		for(int t = first; t < last; ++t)
+		{
+			CPUVector3 tileMin = { boundsMin[t].x - contactSkin, boundsMin[t].y - contactSkin, boundsMin[t].z - contactSkin };
+			CPUVector3 tileMax = { boundsMax[t].x + contactSkin, boundsMax[t].y + contactSkin, boundsMax[t].z + contactSkin };
+
+			colliders.findOverlaps(tileMin, tileMax, tileColliders[t]);
+		}
+	});
+
+	contactSteps = stepCount;
+	storeOrigin(contactOrigin);
+
+	// Self collision lists cover as many substeps as the largest skin allows (two particles
+	// may close in from both sides), lists covering a single pass are not worth building
+	if(selfCollisionEnabled)
+	{
+		float largest = SELF_SKIN * selfCollision.getDistance();
+
+		while(selfInterval < stepCount && 2.0f * getSkin(speed, selfInterval) <= largest)
+			++selfInterval;
+
+		selfSkin = selfInterval > 1 ? 2.0f * getSkin(speed, selfInterval - 1) : 0.0f;
+	}
+}
+
+// Get Skin (travel at the current speed plus the forces' acceleration, with a safety factor)
+float CPUCloth::getSkin(float speed, int steps) const
+{
+	float time = scheduler.getTimeStep() * (float)steps;
+	float acceleration = sqrtf(9.8f * 9.8f + wind * wind);
+
+	return CONTACT_SAFETY * (speed * time + 0.5f * acceleration * time * time);
+}
+
+// Collide Self (directly, or over the lists of the current interval)
+void CPUCloth::collideSelf()
+{
+	const unsigned int* lattice = particleLattice.empty() ? nullptr : &particleLattice[0];
+
+	// Lists only within a frame that prepared them
+	if(selfInterval <= 1 || !contactSteps)
+	{
+		selfCollision.collide(particles, lattice, threadPool);
+		return;
+	}
+
+	if(!selfSteps)
+	{
+		selfCollision.buildLists(particles, lattice, selfSkin, threadPool);
+		selfSteps = selfInterval;
+		storeOrigin(selfOrigin);
+	}
+
+	selfCollision.solveLists(particles, threadPool);
+	--selfSteps;
+}
+
+// Check Contacts (the skins were sized from the speed at the start of the frame, a particle
+// that sped up since may outrun them: the lists are re-detected before the next substep
+// once a particle's displacement since they were built plus its travel over that substep
+// reaches the skin of the collider lists, or half the self collision skin, which two
+// particles close in from both sides)
+void CPUCloth::checkContacts()
+{
+	if(!contactSteps)
+		return;
+
+	bool selfLists = selfSteps > 0;
+	vector<float> tileMotion(tiles.size() * 3);
+
+	threadPool->parallelFor((int)tiles.size(), 1, [&](int first, int last)
+	{
+		for(int t = first; t < last; ++t)
+		{
+			float contact = 0.0f, self = 0.0f, motion = 0.0f;
+
+			for(unsigned int r = tileRunFirst[t]; r < tileRunFirst[t + 1]; ++r)
+			{
+				for(unsigned int i = tileRunStart[r]; i < tileRunEnd[r]; ++i)
+				{
+					float x = particles.x[i], y = particles.y[i], z = particles.z[i];
+					float dx = x - contactOrigin[i * 3], dy = y - contactOrigin[i * 3 + 1], dz = z - contactOrigin[i * 3 + 2];
+
+					contact = max(contact, dx * dx + dy * dy + dz * dz);
+
+					if(selfLists)
+					{
+						dx = x - selfOrigin[i * 3];
+						dy = y - selfOrigin[i * 3 + 1];
+						dz = z - selfOrigin[i * 3 + 2];
+
+						self = max(self, dx * dx + dy * dy + dz * dz);
+					}
+
+					dx = x - particles.oldX[i];
+					dy = y - particles.oldY[i];
+					dz = z - particles.oldZ[i];
+
+					motion = max(motion, dx * dx + dy * dy + dz * dz);
+				}
+			}
+
+			tileMotion[t * 3] = contact;
+			tileMotion[t * 3 + 1] = self;
+			tileMotion[t * 3 + 2] = motion;
+		}
+	});
+
+	float contact = 0.0f, self = 0.0f, motion = 0.0f;
+
+	for(size_t t = 0; t < tiles.size(); ++t)
+	{
+		contact = max(contact, tileMotion[t * 3]);
+		self = max(self, tileMotion[t * 3 + 1]);
+		motion = max(motion, tileMotion[t * 3 + 2]);
+	}
+
+	// The skins carry the safety factor already, the travel is the plain estimate
+	float travel = getSkin(sqrtf(motion) / scheduler.getTimeStep(), 1) / CONTACT_SAFETY;
+
+	// Both lists again for the substeps left, at the current speed
+	if(sqrtf(contact) + travel > contactSkin)
+	{
+		prepareContacts(contactSteps);
+		++contactRefreshes;
+	}
+	else if(selfLists && sqrtf(self) + travel > 0.5f * selfSkin)
+	{
+		selfSteps = 0;
+		++contactRefreshes;
+	}
+}
+
+// Store Origin (the particle positions a set of contact lists is built at)
+void CPUCloth::storeOrigin(vector<float>& origin) const
+{
+	origin.resize(particles.count * 3);
+
+	threadPool->parallelFor((int)particles.count, 1024, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			origin[i * 3] = particles.x[i];
+			origin[i * 3 + 1] = particles.y[i];
+			origin[i * 3 + 2] = particles.z[i];
+		}
+	});
+}
+
+// Get Batch
+CPUConstraintBatch CPUCloth::getBatch(int batch) const
+{
+	CPUConstraintBatch result;
+	result.start = constraintStart + batchStart[batch];
+	result.end = constraintEnd + batchStart[batch];
+	result.distance = constraintDistance + batchStart[batch];
+	result.count = batchSize[batch];
+
+	return result;
+}
+
+// Get Active Batch
+CPUConstraintBatch CPUCloth::getActiveBatch(int batch) const
+{
+	if(!isSleepActive())
+		return getBatch(batch);
+
+	CPUConstraintBatch result;
+	result.start = activeStart + activeBatchStart[batch];
+	result.end = activeEnd + activeBatchStart[batch];
+	result.distance = activeDistance + activeBatchStart[batch];
+	result.count = activeBatchSize[batch];
+
+	return result;
+}
+
+// Get Constraint Params (lambda is where the batch's XPBD multipliers start)
+CPUConstraintParams CPUCloth::getConstraintParams(int batch, float* lambda) const
+{
+	CPUConstraintParams params;
+	params.invMass = particles.invMass;
+	params.lambda = nullptr;
+	params.alpha = 0.0f;
+	params.stretchMax = nullptr;
+	params.stretchSquares = nullptr;
+
+	if(solverMode == CPU_SOLVER_XPBD)
+	{
+		// Batches 0 - 3 are horizontal / vertical, 4 - 7 diagonal
+		CPUConstraintType type = batch < 4 ? CPU_CONSTRAINT_STRUCTURAL : CPU_CONSTRAINT_SHEAR;
+
+		params.lambda = lambda;
+		params.alpha = compliance[type] / (scheduler.getTimeStep() * scheduler.getTimeStep());
+	}
+
+	return params;
+}
+
+// Apply Constraints (cloth_apply_constraints.hlsl)
+void CPUCloth::applyConstraints(int batch)
+{
+	CPUPositions positions;
+	positions.x = particles.x;
+	positions.y = particles.y;
+	positions.z = particles.z;
+
+	CPUConstraintParams params = getConstraintParams(batch,
+		constraintLambda + (isSleepActive() ? activeBatchStart[batch] : batchStart[batch]));
+
+	// While tiles sleep only the constraints with an awake end are projected
+	CPUConstraintBatch constraintBatch = getActiveBatch(batch);
+
+	if(!isStretchCollected())
+	{
+		threadPool->parallelFor(constraintBatch.count, CONSTRAINT_GRAIN, [&](int first, int last)
+		{
+			constraintKernel(constraintBatch, first, last, positions, params);
+		});
+
+		return;
+	}
+
+	// Fixed blocks of constraints each reduce their own stretch, so the sums do not depend
+	// on the thread count
+	int blockCount = (constraintBatch.count + CONSTRAINT_GRAIN - 1) / CONSTRAINT_GRAIN;
+
+	if((int)blockStretchMax.size() < blockCount)
+	{
+		blockStretchMax.resize(blockCount);
+		blockStretchSquares.resize(blockCount);
+	}
+
+	threadPool->parallelFor(blockCount, 1, [&](int first, int last)
+	{
+		CPUConstraintParams blockParams = params;
+
+		for(int b = first; b < last; ++b)
+		{
+			blockParams.stretchMax = &blockStretchMax[b];
+			blockParams.stretchSquares = &blockStretchSquares[b];
+
+			constraintKernel(constraintBatch, b * CONSTRAINT_GRAIN, min((b + 1) * CONSTRAINT_GRAIN, constraintBatch.count),
+				positions, blockParams);
+		}
+	});
+
+	reduceStretchBlocks(blockStretchMax.data(), blockStretchSquares.data(), blockCount, constraintBatch.count,
+		stretch.batchMax[batch], stretch.batchRMS[batch], stretchSquares[batch]);
+}
+
+// Build Blocks (the constraints of every batch sorted into tile interiors and boundaries, each
+// list keeping the batch order)
+void CPUCloth::buildBlocks()
+{
+	int tileCount = (int)tiles.size();
+	int listCount = tileCount * 8 + 8;
+	vector<int> list(constraintCount);
+
+	blockOffset.assign(listCount + 1, 0);
+
+	for(int b = 0; b < 8; ++b)
+	{
+		for(int c = batchStart[b]; c < batchStart[b] + batchSize[b]; ++c)
+		{
+			unsigned int startTile = tileOf(latticeOf(constraintStart[c]));
+			unsigned int endTile = tileOf(latticeOf(constraintEnd[c]));
+
+			list[c] = startTile == endTile ? (int)startTile * 8 + b : tileCount * 8 + b;
+			++blockOffset[list[c] + 1];
+		}
+	}
+
+	for(int l = 0; l < listCount; ++l)
+		blockOffset[l + 1] += blockOffset[l];
+
+	vector<int> next(blockOffset.begin(), blockOffset.end() - 1);
+
+	for(int c = 0; c < constraintCount; ++c)
+	{
+		int packed = next[list[c]]++;
+
+		blockStart[packed] = constraintStart[c];
+		blockEnd[packed] = constraintEnd[c];
+		blockDistance[packed] = constraintDistance[c];
+	}
+}
+
+// Apply Blocks (one round of the blocked sweeps)
+void CPUCloth::applyBlocks()
+{
+	CPUPositions positions;
+	positions.x = particles.x;
+	positions.y = particles.y;
+	positions.z = particles.z;
+
+	int tileCount = (int)tiles.size();
+	bool sleeping = isSleepActive();
+
+	// Tile interiors: a tile touches only its own particles, so the tiles run their sweeps
+	// without a barrier between colours
+	threadPool->parallelFor(tileCount, 1, [&](int first, int last)
+	{
+		for(int t = first; t < last; ++t)
+		{
+			if(sleeping && tiles[t].asleep)
+				continue;
+
+			for(int sweep = 0; sweep < blockedSweeps; ++sweep)
+			{
+				for(int b = 0; b < 8; ++b)
+				{
+					int list = t * 8 + b;
+					CPUConstraintBatch batch = getBlockBatch(list);
+					CPUConstraintParams params = getConstraintParams(b, constraintLambda + blockOffset[list]);
+
+					constraintKernel(batch, 0, batch.count, positions, params);
+				}
+			}
+		}
+	});
+
+	// Boundaries: one sweep over the constraints between tiles, a parallel pass per colour
+	for(int b = 0; b < 8; ++b)
+	{
+		int list = tileCount * 8 + b;
+		CPUConstraintBatch batch = getBlockBatch(list);
+		CPUConstraintParams params = getConstraintParams(b, constraintLambda + blockOffset[list]);
+
+		threadPool->parallelFor(batch.count, CONSTRAINT_GRAIN, [&](int first, int last)
+		{
+			constraintKernel(batch, first, last, positions, params);
+		});
+	}
+}
+
+// Get Block Batch
+CPUConstraintBatch CPUCloth::getBlockBatch(int list) const
+{
+	CPUConstraintBatch result;
+	result.start = blockStart + blockOffset[list];
+	result.end = blockEnd + blockOffset[list];
+	result.distance = blockDistance + blockOffset[list];
+	result.count = blockOffset[list + 1] - blockOffset[list];
+
+	return result;
+}
+
+// Apply Jacobi (rows of particles, read from the particles and written to the second buffer)
+void CPUCloth::applyJacobi(int firstRow, int lastRow)
+{
+	CPUJacobiSpan span;
+
+	for(int k = 0; k < 8; ++k)
+		span.rest[k] = jacobiRest[jacobiType[k]];
+
+	for(int j = firstRow; j < lastRow; ++j)
+	{
+		// The first and last columns lose their left / right neighbours, the columns between
+		// have the same set and run as one span
+		int firstColumn[3] = { 0, 1, (int)width - 1 };
+		int lastColumn[3] = { 1, (int)width - 1, (int)width };
+
+		for(int part = 0; part < 3; ++part)
+		{
+			int column = firstColumn[part];
+			float springs = 0.0f;
+
+			for(int k = 0; k < 8; ++k)
+			{
+				int neighbourColumn = column + jacobiColumn[k];
+				int neighbourRow = j + jacobiRow[k];
+				bool present = neighbourColumn >= 0 && neighbourColumn < (int)width && neighbourRow >= 0 && neighbourRow < (int)height;
+
+				span.offset[k] = present ? jacobiRow[k] * (int)width + jacobiColumn[k] : 0;
+				span.weight[k] = present ? 1.0f : 0.0f;
+				springs += span.weight[k];
+			}
+
+			unsigned int index = j * width + column;
+
+			span.x = particles.x + index;
+			span.y = particles.y + index;
+			span.z = particles.z + index;
+			span.invMass = particles.invMass + index;
+			span.outX = jacobiX + index;
+			span.outY = jacobiY + index;
+			span.outZ = jacobiZ + index;
+			span.scale = jacobiRelaxation / max(springs, 1.0f);
+
+			jacobiKernel(span, 0, lastColumn[part] - column);
+		}
+	}
+}
+
+// Rest Position (the flat grid the cloth is built as)
+CPUVector3 CPUCloth::restPosition(unsigned int latticeIndex) const
+{
+	CPUVector3 result;
+	result.x = (float)(latticeIndex % width) / (float)(width - 1);
+	result.y = 0.0f;
+	result.z = (float)(latticeIndex / width) / (float)(height - 1);
+
+	return result;
+}
+
+// Pin Anchors
+void CPUCloth::pinAnchors(bool pinned)
+{
+	for(size_t i = 0; i < anchorIndices.size(); ++i)
+	{
+		unsigned int index = slotOf(anchorIndices[i]);
+
+		if(pinned)
+		{
+			// Back to the rest position, without velocity
+			CPUVector3 position = restPosition(anchorIndices[i]);
+
+			particles.setPosition(index, position);
+			particles.oldX[index] = position.x;
+			particles.oldY[index] = position.y;
+			particles.oldZ[index] = position.z;
+		}
+
+		particles.invMass[index] = pinned ? 0.0f : freeInvMass[anchorIndices[i]];
+	}
+
+	multigridDirty = true;
+	projectiveDirty = true;
+	chebyshevDirty = true;
+	wakeTiles();
+}
+
+// Set Anchors
+void CPUCloth::setAnchors(const unsigned int* newAnchors, int newAnchorCount)
+{
+	if(!particles.count)
+		return;
+
+	// Release the previous set
+	if(anchored)
+		pinAnchors(false);
+
+	anchorIndices.clear();
+
+	for(int i = 0; i < newAnchorCount; ++i)
+	{
+		// Skip out of range and repeated indices
+		if(newAnchors[i] >= particles.count || find(anchorIndices.begin(), anchorIndices.end(), newAnchors[i]) != anchorIndices.end())
+			continue;
+
+		anchorIndices.push_back(newAnchors[i]);
+	}
+
+	if(anchored)
+		pinAnchors(true);
+
+	buildTethers();
+}
+
+// Build Tethers
+void CPUCloth::buildTethers()
+{
+	// The cloth rests flat, so the geodesic (along the cloth) distance between two
+	// particles is the straight line between their rest positions
+	vector<CPUVector3> anchorRest(anchorIndices.size());
+
+	for(size_t a = 0; a < anchorIndices.size(); ++a)
+		anchorRest[a] = restPosition(anchorIndices[a]);
+
+	for(unsigned int i = 0; i < particles.count; ++i)
+	{
+		CPUVector3 position = restPosition(latticeOf(i));
+		float nearest = 0.0f;
+
+		// Without anchors every particle tethers to itself (a no-op)
+		tetherAnchor[i] = i;
+
+		for(size_t a = 0; a < anchorRest.size(); ++a)
+		{
+			float dx = position.x - anchorRest[a].x;
+			float dz = position.z - anchorRest[a].z;
+			float distanceSq = dx * dx + dz * dz;
+
+			if(!a || distanceSq < nearest)
+			{
+				nearest = distanceSq;
+				tetherAnchor[i] = slotOf(anchorIndices[a]);
+			}
+		}
+
+		tetherLength[i] = sqrtf(nearest);
+	}
+}
+
+// Set Inverse Mass
+void CPUCloth::setInverseMass(unsigned int index, float inverseMass)
+{
+	if(index < particles.count)
+	{
+		freeInvMass[index] = max(inverseMass, 0.0f);
+
+		// Pinned anchors keep their zero inverse mass until they are released
+		if(anchored && find(anchorIndices.begin(), anchorIndices.end(), index) != anchorIndices.end())
+			return;
+
+		particles.invMass[slotOf(index)] = freeInvMass[index];
+		multigridDirty = true;
+		projectiveDirty = true;
+		chebyshevDirty = true;
+		sleepDirty = true;
+
+		if(!tiles.empty())
+			wakeTile(tileOf(index));
+	}
+}
+
+// Set Particle Order
+void CPUCloth::setParticleOrder(CPUParticleOrder order)
+{
+	if(!particles.count || order == particleOrder)
+		return;
+
+	if(order != CPU_ORDER_ROW_MAJOR && ((solverMode != CPU_SOLVER_PBD && solverMode != CPU_SOLVER_XPBD) || multigrid.getLevelCount() > 1))
+	{
+		cout << "Particles are only reordered in PBD or XPBD mode without multigrid, keeping the current order" << endl;
+		return;
+	}
+
+	// New slot of every lattice index (tiles of the sleeping tile size, so they stay contiguous)
+	vector<unsigned int> slots;
+	buildParticleOrder(order, width, height, tileSize, slots);
+
+	// Where each current slot moves to
+	unsigned int count = particles.count;
+	vector<unsigned int> moved(count);
+
+	for(unsigned int i = 0; i < count; ++i)
+		moved[slotOf(i)] = slots[i];
+
+	// Per particle arrays (the padding past count stays where it is)
+	float* floatArrays[] = { particles.x, particles.y, particles.z, particles.oldX, particles.oldY, particles.oldZ, particles.invMass,
+		particles.normalX, particles.normalY, particles.normalZ, tetherLength };
+	uint32_t* wordArrays[] = { particles.matDiffuse, particles.matSpecular, tetherAnchor };
+	vector<float> floats(count * 2);
+	vector<uint32_t> words(count);
+
+	for(size_t a = 0; a < sizeof(floatArrays) / sizeof(floatArrays[0]); ++a)
+	{
+		for(unsigned int i = 0; i < count; ++i)
+			floats[moved[i]] = floatArrays[a][i];
+
+		memcpy(floatArrays[a], &floats[0], count * sizeof(float));
+	}
+
+	for(size_t a = 0; a < sizeof(wordArrays) / sizeof(wordArrays[0]); ++a)
+	{
+		for(unsigned int i = 0; i < count; ++i)
+			words[moved[i]] = wordArrays[a][i];
+
+		memcpy(wordArrays[a], &words[0], count * sizeof(uint32_t));
+	}
+
+	for(unsigned int i = 0; i < count; ++i)
+	{
+		tetherAnchor[i] = moved[tetherAnchor[i]];
+		floats[moved[i] * 2] = particles.texCoord[i * 2];
+		floats[moved[i] * 2 + 1] = particles.texCoord[i * 2 + 1];
+	}
+
+	memcpy(particles.texCoord, &floats[0], count * 2 * sizeof(float));
+
+	// Constraints follow their particles, each batch sorted by its end slot so a sweep walks
+	// memory forwards (no two constraints of a batch share a particle, so the order within a
+	// batch changes no result; row major gets back the order the batches were built in)
+	vector<CPUConstraint> batch;
+
+	for(int b = 0; b < 8; ++b)
+	{
+		batch.resize(batchSize[b]);
+
+		for(int c = 0; c < batchSize[b]; ++c)
+		{
+			batch[c].start = moved[constraintStart[batchStart[b] + c]];
+			batch[c].end = moved[constraintEnd[batchStart[b] + c]];
+			batch[c].distance = constraintDistance[batchStart[b] + c];
+		}
+
+		sort(batch.begin(), batch.end(), [](const CPUConstraint& a, const CPUConstraint& b) { return a.end < b.end; });
+
+		for(int c = 0; c < batchSize[b]; ++c)
+		{
+			constraintStart[batchStart[b] + c] = batch[c].start;
+			constraintEnd[batchStart[b] + c] = batch[c].end;
+			constraintDistance[batchStart[b] + c] = batch[c].distance;
+		}
+	}
+
+	for(unsigned int k = 0; k < getIndexCount(); ++k)
+		indices[k] = moved[indices[k]];
+
+	particleOrder = order;
+	particleSlot.clear();
+	particleLattice.clear();
+
+	if(order != CPU_ORDER_ROW_MAJOR)
+	{
+		particleSlot.swap(slots);
+		particleLattice.resize(count);
+
+		for(unsigned int i = 0; i < count; ++i)
+			particleLattice[particleSlot[i]] = i;
+	}
+
+	// The tiles are laid over the new slots (all awake), and the solvers built on the old
+	// ones are rebuilt when next selected
+	buildTiles();
+
+	if(blockedSweeps > 0)
+		buildBlocks();
+
+	implicitBuilt = false;
+	blockDescentBuilt = false;
+	projectiveDirty = true;
+	chebyshevDirty = true;
+}
+
+// Update Normals
+void CPUCloth::updateNormals()
+{
+	if(!particles.count)
+		return;
+
+	// Rows are independent in both passes, hand out enough rows to make a useful share
+	int rowGrain = max(1, PARTICLE_GRAIN / (int)width);
+
+	if(particleSlot.empty())
+	{
+		threadPool->parallelFor(height - 1, rowGrain, [this](int first, int last)
+		{
+			computeFaceNormals(particles.x, particles.y, particles.z, first, last);
+		});
+
+		threadPool->parallelFor(height, rowGrain, [this](int first, int last)
+		{
+			accumulateNormals(particles.normalX, particles.normalY, particles.normalZ, first, last);
+		});
+
+		return;
+	}
+
+	// Reordered particles are gathered into row major rows first (the Jacobi buffers are free
+	// outside its sweeps, and the positions are done with once the faces are), the normals
+	// are scattered back afterwards
+	float* rowX = jacobiX;
+	float* rowY = jacobiY;
+	float* rowZ = jacobiZ;
+
+	threadPool->parallelFor(particles.count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			unsigned int slot = particleSlot[i];
+
+			rowX[i] = particles.x[slot];
+			rowY[i] = particles.y[slot];
+			rowZ[i] = particles.z[slot];
+		}
+	});
+
+	threadPool->parallelFor(height - 1, rowGrain, [&](int first, int last)
+	{
+		computeFaceNormals(rowX, rowY, rowZ, first, last);
+	});
+
+	threadPool->parallelFor(height, rowGrain, [&](int first, int last)
+	{
+		accumulateNormals(rowX, rowY, rowZ, first, last);
+	});
+
+	threadPool->parallelFor(particles.count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			unsigned int slot = particleSlot[i];
+
+			particles.normalX[slot] = rowX[i];
+			particles.normalY[slot] = rowY[i];
+			particles.normalZ[slot] = rowZ[i];
+		}
+	});
+}
+
+// Compute Face Normals (the two triangles of every quad, wound as in the index buffer)
+void CPUCloth::computeFaceNormals(const float* x, const float* y, const float* z, int firstRow, int lastRow)
+{
+	int stride = width + 1;
+
+	for(int j = firstRow; j < lastRow; ++j)
+	{
+		// Vertex rows j and j + 1 into face row j (offset by the border)
+		unsigned int top = j * width;
+		unsigned int bottom = top + width;
+		int face = (j + 1) * stride + 1;
+
+		computeFaceRow(x + top, y + top, z + top, x + bottom, y + bottom, z + bottom,
+			faceAX + face, faceAY + face, faceAZ + face, faceBX + face, faceBY + face, faceBZ + face, width - 1);
+	}
+}
+
+// Accumulate Normals
+void CPUCloth::accumulateNormals(float* normalX, float* normalY, float* normalZ, int firstRow, int lastRow)
+{
+	int stride = width + 1;
+
+	for(int j = firstRow; j < lastRow; ++j)
+	{
+		// Face rows j - 1 and j (offset by the border)
+		int above = j * stride;
+		int below = above + stride;
+
+		accumulateNormalRow(faceAX + above, faceAY + above, faceAZ + above, faceBX + above, faceBY + above, faceBZ + above,
+			faceAX + below, faceAY + below, faceAZ + below, faceBX + below, faceBY + below, faceBZ + below,
+			normalX + j * width, normalY + j * width, normalZ + j * width, width);
+	}
+}
+
+// Apply Tethers (unilateral: only pulls a particle back when it is too far away)
+void CPUCloth::applyTethers(int first, int last)
+{
+	float* x = particles.x;
+	float* y = particles.y;
+	float* z = particles.z;
+	const float* invMass = particles.invMass;
+
+	for(int i = first; i < last; ++i)
+	{
+		unsigned int anchor = tetherAnchor[i];
+
+		float dx = x[i] - x[anchor];
+		float dy = y[i] - y[anchor];
+		float dz = z[i] - z[anchor];
+		float lengthSq = dx * dx + dy * dy + dz * dz;
+		float limit = tetherLength[i] * tetherScale;
+
+		if(lengthSq > limit * limit && invMass[i] > 0.0f)
+		{
+			float scale = limit / sqrtf(lengthSq);
+
+			x[i] = x[anchor] + dx * scale;
+			y[i] = y[anchor] + dy * scale;
+			z[i] = z[anchor] + dz * scale;
+		}
+	}
+}
+
+// For Each Awake Span (every particle when no tile sleeps)
+void CPUCloth::forEachAwakeSpan(const CPUThreadPool::Task& task)
+{
+	if(!isSleepActive())
+	{
+		threadPool->parallelFor(particles.count, PARTICLE_GRAIN, task);
+		return;
+	}
+
+	threadPool->parallelFor((int)spanStart.size(), 1, [&](int first, int last)
+	{
+		for(int s = first; s < last; ++s)
+			task(spanStart[s], spanEnd[s]);
+	});
+}
+
+// Build Tiles
+void CPUCloth::buildTiles()
+{
+	tileColumns = (width + tileSize - 1) / tileSize;
+	tileRows = (height + tileSize - 1) / tileSize;
+	tiles.assign(tileColumns * tileRows, CPUSleepTile());
+	tileColliderPairs.assign(tiles.size(), 0);
+	tileSweepHits.assign(tiles.size(), 0);
+	awakeTileCount = (int)tiles.size();
+	sleepDirty = true;
+
+	// Bounds of the flat cloth, updated every step a tile is awake
+	for(unsigned int t = 0; t < tiles.size(); ++t)
+	{
+		unsigned int firstColumn = (t % tileColumns) * tileSize;
+		unsigned int firstRow = (t / tileColumns) * tileSize;
+
+		tiles[t].boundsMin = restPosition(firstRow * width + firstColumn);
+		tiles[t].boundsMax = restPosition((min(firstRow + tileSize, height) - 1) * width + min(firstColumn + tileSize, width) - 1);
+	}
+
+	// Slots of every tile in increasing order, split where they stop being consecutive (one
+	// run per row while row major, one per tile in the Morton and tiled orders)
+	tileRunFirst.assign(1, 0);
+	tileRunStart.clear();
+	tileRunEnd.clear();
+
+	vector<unsigned int> slots;
+
+	for(unsigned int t = 0; t < tiles.size(); ++t)
+	{
+		unsigned int firstColumn = (t % tileColumns) * tileSize;
+		unsigned int firstRow = (t / tileColumns) * tileSize;
+
+		slots.clear();
+
+		for(unsigned int j = firstRow; j < min(firstRow + tileSize, height); ++j)
+		{
+			for(unsigned int i = firstColumn; i < min(firstColumn + tileSize, width); ++i)
+				slots.push_back(slotOf(j * width + i));
+		}
+
+		sort(slots.begin(), slots.end());
+
+		for(size_t s = 0; s < slots.size(); ++s)
+		{
+			if(s && slots[s] == tileRunEnd.back())
+			{
+				++tileRunEnd.back();
+			}
+			else
+			{
+				tileRunStart.push_back(slots[s]);
+				tileRunEnd.push_back(slots[s] + 1);
+			}
+		}
+
+		tileRunFirst.push_back((unsigned int)tileRunStart.size());
+	}
+}
+
+// Update Active Set (pinned masses, awake spans and packed constraints of the current tiles)
+void CPUCloth::updateActiveSet()
+{
+	memcpy(activeInvMass, particles.invMass, particles.count * sizeof(float));
+	spanStart.clear();
+	spanEnd.clear();
+
+	// Runs of the awake tiles in slot order (run start in the high half, end in the low)
+	vector<uint64_t> awakeRuns;
+
+	for(unsigned int t = 0; t < tiles.size(); ++t)
+	{
+		for(unsigned int r = tileRunFirst[t]; r < tileRunFirst[t + 1]; ++r)
+		{
+			if(tiles[t].asleep)
+				fill(activeInvMass + tileRunStart[r], activeInvMass + tileRunEnd[r], 0.0f);
+			else
+				awakeRuns.push_back(((uint64_t)tileRunStart[r] << 32) | tileRunEnd[r]);
+		}
+	}
+
+	sort(awakeRuns.begin(), awakeRuns.end());
+
+	for(size_t r = 0; r < awakeRuns.size(); ++r)
+	{
+		int first = (int)(awakeRuns[r] >> 32);
+		int last = (int)(uint32_t)awakeRuns[r];
+
+		// Consecutive awake particles (across rows too) share a span of up to PARTICLE_GRAIN
+		if(!spanEnd.empty() && spanEnd.back() == first && last - spanStart.back() <= PARTICLE_GRAIN)
+		{
+			spanEnd.back() = last;
+		}
+		else
+		{
+			spanStart.push_back(first);
+			spanEnd.push_back(last);
+		}
+	}
+
+	// Constraints with at least one awake end, packed batch after batch in their original order
+	int packed = 0;
+
+	for(int b = 0; b < 8; ++b)
+	{
+		activeBatchStart[b] = packed;
+
+		for(int c = batchStart[b]; c < batchStart[b] + batchSize[b]; ++c)
+		{
+			unsigned int start = constraintStart[c];
+			unsigned int end = constraintEnd[c];
+
+			if(tiles[tileOf(latticeOf(start))].asleep && tiles[tileOf(latticeOf(end))].asleep)
+				continue;
+
+			activeStart[packed] = start;
+			activeEnd[packed] = end;
+			activeDistance[packed] = constraintDistance[c];
+			++packed;
+		}
+
+		activeBatchSize[b] = packed - activeBatchStart[b];
+	}
+
+	// The coarse levels pin what the fine level pins
+	multigridDirty = true;
+	sleepDirty = false;
+}
+
+// Update Tiles
+void CPUCloth::updateTiles()
+{
+	float timeStep = scheduler.getTimeStep();
+	float scale = 0.5f / (timeStep * timeStep);
+	const float* x = particles.x;
+	const float* y = particles.y;
+	const float* z = particles.z;
+	const float* oldX = particles.oldX;
+	const float* oldY = particles.oldY;
+	const float* oldZ = particles.oldZ;
+	const float* invMass = particles.invMass;
+
+	// Energy and bounds of every awake tile, each summed in slot order
+	threadPool->parallelFor((int)tiles.size(), 1, [&](int first, int last)
+	{
+		for(int t = first; t < last; ++t)
+		{
+			CPUSleepTile& tile = tiles[t];
+
+			if(tile.asleep)
+				continue;
+
+			CPUVector3 boundsMin = particles.position(tileRunStart[tileRunFirst[t]]);
+			CPUVector3 boundsMax = boundsMin;
+			float energy = 0.0f;
+			int movable = 0;
+
+			for(unsigned int r = tileRunFirst[t]; r < tileRunFirst[t + 1]; ++r)
+			{
+				for(unsigned int i = tileRunStart[r]; i < tileRunEnd[r]; ++i)
+				{
+					float dx = x[i] - oldX[i];
+					float dy = y[i] - oldY[i];
+					float dz = z[i] - oldZ[i];
+
+					if(invMass[i] > 0.0f)
+					{
+						energy += dx * dx + dy * dy + dz * dz;
+						++movable;
+					}
+
+					boundsMin.x = min(boundsMin.x, x[i]);
+					boundsMin.y = min(boundsMin.y, y[i]);
+					boundsMin.z = min(boundsMin.z, z[i]);
+					boundsMax.x = max(boundsMax.x, x[i]);
+					boundsMax.y = max(boundsMax.y, y[i]);
+					boundsMax.z = max(boundsMax.z, z[i]);
+				}
+			}
+
+			tile.energy = movable ? energy * scale / movable : 0.0f;
+			tile.quietSteps = tile.energy < sleepThreshold ? tile.quietSteps + 1 : 0;
+			tile.boundsMin = boundsMin;
+			tile.boundsMax = boundsMax;
+		}
+	});
+
+	// Fast tiles wake their sleeping neighbours and long quiet tiles sleep, both decided from
+	// this step's energies before either is applied
+	vector<unsigned int> woken, sleepers;
+
+	for(unsigned int t = 0; t < tiles.size(); ++t)
+	{
+		if(tiles[t].asleep)
+			continue;
+
+		if(tiles[t].quietSteps >= sleepSteps)
+			sleepers.push_back(t);
+
+		if(tiles[t].energy < sleepThreshold * WAKE_FACTOR)
+			continue;
+
+		int column = (int)(t % tileColumns);
+		int row = (int)(t / tileColumns);
+
+		for(int r = max(row - 1, 0); r <= min(row + 1, (int)tileRows - 1); ++r)
+		{
+			for(int c = max(column - 1, 0); c <= min(column + 1, (int)tileColumns - 1); ++c)
+			{
+				if(tiles[r * tileColumns + c].asleep)
+					woken.push_back(r * tileColumns + c);
+			}
+		}
+	}
+
+	for(size_t w = 0; w < woken.size(); ++w)
+		wakeTile(woken[w]);
+
+	for(size_t s = 0; s < sleepers.size(); ++s)
+	{
+		CPUSleepTile& tile = tiles[sleepers[s]];
+
+		// Stopped dead, so the tile wakes without velocity
+		for(unsigned int r = tileRunFirst[sleepers[s]]; r < tileRunFirst[sleepers[s] + 1]; ++r)
+		{
+			unsigned int first = tileRunStart[r];
+			unsigned int last = tileRunEnd[r];
+
+			copy(particles.x + first, particles.x + last, particles.oldX + first);
+			copy(particles.y + first, particles.y + last, particles.oldY + first);
+			copy(particles.z + first, particles.z + last, particles.oldZ + first);
+		}
+
+		tile.asleep = true;
+		tile.energy = 0.0f;
+		--awakeTileCount;
+		sleepDirty = true;
+		multigridDirty = true;
+	}
+}
+
+// Wake Tile
+void CPUCloth::wakeTile(unsigned int tile)
+{
+	if(!tiles[tile].asleep)
+		return;
+
+	tiles[tile].asleep = false;
+	tiles[tile].quietSteps = 0;
+	++awakeTileCount;
+	sleepDirty = true;
+	multigridDirty = true;
+}
+
+// Wake Tiles Near (tiles whose bounds come within a lattice spacing of the collider)
+void CPUCloth::wakeTilesNear(int collider)
+{
+	float reach = 1.0f / (float)(min(width, height) - 1);
+
+	for(unsigned int t = 0; t < tiles.size(); ++t)
+	{
+		if(tiles[t].asleep && colliders.overlaps(collider, tiles[t].boundsMin, tiles[t].boundsMax, reach))
+			wakeTile(t);
+	}
+}
+
+// Set Instruction Set
+void CPUCloth::setInstructionSet(CPUInstructionSet isa)
+{
+	CPUInstructionSet supported = detectInstructionSet();
+
+	instructionSet = (isa > supported) ? supported : isa;
+	constraintKernel = getConstraintKernel(instructionSet);
+	jacobiKernel = getJacobiKernel(instructionSet);
+}
+
+// Set Thread Count
+void CPUCloth::setThreadCount(int threadCount)
+{
+	delete threadPool;
+	threadPool = new CPUThreadPool(threadCount);
+}
+
+// Solver Settings
+void CPUCloth::setSolverMode(CPUSolverMode mode)
+{
+	if(mode != CPU_SOLVER_PBD && mode != CPU_SOLVER_XPBD && !particleSlot.empty())
+	{
+		cout << "Only the PBD and XPBD solvers run on reordered particles, keeping the current solver" << endl;
+		return;
+	}
+
+	if(mode == CPU_SOLVER_IMPLICIT && !implicitBuilt && particles.count)
+	{
+		CPUConstraintBatch batches[8];
+
+		for(int i = 0; i < 8; ++i)
+			batches[i] = getBatch(i);
+
+		implicitBuilt = implicitSolver.build(particles.count, batches);
+
+		if(!implicitBuilt)
+		{
+			cout << "Implicit solver could not be built, keeping the current solver" << endl;
+			return;
+		}
+	}
+
+	if(mode == CPU_SOLVER_VBD && !blockDescentBuilt && particles.count)
+	{
+		CPUConstraintBatch batches[8];
+
+		for(int i = 0; i < 8; ++i)
+			batches[i] = getBatch(i);
+
+		blockDescentBuilt = blockDescentSolver.build(width, height, batches);
+
+		if(!blockDescentBuilt)
+		{
+			cout << "Vertex block descent could not colour the cloth, keeping the current solver" << endl;
+			return;
+		}
+	}
+
+	solverMode = mode;
+	chebyshevDirty = true;
+	wakeTiles();
+}
+
+void CPUCloth::setCompliance(CPUConstraintType type, float newCompliance)
+{
+	compliance[type] = max(newCompliance, 0.0f);
+	chebyshevDirty = true;
+	wakeTiles();
+}
+
+void CPUCloth::setChebyshev(bool enabled)
+{
+	chebyshevEnabled = enabled;
+	chebyshevDirty = true;
+}
+
+void CPUCloth::setBlockedSweeps(int sweeps)
+{
+	if(!particles.count)
+		return;
+
+	blockedSweeps = max(sweeps, 0);
+	chebyshevDirty = true;
+
+	if(blockedSweeps > 0)
+		buildBlocks();
+}
+
+void CPUCloth::setJacobiRelaxation(float relaxation)
+{
+	jacobiRelaxation = min(max(relaxation, 0.01f), 1.99f);
+	chebyshevDirty = true;
+}
+
+void CPUCloth::setStiffness(CPUConstraintType type, float stiffness)
+{
+	CPUImplicitSettings settings = implicitSolver.getSettings();
+	settings.stiffness[type] = stiffness;
+
+	implicitSolver.setSettings(settings);
+
+	CPUProjectiveSettings projectiveSettings = projectiveSolver.getSettings();
+	projectiveSettings.stiffness[type] = stiffness;
+
+	projectiveSolver.setSettings(projectiveSettings);
+
+	CPUBlockDescentSettings blockDescentSettings = blockDescentSolver.getSettings();
+	blockDescentSettings.stiffness[type] = stiffness;
+
+	blockDescentSolver.setSettings(blockDescentSettings);
+}
+
+void CPUCloth::setDamping(float damping)
+{
+	CPUImplicitSettings settings = implicitSolver.getSettings();
+	settings.damping = damping;
+
+	implicitSolver.setSettings(settings);
+
+	CPUBlockDescentSettings blockDescentSettings = blockDescentSolver.getSettings();
+	blockDescentSettings.damping = damping;
+
+	blockDescentSolver.setSettings(blockDescentSettings);
+}
+
+void CPUCloth::setImplicitTolerance(float tolerance, int maxIterations)
+{
+	CPUImplicitSettings settings = implicitSolver.getSettings();
+	settings.tolerance = tolerance;
+	settings.maxIterations = maxIterations;
+
+	implicitSolver.setSettings(settings);
+}
+
+void CPUCloth::setAndersonWindow(int window)
+{
+	CPUProjectiveSettings settings = projectiveSolver.getSettings();
+	settings.andersonWindow = window;
+
+	projectiveSolver.setSettings(settings);
+}
+
+void CPUCloth::setFactorCache(const string& directory)
+{
+	projectiveSolver.setCacheDirectory(directory);
+}
+
+void CPUCloth::setTimeStep(float newTimeStep)
+{
+	scheduler.setTimeStep(newTimeStep);
+	projectiveDirty = true;
+	chebyshevDirty = true;
+	wakeTiles();
+}
+
+void CPUCloth::setIterations(int newIterations)
+{
+	iterations = max(newIterations, 1);
+}
+
+void CPUCloth::setStretchMetrics(bool enabled)
+{
+	stretchEnabled = enabled;
+}
+
+void CPUCloth::setIterationTolerance(float tolerance)
+{
+	iterationTolerance = max(tolerance, 0.0f);
+}
+
+void CPUCloth::setIterationBudget(float seconds)
+{
+	iterationBudget = max(seconds, 0.0f);
+}
+
+void CPUCloth::setMultigridLevels(int levels)
+{
+	if(!particles.count)
+		return;
+
+	if(levels > 1 && !particleSlot.empty())
+	{
+		cout << "Multigrid needs the row major particle order, solving on the cloth alone" << endl;
+		levels = 1;
+	}
+
+	if(!multigrid.build(width, height, levels))
+		cout << "Multigrid levels could not be allocated, solving on the cloth alone" << endl;
+
+	multigridDirty = true;
+	chebyshevDirty = true;
+}
+
+void CPUCloth::setMultigridSweeps(int sweeps)
+{
+	multigrid.setSweeps(sweeps);
+	chebyshevDirty = true;
+}
+
+void CPUCloth::setMaxSubsteps(int maxSubsteps)
+{
+	scheduler.setMaxSubsteps(maxSubsteps);
+}
+
+// Determinism
+void CPUCloth::setDeterministic(float frameRate)
+{
+	scheduler.setFixedFrameRate(frameRate);
+}
+
+void CPUCloth::setHashInterval(int interval)
+{
+	hashInterval = max(interval, 0);
+	stateHashes.clear();
+}
+
+// Self Collision
+void CPUCloth::setSelfCollision(bool enabled)
+{
+	selfCollisionEnabled = enabled;
+	wakeTiles();
+}
+
+void CPUCloth::setSelfThickness(float thickness)
+{
+	selfCollision.setThickness(thickness);
+	wakeTiles();
+}
+
+void CPUCloth::setSelfExclusion(int steps)
+{
+	selfCollision.setExclusion(steps);
+	wakeTiles();
+}
+
+// Contact Caching
+void CPUCloth::setContactCaching(bool enabled)
+{
+	contactCaching = enabled;
+}
+
+// Continuous Collision
+void CPUCloth::setContinuousCollision(bool enabled)
+{
+	continuousCollision = enabled;
+	wakeTiles();
+}
+
+// Tethers
+void CPUCloth::setTethers(bool enabled)
+{
+	tethered = enabled;
+	wakeTiles();
+}
+
+void CPUCloth::setTetherScale(float scale)
+{
+	tetherScale = max(scale, 1.0f);
+	wakeTiles();
+}
+
+void CPUCloth::setSleeping(bool enabled)
+{
+	sleepEnabled = enabled;
+	wakeTiles();
+}
+
+void CPUCloth::setSleepThreshold(float energy)
+{
+	sleepThreshold = max(energy, 0.0f);
+}
+
+void CPUCloth::setSleepSteps(int steps)
+{
+	sleepSteps = max(steps, 1);
+}
+
+void CPUCloth::wakeTiles()
+{
+	for(unsigned int t = 0; t < tiles.size(); ++t)
+		wakeTile(t);
+
+	sleepDirty = true;
+}
+
+int CPUCloth::addCollider(const CPUSphere& sphere)
+{
+	int id = colliders.add(sphere);
+	wakeTilesNear(id);
+
+	return id;
+}
+
+int CPUCloth::addCollider(const CPUCapsule& capsule)
+{
+	int id = colliders.add(capsule);
+	wakeTilesNear(id);
+
+	return id;
+}
+
+int CPUCloth::addCollider(const CPUPlane& plane)
+{
+	int id = colliders.add(plane);
+	wakeTilesNear(id);
+
+	return id;
+}
+
+int CPUCloth::addCollider(const CPUBox& box)
+{
+	int id = colliders.add(box);
+	wakeTilesNear(id);
+
+	return id;
+}
+
+int CPUCloth::addCollider(const CPUFieldCollider& field)
+{
+	int id = colliders.add(field);
+	wakeTilesNear(id);
+
+	return id;
+}
+
+void CPUCloth::setCollider(int id, const CPUSphere& sphere)
+{
+	if(id < 0 || id >= colliders.getCount())
+		return;
+
+	wakeTilesNear(id);
+	colliders.set(id, sphere);
+	wakeTilesNear(id);
+}
+
+void CPUCloth::setCollider(int id, const CPUCapsule& capsule)
+{
+	if(id < 0 || id >= colliders.getCount())
+		return;
+
+	wakeTilesNear(id);
+	colliders.set(id, capsule);
+	wakeTilesNear(id);
+}
+
+void CPUCloth::setCollider(int id, const CPUPlane& plane)
+{
+	if(id < 0 || id >= colliders.getCount())
+		return;
+
+	wakeTilesNear(id);
+	colliders.set(id, plane);
+	wakeTilesNear(id);
+}
+
+void CPUCloth::setCollider(int id, const CPUBox& box)
+{
+	if(id < 0 || id >= colliders.getCount())
+		return;
+
+	wakeTilesNear(id);
+	colliders.set(id, box);
+	wakeTilesNear(id);
+}
+
+void CPUCloth::setCollider(int id, const CPUFieldCollider& field)
+{
+	if(id < 0 || id >= colliders.getCount())
+		return;
+
+	wakeTilesNear(id);
+	colliders.set(id, field);
+	wakeTilesNear(id);
+}
+
+void CPUCloth::removeCollider(int id)
+{
+	if(id < 0 || id >= colliders.getCount())
+		return;
+
+	wakeTilesNear(id);
+	colliders.remove(id);
+}
+
+void CPUCloth::clearColliders()
+{
+	for(int c = 0; c < colliders.getCount(); ++c)
+		wakeTilesNear(c);
+
+	colliders.clear();
+}
+
+void CPUCloth::setSphere(const CPUVector3& position, float radius)
+{
+	CPUSphere sphere;
+	sphere.position = position;
+	sphere.radius = radius;
+
+	int id = colliders.find(CPU_COLLIDER_SPHERE);
+
+	if(id >= 0)
+		setCollider(id, sphere);
+	else
+		addCollider(sphere);
+}
+
+// Controls
+void CPUCloth::switchAnchors()
+{
+	anchored = !anchored;
+	pinAnchors(anchored);
+}
+
+void CPUCloth::switchForces()
+{
+	force = !force;
+}
+
+void CPUCloth::increaseWind()
+{
+	if(wind < 20)
+	{
+		wind += 2.0f;
+		wakeTiles();
+	}
+}
+
+void CPUCloth::decreaseWind()
+{
+	if(wind > -20)
+	{
+		wind -= 2.0f;
+		wakeTiles();
+	}
+}
+
+void CPUCloth::zeroWind()
+{
+	if(wind != 0)
+	{
+		wind = 0;
+		wakeTiles();
+	}
+}
@@ -0,0 +1,593 @@
+// ------------------------------------------------
+// Class:	CPU Cloth Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUCLOTH
+#define CPUCLOTH
+
+// INCLUDES
+#include "CPUParticles.h"
+#include "CPUConstraintKernel.h"
+#include "CPUThreadPool.h"
+#include "CPUStepScheduler.h"
+#include "CPUMultigrid.h"
+#include "CPUImplicitSolver.h"
+#include "CPUProjectiveSolver.h"
+#include "CPUBlockDescentSolver.h"
+#include "CPUChebyshev.h"
+#include "CPUParticleOrder.h"
+#include "CPUColliders.h"
+#include "CPUSelfCollision.h"
+
+// Standard includes
+#include <vector>
+
+#pragma region Buffer Structures
+// Linkage information (spring constraints)
+struct CPUConstraint
+{
+	// Two indexes to connected vertices
+	unsigned int start, end;
+
+	// Float detailing the rest distance
+	float distance;
+};
+#pragma endregion
+
+// State hash recorded every hash interval steps
+struct CPUStateHash
+{
+	long long step;	// Steps taken when the hash was taken
+	uint64_t hash;	// hashState() at that point
+};
+
+// Relative stretch |length - rest| / rest of the constraints, per batch and over the cloth
+struct CPUStretchMetrics
+{
+	float batchMax[8];
+	float batchRMS[8];
+	float max;
+	float rms;
+	int sweeps;				// Sweeps run by the last position based substep
+	long long totalSweeps;	// and by all of them since construction
+};
+
+// Square block of particles that sleeps as a whole once it stops moving
+struct CPUSleepTile
+{
+	float energy;			// Kinetic energy per unit mass (m^2 / s^2) of the last step, mean over the movable particles
+	int quietSteps;			// Consecutive steps below the sleep threshold
+	bool asleep;
+	CPUVector3 boundsMin;	// Bounds of the particles when last awake
+	CPUVector3 boundsMax;
+};
+
+// Constraint solver modes
+enum CPUSolverMode
+{
+	CPU_SOLVER_PBD = 0,	// Position based (stiffness depends on step rate and iteration count)
+	CPU_SOLVER_XPBD,	// Extended position based (stiffness set by compliance)
+	CPU_SOLVER_IMPLICIT,	// Backward Euler springs (stiffness in N/m, stable at a full frame time step)
+	CPU_SOLVER_PROJECTIVE,	// Projective dynamics springs (same stiffness, prefactored global solve)
+	CPU_SOLVER_VBD,			// Vertex block descent (same stiffness, per particle Newton steps over vertex colours)
+	CPU_SOLVER_JACOBI		// Position based, every particle gathers its own corrections (no colours)
+};
+
+// Constraint types, each with its own XPBD compliance
+enum CPUConstraintType
+{
+	CPU_CONSTRAINT_STRUCTURAL = 0,	// Horizontal and vertical batches
+	CPU_CONSTRAINT_SHEAR,			// Diagonal batches
+	CPU_CONSTRAINT_TYPE_COUNT
+};
+
+// Portable (Direct X free) cloth class, runs the same pipeline as DXCloth on the CPU
+class CPUCloth
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Attributes
+	unsigned int width, height; // Dimensions of cloth on the (x, z) plane
+
+	// Buffers
+	CPUParticles particles;
+	unsigned int* indices;
+
+	// Colliders (a sphere below the cloth by default), and the colliders that passed each
+	// tile's broadphase in the last collision pass
+	CPUColliderWorld colliders;
+	std::vector<int> tileColliderPairs;
+
+	// Continuous collision (off by default): colliders set between frames move through the
+	// frame's substeps (substep motionStep of motionSteps, 0 when stepped directly) and every
+	// substep sweeps the particles' paths against them before the discrete pass. The particles
+	// each tile's sweeps stopped in the last collision pass, and in all of them.
+	bool continuousCollision;
+	int motionStep, motionSteps;
+	std::vector<int> tileSweepHits;
+	long long sweepTotal;
+
+	// Contacts of the cloth with itself (off by default), one pass per substep after the solve
+	CPUSelfCollision selfCollision;
+	bool selfCollisionEnabled;
+
+	// Contact caching across the substeps of a frame (on by default): the colliders each tile
+	// can reach within the frame are found once at its start (the tile bounds grown by the
+	// skin, the furthest a particle can travel in the frame), and the self collision lists are
+	// built for as many substeps at a time as a skin of at most SELF_SKIN contact distances
+	// covers. Both are dropped at the end of the frame, or re-detected within it once a particle
+	// has moved further from where they were built than their skin allows.
+	bool contactCaching;
+	int contactSteps;	// Substeps the tile collider lists still cover (0 = detect in every pass)
+	float contactSkin;	// Margin of the tile collider lists (m)
+	int selfInterval;	// Substeps a set of self collision lists covers (1 = detect in every pass)
+	int selfSteps;		// Substeps the current self collision lists still cover
+	float selfSkin;		// Skin of the self collision lists (m)
+	long long contactFrames;
+	long long contactRefreshes;
+	std::vector<std::vector<int> > tileColliders;
+	std::vector<float> contactOrigin;	// Particle positions (x, y, z per particle) the tile collider lists were built at
+	std::vector<float> selfOrigin;		// and the self collision lists
+
+	// Memory order of the particle arrays: the storage slot of every lattice index (row * width
+	// + column) and the lattice index of every slot, both empty while row major
+	CPUParticleOrder particleOrder;
+	std::vector<unsigned int> particleSlot, particleLattice;
+
+	// Constraints (structure of arrays, packed batch after batch)
+	unsigned int* constraintStart;
+	unsigned int* constraintEnd;
+	float* constraintDistance;
+
+	// Anchors (lattice indices, pinned through a zero inverse mass while anchored is set), and
+	// the inverse mass of every particle when free (by lattice index, set through setInverseMass),
+	// which released anchors go back to
+	std::vector<unsigned int> anchorIndices;
+	std::vector<float> freeInvMass;
+
+	// Tethers (long range attachments): each particle may be no further from its nearest
+	// anchor than the rest distance between them (times tetherScale)
+	bool tethered;
+	float tetherScale;
+	unsigned int* tetherAnchor;
+	float* tetherLength;
+
+	// Timing (fixed steps with a per frame budget)
+	CPUStepScheduler scheduler;
+	long long stepIndex; // Steps taken since construction
+
+	// State hashes (every hashInterval steps, 0 = off)
+	int hashInterval;
+	std::vector<CPUStateHash> stateHashes;
+
+	// Forces & Control variables
+	float wind;
+	CPUVector3 forces;
+	bool anchored;
+	bool force;
+
+	// Batch sizes and starting offsets into the constraint buffer
+	int batchSize[8];
+	int batchStart[8];
+	int constraintCount;
+
+	// Constraint projection kernels (picked from the instruction set at startup)
+	CPUInstructionSet instructionSet;
+	CPUConstraintKernel constraintKernel;
+	CPUJacobiKernel jacobiKernel;
+
+	// Persistent worker pool, each colour is one parallel-for over it
+	CPUThreadPool* threadPool;
+
+	// Solver settings
+	CPUSolverMode solverMode;
+	float compliance[CPU_CONSTRAINT_TYPE_COUNT]; // Inverse stiffness (m / N), XPBD only
+	int iterations; // Constraint sweeps per substep
+
+	// XPBD Lagrange multipliers (one per constraint, reset every substep)
+	float* constraintLambda;
+
+	// Jacobi mode: each sweep writes the new positions here and swaps them with the particles'.
+	// Rest distances of the horizontal, vertical and diagonal neighbours, and the relaxation.
+	float *jacobiX, *jacobiY, *jacobiZ;
+	float jacobiRest[3];
+	float jacobiRelaxation;
+
+	// Chebyshev acceleration of the position based sweeps, the spectral radius is looked up
+	// (or estimated) again when the configuration is dirty
+	CPUChebyshev chebyshev;
+	bool chebyshevEnabled;
+	bool chebyshevDirty;
+
+	// Residual of the position based sweeps: each batch's stretch is reduced while it is
+	// projected (fixed blocks of constraints, combined in order), and a substep stops sweeping
+	// once the max is within the tolerance or its share of the frame's sweep budget is spent
+	bool stretchEnabled;
+	float iterationTolerance;
+	float iterationBudget;
+	double sweepDeadline; // Steady clock seconds (0 = none)
+	CPUStretchMetrics stretch;
+	double stretchSquares[8];
+	std::vector<float> blockStretchMax, blockStretchSquares;
+
+	// Sleeping (position based modes): the cloth is tracked in tileSize x tileSize tiles, a
+	// tile that stays below the energy threshold for sleepSteps steps stops and is pinned (zero
+	// in activeInvMass, swapped in for the step) and skipped: the passes run over spans of
+	// awake particles and packed batches of the constraints with an awake end
+	bool sleepEnabled;
+	float sleepThreshold;
+	int sleepSteps;
+	bool sleepDirty; // Masses, spans or constraints of the active set are out of date
+	unsigned int tileSize, tileColumns, tileRows;
+	int awakeTileCount;
+	std::vector<CPUSleepTile> tiles;
+	std::vector<unsigned int> tileRunFirst, tileRunStart, tileRunEnd; // Tile t is runs [tileRunFirst[t], tileRunFirst[t + 1]) of consecutive slots
+	float* activeInvMass;
+	unsigned int* activeStart;
+	unsigned int* activeEnd;
+	float* activeDistance;
+	int activeBatchStart[8];
+	int activeBatchSize[8];
+	std::vector<int> spanStart, spanEnd;
+
+	// Cache blocked sweeps (blockedSweeps per round, 0 = off): the constraints repacked by the
+	// sleeping tiles, tile t's interior (both ends in the tile) colour b at
+	// [blockOffset[t * 8 + b], blockOffset[t * 8 + b + 1]), then the constraints crossing
+	// tiles, colour b from blockOffset[tiles * 8 + b]
+	int blockedSweeps;
+	unsigned int* blockStart;
+	unsigned int* blockEnd;
+	float* blockDistance;
+	std::vector<int> blockOffset;
+
+	// Normals are recomputed after frames in which some particle moved
+	bool normalsDirty;
+
+	// Coarse levels for PBD iterations (V-cycles), rebuilt from the inverse masses when dirty
+	CPUMultigrid multigrid;
+	bool multigridDirty;
+
+	// Backward Euler integrator, its matrix pattern is built the first time it is selected
+	CPUImplicitSolver implicitSolver;
+	bool implicitBuilt;
+
+	// Projective dynamics, refactored (or loaded from the cache) when the masses or time step change
+	CPUProjectiveSolver projectiveSolver;
+	bool projectiveDirty;
+
+	// Vertex block descent, its neighbour lists and colours are built the first time it is selected
+	CPUBlockDescentSolver blockDescentSolver;
+	bool blockDescentBuilt;
+
+	// Triangle normals (scaled by twice the area) for the normal update, one pair per quad:
+	// face A is (a, b, d) and face B is (b, c, d). Stored on a (width + 1) x (height + 1)
+	// grid with a zero border so every vertex sums the same six faces without branches.
+	float *faceAX, *faceAY, *faceAZ;
+	float *faceBX, *faceBY, *faceBZ;
+
+	// Methods
+	void setupBuffers();
+
+	// Simulation passes (one per compute shader)
+	void applyForces(int first, int last);
+	void applyTethers(int first, int last);
+
+	// Forces (when integrating) and collisions tile by tile: the bounds of each tile's particles
+	// pick the colliders that can touch them, then only those are tested against the particles
+	void collideTiles(bool integrate);
+
+	// Contact caching: the lists of a frame of stepCount substeps, the furthest a particle
+	// moving at speed (m/s) can travel in a number of substeps, the self collision pass, and
+	// the check after every substep that the lists still cover the next one
+	void prepareContacts(int stepCount);
+	float getSkin(float speed, int steps) const;
+	void collideSelf();
+	void checkContacts();
+	void storeOrigin(std::vector<float>& origin) const;
+	void applyConstraints(int batch);
+	void applyJacobi(int firstRow, int lastRow);
+
+	// Cache blocked sweeps: repack the constraints by tile, and one round (the tile interiors,
+	// then the constraints between tiles)
+	bool isBlocked() const { return blockedSweeps > 0 && (solverMode == CPU_SOLVER_PBD || solverMode == CPU_SOLVER_XPBD); }
+	void buildBlocks();
+	void applyBlocks();
+	CPUConstraintBatch getBlockBatch(int list) const;
+
+	// Kernel parameters of a batch (invMass, and the compliance with XPBD)
+	CPUConstraintParams getConstraintParams(int batch, float* lambda) const;
+
+	// Residual: whether the sweeps reduce the stretch, and the cloth totals from the batch sums
+	bool isStretchCollected() const { return stretchEnabled || iterationTolerance > 0.0f; }
+	void finishStretch(CPUStretchMetrics& metrics, const double* squares, int count) const;
+
+	// Sleeping: whether some tile sleeps in a mode that honours it, the batch the sweeps
+	// project (packed while tiles sleep), and the particle passes over the awake spans
+	bool isPositionBased() const { return solverMode == CPU_SOLVER_PBD || solverMode == CPU_SOLVER_XPBD || solverMode == CPU_SOLVER_JACOBI; }
+	bool isSleepActive() const { return sleepEnabled && isPositionBased() && awakeTileCount < (int)tiles.size(); }
+	CPUConstraintBatch getActiveBatch(int batch) const;
+	void forEachAwakeSpan(const CPUThreadPool::Task& task);
+
+	// Sleeping: tile layout (and the slot runs of each tile), the active set, the energy and
+	// sleep / wake pass after a step
+	unsigned int tileOf(unsigned int latticeIndex) const { return (latticeIndex / width / tileSize) * tileColumns + (latticeIndex % width) / tileSize; }
+	void buildTiles();
+	void updateActiveSet();
+	void updateTiles();
+	void wakeTile(unsigned int tile);
+	void wakeTilesNear(int collider);
+
+	// Normal update passes (rows of quads, then rows of vertices) on row major arrays, the
+	// particles' own unless they are stored in another order
+	void computeFaceNormals(const float* x, const float* y, const float* z, int firstRow, int lastRow);
+	void accumulateNormals(float* normalX, float* normalY, float* normalZ, int firstRow, int lastRow);
+
+	// Particle order: slot of a lattice index and back
+	unsigned int slotOf(unsigned int latticeIndex) const { return particleSlot.empty() ? latticeIndex : particleSlot[latticeIndex]; }
+	unsigned int latticeOf(unsigned int slot) const { return particleLattice.empty() ? slot : particleLattice[slot]; }
+
+	// Pin (zero inverse mass, restored to the rest position) or release the anchor set
+	void pinAnchors(bool pinned);
+	CPUVector3 restPosition(unsigned int latticeIndex) const;
+
+	// Find each particle's nearest anchor and the rest distance to it
+	void buildTethers();
+
+	// Chebyshev: key of the current configuration, and the spectral radius of its sweeps
+	// (false if the cloth is too still to measure it)
+	uint64_t chebyshevKey() const;
+	bool estimateSpectralRadius(uint64_t key);
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor & Destructor
+	// Without an anchor list the top left, top right and top middle particles are pinned
+	CPUCloth(unsigned int newClothWidth, unsigned int newClothHeight, int threadCount = 0,
+		const unsigned int* newAnchors = nullptr, int newAnchorCount = 0);
+	~CPUCloth();
+
+	// Update (advances the simulation by deltaTime seconds in fixed steps, then updates the normals)
+	int update(float deltaTime);
+
+	// Hash of the simulation state (current and previous positions). Blocks of particles are
+	// hashed in parallel and the block hashes combined in index order, so the result does
+	// not depend on the thread count (it does depend on the particle order).
+	uint64_t hashState() const;
+
+	// Recompute the area weighted vertex normals from the current positions,
+	// update() calls this once per frame so it is only needed after driving step() directly
+	void updateNormals();
+
+	// Single fixed simulation step
+	void step();
+
+	// One solver iteration on the current positions (no forces or collisions): a sweep over
+	// the eight colours, or with multigrid in PBD mode a sweep, a coarse grid correction and
+	// another sweep. In Jacobi mode one pass over the rows in which every particle moves by the
+	// relaxed average of the corrections of its (up to 8) springs. With blocked sweeps every
+	// sweep is a whole round of getBlockedSweeps() tile sweeps and the boundary sweep.
+	void solveConstraints();
+
+	// Stretch of the current positions in one pass over every batch (any solver mode)
+	CPUStretchMetrics measureStretch() const;
+
+	// Accessors
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+	int getConstraintCount() const { return constraintCount; }
+	int getBatchSize(int batch) const { return batchSize[batch]; }
+	float getTimeStep() const { return scheduler.getTimeStep(); }
+	const CPUStepScheduler& getScheduler() const { return scheduler; }
+	long long getStepIndex() const { return stepIndex; }
+	bool isDeterministic() const { return scheduler.getFixedFrameRate() > 0.0f; }
+	const std::vector<CPUStateHash>& getStateHashes() const { return stateHashes; }
+	int getIterations() const { return iterations; }
+	int getMultigridLevels() const { return multigrid.getLevelCount(); }
+	bool isMultigridActive() const { return solverMode == CPU_SOLVER_PBD && multigrid.getLevelCount() > 1; }
+	double getIterationCost() const; // One solveConstraints() in fine sweeps (coarse, tile and boundary sweeps weighed by constraint count)
+	int getBlockedSweeps() const { return blockedSweeps; }
+	int getBoundaryConstraintCount() const { return blockOffset.empty() ? 0 : constraintCount - blockOffset[tiles.size() * 8]; }
+	CPUSolverMode getSolverMode() const { return solverMode; }
+	float getCompliance(CPUConstraintType type) const { return compliance[type]; }
+	float getJacobiRelaxation() const { return jacobiRelaxation; }
+	bool isChebyshev() const { return chebyshevEnabled; }
+	const CPUChebyshev& getChebyshev() const { return chebyshev; }
+	bool isStretchEnabled() const { return stretchEnabled; }
+	float getIterationTolerance() const { return iterationTolerance; }
+	float getIterationBudget() const { return iterationBudget; }
+	const CPUStretchMetrics& getStretchMetrics() const { return stretch; } // As the last sweep found it
+	bool isSleeping() const { return sleepEnabled; }
+	float getSleepThreshold() const { return sleepThreshold; }
+	int getSleepSteps() const { return sleepSteps; }
+	unsigned int getTileSize() const { return tileSize; }
+	unsigned int getTileColumns() const { return tileColumns; }
+	unsigned int getTileRows() const { return tileRows; }
+	int getAwakeTileCount() const { return awakeTileCount; }
+	const std::vector<CPUSleepTile>& getTiles() const { return tiles; } // Row major, tileColumns per row
+	const CPUColliderWorld& getColliders() const { return colliders; }
+	int getColliderPairs() const; // Tile / collider pairs the last collision pass tested particle by particle
+	int getSweepHits() const; // Particles the last collision pass's sweeps stopped at a contact
+	long long getSweepTotal() const { return sweepTotal; } // and every pass's
+	bool isSelfCollision() const { return selfCollisionEnabled; }
+	bool isContactCaching() const { return contactCaching; }
+	bool isContinuousCollision() const { return continuousCollision; }
+	float getContactSkin() const { return contactSkin; } // Of the last frame's tile collider lists (0 when not cached)
+	float getSelfSkin() const { return selfSkin; } // and self collision lists
+	int getSelfInterval() const { return selfInterval; } // Substeps the last frame's self collision lists covered
+	long long getContactFrames() const { return contactFrames; } // Frames that cached their contacts
+	long long getContactRefreshes() const { return contactRefreshes; } // Lists re-detected within a frame (particles moved past the skin)
+	const CPUSelfCollision& getSelfCollision() const { return selfCollision; }
+	float getStiffness(CPUConstraintType type) const { return implicitSolver.getSettings().stiffness[type]; }
+	const CPUImplicitSolver& getImplicitSolver() const { return implicitSolver; }
+	const CPUProjectiveSolver& getProjectiveSolver() const { return projectiveSolver; }
+	const CPUBlockDescentSolver& getBlockDescentSolver() const { return blockDescentSolver; }
+	const CPUParticles& getParticles() const { return particles; } // In storage order
+	const unsigned int* getIndices() const { return indices; } // Storage slots
+	CPUParticleOrder getParticleOrder() const { return particleOrder; }
+	unsigned int getParticleSlot(unsigned int latticeIndex) const { return slotOf(latticeIndex); } // Storage slot of particle (row * width + column)
+	CPUConstraintBatch getBatch(int batch) const;
+	CPUInstructionSet getInstructionSet() const { return instructionSet; }
+	int getThreadCount() const { return threadPool->getThreadCount(); }
+	unsigned int getIndexCount() const { return width && height ? (width - 1) * (height - 1) * 6 : 0; }
+	int getAnchorCount() const { return (int)anchorIndices.size(); }
+	const unsigned int* getAnchors() const { return anchorIndices.empty() ? nullptr : &anchorIndices[0]; }
+	bool isAnchored() const { return anchored; }
+	bool isTethered() const { return tethered; }
+	float getTetherScale() const { return tetherScale; }
+
+	// Build interleaved render vertices (width * height entries), interpolated by the scheduler alpha
+	void buildVertices(CPUVertex* vertices) const { particles.buildVertices(vertices, scheduler.getAlpha()); }
+
+	// Select the constraint kernel, clamped to what the processor supports
+	void setInstructionSet(CPUInstructionSet isa);
+
+	// Rebuild the worker pool with threadCount threads (0 = one per physical core)
+	void setThreadCount(int threadCount);
+
+	// Solver settings, the substep length and the sweeps per substep are independent
+	void setSolverMode(CPUSolverMode mode);
+	void setCompliance(CPUConstraintType type, float newCompliance);
+
+	// Chebyshev acceleration of the PBD, XPBD and Jacobi sweeps (needs 8 or more iterations).
+	// The first substep of every new configuration (anchors, masses, time step, solver settings)
+	// runs a trial solve to estimate the spectral radius, later ones reuse it. Sleeping tiles
+	// do not change the configuration, its radius is estimated while every tile is awake.
+	void setChebyshev(bool enabled);
+
+	// Residual of the PBD, XPBD and Jacobi sweeps. With metrics on, every sweep reduces the max
+	// and RMS stretch of each batch as it projects it (before the projection, Jacobi measures
+	// after its pass), read back through getStretchMetrics(). getIterations() becomes a cap:
+	// a substep stops once the max stretch is within the tolerance (0 = off, turns the metrics
+	// on while set), or once its share of the per frame sweep budget in seconds is spent
+	// (0 = off, ignored in deterministic mode). At least one sweep always runs.
+	void setStretchMetrics(bool enabled);
+	void setIterationTolerance(float tolerance);
+	void setIterationBudget(float seconds);
+
+	// Sleeping tiles (PBD, XPBD and Jacobi, off by default). A tile whose kinetic energy per
+	// unit mass stays below the threshold (m^2 / s^2) for the given number of steps stops, and
+	// the forces, collision, constraint and tether passes skip it. Tiles wake when a neighbour
+	// moves, the wind, anchors, masses or solver settings change, or a collider moves over them.
+	// The threshold must stay below what a resting tile picks up in that many steps of free
+	// fall (0.5 (4.9 dt n)^2), or a cloth released at rest sleeps before it falls.
+	void setSleeping(bool enabled);
+	void setSleepThreshold(float energy);
+	void setSleepSteps(int steps);
+	void wakeTiles(); // After moving particles from outside
+
+	// Colliders: add one (returns its id), replace one, or remove one (the later ids move down
+	// by one). Tiles a collider leaves or reaches wake up.
+	int addCollider(const CPUSphere& sphere);
+	int addCollider(const CPUCapsule& capsule);
+	int addCollider(const CPUPlane& plane);
+	int addCollider(const CPUBox& box);
+	int addCollider(const CPUFieldCollider& field);
+	void setCollider(int id, const CPUSphere& sphere);
+	void setCollider(int id, const CPUCapsule& capsule);
+	void setCollider(int id, const CPUPlane& plane);
+	void setCollider(int id, const CPUBox& box);
+	void setCollider(int id, const CPUFieldCollider& field);
+	void removeCollider(int id);
+	void clearColliders();
+
+	// Move or resize the first sphere collider (added if there is none)
+	void setSphere(const CPUVector3& position, float radius);
+
+	// Self collision (off by default): particles closer than the thickness (a fraction of the
+	// rest spacing) push each other apart once per substep, after the constraints in the
+	// position based modes and after the implicit solve in the others. Particles within the
+	// exclusion (lattice steps along rows and columns) of each other never collide.
+	void setSelfCollision(bool enabled);
+	void setSelfThickness(float thickness);
+	void setSelfExclusion(int steps);
+	void resetSelfTimes() { selfCollision.resetTimes(); }
+
+	// Contact caching across the substeps of each update() (on by default). Detection (the
+	// tile / collider broadphase and the self collision hash and query) runs once per frame,
+	// or once per few substeps for self collision when the cloth moves fast, with a skin from
+	// the fastest particle's speed, and every substep only resolves the cached candidates.
+	// Stepped directly (not from update) every pass detects its own contacts.
+	void setContactCaching(bool enabled);
+
+	// Continuous collision against the colliders (off by default). Colliders moved between
+	// frames travel through the substeps instead of jumping at the first, and each particle's
+	// path over a substep is swept against the spheres, capsules, boxes and mesh fields its
+	// tile reaches, so neither fast colliders nor long substeps let particles pass through.
+	void setContinuousCollision(bool enabled);
+
+	// Cache blocked PBD and XPBD sweeps (0 = off). The cloth is split into the sleeping tiles,
+	// each tile runs this many sweeps of the eight colours over its interior constraints while
+	// its particles are in cache (the tiles in parallel, they share no particle), then one sweep
+	// over the constraints between tiles reconciles the boundaries. A substep runs
+	// getIterations() tile sweeps, rounded up to whole rounds; tiles that sleep are skipped.
+	void setBlockedSweeps(int sweeps);
+
+	// Jacobi mode: scale on the averaged corrections (1 = plain average, clamped to (0, 2))
+	void setJacobiRelaxation(float relaxation);
+
+	// Implicit solver settings: spring stiffness (N/m), damping along the springs (N s/m) and
+	// the conjugate gradient stopping rule (relative residual and iteration cap per step).
+	// Use a time step of a whole frame (setTimeStep(1 / 60)), the solve is stable at any step.
+	// The stiffness is shared with projective dynamics, which runs getIterations() local /
+	// global rounds per step, and with vertex block descent (stiffness and damping), which runs
+	// getIterations() sweeps over the vertex colours per step.
+	void setStiffness(CPUConstraintType type, float stiffness);
+	void setDamping(float damping);
+	void setImplicitTolerance(float tolerance, int maxIterations);
+
+	// Projective dynamics: iterates mixed by Anderson acceleration (0 = off), and the directory
+	// its factorisations are cached in between runs ("" = off)
+	void setAndersonWindow(int window);
+	void setFactorCache(const std::string& directory);
+	void setTimeStep(float newTimeStep);
+	void setIterations(int newIterations);
+
+	// Multigrid levels including the cloth itself (1 = off). Every level halves the lattice,
+	// the coarsest is at least 3 x 3. Only used in PBD mode: coarse springs are solved
+	// stiffly, so with XPBD they would override the compliance.
+	void setMultigridLevels(int levels);
+	void setMultigridSweeps(int sweeps);
+
+	// Most substeps run by one update, surplus time beyond it is dropped
+	void setMaxSubsteps(int maxSubsteps);
+
+	// Deterministic mode: update() ignores the measured frame time and runs the steps due for
+	// the next frame at frameRate, so identical inputs give bitwise identical states for any
+	// thread count or instruction set (0 turns it off)
+	void setDeterministic(float frameRate);
+
+	// Record hashState() every interval steps (0 = off), clears the recorded hashes
+	void setHashInterval(int interval);
+
+	// Replace the anchor set (any number of particles, by lattice index row * width + column),
+	// the new anchors are pinned at their rest positions
+	void setAnchors(const unsigned int* newAnchors, int newAnchorCount);
+
+	// Inverse mass of one particle (lattice index, 0 pins it), anchors override this while anchored
+	// and take it when released
+	void setInverseMass(unsigned int index, float inverseMass);
+
+	// Memory order of the particle arrays (row major by default). The state is permuted in
+	// place, the constraints are renumbered (and sorted by slot within each batch, which leaves
+	// every PBD and XPBD result unchanged as a batch never shares a particle) and the index
+	// buffer is remapped. The Jacobi, implicit, projective and block descent solvers and
+	// multigrid walk the lattice in rows, so they need the row major order.
+	void setParticleOrder(CPUParticleOrder order);
+
+	// Tethers are solved once per substep after the constraints (off by default),
+	// the scale (>= 1) allows some slack over the rest distance
+	void setTethers(bool enabled);
+	void setTetherScale(float scale);
+
+	// Controls
+	void switchAnchors();
+	void switchForces();
+	void increaseWind();
+	void decreaseWind();
+	void zeroWind();
+};
+
+#endif
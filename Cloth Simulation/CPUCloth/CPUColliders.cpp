@@ -0,0 +1,898 @@
+// ------------------------------------------------
+// Class:	CPU Colliders Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUColliders.h"
+
+// Standard includes
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Namespaces
+using namespace std;
+
+// Continuous collision: contact within this fraction of the sweep's reach, and the most
+// advancement steps per particle (one still short of the contact stops where it is)
+#define SWEEP_TOLERANCE 1e-3f
+#define SWEEP_ITERATIONS 16
+
+// Vector helpers
+static float dot(const CPUVector3& a, const CPUVector3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static CPUVector3 normalised(const CPUVector3& v)
+{
+	float length = sqrtf(dot(v, v));
+	CPUVector3 result = v;
+
+	if(length > 0.0f)
+	{
+		result.x /= length;
+		result.y /= length;
+		result.z /= length;
+	}
+
+	return result;
+}
+
+static CPUVector3 lerp(const CPUVector3& a, const CPUVector3& b, float t)
+{
+	CPUVector3 result = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+	return result;
+}
+
+static float distanceBetween(const CPUVector3& a, const CPUVector3& b)
+{
+	CPUVector3 difference = { b.x - a.x, b.y - a.y, b.z - a.z };
+	return sqrtf(dot(difference, difference));
+}
+
+// Push a point out of a sphere around a centre (cloth_collision_sphere.hlsl)
+static void pushOut(float& x, float& y, float& z, float cx, float cy, float cz, float radius)
+{
+	float dx = x - cx;
+	float dy = y - cy;
+	float dz = z - cz;
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+	if(distance < radius && distance > 0.0f)
+	{
+		float scaler = 1.0f - (radius / distance);
+
+		x -= dx * scaler;
+		y -= dy * scaler;
+		z -= dz * scaler;
+	}
+}
+
+// Parameter of the point of a capsule's segment closest to a point
+static float capsuleParameter(const CPUCapsule& capsule, const CPUVector3& point)
+{
+	CPUVector3 axis = { capsule.end.x - capsule.start.x, capsule.end.y - capsule.start.y, capsule.end.z - capsule.start.z };
+	CPUVector3 offset = { point.x - capsule.start.x, point.y - capsule.start.y, point.z - capsule.start.z };
+	float axisSquared = dot(axis, axis);
+
+	return axisSquared > 0.0f ? min(max(dot(offset, axis) / axisSquared, 0.0f), 1.0f) : 0.0f;
+}
+
+// Interpolate two poses of one collider (the bounds are the later pose's)
+static CPUCollider interpolate(const CPUCollider& start, const CPUCollider& end, float at)
+{
+	CPUCollider pose = end;
+
+	switch(end.type)
+	{
+	case CPU_COLLIDER_SPHERE:
+		pose.sphere.position = lerp(start.sphere.position, end.sphere.position, at);
+		pose.sphere.radius = start.sphere.radius + (end.sphere.radius - start.sphere.radius) * at;
+		break;
+
+	case CPU_COLLIDER_CAPSULE:
+		pose.capsule.start = lerp(start.capsule.start, end.capsule.start, at);
+		pose.capsule.end = lerp(start.capsule.end, end.capsule.end, at);
+		pose.capsule.radius = start.capsule.radius + (end.capsule.radius - start.capsule.radius) * at;
+		break;
+
+	case CPU_COLLIDER_PLANE:
+	{
+		// Both terms scaled together, so the plane between is the blend of the two
+		float offset = start.plane.offset + (end.plane.offset - start.plane.offset) * at;
+		CPUVector3 normal = lerp(start.plane.normal, end.plane.normal, at);
+		float length = sqrtf(dot(normal, normal));
+
+		if(length > 0.0f)
+		{
+			pose.plane.normal = normalised(normal);
+			pose.plane.offset = offset / length;
+		}
+		break;
+	}
+
+	case CPU_COLLIDER_BOX:
+		pose.box.centre = lerp(start.box.centre, end.box.centre, at);
+		pose.box.halfExtents = lerp(start.box.halfExtents, end.box.halfExtents, at);
+		break;
+
+	case CPU_COLLIDER_FIELD:
+		pose.field.position = lerp(start.field.position, end.field.position, at);
+		pose.field.thickness = start.field.thickness + (end.field.thickness - start.field.thickness) * at;
+		break;
+
+	default:
+		break;
+	}
+
+	return pose;
+}
+
+// Signed distance from a point to a collider's surface (a field's is its sample, and no more
+// than the band outside the grid)
+static float shapeDistance(const CPUCollider& collider, const CPUVector3& point)
+{
+	switch(collider.type)
+	{
+	case CPU_COLLIDER_SPHERE:
+		return distanceBetween(point, collider.sphere.position) - collider.sphere.radius;
+
+	case CPU_COLLIDER_CAPSULE:
+	{
+		const CPUCapsule& capsule = collider.capsule;
+		float t = capsuleParameter(capsule, point);
+
+		return distanceBetween(point, lerp(capsule.start, capsule.end, t)) - capsule.radius;
+	}
+
+	case CPU_COLLIDER_PLANE:
+		return dot(collider.plane.normal, point) + collider.plane.offset;
+
+	case CPU_COLLIDER_BOX:
+	{
+		const CPUBox& box = collider.box;
+		const float* half = &box.halfExtents.x;
+		CPUVector3 offset = { point.x - box.centre.x, point.y - box.centre.y, point.z - box.centre.z };
+		float outside = 0.0f;
+		float inside = -FLT_MAX;
+
+		for(int a = 0; a < 3; ++a)
+		{
+			float excess = fabsf(dot(offset, box.axes[a])) - half[a];
+
+			outside += max(excess, 0.0f) * max(excess, 0.0f);
+			inside = max(inside, excess);
+		}
+
+		return sqrtf(outside) + min(inside, 0.0f);
+	}
+
+	case CPU_COLLIDER_FIELD:
+	{
+		const CPUFieldCollider& field = collider.field;
+
+		if(!field.field || !field.field->isBaked())
+			return FLT_MAX;
+
+		CPUVector3 offset = { point.x - field.position.x, point.y - field.position.y, point.z - field.position.z };
+		CPUVector3 local = { dot(offset, field.axes[0]), dot(offset, field.axes[1]), dot(offset, field.axes[2]) };
+		CPUVector3 gradient;
+		float distance;
+
+		if(!field.field->sample(local, distance, gradient))
+			distance = field.field->getBand();
+
+		return distance - field.thickness;
+	}
+
+	default:
+		return FLT_MAX;
+	}
+}
+
+// Furthest any point of a collider's surface moves between two poses
+static float motionReach(const CPUCollider& start, const CPUCollider& end)
+{
+	switch(end.type)
+	{
+	case CPU_COLLIDER_SPHERE:
+		return distanceBetween(start.sphere.position, end.sphere.position) + fabsf(end.sphere.radius - start.sphere.radius);
+
+	case CPU_COLLIDER_CAPSULE:
+		return max(distanceBetween(start.capsule.start, end.capsule.start), distanceBetween(start.capsule.end, end.capsule.end))
+			+ fabsf(end.capsule.radius - start.capsule.radius);
+
+	case CPU_COLLIDER_BOX:
+		return distanceBetween(start.box.centre, end.box.centre) + distanceBetween(start.box.halfExtents, end.box.halfExtents);
+
+	case CPU_COLLIDER_FIELD:
+		return distanceBetween(start.field.position, end.field.position) + fabsf(end.field.thickness - start.field.thickness);
+
+	default:
+		return 0.0f;
+	}
+}
+
+// Depth a particle can reach inside a collider and still be nearer the side it came in from
+// (the discrete pass resolves shorter paths), none for fields (the mesh may be thin anywhere)
+static float passDepth(const CPUCollider& collider)
+{
+	switch(collider.type)
+	{
+	case CPU_COLLIDER_SPHERE:
+		return collider.sphere.radius;
+
+	case CPU_COLLIDER_CAPSULE:
+		return collider.capsule.radius;
+
+	case CPU_COLLIDER_BOX:
+		return max(min(min(collider.box.halfExtents.x, collider.box.halfExtents.y), collider.box.halfExtents.z), 0.0f);
+
+	default:
+		return 0.0f;
+	}
+}
+
+// Where a point on a collider's surface is carried by the collider moving between two poses
+static CPUVector3 carry(const CPUCollider& start, const CPUCollider& end, const CPUVector3& point)
+{
+	CPUVector3 from, to;
+
+	switch(end.type)
+	{
+	case CPU_COLLIDER_SPHERE:
+		from = start.sphere.position;
+		to = end.sphere.position;
+		break;
+
+	case CPU_COLLIDER_CAPSULE:
+	{
+		// With the closest point of the segment
+		float t = capsuleParameter(start.capsule, point);
+
+		from = lerp(start.capsule.start, start.capsule.end, t);
+		to = lerp(end.capsule.start, end.capsule.end, t);
+		break;
+	}
+
+	case CPU_COLLIDER_BOX:
+		from = start.box.centre;
+		to = end.box.centre;
+		break;
+
+	case CPU_COLLIDER_FIELD:
+		from = start.field.position;
+		to = end.field.position;
+		break;
+
+	default:
+		return point;
+	}
+
+	CPUVector3 result = { point.x + to.x - from.x, point.y + to.y - from.y, point.z + to.z - from.z };
+	return result;
+}
+
+// Prepare
+void CPUColliderWorld::prepare(CPUCollider& collider)
+{
+	CPUVector3& boundsMin = collider.boundsMin;
+	CPUVector3& boundsMax = collider.boundsMax;
+
+	switch(collider.type)
+	{
+	case CPU_COLLIDER_SPHERE:
+	{
+		const CPUSphere& sphere = collider.sphere;
+
+		collider.sphere.radius = max(sphere.radius, 0.0f);
+		boundsMin.x = sphere.position.x - sphere.radius;
+		boundsMin.y = sphere.position.y - sphere.radius;
+		boundsMin.z = sphere.position.z - sphere.radius;
+		boundsMax.x = sphere.position.x + sphere.radius;
+		boundsMax.y = sphere.position.y + sphere.radius;
+		boundsMax.z = sphere.position.z + sphere.radius;
+		break;
+	}
+
+	case CPU_COLLIDER_CAPSULE:
+	{
+		const CPUCapsule& capsule = collider.capsule;
+
+		collider.capsule.radius = max(capsule.radius, 0.0f);
+		boundsMin.x = min(capsule.start.x, capsule.end.x) - capsule.radius;
+		boundsMin.y = min(capsule.start.y, capsule.end.y) - capsule.radius;
+		boundsMin.z = min(capsule.start.z, capsule.end.z) - capsule.radius;
+		boundsMax.x = max(capsule.start.x, capsule.end.x) + capsule.radius;
+		boundsMax.y = max(capsule.start.y, capsule.end.y) + capsule.radius;
+		boundsMax.z = max(capsule.start.z, capsule.end.z) + capsule.radius;
+		break;
+	}
+
+	case CPU_COLLIDER_PLANE:
+	{
+		// Unit normal, and the offset scaled with it so the plane stays where it was
+		float length = sqrtf(dot(collider.plane.normal, collider.plane.normal));
+
+		if(length > 0.0f)
+		{
+			collider.plane.normal = normalised(collider.plane.normal);
+			collider.plane.offset /= length;
+		}
+
+		boundsMin.x = boundsMin.y = boundsMin.z = -FLT_MAX;
+		boundsMax.x = boundsMax.y = boundsMax.z = FLT_MAX;
+		break;
+	}
+
+	case CPU_COLLIDER_BOX:
+	{
+		CPUBox& box = collider.box;
+		const float* half = &box.halfExtents.x;
+		CPUVector3 reach = { 0.0f, 0.0f, 0.0f };
+
+		for(int a = 0; a < 3; ++a)
+		{
+			box.axes[a] = normalised(box.axes[a]);
+			reach.x += fabsf(box.axes[a].x) * max(half[a], 0.0f);
+			reach.y += fabsf(box.axes[a].y) * max(half[a], 0.0f);
+			reach.z += fabsf(box.axes[a].z) * max(half[a], 0.0f);
+		}
+
+		boundsMin.x = box.centre.x - reach.x;
+		boundsMin.y = box.centre.y - reach.y;
+		boundsMin.z = box.centre.z - reach.z;
+		boundsMax.x = box.centre.x + reach.x;
+		boundsMax.y = box.centre.y + reach.y;
+		boundsMax.z = box.centre.z + reach.z;
+		break;
+	}
+
+	case CPU_COLLIDER_FIELD:
+	{
+		// The grid's box turned and moved like the box collider's (nothing without a field)
+		CPUFieldCollider& field = collider.field;
+
+		for(int a = 0; a < 3; ++a)
+			field.axes[a] = normalised(field.axes[a]);
+
+		if(!field.field || !field.field->isBaked())
+		{
+			boundsMin.x = boundsMin.y = boundsMin.z = FLT_MAX;
+			boundsMax.x = boundsMax.y = boundsMax.z = -FLT_MAX;
+			break;
+		}
+
+		CPUVector3 gridMin, gridMax;
+		field.field->getBounds(gridMin, gridMax);
+
+		const float* low = &gridMin.x;
+		const float* high = &gridMax.x;
+		CPUVector3 centre = field.position;
+		CPUVector3 reach = { 0.0f, 0.0f, 0.0f };
+
+		for(int a = 0; a < 3; ++a)
+		{
+			float middle = 0.5f * (low[a] + high[a]);
+			float half = 0.5f * (high[a] - low[a]);
+
+			centre.x += field.axes[a].x * middle;
+			centre.y += field.axes[a].y * middle;
+			centre.z += field.axes[a].z * middle;
+			reach.x += fabsf(field.axes[a].x) * half;
+			reach.y += fabsf(field.axes[a].y) * half;
+			reach.z += fabsf(field.axes[a].z) * half;
+		}
+
+		boundsMin.x = centre.x - reach.x;
+		boundsMin.y = centre.y - reach.y;
+		boundsMin.z = centre.z - reach.z;
+		boundsMax.x = centre.x + reach.x;
+		boundsMax.y = centre.y + reach.y;
+		boundsMax.z = centre.z + reach.z;
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+// Add
+int CPUColliderWorld::add(const CPUSphere& sphere)
+{
+	int id = append();
+	set(id, sphere);
+
+	return id;
+}
+
+int CPUColliderWorld::add(const CPUCapsule& capsule)
+{
+	int id = append();
+	set(id, capsule);
+
+	return id;
+}
+
+int CPUColliderWorld::add(const CPUPlane& plane)
+{
+	int id = append();
+	set(id, plane);
+
+	return id;
+}
+
+int CPUColliderWorld::add(const CPUBox& box)
+{
+	int id = append();
+	set(id, box);
+
+	return id;
+}
+
+int CPUColliderWorld::add(const CPUFieldCollider& field)
+{
+	int id = append();
+	set(id, field);
+
+	return id;
+}
+
+// Append (a start pose of no type, so the first set places the collider without moving it)
+int CPUColliderWorld::append()
+{
+	colliders.push_back(CPUCollider());
+	starts.push_back(CPUCollider());
+	starts.back().type = CPU_COLLIDER_TYPE_COUNT;
+	moving.push_back(0);
+
+	return (int)colliders.size() - 1;
+}
+
+// Set
+void CPUColliderWorld::set(int id, const CPUSphere& sphere)
+{
+	CPUCollider collider;
+	collider.type = CPU_COLLIDER_SPHERE;
+	collider.sphere = sphere;
+
+	set(id, collider);
+}
+
+void CPUColliderWorld::set(int id, const CPUCapsule& capsule)
+{
+	CPUCollider collider;
+	collider.type = CPU_COLLIDER_CAPSULE;
+	collider.capsule = capsule;
+
+	set(id, collider);
+}
+
+void CPUColliderWorld::set(int id, const CPUPlane& plane)
+{
+	CPUCollider collider;
+	collider.type = CPU_COLLIDER_PLANE;
+	collider.plane = plane;
+
+	set(id, collider);
+}
+
+void CPUColliderWorld::set(int id, const CPUBox& box)
+{
+	CPUCollider collider;
+	collider.type = CPU_COLLIDER_BOX;
+	collider.box = box;
+
+	set(id, collider);
+}
+
+void CPUColliderWorld::set(int id, const CPUFieldCollider& field)
+{
+	CPUCollider collider;
+	collider.type = CPU_COLLIDER_FIELD;
+	collider.field = field;
+
+	set(id, collider);
+}
+
+void CPUColliderWorld::set(int id, const CPUCollider& collider)
+{
+	if(id < 0 || id >= (int)colliders.size())
+		return;
+
+	colliders[id] = collider;
+	prepare(colliders[id]);
+
+	// A collider that changes type starts its motion where it is now
+	if(starts[id].type != colliders[id].type)
+	{
+		starts[id] = colliders[id];
+		moving[id] = 0;
+	}
+	else
+	{
+		moving[id] = 1;
+	}
+}
+
+// Remove
+void CPUColliderWorld::remove(int id)
+{
+	if(id >= 0 && id < (int)colliders.size())
+	{
+		colliders.erase(colliders.begin() + id);
+		starts.erase(starts.begin() + id);
+		moving.erase(moving.begin() + id);
+	}
+}
+
+// Clear
+void CPUColliderWorld::clear()
+{
+	colliders.clear();
+	starts.clear();
+	moving.clear();
+}
+
+// Settle
+void CPUColliderWorld::settle()
+{
+	for(int c = 0; c < (int)colliders.size(); ++c)
+	{
+		if(moving[c])
+		{
+			starts[c] = colliders[c];
+			moving[c] = 0;
+		}
+	}
+}
+
+// Overlaps
+bool CPUColliderWorld::overlaps(int id, const CPUVector3& boundsMin, const CPUVector3& boundsMax, float margin) const
+{
+	const CPUCollider& collider = colliders[id];
+
+	if(collider.type == CPU_COLLIDER_PLANE)
+	{
+		// The corner of the box furthest behind the plane, at either end of the motion (the
+		// blended planes between are behind one of them)
+		if(moving[id] && overlapsPlane(starts[id].plane, boundsMin, boundsMax, margin))
+			return true;
+
+		return overlapsPlane(collider.plane, boundsMin, boundsMax, margin);
+	}
+
+	// The bounds of both ends of the motion
+	CPUVector3 sweptMin = collider.boundsMin;
+	CPUVector3 sweptMax = collider.boundsMax;
+
+	if(moving[id])
+	{
+		const CPUCollider& start = starts[id];
+
+		sweptMin.x = min(sweptMin.x, start.boundsMin.x);
+		sweptMin.y = min(sweptMin.y, start.boundsMin.y);
+		sweptMin.z = min(sweptMin.z, start.boundsMin.z);
+		sweptMax.x = max(sweptMax.x, start.boundsMax.x);
+		sweptMax.y = max(sweptMax.y, start.boundsMax.y);
+		sweptMax.z = max(sweptMax.z, start.boundsMax.z);
+	}
+
+	return sweptMin.x <= boundsMax.x + margin && sweptMax.x >= boundsMin.x - margin
+		&& sweptMin.y <= boundsMax.y + margin && sweptMax.y >= boundsMin.y - margin
+		&& sweptMin.z <= boundsMax.z + margin && sweptMax.z >= boundsMin.z - margin;
+}
+
+// Overlaps Plane
+bool CPUColliderWorld::overlapsPlane(const CPUPlane& plane, const CPUVector3& boundsMin, const CPUVector3& boundsMax, float margin)
+{
+	CPUVector3 centre, extent;
+
+	centre.x = 0.5f * (boundsMin.x + boundsMax.x);
+	centre.y = 0.5f * (boundsMin.y + boundsMax.y);
+	centre.z = 0.5f * (boundsMin.z + boundsMax.z);
+	extent.x = 0.5f * (boundsMax.x - boundsMin.x);
+	extent.y = 0.5f * (boundsMax.y - boundsMin.y);
+	extent.z = 0.5f * (boundsMax.z - boundsMin.z);
+
+	float reach = fabsf(plane.normal.x) * extent.x + fabsf(plane.normal.y) * extent.y + fabsf(plane.normal.z) * extent.z;
+
+	return dot(plane.normal, centre) + plane.offset - reach < margin;
+}
+
+// Find Overlaps
+void CPUColliderWorld::findOverlaps(const CPUVector3& boundsMin, const CPUVector3& boundsMax, vector<int>& ids) const
+{
+	ids.clear();
+
+	for(int c = 0; c < (int)colliders.size(); ++c)
+	{
+		if(overlaps(c, boundsMin, boundsMax))
+			ids.push_back(c);
+	}
+}
+
+// Collide
+void CPUColliderWorld::collide(int id, CPUParticles& particles, int first, int last, float at) const
+{
+	// Colliders still moving are posed part way
+	bool posed = moving[id] && at < 1.0f;
+	CPUCollider pose;
+
+	if(posed)
+		pose = getPose(id, at);
+
+	const CPUCollider& collider = posed ? pose : colliders[id];
+	float* x = particles.x;
+	float* y = particles.y;
+	float* z = particles.z;
+	const float* invMass = particles.invMass;
+
+	switch(collider.type)
+	{
+	case CPU_COLLIDER_SPHERE:
+	{
+		const CPUSphere& sphere = collider.sphere;
+
+		for(int i = first; i < last; ++i)
+		{
+			if(invMass[i] > 0.0f)
+				pushOut(x[i], y[i], z[i], sphere.position.x, sphere.position.y, sphere.position.z, sphere.radius);
+		}
+		break;
+	}
+
+	case CPU_COLLIDER_CAPSULE:
+	{
+		// Out of the sphere around the closest point of the segment
+		const CPUCapsule& capsule = collider.capsule;
+		CPUVector3 axis = { capsule.end.x - capsule.start.x, capsule.end.y - capsule.start.y, capsule.end.z - capsule.start.z };
+		float axisSquared = dot(axis, axis);
+		float inverseSquared = axisSquared > 0.0f ? 1.0f / axisSquared : 0.0f;
+
+		for(int i = first; i < last; ++i)
+		{
+			if(invMass[i] <= 0.0f)
+				continue;
+
+			float t = ((x[i] - capsule.start.x) * axis.x + (y[i] - capsule.start.y) * axis.y + (z[i] - capsule.start.z) * axis.z) * inverseSquared;
+			t = min(max(t, 0.0f), 1.0f);
+
+			pushOut(x[i], y[i], z[i], capsule.start.x + axis.x * t, capsule.start.y + axis.y * t, capsule.start.z + axis.z * t, capsule.radius);
+		}
+		break;
+	}
+
+	case CPU_COLLIDER_PLANE:
+	{
+		const CPUPlane& plane = collider.plane;
+
+		for(int i = first; i < last; ++i)
+		{
+			float distance = plane.normal.x * x[i] + plane.normal.y * y[i] + plane.normal.z * z[i] + plane.offset;
+
+			if(distance < 0.0f && invMass[i] > 0.0f)
+			{
+				x[i] -= plane.normal.x * distance;
+				y[i] -= plane.normal.y * distance;
+				z[i] -= plane.normal.z * distance;
+			}
+		}
+		break;
+	}
+
+	case CPU_COLLIDER_BOX:
+	{
+		// Out through the face with the least penetration
+		const CPUBox& box = collider.box;
+		const float* half = &box.halfExtents.x;
+
+		for(int i = first; i < last; ++i)
+		{
+			if(invMass[i] <= 0.0f)
+				continue;
+
+			CPUVector3 offset = { x[i] - box.centre.x, y[i] - box.centre.y, z[i] - box.centre.z };
+			float depth = FLT_MAX;
+			int face = -1;
+			float side = 1.0f;
+
+			for(int a = 0; a < 3; ++a)
+			{
+				float local = dot(offset, box.axes[a]);
+				float faceDepth = half[a] - fabsf(local);
+
+				if(faceDepth <= 0.0f)
+				{
+					face = -1;
+					break;
+				}
+
+				if(faceDepth < depth)
+				{
+					depth = faceDepth;
+					face = a;
+					side = local < 0.0f ? -1.0f : 1.0f;
+				}
+			}
+
+			if(face >= 0)
+			{
+				x[i] += box.axes[face].x * depth * side;
+				y[i] += box.axes[face].y * depth * side;
+				z[i] += box.axes[face].z * depth * side;
+			}
+		}
+		break;
+	}
+
+	case CPU_COLLIDER_FIELD:
+	{
+		// Out along the field's gradient, one lookup per particle whatever the mesh
+		const CPUFieldCollider& field = collider.field;
+		const CPUVector3* axes = field.axes;
+
+		for(int i = first; i < last; ++i)
+		{
+			if(invMass[i] <= 0.0f)
+				continue;
+
+			CPUVector3 offset = { x[i] - field.position.x, y[i] - field.position.y, z[i] - field.position.z };
+			CPUVector3 local = { dot(offset, axes[0]), dot(offset, axes[1]), dot(offset, axes[2]) };
+			CPUVector3 gradient;
+			float distance;
+
+			if(!field.field->sample(local, distance, gradient) || distance >= field.thickness)
+				continue;
+
+			float length = sqrtf(dot(gradient, gradient));
+
+			if(length <= 0.0f)
+				continue;
+
+			float push = (field.thickness - distance) / length;
+
+			x[i] += (axes[0].x * gradient.x + axes[1].x * gradient.y + axes[2].x * gradient.z) * push;
+			y[i] += (axes[0].y * gradient.x + axes[1].y * gradient.y + axes[2].y * gradient.z) * push;
+			z[i] += (axes[0].z * gradient.x + axes[1].z * gradient.y + axes[2].z * gradient.z) * push;
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+// Sweep (conservative advancement of every particle's path against the moving collider)
+int CPUColliderWorld::sweep(int id, CPUParticles& particles, int first, int last, float from, float to) const
+{
+	// Particles behind a plane always go back in front of it
+	if(colliders[id].type == CPU_COLLIDER_PLANE)
+		return 0;
+
+	bool moves = moving[id] && to > from;
+	CPUCollider startPose = getPose(id, from);
+	CPUCollider endPose = moves ? getPose(id, to) : startPose;
+	float colliderReach = moves ? motionReach(startPose, endPose) : 0.0f;
+
+	// Paths shorter than this cannot pass through a still collider (most of them, no distance
+	// needed), a moving one may carry particles the solve left inside it
+	float depth = moves ? 0.0f : passDepth(endPose);
+	float depthSquared = depth > 0.0f ? depth * depth : -1.0f;
+
+	float* x = particles.x;
+	float* y = particles.y;
+	float* z = particles.z;
+	const float* oldX = particles.oldX;
+	const float* oldY = particles.oldY;
+	const float* oldZ = particles.oldZ;
+	const float* invMass = particles.invMass;
+	int stopped = 0;
+
+	for(int i = first; i < last; ++i)
+	{
+		if(invMass[i] <= 0.0f)
+			continue;
+
+		CPUVector3 start = { oldX[i], oldY[i], oldZ[i] };
+		CPUVector3 move = { x[i] - oldX[i], y[i] - oldY[i], z[i] - oldZ[i] };
+		float moveSquared = dot(move, move);
+
+		if(moveSquared < depthSquared)
+			continue;
+
+		// The fastest the particle and the collider's surface can close
+		float reach = sqrtf(moveSquared) + colliderReach;
+		float distance = shapeDistance(startPose, start);
+
+		// Out of reach (most particles, one distance each)
+		if(distance >= reach)
+			continue;
+
+		// Inside from the start (the solve pulled it in): carried with a moving solid, so the
+		// discrete pass pushes it out on the side it is on now. Left to the discrete pass when
+		// the collider is still, or a field (its thin parts would drag particles along).
+		if(distance <= 0.0f)
+		{
+			if(!moves || passDepth(startPose) <= 0.0f)
+				continue;
+
+			CPUVector3 carried = carry(startPose, endPose, start);
+
+			x[i] = carried.x;
+			y[i] = carried.y;
+			z[i] = carried.z;
+			++stopped;
+			continue;
+		}
+
+		float t = 0.0f;
+		CPUCollider pose = startPose;
+		CPUVector3 point = start;
+		bool contact = true;
+
+		for(int s = 0; s < SWEEP_ITERATIONS && distance > SWEEP_TOLERANCE * reach; ++s)
+		{
+			float next = t + distance / reach;
+
+			if(next >= 1.0f)
+			{
+				contact = false;
+				break;
+			}
+
+			CPUCollider nextPose = moves ? interpolate(startPose, endPose, next) : pose;
+			CPUVector3 nextPoint = { start.x + move.x * next, start.y + move.y * next, start.z + move.z * next };
+			float nextDistance = shapeDistance(nextPose, nextPoint);
+
+			// A field's distance is interpolated, so a step may overshoot into it (the last point
+			// outside is the contact then)
+			if(nextDistance < 0.0f)
+				break;
+
+			t = next;
+			pose = nextPose;
+			point = nextPoint;
+			distance = nextDistance;
+		}
+
+		if(!contact)
+			continue;
+
+		// Stopped at the contact, then carried with the collider to the end of the sweep
+		if(moves)
+			point = carry(pose, endPose, point);
+
+		x[i] = point.x;
+		y[i] = point.y;
+		z[i] = point.z;
+		++stopped;
+	}
+
+	return stopped;
+}
+
+// Get Pose
+CPUCollider CPUColliderWorld::getPose(int id, float at) const
+{
+	if(!moving[id] || at >= 1.0f)
+		return colliders[id];
+
+	return interpolate(starts[id], colliders[id], max(at, 0.0f));
+}
+
+// Find
+int CPUColliderWorld::find(CPUColliderType type) const
+{
+	for(int c = 0; c < (int)colliders.size(); ++c)
+	{
+		if(colliders[c].type == type)
+			return c;
+	}
+
+	return -1;
+}
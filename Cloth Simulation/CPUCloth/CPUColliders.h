@@ -0,0 +1,177 @@
+// ------------------------------------------------
+// Class:	CPU Colliders Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUCOLLIDERS
+#define CPUCOLLIDERS
+
+// INCLUDES
+#include "CPUParticles.h"
+#include "CPUDistanceField.h"
+
+// Standard includes
+#include <vector>
+
+#pragma region Collider Shapes
+// Sphere data
+struct CPUSphere
+{
+	CPUVector3 position;
+	float radius;
+};
+
+// Capsule: every point within radius of the segment from start to end
+struct CPUCapsule
+{
+	CPUVector3 start, end;
+	float radius;
+};
+
+// Half-space: particles are kept where normal . p + offset >= 0 (the a x + b y + c z + d
+// plane of GUPlane, the normal is normalised when the plane is set)
+struct CPUPlane
+{
+	CPUVector3 normal;
+	float offset;
+};
+
+// Oriented box: centre, three orthogonal axes (normalised when the box is set) and the half
+// extent along each
+struct CPUBox
+{
+	CPUVector3 centre;
+	CPUVector3 axes[3];
+	CPUVector3 halfExtents;
+};
+
+// Baked mesh: a distance field placed at position with its grid axes turned onto axes
+// (orthogonal, normalised when the collider is set), particles are kept thickness outside
+// the surface. The field is not owned and must outlive the collider.
+struct CPUFieldCollider
+{
+	const CPUDistanceField* field;
+	CPUVector3 position;
+	CPUVector3 axes[3];
+	float thickness;
+};
+#pragma endregion
+
+// Collider types
+enum CPUColliderType
+{
+	CPU_COLLIDER_SPHERE = 0,
+	CPU_COLLIDER_CAPSULE,
+	CPU_COLLIDER_PLANE,
+	CPU_COLLIDER_BOX,
+	CPU_COLLIDER_FIELD,
+	CPU_COLLIDER_TYPE_COUNT
+};
+
+// One collider of any type, with its world bounds (a plane has none)
+struct CPUCollider
+{
+	CPUColliderType type;
+
+	union
+	{
+		CPUSphere sphere;
+		CPUCapsule capsule;
+		CPUPlane plane;
+		CPUBox box;
+		CPUFieldCollider field;
+	};
+
+	CPUVector3 boundsMin, boundsMax;
+};
+
+// Set of colliders the particles are pushed out of, in the order they were added (the
+// projections run in that order, so overlapping colliders resolve the same way every run).
+// A particle inside a collider moves to its nearest surface point, pinned particles stay.
+// The broadphase tests a box of particles (a tile of the cloth) against every collider's
+// bounds, so the narrowphase only runs the colliders that can touch it.
+//
+// Colliders set again keep the pose they had when their motion started (the last settle), so
+// they can be moved through the substeps of a frame and swept (continuous collision): every
+// particle's path from its old position to its position is advanced towards the moving
+// collider by its distance over the fastest the two can close (conservative advancement),
+// and stops at the first contact. Boxes and fields are swept along their motion with the
+// axes of their current pose, and planes are not swept (nothing passes a half-space).
+class CPUColliderWorld
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable
+	CPUColliderWorld(const CPUColliderWorld&);
+	CPUColliderWorld& operator=(const CPUColliderWorld&);
+
+	std::vector<CPUCollider> colliders;
+
+	// Pose of every collider when its motion started, and whether it was set since
+	std::vector<CPUCollider> starts;
+	std::vector<char> moving;
+
+	// Normalise the shape and compute its bounds
+	static void prepare(CPUCollider& collider);
+
+	// Room for one more collider, returns its id
+	int append();
+
+	// Whether a box reaches within margin of the half-space behind a plane
+	static bool overlapsPlane(const CPUPlane& plane, const CPUVector3& boundsMin, const CPUVector3& boundsMax, float margin);
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor
+	CPUColliderWorld() {}
+
+	// Add a collider, returns its id (the colliders added before keep theirs)
+	int add(const CPUSphere& sphere);
+	int add(const CPUCapsule& capsule);
+	int add(const CPUPlane& plane);
+	int add(const CPUBox& box);
+	int add(const CPUFieldCollider& field);
+
+	// Replace a collider (its type may change), ids out of range are ignored
+	void set(int id, const CPUSphere& sphere);
+	void set(int id, const CPUCapsule& capsule);
+	void set(int id, const CPUPlane& plane);
+	void set(int id, const CPUBox& box);
+	void set(int id, const CPUFieldCollider& field);
+	void set(int id, const CPUCollider& collider);
+
+	// Remove a collider, the ids after it move down by one
+	void remove(int id);
+	void clear();
+
+	// End the motion of every collider (the current poses become the start poses)
+	void settle();
+
+	// Whether a collider reaches within margin of the box (anywhere along its motion)
+	bool overlaps(int id, const CPUVector3& boundsMin, const CPUVector3& boundsMax, float margin = 0.0f) const;
+
+	// Broadphase: ids of the colliders that reach the box, in id order
+	void findOverlaps(const CPUVector3& boundsMin, const CPUVector3& boundsMax, std::vector<int>& ids) const;
+
+	// Narrowphase: push the particles [first, last) out of one collider, posed at a fraction of
+	// its motion
+	void collide(int id, CPUParticles& particles, int first, int last, float at = 1.0f) const;
+
+	// Continuous narrowphase: sweep the paths of the particles [first, last) against one collider
+	// moving between two fractions of its motion, particles that touch it stop at the contact
+	// and move on with the collider. Returns the particles stopped.
+	int sweep(int id, CPUParticles& particles, int first, int last, float from, float to) const;
+
+	// Pose of a collider at a fraction of its motion (0 = start, 1 = current)
+	CPUCollider getPose(int id, float at) const;
+
+	// Accessors
+	int getCount() const { return (int)colliders.size(); }
+	const CPUCollider& get(int id) const { return colliders[id]; }
+	bool isMoving(int id) const { return moving[id] != 0; } // Set since the last settle
+	int find(CPUColliderType type) const; // First collider of a type, -1 if there is none
+};
+
+#endif
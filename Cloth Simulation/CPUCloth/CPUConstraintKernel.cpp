@@ -0,0 +1,171 @@
+// ------------------------------------------------
+// Source:	CPU Constraint Projection Kernels (scalar + dispatch)
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUConstraintKernel.h"
+
+// Standard includes
+#include <cmath>
+#include <algorithm>
+
+// Namespaces
+using namespace std;
+
+// Scalar kernel, the reference every SIMD kernel must agree with
+void projectConstraintsScalar(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params)
+{
+	float* x = positions.x;
+	float* y = positions.y;
+	float* z = positions.z;
+
+	float stretchMax = 0.0f;
+	float stretchSquares = 0.0f;
+
+	for(int i = first; i < last; ++i)
+	{
+		unsigned int start = batch.start[i];
+		unsigned int end = batch.end[i];
+
+		float dx = x[start] - x[end];
+		float dy = y[start] - y[end];
+		float dz = z[start] - z[end];
+
+		float distance = max(sqrtf(dx * dx + dy * dy + dz * dz), 1e-7f);
+
+		if(params.stretchMax)
+		{
+			float stretch = fabsf(distance - batch.distance[i]) / batch.distance[i];
+
+			stretchMax = max(stretchMax, stretch);
+			stretchSquares += stretch * stretch;
+		}
+
+		float startInvMass = params.invMass[start];
+		float endInvMass = params.invMass[end];
+		float invMassSum = startInvMass + endInvMass;
+
+		float startWeight, endWeight;
+
+		if(params.lambda)
+		{
+			// XPBD: the correction along the constraint direction is accumulated into the multiplier
+			float denominator = invMassSum + params.alpha;
+
+			float constraint = distance - batch.distance[i];
+			float deltaLambda = denominator > 0.0f ? (-constraint - params.alpha * params.lambda[i]) / denominator : 0.0f;
+
+			params.lambda[i] += deltaLambda;
+
+			// Express as a fraction of the delta vector so both modes share the update below
+			float scale = -deltaLambda / distance;
+
+			dx *= scale;
+			dy *= scale;
+			dz *= scale;
+
+			startWeight = startInvMass;
+			endWeight = endInvMass;
+		}
+		else
+		{
+			float streching = 1.0f - batch.distance[i] / distance;
+
+			dx *= streching;
+			dy *= streching;
+			dz *= streching;
+
+			// Split the correction by inverse mass, pinned ends do not move
+			startWeight = invMassSum > 0.0f ? startInvMass / invMassSum : 0.0f;
+			endWeight = invMassSum > 0.0f ? endInvMass / invMassSum : 0.0f;
+		}
+
+		x[start] -= dx * startWeight;
+		y[start] -= dy * startWeight;
+		z[start] -= dz * startWeight;
+
+		x[end] += dx * endWeight;
+		y[end] += dy * endWeight;
+		z[end] += dz * endWeight;
+	}
+
+	if(params.stretchMax)
+	{
+		*params.stretchMax = stretchMax;
+		*params.stretchSquares = stretchSquares;
+	}
+}
+
+// Scalar Jacobi kernel, the SIMD kernels repeat its operations in the same order
+void jacobiScalar(const CPUJacobiSpan& span, int first, int last)
+{
+	for(int i = first; i < last; ++i)
+	{
+		float px = span.x[i], py = span.y[i], pz = span.z[i], w = span.invMass[i];
+		float dx = 0.0f, dy = 0.0f, dz = 0.0f;
+
+		for(int k = 0; k < 8; ++k)
+		{
+			int j = i + span.offset[k];
+
+			float ex = span.x[j] - px;
+			float ey = span.y[j] - py;
+			float ez = span.z[j] - pz;
+			float length = sqrtf(ex * ex + ey * ey + ez * ez);
+
+			// Share of the correction this end takes (0 when pinned, or both ends are)
+			float share = span.weight[k] * w / max(w + span.invMass[j], 1e-12f);
+			float correction = share * (length - span.rest[k]) / max(length, 1e-12f);
+
+			dx += correction * ex;
+			dy += correction * ey;
+			dz += correction * ez;
+		}
+
+		span.outX[i] = px + span.scale * dx;
+		span.outY[i] = py + span.scale * dy;
+		span.outZ[i] = pz + span.scale * dz;
+	}
+}
+
+// Get Constraint Kernel
+CPUConstraintKernel getConstraintKernel(CPUInstructionSet isa)
+{
+#ifdef CPU_CLOTH_X86_KERNELS
+	switch(isa)
+	{
+	case CPU_ISA_AVX512:
+		return projectConstraintsAVX512;
+	case CPU_ISA_AVX2:
+		return projectConstraintsAVX2;
+	case CPU_ISA_SSE42:
+		return projectConstraintsSSE42;
+	default:
+		break;
+	}
+#endif
+
+	return projectConstraintsScalar;
+}
+
+// Get Jacobi Kernel
+CPUJacobiKernel getJacobiKernel(CPUInstructionSet isa)
+{
+#ifdef CPU_CLOTH_X86_KERNELS
+	switch(isa)
+	{
+	case CPU_ISA_AVX512:
+		return jacobiAVX512;
+	case CPU_ISA_AVX2:
+		return jacobiAVX2;
+	case CPU_ISA_SSE42:
+		return jacobiSSE42;
+	default:
+		break;
+	}
+#endif
+
+	return jacobiScalar;
+}
@@ -0,0 +1,97 @@
+// ------------------------------------------------
+// Header:	CPU Constraint Projection Kernels
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUCONSTRAINTKERNEL
+#define CPUCONSTRAINTKERNEL
+
+// INCLUDES
+#include "CPUFeatures.h"
+
+// One coloured constraint batch in structure of arrays form.
+// Constraints inside a batch never share a particle, so any number of them
+// can be projected at once.
+struct CPUConstraintBatch
+{
+	const unsigned int* start;
+	const unsigned int* end;
+	const float* distance;
+	int count;
+};
+
+// Particle positions updated by the kernels
+struct CPUPositions
+{
+	float* x;
+	float* y;
+	float* z;
+};
+
+// Per pass solver parameters
+struct CPUConstraintParams
+{
+	// Per particle inverse mass (0 = pinned), corrections are split in proportion to it
+	const float* invMass;
+
+	// XPBD: accumulated Lagrange multipliers (one per constraint in the batch) and the
+	// time step scaled compliance (compliance / dt^2). A null lambda selects plain PBD.
+	float* lambda;
+	float alpha;
+
+	// Optional stretch reduction (null = off): the largest relative stretch |distance - rest| / rest
+	// of constraints [first, last) as they were before their projection, and the sum of its squares
+	float* stretchMax;
+	float* stretchSquares;
+};
+
+// One span of a lattice row for the Jacobi gather pass. Particle i reads neighbour k at
+// i + offset[k] (a missing neighbour has offset 0 and weight 0) and writes its position plus
+// scale times the sum of the PBD corrections of its springs to the output arrays.
+struct CPUJacobiSpan
+{
+	const float* x;
+	const float* y;
+	const float* z;
+	const float* invMass;
+	float* outX;
+	float* outY;
+	float* outZ;
+	int offset[8];
+	float weight[8];
+	float rest[8];
+	float scale; // Relaxation over the number of springs
+};
+
+// Projects constraints [first, last) of a batch (cloth_apply_constraints.hlsl)
+typedef void (*CPUConstraintKernel)(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params);
+
+// Moves particles [first, last) of a Jacobi span
+typedef void (*CPUJacobiKernel)(const CPUJacobiSpan& span, int first, int last);
+
+// Kernel for an instruction set, falls back to the widest compiled kernel not wider than isa
+CPUConstraintKernel getConstraintKernel(CPUInstructionSet isa);
+CPUJacobiKernel getJacobiKernel(CPUInstructionSet isa);
+
+// Kernels (the SIMD variants live in their own translation units built with matching flags)
+void projectConstraintsScalar(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params);
+void jacobiScalar(const CPUJacobiSpan& span, int first, int last);
+
+#ifdef CPU_CLOTH_X86_KERNELS
+void projectConstraintsSSE42(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params);
+
+void projectConstraintsAVX2(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params);
+
+void projectConstraintsAVX512(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params);
+
+void jacobiSSE42(const CPUJacobiSpan& span, int first, int last);
+void jacobiAVX2(const CPUJacobiSpan& span, int first, int last);
+void jacobiAVX512(const CPUJacobiSpan& span, int first, int last);
+#endif
+
+#endif
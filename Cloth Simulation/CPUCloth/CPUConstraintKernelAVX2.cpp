@@ -0,0 +1,206 @@
+// ------------------------------------------------
+// Source:	CPU Constraint Projection Kernel (AVX2, 8 lanes)
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUConstraintKernel.h"
+
+// Intrinsics
+#include <immintrin.h>
+
+// AVX2 kernel
+void projectConstraintsAVX2(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params)
+{
+	float* x = positions.x;
+	float* y = positions.y;
+	float* z = positions.z;
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 epsilon = _mm256_set1_ps(1e-7f);
+	const __m256 alpha = _mm256_set1_ps(params.alpha);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+	__m256 stretchMax = _mm256_setzero_ps();
+	__m256 stretchSquares = _mm256_setzero_ps();
+
+	int i = first;
+
+	for(; i + 8 <= last; i += 8)
+	{
+		__m256i startIndex = _mm256_loadu_si256((const __m256i*)(batch.start + i));
+		__m256i endIndex = _mm256_loadu_si256((const __m256i*)(batch.end + i));
+
+		// Gather
+		__m256 startX = _mm256_i32gather_ps(x, startIndex, 4);
+		__m256 startY = _mm256_i32gather_ps(y, startIndex, 4);
+		__m256 startZ = _mm256_i32gather_ps(z, startIndex, 4);
+		__m256 endX = _mm256_i32gather_ps(x, endIndex, 4);
+		__m256 endY = _mm256_i32gather_ps(y, endIndex, 4);
+		__m256 endZ = _mm256_i32gather_ps(z, endIndex, 4);
+
+		__m256 dx = _mm256_sub_ps(startX, endX);
+		__m256 dy = _mm256_sub_ps(startY, endY);
+		__m256 dz = _mm256_sub_ps(startZ, endZ);
+
+		__m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		__m256 distance = _mm256_max_ps(epsilon, _mm256_sqrt_ps(lengthSq));
+
+		if(params.stretchMax)
+		{
+			__m256 rest = _mm256_loadu_ps(batch.distance + i);
+			__m256 stretch = _mm256_div_ps(_mm256_andnot_ps(signMask, _mm256_sub_ps(distance, rest)), rest);
+
+			stretchMax = _mm256_max_ps(stretchMax, stretch);
+			stretchSquares = _mm256_add_ps(stretchSquares, _mm256_mul_ps(stretch, stretch));
+		}
+
+		// Inverse masses
+		__m256 startInvMass = _mm256_i32gather_ps(params.invMass, startIndex, 4);
+		__m256 endInvMass = _mm256_i32gather_ps(params.invMass, endIndex, 4);
+		__m256 invMassSum = _mm256_add_ps(startInvMass, endInvMass);
+
+		__m256 startWeight, endWeight;
+
+		if(params.lambda)
+		{
+			// XPBD (see projectConstraintsScalar)
+			__m256 denominator = _mm256_add_ps(invMassSum, alpha);
+
+			__m256 lambda = _mm256_loadu_ps(params.lambda + i);
+			__m256 constraint = _mm256_sub_ps(distance, _mm256_loadu_ps(batch.distance + i));
+			__m256 numerator = _mm256_sub_ps(_mm256_xor_ps(constraint, signMask), _mm256_mul_ps(alpha, lambda));
+			__m256 deltaLambda = _mm256_blendv_ps(zero, _mm256_div_ps(numerator, denominator), _mm256_cmp_ps(denominator, zero, _CMP_GT_OQ));
+
+			_mm256_storeu_ps(params.lambda + i, _mm256_add_ps(lambda, deltaLambda));
+
+			__m256 scale = _mm256_div_ps(_mm256_xor_ps(deltaLambda, signMask), distance);
+
+			dx = _mm256_mul_ps(dx, scale);
+			dy = _mm256_mul_ps(dy, scale);
+			dz = _mm256_mul_ps(dz, scale);
+
+			startWeight = startInvMass;
+			endWeight = endInvMass;
+		}
+		else
+		{
+			__m256 streching = _mm256_sub_ps(one, _mm256_div_ps(_mm256_loadu_ps(batch.distance + i), distance));
+
+			dx = _mm256_mul_ps(dx, streching);
+			dy = _mm256_mul_ps(dy, streching);
+			dz = _mm256_mul_ps(dz, streching);
+
+			__m256 movable = _mm256_cmp_ps(invMassSum, zero, _CMP_GT_OQ);
+			startWeight = _mm256_blendv_ps(zero, _mm256_div_ps(startInvMass, invMassSum), movable);
+			endWeight = _mm256_blendv_ps(zero, _mm256_div_ps(endInvMass, invMassSum), movable);
+		}
+
+		startX = _mm256_sub_ps(startX, _mm256_mul_ps(dx, startWeight));
+		startY = _mm256_sub_ps(startY, _mm256_mul_ps(dy, startWeight));
+		startZ = _mm256_sub_ps(startZ, _mm256_mul_ps(dz, startWeight));
+		endX = _mm256_add_ps(endX, _mm256_mul_ps(dx, endWeight));
+		endY = _mm256_add_ps(endY, _mm256_mul_ps(dy, endWeight));
+		endZ = _mm256_add_ps(endZ, _mm256_mul_ps(dz, endWeight));
+
+		// Scatter (AVX2 has no scatter instruction)
+		const unsigned int* s = batch.start + i;
+		const unsigned int* e = batch.end + i;
+
+		float sx[8], sy[8], sz[8], ex[8], ey[8], ez[8];
+		_mm256_storeu_ps(sx, startX);
+		_mm256_storeu_ps(sy, startY);
+		_mm256_storeu_ps(sz, startZ);
+		_mm256_storeu_ps(ex, endX);
+		_mm256_storeu_ps(ey, endY);
+		_mm256_storeu_ps(ez, endZ);
+
+		for(int k = 0; k < 8; ++k)
+		{
+			x[s[k]] = sx[k];
+			y[s[k]] = sy[k];
+			z[s[k]] = sz[k];
+			x[e[k]] = ex[k];
+			y[e[k]] = ey[k];
+			z[e[k]] = ez[k];
+		}
+	}
+
+	// Remainder, the lanes are folded into its stretch in lane order
+	CPUConstraintParams remainder = params;
+	float remainderMax = 0.0f, remainderSquares = 0.0f;
+
+	if(params.stretchMax)
+	{
+		remainder.stretchMax = &remainderMax;
+		remainder.stretchSquares = &remainderSquares;
+	}
+
+	projectConstraintsScalar(batch, i, last, positions, remainder);
+
+	if(params.stretchMax)
+	{
+		float laneMax[8], laneSquares[8];
+		_mm256_storeu_ps(laneMax, stretchMax);
+		_mm256_storeu_ps(laneSquares, stretchSquares);
+
+		for(int k = 0; k < 8; ++k)
+		{
+			remainderMax = laneMax[k] > remainderMax ? laneMax[k] : remainderMax;
+			remainderSquares += laneSquares[k];
+		}
+
+		*params.stretchMax = remainderMax;
+		*params.stretchSquares = remainderSquares;
+	}
+}
+
+// AVX2 Jacobi kernel (see jacobiScalar)
+void jacobiAVX2(const CPUJacobiSpan& span, int first, int last)
+{
+	const __m256 epsilon = _mm256_set1_ps(1e-12f);
+	const __m256 scale = _mm256_set1_ps(span.scale);
+
+	int i = first;
+
+	for(; i + 8 <= last; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(span.x + i);
+		__m256 py = _mm256_loadu_ps(span.y + i);
+		__m256 pz = _mm256_loadu_ps(span.z + i);
+		__m256 w = _mm256_loadu_ps(span.invMass + i);
+
+		__m256 dx = _mm256_setzero_ps();
+		__m256 dy = _mm256_setzero_ps();
+		__m256 dz = _mm256_setzero_ps();
+
+		for(int k = 0; k < 8; ++k)
+		{
+			// The neighbours of consecutive particles are consecutive, plain loads rather than gathers
+			int j = i + span.offset[k];
+
+			__m256 ex = _mm256_sub_ps(_mm256_loadu_ps(span.x + j), px);
+			__m256 ey = _mm256_sub_ps(_mm256_loadu_ps(span.y + j), py);
+			__m256 ez = _mm256_sub_ps(_mm256_loadu_ps(span.z + j), pz);
+			__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)), _mm256_mul_ps(ez, ez)));
+
+			__m256 share = _mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(span.weight[k]), w),
+				_mm256_max_ps(_mm256_add_ps(w, _mm256_loadu_ps(span.invMass + j)), epsilon));
+			__m256 correction = _mm256_div_ps(_mm256_mul_ps(share, _mm256_sub_ps(length, _mm256_set1_ps(span.rest[k]))),
+				_mm256_max_ps(length, epsilon));
+
+			dx = _mm256_add_ps(dx, _mm256_mul_ps(correction, ex));
+			dy = _mm256_add_ps(dy, _mm256_mul_ps(correction, ey));
+			dz = _mm256_add_ps(dz, _mm256_mul_ps(correction, ez));
+		}
+
+		_mm256_storeu_ps(span.outX + i, _mm256_add_ps(px, _mm256_mul_ps(scale, dx)));
+		_mm256_storeu_ps(span.outY + i, _mm256_add_ps(py, _mm256_mul_ps(scale, dy)));
+		_mm256_storeu_ps(span.outZ + i, _mm256_add_ps(pz, _mm256_mul_ps(scale, dz)));
+	}
+
+	// Remainder
+	jacobiScalar(span, i, last);
+}
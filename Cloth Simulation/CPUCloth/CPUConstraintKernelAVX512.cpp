@@ -0,0 +1,193 @@
+// ------------------------------------------------
+// Source:	CPU Constraint Projection Kernel (AVX-512, 16 lanes)
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUConstraintKernel.h"
+
+// Intrinsics
+#include <immintrin.h>
+
+// AVX-512 kernel
+void projectConstraintsAVX512(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params)
+{
+	float* x = positions.x;
+	float* y = positions.y;
+	float* z = positions.z;
+
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 epsilon = _mm512_set1_ps(1e-7f);
+	const __m512 alpha = _mm512_set1_ps(params.alpha);
+	const __m512i signMask = _mm512_set1_epi32((int)0x80000000);
+
+	__m512 stretchMax = _mm512_setzero_ps();
+	__m512 stretchSquares = _mm512_setzero_ps();
+
+	int i = first;
+
+	for(; i + 16 <= last; i += 16)
+	{
+		__m512i startIndex = _mm512_loadu_si512((const void*)(batch.start + i));
+		__m512i endIndex = _mm512_loadu_si512((const void*)(batch.end + i));
+
+		// Gather
+		__m512 startX = _mm512_i32gather_ps(startIndex, x, 4);
+		__m512 startY = _mm512_i32gather_ps(startIndex, y, 4);
+		__m512 startZ = _mm512_i32gather_ps(startIndex, z, 4);
+		__m512 endX = _mm512_i32gather_ps(endIndex, x, 4);
+		__m512 endY = _mm512_i32gather_ps(endIndex, y, 4);
+		__m512 endZ = _mm512_i32gather_ps(endIndex, z, 4);
+
+		__m512 dx = _mm512_sub_ps(startX, endX);
+		__m512 dy = _mm512_sub_ps(startY, endY);
+		__m512 dz = _mm512_sub_ps(startZ, endZ);
+
+		__m512 lengthSq = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+		__m512 distance = _mm512_max_ps(epsilon, _mm512_sqrt_ps(lengthSq));
+
+		if(params.stretchMax)
+		{
+			__m512 rest = _mm512_loadu_ps(batch.distance + i);
+			__m512 stretch = _mm512_div_ps(_mm512_abs_ps(_mm512_sub_ps(distance, rest)), rest);
+
+			stretchMax = _mm512_max_ps(stretchMax, stretch);
+			stretchSquares = _mm512_add_ps(stretchSquares, _mm512_mul_ps(stretch, stretch));
+		}
+
+		// Inverse masses
+		__m512 startInvMass = _mm512_i32gather_ps(startIndex, params.invMass, 4);
+		__m512 endInvMass = _mm512_i32gather_ps(endIndex, params.invMass, 4);
+		__m512 invMassSum = _mm512_add_ps(startInvMass, endInvMass);
+
+		__m512 startWeight, endWeight;
+
+		if(params.lambda)
+		{
+			// XPBD (see projectConstraintsScalar)
+			__m512 denominator = _mm512_add_ps(invMassSum, alpha);
+
+			__m512 lambda = _mm512_loadu_ps(params.lambda + i);
+			__m512 constraint = _mm512_sub_ps(distance, _mm512_loadu_ps(batch.distance + i));
+			__m512 numerator = _mm512_sub_ps(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(constraint), signMask)), _mm512_mul_ps(alpha, lambda));
+			__mmask16 solvable = _mm512_cmp_ps_mask(denominator, zero, _CMP_GT_OQ);
+			__m512 deltaLambda = _mm512_maskz_div_ps(solvable, numerator, denominator);
+
+			_mm512_storeu_ps(params.lambda + i, _mm512_add_ps(lambda, deltaLambda));
+
+			__m512 scale = _mm512_div_ps(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(deltaLambda), signMask)), distance);
+
+			dx = _mm512_mul_ps(dx, scale);
+			dy = _mm512_mul_ps(dy, scale);
+			dz = _mm512_mul_ps(dz, scale);
+
+			startWeight = startInvMass;
+			endWeight = endInvMass;
+		}
+		else
+		{
+			__m512 streching = _mm512_sub_ps(one, _mm512_div_ps(_mm512_loadu_ps(batch.distance + i), distance));
+
+			dx = _mm512_mul_ps(dx, streching);
+			dy = _mm512_mul_ps(dy, streching);
+			dz = _mm512_mul_ps(dz, streching);
+
+			__mmask16 movable = _mm512_cmp_ps_mask(invMassSum, zero, _CMP_GT_OQ);
+			startWeight = _mm512_maskz_div_ps(movable, startInvMass, invMassSum);
+			endWeight = _mm512_maskz_div_ps(movable, endInvMass, invMassSum);
+		}
+
+		startX = _mm512_sub_ps(startX, _mm512_mul_ps(dx, startWeight));
+		startY = _mm512_sub_ps(startY, _mm512_mul_ps(dy, startWeight));
+		startZ = _mm512_sub_ps(startZ, _mm512_mul_ps(dz, startWeight));
+		endX = _mm512_add_ps(endX, _mm512_mul_ps(dx, endWeight));
+		endY = _mm512_add_ps(endY, _mm512_mul_ps(dy, endWeight));
+		endZ = _mm512_add_ps(endZ, _mm512_mul_ps(dz, endWeight));
+
+		// Scatter
+		_mm512_i32scatter_ps(x, startIndex, startX, 4);
+		_mm512_i32scatter_ps(y, startIndex, startY, 4);
+		_mm512_i32scatter_ps(z, startIndex, startZ, 4);
+		_mm512_i32scatter_ps(x, endIndex, endX, 4);
+		_mm512_i32scatter_ps(y, endIndex, endY, 4);
+		_mm512_i32scatter_ps(z, endIndex, endZ, 4);
+	}
+
+	// Remainder, the lanes are folded into its stretch in lane order
+	CPUConstraintParams remainder = params;
+	float remainderMax = 0.0f, remainderSquares = 0.0f;
+
+	if(params.stretchMax)
+	{
+		remainder.stretchMax = &remainderMax;
+		remainder.stretchSquares = &remainderSquares;
+	}
+
+	projectConstraintsScalar(batch, i, last, positions, remainder);
+
+	if(params.stretchMax)
+	{
+		float laneMax[16], laneSquares[16];
+		_mm512_storeu_ps(laneMax, stretchMax);
+		_mm512_storeu_ps(laneSquares, stretchSquares);
+
+		for(int k = 0; k < 16; ++k)
+		{
+			remainderMax = laneMax[k] > remainderMax ? laneMax[k] : remainderMax;
+			remainderSquares += laneSquares[k];
+		}
+
+		*params.stretchMax = remainderMax;
+		*params.stretchSquares = remainderSquares;
+	}
+}
+
+// AVX-512 Jacobi kernel (see jacobiScalar)
+void jacobiAVX512(const CPUJacobiSpan& span, int first, int last)
+{
+	const __m512 epsilon = _mm512_set1_ps(1e-12f);
+	const __m512 scale = _mm512_set1_ps(span.scale);
+
+	int i = first;
+
+	for(; i + 16 <= last; i += 16)
+	{
+		__m512 px = _mm512_loadu_ps(span.x + i);
+		__m512 py = _mm512_loadu_ps(span.y + i);
+		__m512 pz = _mm512_loadu_ps(span.z + i);
+		__m512 w = _mm512_loadu_ps(span.invMass + i);
+
+		__m512 dx = _mm512_setzero_ps();
+		__m512 dy = _mm512_setzero_ps();
+		__m512 dz = _mm512_setzero_ps();
+
+		for(int k = 0; k < 8; ++k)
+		{
+			// The neighbours of consecutive particles are consecutive, plain loads rather than gathers
+			int j = i + span.offset[k];
+
+			__m512 ex = _mm512_sub_ps(_mm512_loadu_ps(span.x + j), px);
+			__m512 ey = _mm512_sub_ps(_mm512_loadu_ps(span.y + j), py);
+			__m512 ez = _mm512_sub_ps(_mm512_loadu_ps(span.z + j), pz);
+			__m512 length = _mm512_sqrt_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ex, ex), _mm512_mul_ps(ey, ey)), _mm512_mul_ps(ez, ez)));
+
+			__m512 share = _mm512_div_ps(_mm512_mul_ps(_mm512_set1_ps(span.weight[k]), w),
+				_mm512_max_ps(_mm512_add_ps(w, _mm512_loadu_ps(span.invMass + j)), epsilon));
+			__m512 correction = _mm512_div_ps(_mm512_mul_ps(share, _mm512_sub_ps(length, _mm512_set1_ps(span.rest[k]))),
+				_mm512_max_ps(length, epsilon));
+
+			dx = _mm512_add_ps(dx, _mm512_mul_ps(correction, ex));
+			dy = _mm512_add_ps(dy, _mm512_mul_ps(correction, ey));
+			dz = _mm512_add_ps(dz, _mm512_mul_ps(correction, ez));
+		}
+
+		_mm512_storeu_ps(span.outX + i, _mm512_add_ps(px, _mm512_mul_ps(scale, dx)));
+		_mm512_storeu_ps(span.outY + i, _mm512_add_ps(py, _mm512_mul_ps(scale, dy)));
+		_mm512_storeu_ps(span.outZ + i, _mm512_add_ps(pz, _mm512_mul_ps(scale, dz)));
+	}
+
+	// Remainder
+	jacobiScalar(span, i, last);
+}
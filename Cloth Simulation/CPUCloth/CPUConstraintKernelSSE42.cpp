@@ -0,0 +1,204 @@
+// ------------------------------------------------
+// Source:	CPU Constraint Projection Kernel (SSE4.2, 4 lanes)
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUConstraintKernel.h"
+
+// Intrinsics
+#include <smmintrin.h>
+
+// SSE4.2 kernel
+void projectConstraintsSSE42(const CPUConstraintBatch& batch, int first, int last,
+	const CPUPositions& positions, const CPUConstraintParams& params)
+{
+	float* x = positions.x;
+	float* y = positions.y;
+	float* z = positions.z;
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 epsilon = _mm_set1_ps(1e-7f);
+	const __m128 alpha = _mm_set1_ps(params.alpha);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	__m128 stretchMax = _mm_setzero_ps();
+	__m128 stretchSquares = _mm_setzero_ps();
+
+	int i = first;
+
+	for(; i + 4 <= last; i += 4)
+	{
+		const unsigned int* s = batch.start + i;
+		const unsigned int* e = batch.end + i;
+
+		// Gather
+		__m128 startX = _mm_setr_ps(x[s[0]], x[s[1]], x[s[2]], x[s[3]]);
+		__m128 startY = _mm_setr_ps(y[s[0]], y[s[1]], y[s[2]], y[s[3]]);
+		__m128 startZ = _mm_setr_ps(z[s[0]], z[s[1]], z[s[2]], z[s[3]]);
+		__m128 endX = _mm_setr_ps(x[e[0]], x[e[1]], x[e[2]], x[e[3]]);
+		__m128 endY = _mm_setr_ps(y[e[0]], y[e[1]], y[e[2]], y[e[3]]);
+		__m128 endZ = _mm_setr_ps(z[e[0]], z[e[1]], z[e[2]], z[e[3]]);
+
+		__m128 dx = _mm_sub_ps(startX, endX);
+		__m128 dy = _mm_sub_ps(startY, endY);
+		__m128 dz = _mm_sub_ps(startZ, endZ);
+
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 distance = _mm_max_ps(epsilon, _mm_sqrt_ps(lengthSq));
+
+		if(params.stretchMax)
+		{
+			__m128 rest = _mm_loadu_ps(batch.distance + i);
+			__m128 stretch = _mm_div_ps(_mm_andnot_ps(signMask, _mm_sub_ps(distance, rest)), rest);
+
+			stretchMax = _mm_max_ps(stretchMax, stretch);
+			stretchSquares = _mm_add_ps(stretchSquares, _mm_mul_ps(stretch, stretch));
+		}
+
+		// Inverse masses
+		const float* w = params.invMass;
+		__m128 startInvMass = _mm_setr_ps(w[s[0]], w[s[1]], w[s[2]], w[s[3]]);
+		__m128 endInvMass = _mm_setr_ps(w[e[0]], w[e[1]], w[e[2]], w[e[3]]);
+		__m128 invMassSum = _mm_add_ps(startInvMass, endInvMass);
+
+		__m128 startWeight, endWeight;
+
+		if(params.lambda)
+		{
+			// XPBD (see projectConstraintsScalar)
+			__m128 denominator = _mm_add_ps(invMassSum, alpha);
+
+			__m128 lambda = _mm_loadu_ps(params.lambda + i);
+			__m128 constraint = _mm_sub_ps(distance, _mm_loadu_ps(batch.distance + i));
+			__m128 numerator = _mm_sub_ps(_mm_xor_ps(constraint, signMask), _mm_mul_ps(alpha, lambda));
+			__m128 deltaLambda = _mm_blendv_ps(zero, _mm_div_ps(numerator, denominator), _mm_cmpgt_ps(denominator, zero));
+
+			_mm_storeu_ps(params.lambda + i, _mm_add_ps(lambda, deltaLambda));
+
+			__m128 scale = _mm_div_ps(_mm_xor_ps(deltaLambda, signMask), distance);
+
+			dx = _mm_mul_ps(dx, scale);
+			dy = _mm_mul_ps(dy, scale);
+			dz = _mm_mul_ps(dz, scale);
+
+			startWeight = startInvMass;
+			endWeight = endInvMass;
+		}
+		else
+		{
+			__m128 streching = _mm_sub_ps(one, _mm_div_ps(_mm_loadu_ps(batch.distance + i), distance));
+
+			dx = _mm_mul_ps(dx, streching);
+			dy = _mm_mul_ps(dy, streching);
+			dz = _mm_mul_ps(dz, streching);
+
+			__m128 movable = _mm_cmpgt_ps(invMassSum, zero);
+			startWeight = _mm_blendv_ps(zero, _mm_div_ps(startInvMass, invMassSum), movable);
+			endWeight = _mm_blendv_ps(zero, _mm_div_ps(endInvMass, invMassSum), movable);
+		}
+
+		startX = _mm_sub_ps(startX, _mm_mul_ps(dx, startWeight));
+		startY = _mm_sub_ps(startY, _mm_mul_ps(dy, startWeight));
+		startZ = _mm_sub_ps(startZ, _mm_mul_ps(dz, startWeight));
+		endX = _mm_add_ps(endX, _mm_mul_ps(dx, endWeight));
+		endY = _mm_add_ps(endY, _mm_mul_ps(dy, endWeight));
+		endZ = _mm_add_ps(endZ, _mm_mul_ps(dz, endWeight));
+
+		// Scatter
+		float sx[4], sy[4], sz[4], ex[4], ey[4], ez[4];
+		_mm_storeu_ps(sx, startX);
+		_mm_storeu_ps(sy, startY);
+		_mm_storeu_ps(sz, startZ);
+		_mm_storeu_ps(ex, endX);
+		_mm_storeu_ps(ey, endY);
+		_mm_storeu_ps(ez, endZ);
+
+		for(int k = 0; k < 4; ++k)
+		{
+			x[s[k]] = sx[k];
+			y[s[k]] = sy[k];
+			z[s[k]] = sz[k];
+			x[e[k]] = ex[k];
+			y[e[k]] = ey[k];
+			z[e[k]] = ez[k];
+		}
+	}
+
+	// Remainder, the lanes are folded into its stretch in lane order
+	CPUConstraintParams remainder = params;
+	float remainderMax = 0.0f, remainderSquares = 0.0f;
+
+	if(params.stretchMax)
+	{
+		remainder.stretchMax = &remainderMax;
+		remainder.stretchSquares = &remainderSquares;
+	}
+
+	projectConstraintsScalar(batch, i, last, positions, remainder);
+
+	if(params.stretchMax)
+	{
+		float laneMax[4], laneSquares[4];
+		_mm_storeu_ps(laneMax, stretchMax);
+		_mm_storeu_ps(laneSquares, stretchSquares);
+
+		for(int k = 0; k < 4; ++k)
+		{
+			remainderMax = laneMax[k] > remainderMax ? laneMax[k] : remainderMax;
+			remainderSquares += laneSquares[k];
+		}
+
+		*params.stretchMax = remainderMax;
+		*params.stretchSquares = remainderSquares;
+	}
+}
+
+// SSE4.2 Jacobi kernel (see jacobiScalar)
+void jacobiSSE42(const CPUJacobiSpan& span, int first, int last)
+{
+	const __m128 epsilon = _mm_set1_ps(1e-12f);
+	const __m128 scale = _mm_set1_ps(span.scale);
+
+	int i = first;
+
+	for(; i + 4 <= last; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(span.x + i);
+		__m128 py = _mm_loadu_ps(span.y + i);
+		__m128 pz = _mm_loadu_ps(span.z + i);
+		__m128 w = _mm_loadu_ps(span.invMass + i);
+
+		__m128 dx = _mm_setzero_ps();
+		__m128 dy = _mm_setzero_ps();
+		__m128 dz = _mm_setzero_ps();
+
+		for(int k = 0; k < 8; ++k)
+		{
+			// The neighbours of consecutive particles are consecutive, plain loads rather than gathers
+			int j = i + span.offset[k];
+
+			__m128 ex = _mm_sub_ps(_mm_loadu_ps(span.x + j), px);
+			__m128 ey = _mm_sub_ps(_mm_loadu_ps(span.y + j), py);
+			__m128 ez = _mm_sub_ps(_mm_loadu_ps(span.z + j), pz);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez)));
+
+			__m128 share = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(span.weight[k]), w),
+				_mm_max_ps(_mm_add_ps(w, _mm_loadu_ps(span.invMass + j)), epsilon));
+			__m128 correction = _mm_div_ps(_mm_mul_ps(share, _mm_sub_ps(length, _mm_set1_ps(span.rest[k]))),
+				_mm_max_ps(length, epsilon));
+
+			dx = _mm_add_ps(dx, _mm_mul_ps(correction, ex));
+			dy = _mm_add_ps(dy, _mm_mul_ps(correction, ey));
+			dz = _mm_add_ps(dz, _mm_mul_ps(correction, ez));
+		}
+
+		_mm_storeu_ps(span.outX + i, _mm_add_ps(px, _mm_mul_ps(scale, dx)));
+		_mm_storeu_ps(span.outY + i, _mm_add_ps(py, _mm_mul_ps(scale, dy)));
+		_mm_storeu_ps(span.outZ + i, _mm_add_ps(pz, _mm_mul_ps(scale, dz)));
+	}
+
+	// Remainder
+	jacobiScalar(span, i, last);
+}
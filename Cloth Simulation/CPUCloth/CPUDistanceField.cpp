@@ -0,0 +1,490 @@
+// ------------------------------------------------
+// Class:	CPU Distance Field Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUDistanceField.h"
+#include "CPUHash.h"
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Debug includes
+#include <iostream>
+
+// Namespaces
+using namespace std;
+
+// Cache file tag and layout version
+#define FIELD_MAGIC 0x3130464453555043ull // "CPUSDF01"
+#define FIELD_VERSION 1
+
+// Offset of the sign rays from the grid rows (in cells, odd fractions so a ray never runs
+// exactly along an edge of a mesh built on round coordinates)
+#define RAY_OFFSET_Y 0.000137f
+#define RAY_OFFSET_Z 0.000291f
+
+// Cache file header
+struct CPUDistanceFieldHeader
+{
+	uint64_t magic;
+	uint64_t key;
+	int32_t version;
+	int32_t samples[3];
+	CPUVector3 origin;
+	float spacing;
+	float band;
+};
+
+// Squared distance from a point to a triangle (Ericson, Real-Time Collision Detection 5.1.5)
+static float triangleDistanceSquared(const CPUVector3& p, const CPUVector3& a, const CPUVector3& b, const CPUVector3& c)
+{
+	float abx = b.x - a.x, aby = b.y - a.y, abz = b.z - a.z;
+	float acx = c.x - a.x, acy = c.y - a.y, acz = c.z - a.z;
+	float apx = p.x - a.x, apy = p.y - a.y, apz = p.z - a.z;
+
+	float d1 = abx * apx + aby * apy + abz * apz;
+	float d2 = acx * apx + acy * apy + acz * apz;
+
+	// Closest point as a + v ab + w ac
+	float v, w;
+
+	if(d1 <= 0.0f && d2 <= 0.0f)
+	{
+		v = 0.0f; w = 0.0f;
+	}
+	else
+	{
+		float bpx = p.x - b.x, bpy = p.y - b.y, bpz = p.z - b.z;
+		float d3 = abx * bpx + aby * bpy + abz * bpz;
+		float d4 = acx * bpx + acy * bpy + acz * bpz;
+
+		float cpx = p.x - c.x, cpy = p.y - c.y, cpz = p.z - c.z;
+		float d5 = abx * cpx + aby * cpy + abz * cpz;
+		float d6 = acx * cpx + acy * cpy + acz * cpz;
+
+		float vc = d1 * d4 - d3 * d2;
+		float vb = d5 * d2 - d1 * d6;
+		float va = d3 * d6 - d5 * d4;
+
+		if(d3 >= 0.0f && d4 <= d3)
+		{
+			v = 1.0f; w = 0.0f;
+		}
+		else if(d6 >= 0.0f && d5 <= d6)
+		{
+			v = 0.0f; w = 1.0f;
+		}
+		else if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		{
+			v = d1 / (d1 - d3); w = 0.0f;
+		}
+		else if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		{
+			v = 0.0f; w = d2 / (d2 - d6);
+		}
+		else if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		{
+			w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			v = 1.0f - w;
+		}
+		else
+		{
+			float denominator = 1.0f / (va + vb + vc);
+			v = vb * denominator;
+			w = vc * denominator;
+		}
+	}
+
+	float dx = a.x + abx * v + acx * w - p.x;
+	float dy = a.y + aby * v + acy * w - p.y;
+	float dz = a.z + abz * v + acz * w - p.z;
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Constructor
+CPUDistanceField::CPUDistanceField()
+{
+	samples[0] = samples[1] = samples[2] = 0;
+	origin.x = origin.y = origin.z = 0.0f;
+	spacing = 0.0f;
+	band = 0.0f;
+	key = 0;
+	loaded = false;
+	bakeTime = 0.0;
+}
+
+// Bake
+bool CPUDistanceField::bake(const CPUTriangleMesh& mesh, int resolution, int bandCells, CPUThreadPool* threadPool)
+{
+	typedef chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	distances.clear();
+	loaded = false;
+
+	if(!mesh.getTriangleCount())
+		return false;
+
+	resolution = max(resolution, 2);
+	bandCells = max(bandCells, 1);
+
+	// The grid covers the bounds plus the band and a cell either side
+	CPUVector3 boundsMin, boundsMax;
+	meshBounds(mesh, boundsMin, boundsMax);
+
+	const float* low = &boundsMin.x;
+	const float* high = &boundsMax.x;
+	float longest = max(max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+	int padding = bandCells + 1;
+
+	spacing = longest > 0.0f ? longest / (float)(resolution - 1) : 1.0f;
+	band = bandCells * spacing;
+
+	float* corner = &origin.x;
+
+	for(int a = 0; a < 3; ++a)
+	{
+		samples[a] = (int)ceilf((high[a] - low[a]) / spacing) + 1 + 2 * padding;
+		corner[a] = low[a] - padding * spacing;
+	}
+
+	distances.assign((size_t)samples[0] * samples[1] * samples[2], band);
+
+	bakeDistances(mesh, threadPool);
+	bakeSigns(mesh, threadPool);
+
+	uint64_t seed = hashMesh(mesh);
+	int32_t settings[3] = { FIELD_VERSION, resolution, bandCells };
+	key = hashXX64(settings, sizeof(settings), seed);
+
+	bakeTime = chrono::duration<double>(Clock::now() - start).count();
+
+	return true;
+}
+
+// Bake Distances
+void CPUDistanceField::bakeDistances(const CPUTriangleMesh& mesh, CPUThreadPool* threadPool)
+{
+	int triangleCount = mesh.getTriangleCount();
+	const CPUVector3* vertices = &mesh.vertices[0];
+	const unsigned int* indices = &mesh.indices[0];
+
+	// Sample ranges each triangle's band reaches, and the triangles of every z slice
+	vector<int> ranges(triangleCount * 6);
+	vector<vector<int> > slices(samples[2]);
+	const float* corner = &origin.x;
+
+	for(int t = 0; t < triangleCount; ++t)
+	{
+		const CPUVector3& a = vertices[indices[t * 3]];
+		const CPUVector3& b = vertices[indices[t * 3 + 1]];
+		const CPUVector3& c = vertices[indices[t * 3 + 2]];
+		float low[3] = { min(min(a.x, b.x), c.x), min(min(a.y, b.y), c.y), min(min(a.z, b.z), c.z) };
+		float high[3] = { max(max(a.x, b.x), c.x), max(max(a.y, b.y), c.y), max(max(a.z, b.z), c.z) };
+
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			ranges[t * 6 + axis * 2] = max((int)floorf((low[axis] - band - corner[axis]) / spacing), 0);
+			ranges[t * 6 + axis * 2 + 1] = min((int)ceilf((high[axis] + band - corner[axis]) / spacing), samples[axis] - 1);
+		}
+
+		for(int k = ranges[t * 6 + 4]; k <= ranges[t * 6 + 5]; ++k)
+			slices[k].push_back(t);
+	}
+
+	// Each slice only writes its own samples, and keeps the nearest triangle whatever order
+	// they come in
+	CPUThreadPool::Task task = [&](int first, int last)
+	{
+		for(int k = first; k < last; ++k)
+		{
+			float* slice = &distances[(size_t)k * samples[0] * samples[1]];
+			CPUVector3 point;
+			point.z = origin.z + k * spacing;
+
+			for(size_t s = 0; s < slices[k].size(); ++s)
+			{
+				int t = slices[k][s];
+				const CPUVector3& a = vertices[indices[t * 3]];
+				const CPUVector3& b = vertices[indices[t * 3 + 1]];
+				const CPUVector3& c = vertices[indices[t * 3 + 2]];
+
+				for(int j = ranges[t * 6 + 2]; j <= ranges[t * 6 + 3]; ++j)
+				{
+					point.y = origin.y + j * spacing;
+
+					for(int i = ranges[t * 6]; i <= ranges[t * 6 + 1]; ++i)
+					{
+						point.x = origin.x + i * spacing;
+
+						float& sampleDistance = slice[j * samples[0] + i];
+						float distanceSquared = triangleDistanceSquared(point, a, b, c);
+
+						if(distanceSquared < sampleDistance * sampleDistance)
+							sampleDistance = sqrtf(distanceSquared);
+					}
+				}
+			}
+		}
+	};
+
+	if(threadPool)
+		threadPool->parallelFor(samples[2], 1, task);
+	else
+		task(0, samples[2]);
+}
+
+// Bake Signs
+void CPUDistanceField::bakeSigns(const CPUTriangleMesh& mesh, CPUThreadPool* threadPool)
+{
+	int triangleCount = mesh.getTriangleCount();
+	const CPUVector3* vertices = &mesh.vertices[0];
+	const unsigned int* indices = &mesh.indices[0];
+
+	// Triangles whose (y, z) bounds reach each grid row
+	int rowCount = samples[1] * samples[2];
+	vector<vector<int> > rows(rowCount);
+
+	for(int t = 0; t < triangleCount; ++t)
+	{
+		const CPUVector3& a = vertices[indices[t * 3]];
+		const CPUVector3& b = vertices[indices[t * 3 + 1]];
+		const CPUVector3& c = vertices[indices[t * 3 + 2]];
+
+		int j0 = max((int)floorf((min(min(a.y, b.y), c.y) - origin.y) / spacing), 0);
+		int j1 = min((int)ceilf((max(max(a.y, b.y), c.y) - origin.y) / spacing), samples[1] - 1);
+		int k0 = max((int)floorf((min(min(a.z, b.z), c.z) - origin.z) / spacing), 0);
+		int k1 = min((int)ceilf((max(max(a.z, b.z), c.z) - origin.z) / spacing), samples[2] - 1);
+
+		for(int k = k0; k <= k1; ++k)
+		{
+			for(int j = j0; j <= j1; ++j)
+				rows[k * samples[1] + j].push_back(t);
+		}
+	}
+
+	// A sample is inside when an odd number of surface crossings lie before it along +x
+	CPUThreadPool::Task task = [&](int first, int last)
+	{
+		vector<float> crossings;
+
+		for(int row = first; row < last; ++row)
+		{
+			double y = origin.y + (row % samples[1] + RAY_OFFSET_Y) * spacing;
+			double z = origin.z + (row / samples[1] + RAY_OFFSET_Z) * spacing;
+
+			crossings.clear();
+
+			for(size_t r = 0; r < rows[row].size(); ++r)
+			{
+				int t = rows[row][r];
+				const CPUVector3& a = vertices[indices[t * 3]];
+				const CPUVector3& b = vertices[indices[t * 3 + 1]];
+				const CPUVector3& c = vertices[indices[t * 3 + 2]];
+
+				// Barycentric weights of the ray in the (y, z) projection
+				double wa = (b.y - y) * (c.z - z) - (b.z - z) * (c.y - y);
+				double wb = (c.y - y) * (a.z - z) - (c.z - z) * (a.y - y);
+				double wc = (a.y - y) * (b.z - z) - (a.z - z) * (b.y - y);
+				double area = wa + wb + wc;
+
+				if(area == 0.0 || (wa < 0.0) != (area < 0.0) || (wb < 0.0) != (area < 0.0) || (wc < 0.0) != (area < 0.0))
+					continue;
+
+				crossings.push_back((float)((wa * a.x + wb * b.x + wc * c.x) / area));
+			}
+
+			sort(crossings.begin(), crossings.end());
+
+			float* line = &distances[(size_t)row * samples[0]];
+			size_t passed = 0;
+
+			for(int i = 0; i < samples[0]; ++i)
+			{
+				float x = origin.x + i * spacing;
+
+				while(passed < crossings.size() && crossings[passed] < x)
+					++passed;
+
+				if(passed & 1)
+					line[i] = -line[i];
+			}
+		}
+	};
+
+	if(threadPool)
+		threadPool->parallelFor(rowCount, 16, task);
+	else
+		task(0, rowCount);
+}
+
+// Bake Cached
+bool CPUDistanceField::bakeCached(const CPUTriangleMesh& mesh, int resolution, int bandCells, const string& directory,
+	CPUThreadPool* threadPool)
+{
+	typedef chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	resolution = max(resolution, 2);
+	bandCells = max(bandCells, 1);
+
+	int32_t settings[3] = { FIELD_VERSION, resolution, bandCells };
+	uint64_t expectedKey = hashXX64(settings, sizeof(settings), hashMesh(mesh));
+	string path;
+
+	if(!directory.empty() && mesh.getTriangleCount())
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "/sdf_%d_%016llx.sdf", resolution, (unsigned long long)expectedKey);
+		path = directory + name;
+
+		if(load(path.c_str(), expectedKey))
+		{
+			loaded = true;
+			bakeTime = chrono::duration<double>(Clock::now() - start).count();
+			return true;
+		}
+	}
+
+	if(!bake(mesh, resolution, bandCells, threadPool))
+		return false;
+
+	if(!path.empty() && !save(path.c_str()))
+		cout << "Distance field could not be cached to '" << path << "'" << endl;
+
+	return true;
+}
+
+// Save
+bool CPUDistanceField::save(const char* path) const
+{
+	FILE* file = fopen(path, "wb");
+
+	if(!file)
+		return false;
+
+	CPUDistanceFieldHeader header;
+	header.magic = FIELD_MAGIC;
+	header.key = key;
+	header.version = FIELD_VERSION;
+	header.samples[0] = samples[0];
+	header.samples[1] = samples[1];
+	header.samples[2] = samples[2];
+	header.origin = origin;
+	header.spacing = spacing;
+	header.band = band;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(&distances[0], sizeof(float), distances.size(), file) == distances.size();
+
+	written = (fclose(file) == 0) && written;
+
+	// Never leave a partial file behind for the next run to trip over
+	if(!written)
+		remove(path);
+
+	return written;
+}
+
+// Load
+bool CPUDistanceField::load(const char* path, uint64_t expectedKey)
+{
+	distances.clear();
+
+	FILE* file = fopen(path, "rb");
+
+	if(!file)
+		return false;
+
+	CPUDistanceFieldHeader header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == FIELD_MAGIC
+		&& header.key == expectedKey && header.version == FIELD_VERSION
+		&& header.samples[0] >= 2 && header.samples[1] >= 2 && header.samples[2] >= 2 && header.spacing > 0.0f;
+
+	if(valid)
+	{
+		distances.resize((size_t)header.samples[0] * header.samples[1] * header.samples[2]);
+		valid = fread(&distances[0], sizeof(float), distances.size(), file) == distances.size();
+	}
+
+	fclose(file);
+
+	if(!valid)
+	{
+		distances.clear();
+		return false;
+	}
+
+	samples[0] = header.samples[0];
+	samples[1] = header.samples[1];
+	samples[2] = header.samples[2];
+	origin = header.origin;
+	spacing = header.spacing;
+	band = header.band;
+	key = header.key;
+
+	return true;
+}
+
+// Sample
+bool CPUDistanceField::sample(const CPUVector3& point, float& distance, CPUVector3& gradient) const
+{
+	if(distances.empty())
+		return false;
+
+	float gx = (point.x - origin.x) / spacing;
+	float gy = (point.y - origin.y) / spacing;
+	float gz = (point.z - origin.z) / spacing;
+
+	if(!(gx >= 0.0f && gy >= 0.0f && gz >= 0.0f && gx <= samples[0] - 1 && gy <= samples[1] - 1 && gz <= samples[2] - 1))
+		return false;
+
+	int i = min((int)gx, samples[0] - 2);
+	int j = min((int)gy, samples[1] - 2);
+	int k = min((int)gz, samples[2] - 2);
+	float fx = gx - i, fy = gy - j, fz = gz - k;
+
+	// Corners of the cell
+	size_t rowStep = samples[0];
+	size_t sliceStep = rowStep * samples[1];
+	const float* d = &distances[k * sliceStep + j * rowStep + i];
+
+	float d000 = d[0], d100 = d[1];
+	float d010 = d[rowStep], d110 = d[rowStep + 1];
+	float d001 = d[sliceStep], d101 = d[sliceStep + 1];
+	float d011 = d[sliceStep + rowStep], d111 = d[sliceStep + rowStep + 1];
+
+	float c00 = d000 + (d100 - d000) * fx;
+	float c10 = d010 + (d110 - d010) * fx;
+	float c01 = d001 + (d101 - d001) * fx;
+	float c11 = d011 + (d111 - d011) * fx;
+	float c0 = c00 + (c10 - c00) * fy;
+	float c1 = c01 + (c11 - c01) * fy;
+
+	distance = c0 + (c1 - c0) * fz;
+
+	// Derivatives of the same interpolation
+	float dx0 = (d100 - d000) + ((d110 - d010) - (d100 - d000)) * fy;
+	float dx1 = (d101 - d001) + ((d111 - d011) - (d101 - d001)) * fy;
+
+	gradient.x = (dx0 + (dx1 - dx0) * fz) / spacing;
+	gradient.y = ((c10 - c00) + ((c11 - c01) - (c10 - c00)) * fz) / spacing;
+	gradient.z = (c1 - c0) / spacing;
+
+	return true;
+}
+
+// Get Bounds
+void CPUDistanceField::getBounds(CPUVector3& boundsMin, CPUVector3& boundsMax) const
+{
+	boundsMin = origin;
+	boundsMax.x = origin.x + (samples[0] - 1) * spacing;
+	boundsMax.y = origin.y + (samples[1] - 1) * spacing;
+	boundsMax.z = origin.z + (samples[2] - 1) * spacing;
+}
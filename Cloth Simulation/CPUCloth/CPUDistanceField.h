@@ -0,0 +1,84 @@
+// ------------------------------------------------
+// Class:	CPU Distance Field Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUDISTANCEFIELD
+#define CPUDISTANCEFIELD
+
+// INCLUDES
+#include "CPUMesh.h"
+#include "CPUThreadPool.h"
+
+// Standard includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Signed distance to a closed triangle mesh on a regular grid, negative inside. Baking
+// computes the exact distance to the nearest triangle for the samples within the narrow band
+// around the surface (band cells), the samples further out hold +-band cells, and the sign
+// of every sample comes from the parity of the surface crossings along its grid row. Sampling
+// is trilinear, with the gradient of the same interpolation, so a lookup costs the same for
+// any triangle count.
+class CPUDistanceField
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable
+	CPUDistanceField(const CPUDistanceField&);
+	CPUDistanceField& operator=(const CPUDistanceField&);
+
+	// Grid: samples x samples y samples z, x fastest, sample (i, j, k) at origin + (i, j, k) * spacing
+	int samples[3];
+	CPUVector3 origin;
+	float spacing;
+	float band;					// Narrow band half width (world units), the clamp of the far samples
+	std::vector<float> distances;
+
+	// Cache key of the last bake (mesh hash, resolution and band)
+	uint64_t key;
+	bool loaded;				// Last bakeCached read the cache
+	double bakeTime;			// Seconds spent in the last bake or load
+
+	// Bake passes: unsigned distances in the band (one z slice of the grid per task), then the
+	// signs (one grid row per task)
+	void bakeDistances(const CPUTriangleMesh& mesh, CPUThreadPool* threadPool);
+	void bakeSigns(const CPUTriangleMesh& mesh, CPUThreadPool* threadPool);
+
+	// Cache file of a key in a directory
+	bool save(const char* path) const;
+	bool load(const char* path, uint64_t expectedKey);
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor
+	CPUDistanceField();
+
+	// Bake a mesh with resolution samples along the longest side of its bounds (plus the band
+	// on every side), bandCells cells of exact distance either side of the surface. The thread
+	// pool is optional, the field is the same either way. Returns false for an empty mesh.
+	bool bake(const CPUTriangleMesh& mesh, int resolution, int bandCells = 4, CPUThreadPool* threadPool = nullptr);
+
+	// Bake through a cache directory: a field baked before from the same mesh, resolution and
+	// band is read back instead ("" = no cache)
+	bool bakeCached(const CPUTriangleMesh& mesh, int resolution, int bandCells, const std::string& directory,
+		CPUThreadPool* threadPool = nullptr);
+
+	// Distance and gradient (not normalised) at a point, false outside the grid
+	bool sample(const CPUVector3& point, float& distance, CPUVector3& gradient) const;
+
+	// Accessors
+	bool isBaked() const { return !distances.empty(); }
+	const int* getSamples() const { return samples; }
+	float getSpacing() const { return spacing; }
+	float getBand() const { return band; }
+	uint64_t getKey() const { return key; }
+	bool isLoaded() const { return loaded; }
+	double getBakeTime() const { return bakeTime; }
+	void getBounds(CPUVector3& boundsMin, CPUVector3& boundsMax) const;
+};
+
+#endif
@@ -0,0 +1,134 @@
+// ------------------------------------------------
+// Source:	CPU Feature Detection
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUFeatures.h"
+
+// Standard includes
+#include <cstring>
+
+#ifdef CPU_CLOTH_X86_KERNELS
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#include <immintrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+#ifdef CPU_CLOTH_X86_KERNELS
+// CPUID leaf / subleaf query, registers returned as {eax, ebx, ecx, edx}
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+{
+#ifdef _MSC_VER
+	int values[4];
+	__cpuidex(values, (int)leaf, (int)subleaf);
+
+	for(int i = 0; i < 4; ++i)
+		registers[i] = (unsigned int)values[i];
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// Extended control register 0 (which register states the OS saves)
+static unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+// Detect Instruction Set
+CPUInstructionSet detectInstructionSet()
+{
+#ifdef CPU_CLOTH_X86_KERNELS
+	unsigned int registers[4];
+
+	cpuid(0, 0, registers);
+	unsigned int maxLeaf = registers[0];
+
+	if(maxLeaf < 1)
+		return CPU_ISA_SCALAR;
+
+	cpuid(1, 0, registers);
+
+	bool sse42 = (registers[2] & (1u << 20)) != 0;
+	bool osxsave = (registers[2] & (1u << 27)) != 0;
+	bool avx = (registers[2] & (1u << 28)) != 0;
+
+	if(!sse42)
+		return CPU_ISA_SCALAR;
+
+	// AVX state must be enabled by the OS before any wider kernel can run
+	if(!osxsave || !avx || maxLeaf < 7)
+		return CPU_ISA_SSE42;
+
+	unsigned long long xcr0 = xgetbv0();
+	bool ymmState = (xcr0 & 0x6) == 0x6;
+	bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+	cpuid(7, 0, registers);
+
+	bool avx2 = (registers[1] & (1u << 5)) != 0;
+	bool avx512f = (registers[1] & (1u << 16)) != 0;
+
+	if(avx512f && zmmState)
+		return CPU_ISA_AVX512;
+
+	if(avx2 && ymmState)
+		return CPU_ISA_AVX2;
+
+	return CPU_ISA_SSE42;
+#else
+	return CPU_ISA_SCALAR;
+#endif
+}
+
+// Instruction Set Width
+int instructionSetWidth(CPUInstructionSet isa)
+{
+	switch(isa)
+	{
+	case CPU_ISA_SSE42:
+		return 4;
+	case CPU_ISA_AVX2:
+		return 8;
+	case CPU_ISA_AVX512:
+		return 16;
+	default:
+		return 1;
+	}
+}
+
+// Instruction Set Names
+static const char* isaNames[CPU_ISA_COUNT] = { "scalar", "sse42", "avx2", "avx512" };
+
+const char* instructionSetName(CPUInstructionSet isa)
+{
+	if(isa < CPU_ISA_SCALAR || isa >= CPU_ISA_COUNT)
+		return "unknown";
+
+	return isaNames[isa];
+}
+
+bool parseInstructionSet(const char* name, CPUInstructionSet& isa)
+{
+	for(int i = 0; i < CPU_ISA_COUNT; ++i)
+	{
+		if(!strcmp(name, isaNames[i]))
+		{
+			isa = (CPUInstructionSet)i;
+			return true;
+		}
+	}
+
+	return false;
+}
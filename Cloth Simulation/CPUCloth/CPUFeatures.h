@@ -0,0 +1,31 @@
+// ------------------------------------------------
+// Header:	CPU Feature Detection
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUFEATURES
+#define CPUFEATURES
+
+// Instruction sets the constraint kernels are built for (ordered by width)
+enum CPUInstructionSet
+{
+	CPU_ISA_SCALAR = 0,
+	CPU_ISA_SSE42,
+	CPU_ISA_AVX2,
+	CPU_ISA_AVX512,
+	CPU_ISA_COUNT
+};
+
+// Widest instruction set supported by both this build and the processor (CPUID + OS state)
+CPUInstructionSet detectInstructionSet();
+
+// Lanes processed per instruction for an instruction set (1, 4, 8 or 16)
+int instructionSetWidth(CPUInstructionSet isa);
+
+// Short lower case name ("scalar", "sse42", "avx2", "avx512")
+const char* instructionSetName(CPUInstructionSet isa);
+
+// Parse a name produced by instructionSetName, returns false if unknown
+bool parseInstructionSet(const char* name, CPUInstructionSet& isa);
+
+#endif
@@ -0,0 +1,119 @@
+// ------------------------------------------------
+// Source:	CPU State Hashing (XXH64)
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUHash.h"
+
+// Standard includes
+#include <cstring>
+
+// XXH64 primes
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// Unaligned little endian reads
+static inline uint64_t read64(const unsigned char* p)
+{
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint32_t read32(const unsigned char* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint64_t round64(uint64_t accumulator, uint64_t lane)
+{
+	accumulator += lane * PRIME2;
+	accumulator = rotateLeft(accumulator, 31);
+	return accumulator * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t accumulator, uint64_t value)
+{
+	accumulator ^= round64(0, value);
+	return accumulator * PRIME1 + PRIME4;
+}
+
+// Hash XX64
+uint64_t hashXX64(const void* input, size_t length, uint64_t seed)
+{
+	const unsigned char* p = (const unsigned char*)input;
+	const unsigned char* end = p + length;
+	uint64_t hash;
+
+	if(length >= 32)
+	{
+		// Four independent lanes over 32 byte stripes
+		const unsigned char* limit = end - 32;
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+
+		do
+		{
+			v1 = round64(v1, read64(p));
+			v2 = round64(v2, read64(p + 8));
+			v3 = round64(v3, read64(p + 16));
+			v4 = round64(v4, read64(p + 24));
+			p += 32;
+		}
+		while(p <= limit);
+
+		hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+		hash = mergeRound(hash, v1);
+		hash = mergeRound(hash, v2);
+		hash = mergeRound(hash, v3);
+		hash = mergeRound(hash, v4);
+	}
+	else
+	{
+		hash = seed + PRIME5;
+	}
+
+	hash += (uint64_t)length;
+
+	// Tail
+	for(; p + 8 <= end; p += 8)
+	{
+		hash ^= round64(0, read64(p));
+		hash = rotateLeft(hash, 27) * PRIME1 + PRIME4;
+	}
+
+	if(p + 4 <= end)
+	{
+		hash ^= (uint64_t)read32(p) * PRIME1;
+		hash = rotateLeft(hash, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+
+	for(; p < end; ++p)
+	{
+		hash ^= (*p) * PRIME5;
+		hash = rotateLeft(hash, 11) * PRIME1;
+	}
+
+	// Avalanche
+	hash ^= hash >> 33;
+	hash *= PRIME2;
+	hash ^= hash >> 29;
+	hash *= PRIME3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
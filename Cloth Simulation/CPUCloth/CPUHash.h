@@ -0,0 +1,17 @@
+// ------------------------------------------------
+// Header:	CPU State Hashing
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUHASH
+#define CPUHASH
+
+// INCLUDES
+#include <cstddef>
+#include <cstdint>
+
+// 64 bit xxHash (XXH64) of length bytes, matches the reference implementation on
+// little endian machines
+uint64_t hashXX64(const void* input, size_t length, uint64_t seed = 0);
+
+#endif
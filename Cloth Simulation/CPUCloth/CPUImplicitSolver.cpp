@@ -0,0 +1,474 @@
+// ------------------------------------------------
+// Class:	CPU Implicit Solver Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUImplicitSolver.h"
+
+// Standard includes
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// Namespaces
+using namespace std;
+
+// Smallest share of work handed to a thread
+#define ROW_GRAIN 1024
+#define CONSTRAINT_GRAIN 256
+
+// 3 x 3 helpers (row major)
+static void addOuter(float* block, const float* u, float scale)
+{
+	for(int r = 0; r < 3; ++r)
+	{
+		for(int c = 0; c < 3; ++c)
+			block[r * 3 + c] += u[r] * u[c] * scale;
+	}
+}
+
+static void multiplyBlock(const float* block, const float* vector, float* result)
+{
+	result[0] = block[0] * vector[0] + block[1] * vector[1] + block[2] * vector[2];
+	result[1] = block[3] * vector[0] + block[4] * vector[1] + block[5] * vector[2];
+	result[2] = block[6] * vector[0] + block[7] * vector[1] + block[8] * vector[2];
+}
+
+// Constructor
+CPUImplicitSolver::CPUImplicitSolver()
+{
+	// Stiff cotton like cloth
+	settings.stiffness[0] = 5000.0f;
+	settings.stiffness[1] = 500.0f;
+	settings.damping = 2.0f;
+	settings.mass = 1.0f;
+	settings.tolerance = 1e-3f;
+	settings.maxIterations = 100;
+
+	matrix.rows = 0;
+	lastIterations = 0;
+	lastResidual = 0.0f;
+
+	for(int b = 0; b < 8; ++b)
+		batchStart[b] = 0;
+}
+
+// Build
+bool CPUImplicitSolver::build(unsigned int particleCount, const CPUConstraintBatch* batches)
+{
+	matrix.rows = particleCount;
+
+	// Neighbours of every particle, the diagonal included
+	vector<unsigned int> degree(particleCount, 1);
+	int constraintCount = 0;
+
+	for(int b = 0; b < 8; ++b)
+	{
+		batchStart[b] = constraintCount;
+		constraintCount += batches[b].count;
+
+		for(int c = 0; c < batches[b].count; ++c)
+		{
+			if(batches[b].start[c] >= particleCount || batches[b].end[c] >= particleCount)
+			{
+				matrix.rows = 0;
+				return false;
+			}
+
+			++degree[batches[b].start[c]];
+			++degree[batches[b].end[c]];
+		}
+	}
+
+	matrix.rowStart.assign(particleCount + 1, 0);
+
+	for(unsigned int i = 0; i < particleCount; ++i)
+		matrix.rowStart[i + 1] = matrix.rowStart[i] + degree[i];
+
+	// Fill the columns, then sort each row
+	vector<unsigned int> fill(matrix.rowStart.begin(), matrix.rowStart.end() - 1);
+	matrix.column.resize(matrix.rowStart[particleCount]);
+
+	for(unsigned int i = 0; i < particleCount; ++i)
+		matrix.column[fill[i]++] = i;
+
+	for(int b = 0; b < 8; ++b)
+	{
+		for(int c = 0; c < batches[b].count; ++c)
+		{
+			unsigned int a = batches[b].start[c];
+			unsigned int e = batches[b].end[c];
+
+			matrix.column[fill[a]++] = e;
+			matrix.column[fill[e]++] = a;
+		}
+	}
+
+	matrix.diagonal.resize(particleCount);
+
+	for(unsigned int i = 0; i < particleCount; ++i)
+	{
+		sort(matrix.column.begin() + matrix.rowStart[i], matrix.column.begin() + matrix.rowStart[i + 1]);
+		matrix.diagonal[i] = (unsigned int)(lower_bound(matrix.column.begin() + matrix.rowStart[i],
+			matrix.column.begin() + matrix.rowStart[i + 1], i) - matrix.column.begin());
+	}
+
+	// Where each constraint's off diagonal blocks live, so assembly never searches
+	blockStartEnd.resize(constraintCount);
+	blockEndStart.resize(constraintCount);
+
+	for(int b = 0; b < 8; ++b)
+	{
+		for(int c = 0; c < batches[b].count; ++c)
+		{
+			unsigned int a = batches[b].start[c];
+			unsigned int e = batches[b].end[c];
+
+			blockStartEnd[batchStart[b] + c] = (unsigned int)(lower_bound(matrix.column.begin() + matrix.rowStart[a],
+				matrix.column.begin() + matrix.rowStart[a + 1], e) - matrix.column.begin());
+			blockEndStart[batchStart[b] + c] = (unsigned int)(lower_bound(matrix.column.begin() + matrix.rowStart[e],
+				matrix.column.begin() + matrix.rowStart[e + 1], a) - matrix.column.begin());
+		}
+	}
+
+	matrix.value.assign(matrix.column.size() * 9, 0.0f);
+
+	// Vectors
+	size_t length = (size_t)particleCount * 3;
+
+	velocity.assign(length, 0.0f);
+	rhs.assign(length, 0.0f);
+	deltaV.assign(length, 0.0f);
+	residual.assign(length, 0.0f);
+	preconditioned.assign(length, 0.0f);
+	search.assign(length, 0.0f);
+	product.assign(length, 0.0f);
+	inverseDiagonal.assign((size_t)particleCount * 9, 0.0f);
+	movable.assign(particleCount, 1.0f);
+
+	return true;
+}
+
+// Step
+int CPUImplicitSolver::step(CPUParticles& particles, const CPUConstraintBatch* batches, const CPUVector3& acceleration,
+	float timeStep, CPUThreadPool* threadPool)
+{
+	if(!matrix.rows || matrix.rows != particles.count || timeStep <= 0.0f)
+		return 0;
+
+	// Velocities implied by the Verlet state
+	float inverseStep = 1.0f / timeStep;
+
+	threadPool->parallelFor(matrix.rows, ROW_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			movable[i] = particles.invMass[i] > 0.0f ? 1.0f : 0.0f;
+
+			velocity[i * 3] = (particles.x[i] - particles.oldX[i]) * inverseStep * movable[i];
+			velocity[i * 3 + 1] = (particles.y[i] - particles.oldY[i]) * inverseStep * movable[i];
+			velocity[i * 3 + 2] = (particles.z[i] - particles.oldZ[i]) * inverseStep * movable[i];
+		}
+	});
+
+	assemble(particles, batches, acceleration, timeStep, threadPool);
+	invertDiagonal(threadPool);
+
+	lastIterations = solve(threadPool);
+
+	// New velocity, then positions (the previous positions become the Verlet old state)
+	float keep = (float)verletKeep(timeStep);
+
+	threadPool->parallelFor(matrix.rows, ROW_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			float vx = (velocity[i * 3] + deltaV[i * 3]) * keep * movable[i];
+			float vy = (velocity[i * 3 + 1] + deltaV[i * 3 + 1]) * keep * movable[i];
+			float vz = (velocity[i * 3 + 2] + deltaV[i * 3 + 2]) * keep * movable[i];
+
+			particles.oldX[i] = particles.x[i];
+			particles.oldY[i] = particles.y[i];
+			particles.oldZ[i] = particles.z[i];
+
+			particles.x[i] += vx * timeStep;
+			particles.y[i] += vy * timeStep;
+			particles.z[i] += vz * timeStep;
+		}
+	});
+
+	return lastIterations;
+}
+
+// Assemble (matrix values and right hand side, the pattern is fixed)
+void CPUImplicitSolver::assemble(const CPUParticles& particles, const CPUConstraintBatch* batches, const CPUVector3& acceleration,
+	float timeStep, CPUThreadPool* threadPool)
+{
+	float particleMass = settings.mass / (float)matrix.rows;
+
+	// Mass on the diagonal, external force on the right hand side, off diagonal blocks cleared
+	threadPool->parallelFor(matrix.rows, ROW_GRAIN, [&](int first, int last)
+	{
+		memset(&matrix.value[matrix.rowStart[first] * 9], 0, (matrix.rowStart[last] - matrix.rowStart[first]) * 9 * sizeof(float));
+
+		for(int i = first; i < last; ++i)
+		{
+			// Pinned rows keep a unit diagonal so the preconditioner stays finite
+			float mass = movable[i] > 0.0f ? particleMass / particles.invMass[i] : 1.0f;
+			float* block = &matrix.value[matrix.diagonal[i] * 9];
+
+			block[0] = block[4] = block[8] = mass;
+
+			rhs[i * 3] = timeStep * mass * acceleration.x;
+			rhs[i * 3 + 1] = timeStep * mass * acceleration.y;
+			rhs[i * 3 + 2] = timeStep * mass * acceleration.z;
+		}
+	});
+
+	// Springs, a colour at a time so no two threads touch the same diagonal block
+	for(int b = 0; b < 8; ++b)
+	{
+		// Batches 0 - 3 are horizontal / vertical, 4 - 7 diagonal
+		float stiffness = settings.stiffness[b < 4 ? 0 : 1];
+		const CPUConstraintBatch& batch = batches[b];
+
+		threadPool->parallelFor(batch.count, CONSTRAINT_GRAIN, [&](int first, int last)
+		{
+			for(int c = first; c < last; ++c)
+				assembleSpring(particles, batchStart[b] + c, batch.start[c], batch.end[c], batch.distance[c], stiffness, timeStep);
+		});
+	}
+}
+
+// Assemble Spring
+void CPUImplicitSolver::assembleSpring(const CPUParticles& particles, int constraint, unsigned int a, unsigned int b,
+	float restDistance, float stiffness, float timeStep)
+{
+	float d[3] = { particles.x[b] - particles.x[a], particles.y[b] - particles.y[a], particles.z[b] - particles.z[a] };
+	float length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+	if(length <= 0.0f)
+		return;
+
+	float u[3] = { d[0] / length, d[1] / length, d[2] / length };
+
+	// Force on a (b gets the opposite): elastic, and damping of the relative velocity along the spring
+	const float* va = &velocity[a * 3];
+	const float* vb = &velocity[b * 3];
+	float relative = (vb[0] - va[0]) * u[0] + (vb[1] - va[1]) * u[1] + (vb[2] - va[2]) * u[2];
+	float magnitude = stiffness * (length - restDistance) + settings.damping * relative;
+
+	// Stiffness K = k (u u^T + c (I - u u^T)), the transverse part c = 1 - rest / length is
+	// dropped when compressed so the matrix stays positive definite
+	float transverse = max(1.0f - restDistance / length, 0.0f);
+	float K[9] = { 0.0f };
+
+	K[0] = K[4] = K[8] = stiffness * transverse;
+	addOuter(K, u, stiffness * (1.0f - transverse));
+
+	// System block h^2 K + h D, with D = damping u u^T
+	float J[9];
+
+	for(int e = 0; e < 9; ++e)
+		J[e] = K[e] * timeStep * timeStep;
+
+	addOuter(J, u, settings.damping * timeStep);
+
+	float* blockA = &matrix.value[matrix.diagonal[a] * 9];
+	float* blockB = &matrix.value[matrix.diagonal[b] * 9];
+	float* blockAB = &matrix.value[blockStartEnd[constraint] * 9];
+	float* blockBA = &matrix.value[blockEndStart[constraint] * 9];
+
+	for(int e = 0; e < 9; ++e)
+	{
+		blockA[e] += J[e];
+		blockB[e] += J[e];
+		blockAB[e] = -J[e];
+		blockBA[e] = -J[e];
+	}
+
+	// Right hand side h (F + h dF/dx v), where dF_a/dx v = -K (v_a - v_b)
+	float vab[3] = { va[0] - vb[0], va[1] - vb[1], va[2] - vb[2] };
+	float Kv[3];
+
+	multiplyBlock(K, vab, Kv);
+
+	for(int r = 0; r < 3; ++r)
+	{
+		float term = timeStep * (magnitude * u[r] - timeStep * Kv[r]);
+
+		rhs[a * 3 + r] += term;
+		rhs[b * 3 + r] -= term;
+	}
+}
+
+// Invert Diagonal (block Jacobi preconditioner, zero for pinned rows)
+void CPUImplicitSolver::invertDiagonal(CPUThreadPool* threadPool)
+{
+	threadPool->parallelFor(matrix.rows, ROW_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			const float* m = &matrix.value[matrix.diagonal[i] * 9];
+			float* inverse = &inverseDiagonal[i * 9];
+
+			// Cofactors (the block is symmetric positive definite, so the determinant is positive)
+			double c00 = (double)m[4] * m[8] - (double)m[5] * m[7];
+			double c01 = (double)m[5] * m[6] - (double)m[3] * m[8];
+			double c02 = (double)m[3] * m[7] - (double)m[4] * m[6];
+			double c11 = (double)m[0] * m[8] - (double)m[2] * m[6];
+			double c12 = (double)m[2] * m[3] - (double)m[0] * m[5];
+			double c22 = (double)m[0] * m[4] - (double)m[1] * m[3];
+			double c10 = (double)m[2] * m[7] - (double)m[1] * m[8];
+			double c20 = (double)m[1] * m[5] - (double)m[2] * m[4];
+			double c21 = (double)m[1] * m[6] - (double)m[0] * m[7];
+
+			double determinant = m[0] * c00 + m[1] * c01 + m[2] * c02;
+			double scale = movable[i] / determinant;
+
+			inverse[0] = (float)(c00 * scale);
+			inverse[1] = (float)(c10 * scale);
+			inverse[2] = (float)(c20 * scale);
+			inverse[3] = (float)(c01 * scale);
+			inverse[4] = (float)(c11 * scale);
+			inverse[5] = (float)(c21 * scale);
+			inverse[6] = (float)(c02 * scale);
+			inverse[7] = (float)(c12 * scale);
+			inverse[8] = (float)(c22 * scale);
+		}
+	});
+}
+
+// Solve (filtered preconditioned conjugate gradients, deltaV holds the previous solution as the first guess)
+int CPUImplicitSolver::solve(CPUThreadPool* threadPool)
+{
+	size_t length = (size_t)matrix.rows * 3;
+
+	// Pinned rows take no part (a zero guess, residual and search direction)
+	for(size_t k = 0; k < length; ++k)
+	{
+		deltaV[k] *= movable[k / 3];
+		rhs[k] *= movable[k / 3];
+	}
+
+	multiply(&deltaV[0], &product[0], threadPool);
+
+	for(size_t k = 0; k < length; ++k)
+		residual[k] = rhs[k] - product[k];
+
+	precondition(&residual[0], &preconditioned[0], threadPool);
+	search = preconditioned;
+
+	double rhsNorm = sqrt(dot(&rhs[0], &rhs[0], threadPool));
+	double threshold = settings.tolerance * max(rhsNorm, 1e-30);
+	double rz = dot(&residual[0], &preconditioned[0], threadPool);
+	double residualNorm = sqrt(dot(&residual[0], &residual[0], threadPool));
+	int iteration = 0;
+
+	while(iteration < settings.maxIterations && residualNorm > threshold)
+	{
+		multiply(&search[0], &product[0], threadPool);
+
+		double curvature = dot(&search[0], &product[0], threadPool);
+
+		if(curvature <= 0.0)
+			break;
+
+		float alpha = (float)(rz / curvature);
+
+		threadPool->parallelFor((int)length, ROW_GRAIN * 3, [&](int first, int last)
+		{
+			for(int k = first; k < last; ++k)
+			{
+				deltaV[k] += alpha * search[k];
+				residual[k] -= alpha * product[k];
+			}
+		});
+
+		precondition(&residual[0], &preconditioned[0], threadPool);
+
+		double rzNext = dot(&residual[0], &preconditioned[0], threadPool);
+		float beta = (float)(rzNext / rz);
+
+		threadPool->parallelFor((int)length, ROW_GRAIN * 3, [&](int first, int last)
+		{
+			for(int k = first; k < last; ++k)
+				search[k] = preconditioned[k] + beta * search[k];
+		});
+
+		rz = rzNext;
+		residualNorm = sqrt(dot(&residual[0], &residual[0], threadPool));
+		++iteration;
+	}
+
+	lastResidual = (float)(residualNorm / max(rhsNorm, 1e-30));
+
+	return iteration;
+}
+
+// Multiply (filtered: pinned rows come out zero)
+void CPUImplicitSolver::multiply(const float* vector, float* result, CPUThreadPool* threadPool) const
+{
+	threadPool->parallelFor(matrix.rows, ROW_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+
+			for(unsigned int k = matrix.rowStart[i]; k < matrix.rowStart[i + 1]; ++k)
+			{
+				float term[3];
+				multiplyBlock(&matrix.value[k * 9], vector + matrix.column[k] * 3, term);
+
+				sum[0] += term[0];
+				sum[1] += term[1];
+				sum[2] += term[2];
+			}
+
+			result[i * 3] = sum[0] * movable[i];
+			result[i * 3 + 1] = sum[1] * movable[i];
+			result[i * 3 + 2] = sum[2] * movable[i];
+		}
+	});
+}
+
+// Precondition
+void CPUImplicitSolver::precondition(const float* vector, float* result, CPUThreadPool* threadPool) const
+{
+	threadPool->parallelFor(matrix.rows, ROW_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+			multiplyBlock(&inverseDiagonal[i * 9], vector + i * 3, result + i * 3);
+	});
+}
+
+// Dot
+double CPUImplicitSolver::dot(const float* a, const float* b, CPUThreadPool* threadPool)
+{
+	return blockSum((int)matrix.rows * 3, [&](int first, int last)
+	{
+		double sum = 0.0;
+
+		for(int k = first; k < last; ++k)
+			sum += (double)a[k] * b[k];
+
+		return sum;
+	}, partialSums, threadPool);
+}
+
+// Reset
+void CPUImplicitSolver::reset()
+{
+	fill(deltaV.begin(), deltaV.end(), 0.0f);
+}
+
+// Set Settings
+void CPUImplicitSolver::setSettings(const CPUImplicitSettings& newSettings)
+{
+	settings = newSettings;
+	settings.clamp();
+	settings.damping = max(settings.damping, 0.0f);
+	settings.tolerance = max(settings.tolerance, 0.0f);
+	settings.maxIterations = max(settings.maxIterations, 1);
+}
@@ -0,0 +1,113 @@
+// ------------------------------------------------
+// Class:	CPU Implicit Solver Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUIMPLICITSOLVER
+#define CPUIMPLICITSOLVER
+
+// INCLUDES
+#include "CPUParticles.h"
+#include "CPUConstraintKernel.h"
+#include "CPUThreadPool.h"
+#include "CPUSolverCommon.h"
+
+// Standard includes
+#include <vector>
+
+// Sparse symmetric matrix of 3 x 3 blocks in compressed row form, one block row per particle
+struct CPUBlockMatrix
+{
+	unsigned int rows;
+	std::vector<unsigned int> rowStart;	// rows + 1 offsets into column / value
+	std::vector<unsigned int> column;	// Block column, sorted within each row
+	std::vector<unsigned int> diagonal;	// Block index of each row's diagonal
+	std::vector<float> value;			// 9 floats per block (row major)
+};
+
+// Settings of the implicit integrator
+struct CPUImplicitSettings : CPUSpringSettings
+{
+	float damping;		// Damping along each spring (N s/m)
+	float tolerance;	// CG stops once |residual| <= tolerance * |right hand side|
+	int maxIterations;	// CG iteration cap per step
+};
+
+// Backward Euler integrator (Baraff & Witkin, Large Steps in Cloth Simulation).
+// Every constraint is treated as a spring, the linearised system
+//		(M - h dF/dv - h^2 dF/dx) dv = h (F + h dF/dx v)
+// is assembled into a block matrix whose sparsity pattern is built once from the constraint
+// list, and solved for the velocity change with conjugate gradients, preconditioned with the
+// inverse diagonal blocks and warm started from the previous step's solution. Pinned
+// particles are filtered out of the solve (their velocity stays zero).
+class CPUImplicitSolver
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable
+	CPUImplicitSolver(const CPUImplicitSolver&);
+	CPUImplicitSolver& operator=(const CPUImplicitSolver&);
+
+	// Attributes
+	CPUImplicitSettings settings;
+	CPUBlockMatrix matrix;
+
+	// Off diagonal blocks of every constraint (packed batch order): row start / column end and the transpose
+	std::vector<unsigned int> blockStartEnd, blockEndStart;
+	int batchStart[8];
+
+	// Per particle vectors (3 floats each), the inverse diagonal blocks and the pin filter
+	std::vector<float> velocity, rhs, deltaV, residual, preconditioned, search, product;
+	std::vector<float> inverseDiagonal;
+	std::vector<float> movable;
+
+	// Block sums of the dot products (blockSum scratch)
+	std::vector<double> partialSums;
+
+	// Statistics of the last step
+	int lastIterations;
+	float lastResidual;
+
+	// Methods
+	void assemble(const CPUParticles& particles, const CPUConstraintBatch* batches, const CPUVector3& acceleration,
+		float timeStep, CPUThreadPool* threadPool);
+	void assembleSpring(const CPUParticles& particles, int constraint, unsigned int a, unsigned int b, float restDistance,
+		float stiffness, float timeStep);
+	void invertDiagonal(CPUThreadPool* threadPool);
+	int solve(CPUThreadPool* threadPool);
+
+	// Vector kernels over all rows
+	void multiply(const float* vector, float* result, CPUThreadPool* threadPool) const;
+	void precondition(const float* vector, float* result, CPUThreadPool* threadPool) const;
+	double dot(const float* a, const float* b, CPUThreadPool* threadPool);
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor
+	CPUImplicitSolver();
+
+	// Build the matrix pattern (rows = particleCount) from the eight constraint batches,
+	// returns false when a constraint references a particle out of range
+	bool build(unsigned int particleCount, const CPUConstraintBatch* batches);
+
+	// One backward Euler step of timeStep seconds under a uniform acceleration,
+	// returns the CG iterations used
+	int step(CPUParticles& particles, const CPUConstraintBatch* batches, const CPUVector3& acceleration,
+		float timeStep, CPUThreadPool* threadPool);
+
+	// Forget the warm start (after the state was changed from outside)
+	void reset();
+
+	// Settings
+	const CPUImplicitSettings& getSettings() const { return settings; }
+	void setSettings(const CPUImplicitSettings& newSettings);
+
+	// Statistics
+	int getLastIterations() const { return lastIterations; }
+	float getLastResidual() const { return lastResidual; } // Relative to the right hand side
+	size_t getBlockCount() const { return matrix.column.size(); }
+};
+
+#endif
@@ -0,0 +1,48 @@
+// ------------------------------------------------
+// Header:	CPU Aligned Memory Helpers
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUMEMORY
+#define CPUMEMORY
+
+// INCLUDES
+#include <cstddef>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Alignment used for simulation arrays (one cache line, also covers AVX-512 loads)
+#define CPU_ALIGNMENT 64
+
+// Marks array pointers that do not overlap, so loops over several SoA arrays can be vectorised
+#define CPU_RESTRICT __restrict
+
+// Allocate size bytes aligned to CPU_ALIGNMENT, returns nullptr on failure
+inline void* alignedMalloc(size_t size)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, CPU_ALIGNMENT);
+#else
+	void* memory = nullptr;
+
+	if(posix_memalign(&memory, CPU_ALIGNMENT, size))
+		return nullptr;
+
+	return memory;
+#endif
+}
+
+// Free memory returned by alignedMalloc (nullptr is ignored)
+inline void alignedFree(void* memory)
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+#endif
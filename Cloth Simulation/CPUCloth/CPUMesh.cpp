@@ -0,0 +1,274 @@
+// ------------------------------------------------
+// Source:	CPU Triangle Mesh
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUMesh.h"
+#include "CPUHash.h"
+
+// Standard includes
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// GSF layout (little endian): a 16 byte signature, two version shorts and the file size, then
+// chunks of a type byte, a byte and a version short, and their size (header included). The
+// geometry chunk holds 10 bytes of model settings, the mesh count and the mesh records: the
+// record size, flags, the vertex, edge and face counts, the bytes per index and a byte, the
+// vertices (three floats each), the faces (three indices each), then data loadGSF skips.
+#define GSF_SIGNATURE "GASTINEAU_SC_01"
+#define GSF_HEADER_SIZE 24
+#define GSF_CHUNK_HEADER_SIZE 8
+#define GSF_GEOMETRY_CHUNK 2
+#define GSF_GEOMETRY_HEADER_SIZE 10
+#define GSF_RECORD_HEADER_SIZE 20
+
+// Namespaces
+using namespace std;
+
+// Little endian unsigned integer of 1, 2 or 4 bytes
+static unsigned int readUnsigned(const unsigned char* data, int bytes)
+{
+	unsigned int value = 0;
+
+	for(int b = bytes - 1; b >= 0; --b)
+		value = (value << 8) | data[b];
+
+	return value;
+}
+
+// Parse one face corner ("v", "v/vt", "v//vn" or "v/vt/vn"), OBJ indices count from 1 and
+// negative ones from the end of the vertex list
+static bool parseCorner(const char* token, int vertexCount, unsigned int& index)
+{
+	char* end = nullptr;
+	long value = strtol(token, &end, 10);
+
+	if(end == token || value == 0)
+		return false;
+
+	long resolved = value > 0 ? value - 1 : vertexCount + value;
+
+	if(resolved < 0 || resolved >= vertexCount)
+		return false;
+
+	index = (unsigned int)resolved;
+
+	return true;
+}
+
+// Load OBJ
+bool loadOBJ(const char* path, CPUTriangleMesh& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	FILE* file = fopen(path, "r");
+
+	if(!file)
+		return false;
+
+	char line[1024];
+	bool valid = true;
+	vector<unsigned int> polygon;
+
+	while(valid && fgets(line, sizeof(line), file))
+	{
+		if(line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+		{
+			CPUVector3 vertex;
+
+			valid = sscanf(line + 2, "%f %f %f", &vertex.x, &vertex.y, &vertex.z) == 3;
+			mesh.vertices.push_back(vertex);
+		}
+		else if(line[0] == 'f' && (line[1] == ' ' || line[1] == '\t'))
+		{
+			polygon.clear();
+
+			for(char* token = strtok(line + 2, " \t\r\n"); valid && token; token = strtok(nullptr, " \t\r\n"))
+			{
+				unsigned int index;
+
+				valid = parseCorner(token, (int)mesh.vertices.size(), index);
+				polygon.push_back(index);
+			}
+
+			// Fan around the first corner
+			for(size_t c = 2; valid && c < polygon.size(); ++c)
+			{
+				mesh.indices.push_back(polygon[0]);
+				mesh.indices.push_back(polygon[c - 1]);
+				mesh.indices.push_back(polygon[c]);
+			}
+		}
+	}
+
+	fclose(file);
+
+	if(!valid)
+	{
+		mesh.vertices.clear();
+		mesh.indices.clear();
+	}
+
+	return valid;
+}
+
+// Load GSF
+bool loadGSF(const char* path, CPUTriangleMesh& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	FILE* file = fopen(path, "rb");
+
+	if(!file)
+		return false;
+
+	vector<unsigned char> data;
+	unsigned char buffer[4096];
+	size_t read;
+
+	while((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + read);
+
+	fclose(file);
+
+	size_t size = data.size();
+
+	if(size < GSF_HEADER_SIZE || memcmp(&data[0], GSF_SIGNATURE, sizeof(GSF_SIGNATURE)))
+		return false;
+
+	// Find the geometry chunk
+	size_t chunk = GSF_HEADER_SIZE;
+	size_t chunkEnd = 0;
+
+	while(chunk + GSF_CHUNK_HEADER_SIZE <= size)
+	{
+		size_t chunkSize = readUnsigned(&data[chunk + 4], 4);
+
+		if(chunkSize < GSF_CHUNK_HEADER_SIZE || chunkSize > size - chunk)
+			return false;
+
+		if(data[chunk] == GSF_GEOMETRY_CHUNK)
+		{
+			chunkEnd = chunk + chunkSize;
+			break;
+		}
+
+		chunk += chunkSize;
+	}
+
+	size_t offset = chunk + GSF_CHUNK_HEADER_SIZE + GSF_GEOMETRY_HEADER_SIZE;
+
+	if(!chunkEnd || offset + 4 > chunkEnd)
+		return false;
+
+	unsigned int meshCount = readUnsigned(&data[offset], 4);
+	bool valid = true;
+
+	offset += 4;
+
+	for(unsigned int m = 0; valid && m < meshCount; ++m)
+	{
+		valid = offset + GSF_RECORD_HEADER_SIZE <= chunkEnd;
+
+		if(!valid)
+			break;
+
+		const unsigned char* record = &data[offset];
+		size_t recordSize = readUnsigned(record, 4);
+		size_t vertexCount = readUnsigned(record + 6, 4);
+		size_t faceCount = readUnsigned(record + 14, 4);
+		int indexBytes = record[18];
+
+		// Counts checked against the record before they size anything
+		valid = recordSize <= chunkEnd - offset && (indexBytes == 1 || indexBytes == 2 || indexBytes == 4) &&
+			vertexCount <= recordSize / 12 && faceCount <= recordSize / (3 * indexBytes) &&
+			GSF_RECORD_HEADER_SIZE + vertexCount * 12 + faceCount * 3 * indexBytes <= recordSize;
+
+		if(!valid)
+			break;
+
+		const unsigned char* vertices = record + GSF_RECORD_HEADER_SIZE;
+		const unsigned char* faces = vertices + vertexCount * 12;
+		unsigned int base = (unsigned int)mesh.vertices.size();
+
+		for(size_t v = 0; v < vertexCount; ++v)
+		{
+			CPUVector3 vertex;
+
+			memcpy(&vertex.x, vertices + v * 12, sizeof(float));
+			memcpy(&vertex.y, vertices + v * 12 + 4, sizeof(float));
+			memcpy(&vertex.z, vertices + v * 12 + 8, sizeof(float));
+			mesh.vertices.push_back(vertex);
+		}
+
+		for(size_t i = 0; valid && i < faceCount * 3; ++i)
+		{
+			unsigned int index = readUnsigned(faces + i * indexBytes, indexBytes);
+
+			valid = index < vertexCount;
+			mesh.indices.push_back(base + index);
+		}
+
+		offset += recordSize;
+	}
+
+	if(!valid)
+	{
+		mesh.vertices.clear();
+		mesh.indices.clear();
+	}
+
+	return valid;
+}
+
+// Load Mesh
+bool loadMesh(const char* path, CPUTriangleMesh& mesh)
+{
+	size_t length = strlen(path);
+	const char* extension = ".gsf";
+	bool gsf = length >= 4;
+
+	for(size_t c = 0; gsf && c < 4; ++c)
+		gsf = tolower((unsigned char)path[length - 4 + c]) == extension[c];
+
+	return gsf ? loadGSF(path, mesh) : loadOBJ(path, mesh);
+}
+
+// Hash Mesh
+uint64_t hashMesh(const CPUTriangleMesh& mesh)
+{
+	uint64_t seed = hashXX64(mesh.vertices.empty() ? nullptr : &mesh.vertices[0], mesh.vertices.size() * sizeof(CPUVector3));
+
+	return hashXX64(mesh.indices.empty() ? nullptr : &mesh.indices[0], mesh.indices.size() * sizeof(unsigned int), seed);
+}
+
+// Mesh Bounds
+void meshBounds(const CPUTriangleMesh& mesh, CPUVector3& boundsMin, CPUVector3& boundsMax)
+{
+	if(mesh.vertices.empty())
+	{
+		boundsMin.x = boundsMin.y = boundsMin.z = 0.0f;
+		boundsMax = boundsMin;
+		return;
+	}
+
+	boundsMin = boundsMax = mesh.vertices[0];
+
+	for(size_t v = 1; v < mesh.vertices.size(); ++v)
+	{
+		const CPUVector3& vertex = mesh.vertices[v];
+
+		boundsMin.x = min(boundsMin.x, vertex.x);
+		boundsMin.y = min(boundsMin.y, vertex.y);
+		boundsMin.z = min(boundsMin.z, vertex.z);
+		boundsMax.x = max(boundsMax.x, vertex.x);
+		boundsMax.y = max(boundsMax.y, vertex.y);
+		boundsMax.z = max(boundsMax.z, vertex.z);
+	}
+}
@@ -0,0 +1,46 @@
+// ------------------------------------------------
+// Header:	CPU Triangle Mesh
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUMESH
+#define CPUMESH
+
+// INCLUDES
+#include "CPUParticles.h"
+
+// Standard includes
+#include <cstdint>
+#include <vector>
+
+// Indexed triangle mesh, three indices per triangle, counter-clockwise seen from outside
+// (the CGPolyMesh convention). loadOBJ and loadGSF below read the files themselves,
+// CPUMeshAdapter.h fills one from a CGPolyMesh in the Direct X build.
+struct CPUTriangleMesh
+{
+	std::vector<CPUVector3> vertices;
+	std::vector<unsigned int> indices;
+
+	int getTriangleCount() const { return (int)(indices.size() / 3); }
+};
+
+// Load the vertices and faces of a Wavefront OBJ file (every object, polygons split into fans,
+// texture coordinates and normals skipped), returns false if the file cannot be read or holds
+// an index out of range
+bool loadOBJ(const char* path, CPUTriangleMesh& mesh);
+
+// Load the meshes of a GSF model (the format importGSF reads, Resources/Models/dropship.gsf)
+// into one, every mesh is stored in model space already. Returns false if the file cannot be
+// read, is not a GSF model or holds an index out of range
+bool loadGSF(const char* path, CPUTriangleMesh& mesh);
+
+// loadGSF for paths ending in .gsf (any case), loadOBJ for the rest
+bool loadMesh(const char* path, CPUTriangleMesh& mesh);
+
+// Hash of the vertices and indices (cache key of anything baked from the mesh)
+uint64_t hashMesh(const CPUTriangleMesh& mesh);
+
+// Bounds of the vertices (both zero for an empty mesh)
+void meshBounds(const CPUTriangleMesh& mesh, CPUVector3& boundsMin, CPUVector3& boundsMax);
+
+#endif
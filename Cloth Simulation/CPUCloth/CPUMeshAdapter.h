@@ -0,0 +1,61 @@
+// ------------------------------------------------
+// Header:	CPU Mesh Adapter
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUMESHADAPTER
+#define CPUMESHADAPTER
+
+// Converts the meshes CGImport3 loads (importOBJ, importGSF, ...) into the portable
+// CPUTriangleMesh. Only for the Direct X build, the library itself never includes it.
+
+// INCLUDES
+#include "CPUMesh.h"
+#include <CGModel\CGModel.h>
+
+// Triangles of one mesh, translated and uniformly scaled like DXUnitSphere places its model
+inline void meshFromPolyMesh(CGPolyMesh* polyMesh, CPUTriangleMesh& mesh, const CPUVector3& position, float scale = 1.0f)
+{
+	CoreStructures::GUVector4* vertices = polyMesh->vertexArray();
+	CGFaceVertex* faces = polyMesh->vertexIndexArray();
+
+	mesh.vertices.resize(polyMesh->vertexCount());
+	mesh.indices.resize(polyMesh->faceCount() * 3);
+
+	for(int v = 0; v < polyMesh->vertexCount(); ++v)
+	{
+		mesh.vertices[v].x = vertices[v].x * scale + position.x;
+		mesh.vertices[v].y = vertices[v].y * scale + position.y;
+		mesh.vertices[v].z = vertices[v].z * scale + position.z;
+	}
+
+	for(int f = 0; f < polyMesh->faceCount(); ++f)
+	{
+		mesh.indices[f * 3] = faces[f].v1;
+		mesh.indices[f * 3 + 1] = faces[f].v2;
+		mesh.indices[f * 3 + 2] = faces[f].v3;
+	}
+}
+
+// Every mesh of a model in one
+inline void meshFromModel(CGModel* model, int meshCount, CPUTriangleMesh& mesh, const CPUVector3& position, float scale = 1.0f)
+{
+	CPUTriangleMesh part;
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	for(int m = 0; m < meshCount; ++m)
+	{
+		meshFromPolyMesh(model->getMeshAtIndex(m), part, position, scale);
+
+		unsigned int base = (unsigned int)mesh.vertices.size();
+
+		mesh.vertices.insert(mesh.vertices.end(), part.vertices.begin(), part.vertices.end());
+
+		for(size_t i = 0; i < part.indices.size(); ++i)
+			mesh.indices.push_back(part.indices[i] + base);
+	}
+}
+
+#endif
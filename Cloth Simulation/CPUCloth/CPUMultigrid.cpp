@@ -0,0 +1,395 @@
+// ------------------------------------------------
+// Class:	CPU Multigrid Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUMultigrid.h"
+
+// Standard includes
+#include <cmath>
+#include <algorithm>
+
+// Namespaces
+using namespace std;
+
+// Smallest share of work handed to a thread
+#define CONSTRAINT_GRAIN 256
+#define ROW_GRAIN 1024
+
+// Smallest coarse lattice worth relaxing
+#define MIN_LEVEL_SIZE 3
+
+// Unilateral distance constraints of one colour (position based, weighted by inverse mass)
+static void projectStretch(const unsigned int* start, const unsigned int* end, const float* restDistance,
+	float* x, float* y, float* z, const float* invMass, int first, int last)
+{
+	for(int c = first; c < last; ++c)
+	{
+		unsigned int a = start[c];
+		unsigned int b = end[c];
+
+		float dx = x[b] - x[a];
+		float dy = y[b] - y[a];
+		float dz = z[b] - z[a];
+		float length = sqrtf(dx * dx + dy * dy + dz * dz);
+		float weightSum = invMass[a] + invMass[b];
+
+		if(length > restDistance[c] && weightSum > 0.0f)
+		{
+			float scale = (length - restDistance[c]) / (length * weightSum);
+
+			x[a] += dx * scale * invMass[a];
+			y[a] += dy * scale * invMass[a];
+			z[a] += dz * scale * invMass[a];
+
+			x[b] -= dx * scale * invMass[b];
+			y[b] -= dy * scale * invMass[b];
+			z[b] -= dz * scale * invMass[b];
+		}
+	}
+}
+
+// Prolongation table for one axis: the last coarse node at or before each finer column / row,
+// and the interpolation weight of the node after it
+static void buildProlongation(const vector<unsigned int>& fineIndex, unsigned int finerCount,
+	vector<unsigned int>& lower, vector<float>& upperWeight)
+{
+	unsigned int coarseCount = (unsigned int)fineIndex.size();
+	unsigned int node = 0;
+
+	lower.resize(finerCount);
+	upperWeight.resize(finerCount);
+
+	for(unsigned int i = 0; i < finerCount; ++i)
+	{
+		while(node + 1 < coarseCount && fineIndex[node + 1] <= i)
+			++node;
+
+		lower[i] = node;
+		upperWeight[i] = (fineIndex[node] == i) ? 0.0f
+			: (float)(i - fineIndex[node]) / (float)(fineIndex[node + 1] - fineIndex[node]);
+	}
+}
+
+// Constructor
+CPUMultigrid::CPUMultigrid()
+{
+	gridWidth = 0;
+	gridHeight = 0;
+	sweeps = 1;
+}
+
+// Destructor
+CPUMultigrid::~CPUMultigrid()
+{
+	release();
+}
+
+// Build
+bool CPUMultigrid::build(unsigned int width, unsigned int height, int levelCount)
+{
+	release();
+
+	gridWidth = width;
+	gridHeight = height;
+
+	unsigned int finerWidth = width;
+	unsigned int finerHeight = height;
+
+	for(int l = 1; l < levelCount; ++l)
+	{
+		// Every other column and row, the last one is always kept
+		if(finerWidth / 2 + 1 < MIN_LEVEL_SIZE || finerHeight / 2 + 1 < MIN_LEVEL_SIZE)
+			break;
+
+		if(!addLevel(finerWidth, finerHeight))
+		{
+			release();
+			return false;
+		}
+
+		finerWidth = levels.back()->width;
+		finerHeight = levels.back()->height;
+	}
+
+	return true;
+}
+
+// Release
+void CPUMultigrid::release()
+{
+	for(size_t l = 0; l < levels.size(); ++l)
+		delete levels[l];
+
+	levels.clear();
+}
+
+// Add Level
+bool CPUMultigrid::addLevel(unsigned int finerWidth, unsigned int finerHeight)
+{
+	CPUMultigridLevel* level = new CPUMultigridLevel;
+	CPUMultigridLevel* finer = levels.empty() ? nullptr : levels.back();
+
+	level->width = finerWidth / 2 + 1;
+	level->height = finerHeight / 2 + 1;
+
+	if(!level->particles.allocate(level->width * level->height))
+	{
+		delete level;
+		return false;
+	}
+
+	// Injection: node (i, j) sits on finer column 2i and row 2j, clamped to the last one
+	level->fineColumn.resize(level->width);
+	level->fineRow.resize(level->height);
+	level->gridColumn.resize(level->width);
+	level->gridRow.resize(level->height);
+
+	for(unsigned int i = 0; i < level->width; ++i)
+	{
+		level->fineColumn[i] = min(i * 2, finerWidth - 1);
+		level->gridColumn[i] = finer ? finer->gridColumn[level->fineColumn[i]] : level->fineColumn[i];
+	}
+
+	for(unsigned int j = 0; j < level->height; ++j)
+	{
+		level->fineRow[j] = min(j * 2, finerHeight - 1);
+		level->gridRow[j] = finer ? finer->gridRow[level->fineRow[j]] : level->fineRow[j];
+	}
+
+	buildProlongation(level->fineColumn, finerWidth, level->lowerColumn, level->upperColumnWeight);
+	buildProlongation(level->fineRow, finerHeight, level->lowerRow, level->upperRowWeight);
+
+	// Free until updateMasses pins the anchors
+	for(unsigned int n = 0; n < level->particles.count; ++n)
+		level->particles.invMass[n] = 1.0f;
+
+	buildConstraints(*level);
+	levels.push_back(level);
+
+	return true;
+}
+
+// Build Constraints (same colouring as CPUCloth::setupBuffers, rest lengths from the finest grid)
+void CPUMultigrid::buildConstraints(CPUMultigridLevel& level)
+{
+	vector<unsigned int> batchStartIndex[8];
+	vector<unsigned int> batchEndIndex[8];
+	vector<float> batchDistance[8];
+
+	unsigned int width = level.width;
+
+	for(unsigned int j = 0; j < level.height; ++j)
+	{
+		for(unsigned int i = 0; i < width; ++i)
+		{
+			unsigned int index = (j * width) + i;
+
+			// Candidate partners: left, up and left, up, up and right
+			unsigned int partner[4] = { index - 1, index - (width + 1), index - width, index - (width - 1) };
+			bool valid[4] = { i > 0, i > 0 && j > 0, j > 0, j > 0 && i < (width - 1) };
+			int batch[4] = { (i & 1) ? 0 : 1, (j & 1) ? 4 : 5, (j & 1) ? 2 : 3, (j & 1) ? 6 : 7 };
+
+			for(int p = 0; p < 4; ++p)
+			{
+				if(!valid[p])
+					continue;
+
+				unsigned int start = partner[p];
+				float dx = ((float)level.gridColumn[i] - (float)level.gridColumn[start % width]) / (float)(gridWidth - 1);
+				float dz = ((float)level.gridRow[j] - (float)level.gridRow[start / width]) / (float)(gridHeight - 1);
+
+				batchStartIndex[batch[p]].push_back(start);
+				batchEndIndex[batch[p]].push_back(index);
+				batchDistance[batch[p]].push_back(sqrtf(dx * dx + dz * dz));
+			}
+		}
+	}
+
+	int total = 0;
+
+	for(int b = 0; b < 8; ++b)
+	{
+		level.batchSize[b] = (int)batchStartIndex[b].size();
+		level.batchStart[b] = total;
+		total += level.batchSize[b];
+
+		level.constraintStart.insert(level.constraintStart.end(), batchStartIndex[b].begin(), batchStartIndex[b].end());
+		level.constraintEnd.insert(level.constraintEnd.end(), batchEndIndex[b].begin(), batchEndIndex[b].end());
+		level.constraintDistance.insert(level.constraintDistance.end(), batchDistance[b].begin(), batchDistance[b].end());
+	}
+}
+
+// Update Masses
+void CPUMultigrid::updateMasses(const float* fineInvMass)
+{
+	const float* finerInvMass = fineInvMass;
+	unsigned int finerWidth = gridWidth;
+	unsigned int finerHeight = gridHeight;
+
+	for(size_t l = 0; l < levels.size(); ++l)
+	{
+		CPUMultigridLevel& level = *levels[l];
+		float* invMass = level.particles.invMass;
+
+		for(unsigned int n = 0; n < level.particles.count; ++n)
+			invMass[n] = 1.0f;
+
+		for(unsigned int j = 0; j < finerHeight; ++j)
+		{
+			for(unsigned int i = 0; i < finerWidth; ++i)
+			{
+				if(finerInvMass[j * finerWidth + i] > 0.0f)
+					continue;
+
+				// The (up to four) nodes the pinned particle is interpolated from
+				unsigned int column = level.lowerColumn[i];
+				unsigned int row = level.lowerRow[j];
+				unsigned int nextColumn = level.upperColumnWeight[i] > 0.0f ? column + 1 : column;
+				unsigned int nextRow = level.upperRowWeight[j] > 0.0f ? row + 1 : row;
+
+				invMass[row * level.width + column] = 0.0f;
+				invMass[row * level.width + nextColumn] = 0.0f;
+				invMass[nextRow * level.width + column] = 0.0f;
+				invMass[nextRow * level.width + nextColumn] = 0.0f;
+			}
+		}
+
+		finerInvMass = invMass;
+		finerWidth = level.width;
+		finerHeight = level.height;
+	}
+}
+
+// Restrict (inject the finer positions into a level, and remember them)
+static void restrictLevel(const CPUParticles& finer, unsigned int finerWidth, CPUMultigridLevel& level, CPUThreadPool* threadPool)
+{
+	threadPool->parallelFor(level.height, max(1, ROW_GRAIN / (int)level.width), [&](int first, int last)
+	{
+		for(int j = first; j < last; ++j)
+		{
+			unsigned int row = level.fineRow[j] * finerWidth;
+
+			for(unsigned int i = 0; i < level.width; ++i)
+			{
+				unsigned int node = j * level.width + i;
+				unsigned int source = row + level.fineColumn[i];
+
+				level.particles.x[node] = level.particles.oldX[node] = finer.x[source];
+				level.particles.y[node] = level.particles.oldY[node] = finer.y[source];
+				level.particles.z[node] = level.particles.oldZ[node] = finer.z[source];
+			}
+		}
+	});
+}
+
+// Prolong (bilinearly interpolate the change in a level's positions onto the movable finer particles)
+static void prolongLevel(const CPUMultigridLevel& level, CPUParticles& finer, unsigned int finerWidth, unsigned int finerHeight, CPUThreadPool* threadPool)
+{
+	const CPUParticles& coarse = level.particles;
+	unsigned int width = level.width;
+
+	threadPool->parallelFor(finerHeight, max(1, ROW_GRAIN / (int)finerWidth), [&](int first, int last)
+	{
+		for(int j = first; j < last; ++j)
+		{
+			unsigned int row = level.lowerRow[j] * width;
+			unsigned int nextRow = level.upperRowWeight[j] > 0.0f ? row + width : row;
+			float rowWeight = level.upperRowWeight[j];
+
+			for(unsigned int i = 0; i < finerWidth; ++i)
+			{
+				unsigned int column = level.lowerColumn[i];
+				unsigned int nextColumn = level.upperColumnWeight[i] > 0.0f ? column + 1 : column;
+				float columnWeight = level.upperColumnWeight[i];
+
+				// Corner weights
+				float w00 = (1.0f - columnWeight) * (1.0f - rowWeight);
+				float w10 = columnWeight * (1.0f - rowWeight);
+				float w01 = (1.0f - columnWeight) * rowWeight;
+				float w11 = columnWeight * rowWeight;
+
+				unsigned int n00 = row + column, n10 = row + nextColumn;
+				unsigned int n01 = nextRow + column, n11 = nextRow + nextColumn;
+				unsigned int index = j * finerWidth + i;
+
+				float movable = finer.invMass[index] > 0.0f ? 1.0f : 0.0f;
+
+				finer.x[index] += movable * (w00 * (coarse.x[n00] - coarse.oldX[n00]) + w10 * (coarse.x[n10] - coarse.oldX[n10])
+					+ w01 * (coarse.x[n01] - coarse.oldX[n01]) + w11 * (coarse.x[n11] - coarse.oldX[n11]));
+				finer.y[index] += movable * (w00 * (coarse.y[n00] - coarse.oldY[n00]) + w10 * (coarse.y[n10] - coarse.oldY[n10])
+					+ w01 * (coarse.y[n01] - coarse.oldY[n01]) + w11 * (coarse.y[n11] - coarse.oldY[n11]));
+				finer.z[index] += movable * (w00 * (coarse.z[n00] - coarse.oldZ[n00]) + w10 * (coarse.z[n10] - coarse.oldZ[n10])
+					+ w01 * (coarse.z[n01] - coarse.oldZ[n01]) + w11 * (coarse.z[n11] - coarse.oldZ[n11]));
+			}
+		}
+	});
+}
+
+// Correct
+void CPUMultigrid::correct(CPUParticles& fine, CPUThreadPool* threadPool)
+{
+	if(levels.empty())
+		return;
+
+	restrictLevel(fine, gridWidth, *levels[0], threadPool);
+	cycle(0, threadPool);
+	prolongLevel(*levels[0], fine, gridWidth, gridHeight, threadPool);
+}
+
+// Cycle
+void CPUMultigrid::cycle(int index, CPUThreadPool* threadPool)
+{
+	CPUMultigridLevel& level = *levels[index];
+
+	for(int s = 0; s < sweeps; ++s)
+		relax(level, threadPool);
+
+	if(index + 1 < (int)levels.size())
+	{
+		CPUMultigridLevel& coarser = *levels[index + 1];
+
+		restrictLevel(level.particles, level.width, coarser, threadPool);
+		cycle(index + 1, threadPool);
+		prolongLevel(coarser, level.particles, level.width, level.height, threadPool);
+	}
+
+	for(int s = 0; s < sweeps; ++s)
+		relax(level, threadPool);
+}
+
+// Relax (one Gauss-Seidel sweep, colour by colour)
+void CPUMultigrid::relax(CPUMultigridLevel& level, CPUThreadPool* threadPool)
+{
+	for(int b = 0; b < 8; ++b)
+	{
+		if(!level.batchSize[b])
+			continue;
+
+		const unsigned int* start = &level.constraintStart[level.batchStart[b]];
+		const unsigned int* end = &level.constraintEnd[level.batchStart[b]];
+		const float* distance = &level.constraintDistance[level.batchStart[b]];
+		CPUParticles& particles = level.particles;
+
+		threadPool->parallelFor(level.batchSize[b], CONSTRAINT_GRAIN, [&](int first, int last)
+		{
+			projectStretch(start, end, distance, particles.x, particles.y, particles.z, particles.invMass, first, last);
+		});
+	}
+}
+
+// Get Constraint Count
+int CPUMultigrid::getConstraintCount(int level) const
+{
+	if(level < 1 || level > (int)levels.size())
+		return 0;
+
+	return (int)levels[level - 1]->constraintStart.size();
+}
+
+// Set Sweeps
+void CPUMultigrid::setSweeps(int newSweeps)
+{
+	sweeps = max(newSweeps, 1);
+}
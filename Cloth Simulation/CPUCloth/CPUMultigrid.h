@@ -0,0 +1,101 @@
+// ------------------------------------------------
+// Class:	CPU Multigrid Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUMULTIGRID
+#define CPUMULTIGRID
+
+// INCLUDES
+#include "CPUParticles.h"
+#include "CPUThreadPool.h"
+
+// Standard includes
+#include <vector>
+
+// One coarse level of the hierarchy, every level halves the lattice of the one above it
+struct CPUMultigridLevel
+{
+	unsigned int width, height;
+
+	// Node positions (x, y, z), the positions restricted from the finer level before
+	// the level is relaxed (oldX, oldY, oldZ) and the inverse masses
+	CPUParticles particles;
+
+	// Finer level column / row each node is injected from, and its column / row on the
+	// finest grid (for the rest positions)
+	std::vector<unsigned int> fineColumn, fineRow;
+	std::vector<unsigned int> gridColumn, gridRow;
+
+	// Prolongation onto the finer level, per finer column / row: the node at or before it
+	// and the weight of the node after it
+	std::vector<unsigned int> lowerColumn, lowerRow;
+	std::vector<float> upperColumnWeight, upperRowWeight;
+
+	// Constraints (8 colour batches packed one after another, as on the finest level)
+	std::vector<unsigned int> constraintStart, constraintEnd;
+	std::vector<float> constraintDistance;
+	int batchSize[8];
+	int batchStart[8];
+};
+
+// Geometric multigrid for the constraint solve on the regular cloth lattice.
+// Each coarse level keeps every other column and row (plus the last one), links its nodes
+// with the same eight colours of springs as the cloth, and is relaxed with Gauss-Seidel
+// sweeps in a V-cycle. Only the change in node positions (the correction) is prolonged
+// back up, bilinearly, so the fine level keeps its own detail.
+//
+// Coarse springs are unilateral (they only resist stretching), as folds and bends on a finer
+// level legitimately bring coarse nodes closer together than their rest distance.
+class CPUMultigrid
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable (owns its levels)
+	CPUMultigrid(const CPUMultigrid&);
+	CPUMultigrid& operator=(const CPUMultigrid&);
+
+	// Attributes
+	unsigned int gridWidth, gridHeight; // Finest lattice
+	std::vector<CPUMultigridLevel*> levels; // Finest coarse level first
+	int sweeps; // Sweeps before and after descending (the coarsest level runs both)
+
+	// Methods
+	bool addLevel(unsigned int finerWidth, unsigned int finerHeight);
+	void buildConstraints(CPUMultigridLevel& level);
+
+	// V-cycle below the finer level of coarse level index
+	void cycle(int index, CPUThreadPool* threadPool);
+	void relax(CPUMultigridLevel& level, CPUThreadPool* threadPool);
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor & Destructor
+	CPUMultigrid();
+	~CPUMultigrid();
+
+	// Build up to levelCount - 1 coarse levels below a width x height lattice (coarsening
+	// stops once a level would be smaller than 3 x 3), returns false on allocation failure
+	bool build(unsigned int width, unsigned int height, int levelCount);
+	void release();
+
+	// Pin every coarse node a pinned fine particle is interpolated from, call after the
+	// fine inverse masses change
+	void updateMasses(const float* fineInvMass);
+
+	// Coarse grid correction of the fine positions: restrict, run a V-cycle over the coarse
+	// levels, then prolong the change back and add it to the movable particles
+	void correct(CPUParticles& fine, CPUThreadPool* threadPool);
+
+	// Accessors
+	int getLevelCount() const { return (int)levels.size() + 1; } // Including the finest
+	int getSweeps() const { return sweeps; }
+	int getConstraintCount(int level) const;
+
+	// Sweeps per level on the way down and up (>= 1)
+	void setSweeps(int newSweeps);
+};
+
+#endif
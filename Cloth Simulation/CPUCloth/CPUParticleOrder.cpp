@@ -0,0 +1,106 @@
+// ------------------------------------------------
+// Source:	CPU Particle Order
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUParticleOrder.h"
+
+// Standard includes
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Namespaces
+using namespace std;
+
+// Spread the low 16 bits of value over the even bits
+static uint32_t spreadBits(uint32_t value)
+{
+	value &= 0x0000FFFF;
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+
+	return value;
+}
+
+// Build Particle Order
+void buildParticleOrder(CPUParticleOrder order, unsigned int width, unsigned int height, unsigned int tileSize,
+	vector<unsigned int>& slots)
+{
+	unsigned int count = width * height;
+
+	slots.resize(count);
+
+	if(order == CPU_ORDER_MORTON)
+	{
+		// Morton code in the high half and the lattice index in the low half, sorted. Lattice
+		// positions past the cloth have no code, so the slots stay dense on any dimensions.
+		vector<uint64_t> keys(count);
+
+		for(unsigned int j = 0; j < height; ++j)
+		{
+			for(unsigned int i = 0; i < width; ++i)
+			{
+				uint64_t code = spreadBits(i) | (spreadBits(j) << 1);
+				keys[j * width + i] = (code << 32) | (j * width + i);
+			}
+		}
+
+		sort(keys.begin(), keys.end());
+
+		for(unsigned int s = 0; s < count; ++s)
+			slots[(uint32_t)keys[s]] = s;
+	}
+	else if(order == CPU_ORDER_TILED)
+	{
+		tileSize = max(tileSize, 1u);
+
+		for(unsigned int j = 0; j < height; ++j)
+		{
+			// Tiles of the band hold tileRows rows each (fewer in the last band)
+			unsigned int bandRow = j - j % tileSize;
+			unsigned int tileRows = min(tileSize, height - bandRow);
+
+			for(unsigned int i = 0; i < width; ++i)
+			{
+				unsigned int tileColumn = i - i % tileSize;
+				unsigned int tileColumns = min(tileSize, width - tileColumn);
+
+				slots[j * width + i] = bandRow * width + tileColumn * tileRows + (j - bandRow) * tileColumns + (i - tileColumn);
+			}
+		}
+	}
+	else
+	{
+		for(unsigned int i = 0; i < count; ++i)
+			slots[i] = i;
+	}
+}
+
+// Particle Order Names
+static const char* orderNames[CPU_ORDER_COUNT] = { "row", "morton", "tiled" };
+
+const char* particleOrderName(CPUParticleOrder order)
+{
+	if(order < CPU_ORDER_ROW_MAJOR || order >= CPU_ORDER_COUNT)
+		return "unknown";
+
+	return orderNames[order];
+}
+
+bool parseParticleOrder(const char* name, CPUParticleOrder& order)
+{
+	for(int i = 0; i < CPU_ORDER_COUNT; ++i)
+	{
+		if(!strcmp(name, orderNames[i]))
+		{
+			order = (CPUParticleOrder)i;
+			return true;
+		}
+	}
+
+	return false;
+}
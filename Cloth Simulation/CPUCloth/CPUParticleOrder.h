@@ -0,0 +1,36 @@
+// ------------------------------------------------
+// Header:	CPU Particle Order
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUPARTICLEORDER
+#define CPUPARTICLEORDER
+
+// Standard includes
+#include <vector>
+
+// Memory orders of the particle arrays. Row major puts vertical and diagonal neighbours a
+// whole row apart, so on wide cloths every vertical batch misses the cache on both ends;
+// Morton (Z-order) and square tiles keep the neighbours of most particles a few cache lines away.
+enum CPUParticleOrder
+{
+	CPU_ORDER_ROW_MAJOR = 0,
+	CPU_ORDER_MORTON,	// Lattice positions sorted by their interleaved column / row bits
+	CPU_ORDER_TILED,	// Row major tiles, row major inside each tile (partial tiles on the far edges)
+	CPU_ORDER_COUNT
+};
+
+// Storage slot of every particle of a width x height lattice, indexed by its lattice index
+// (row * width + column). tileSize is the side of the tiles, only used by CPU_ORDER_TILED.
+// Aligned power of two blocks stay contiguous in Morton order, so both orders keep tiles of
+// that size together.
+void buildParticleOrder(CPUParticleOrder order, unsigned int width, unsigned int height, unsigned int tileSize,
+	std::vector<unsigned int>& slots);
+
+// Short lower case name ("row", "morton", "tiled")
+const char* particleOrderName(CPUParticleOrder order);
+
+// Parse a name produced by particleOrderName, returns false if unknown
+bool parseParticleOrder(const char* name, CPUParticleOrder& order);
+
+#endif
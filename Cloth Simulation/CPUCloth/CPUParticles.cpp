@@ -0,0 +1,149 @@
+// ------------------------------------------------
+// Class:	CPU Particle Storage Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUParticles.h"
+#include "CPUMemory.h"
+
+// Standard includes
+#include <cstring>
+
+// Particles per SIMD block (16 floats fill a cache line and an AVX-512 register)
+#define PARTICLE_BLOCK 16
+
+// Constructor
+CPUParticles::CPUParticles()
+{
+	count = 0;
+	capacity = 0;
+	x = y = z = nullptr;
+	oldX = oldY = oldZ = nullptr;
+	invMass = nullptr;
+	normalX = normalY = normalZ = nullptr;
+	matDiffuse = nullptr;
+	matSpecular = nullptr;
+	texCoord = nullptr;
+}
+
+// Destructor
+CPUParticles::~CPUParticles()
+{
+	release();
+}
+
+// Allocate
+bool CPUParticles::allocate(unsigned int newCount)
+{
+	release();
+
+	capacity = (newCount + PARTICLE_BLOCK - 1) & ~(PARTICLE_BLOCK - 1);
+	size_t bytes = capacity * sizeof(float);
+
+	// Hot arrays
+	x = (float*)alignedMalloc(bytes);
+	y = (float*)alignedMalloc(bytes);
+	z = (float*)alignedMalloc(bytes);
+	oldX = (float*)alignedMalloc(bytes);
+	oldY = (float*)alignedMalloc(bytes);
+	oldZ = (float*)alignedMalloc(bytes);
+	invMass = (float*)alignedMalloc(bytes);
+
+	// Cold arrays
+	normalX = (float*)alignedMalloc(bytes);
+	normalY = (float*)alignedMalloc(bytes);
+	normalZ = (float*)alignedMalloc(bytes);
+	matDiffuse = (uint32_t*)alignedMalloc(capacity * sizeof(uint32_t));
+	matSpecular = (uint32_t*)alignedMalloc(capacity * sizeof(uint32_t));
+	texCoord = (float*)alignedMalloc(capacity * 2 * sizeof(float));
+
+	if(!x || !y || !z || !oldX || !oldY || !oldZ || !invMass || !normalX || !normalY || !normalZ || !matDiffuse || !matSpecular || !texCoord)
+	{
+		release();
+		return false;
+	}
+
+	// Zero everything so the padding lanes hold valid floats
+	memset(x, 0, bytes);
+	memset(y, 0, bytes);
+	memset(z, 0, bytes);
+	memset(oldX, 0, bytes);
+	memset(oldY, 0, bytes);
+	memset(oldZ, 0, bytes);
+	memset(invMass, 0, bytes);
+	memset(normalX, 0, bytes);
+	memset(normalY, 0, bytes);
+	memset(normalZ, 0, bytes);
+	memset(matDiffuse, 0, capacity * sizeof(uint32_t));
+	memset(matSpecular, 0, capacity * sizeof(uint32_t));
+	memset(texCoord, 0, capacity * 2 * sizeof(float));
+
+	count = newCount;
+
+	return true;
+}
+
+// Release
+void CPUParticles::release()
+{
+	alignedFree(x);
+	alignedFree(y);
+	alignedFree(z);
+	alignedFree(oldX);
+	alignedFree(oldY);
+	alignedFree(oldZ);
+	alignedFree(invMass);
+	alignedFree(normalX);
+	alignedFree(normalY);
+	alignedFree(normalZ);
+	alignedFree(matDiffuse);
+	alignedFree(matSpecular);
+	alignedFree(texCoord);
+
+	count = 0;
+	capacity = 0;
+	x = y = z = nullptr;
+	oldX = oldY = oldZ = nullptr;
+	invMass = nullptr;
+	normalX = normalY = normalZ = nullptr;
+	matDiffuse = nullptr;
+	matSpecular = nullptr;
+	texCoord = nullptr;
+}
+
+// Position accessors
+CPUVector3 CPUParticles::position(unsigned int index) const
+{
+	CPUVector3 result;
+	result.x = x[index];
+	result.y = y[index];
+	result.z = z[index];
+
+	return result;
+}
+
+void CPUParticles::setPosition(unsigned int index, const CPUVector3& position)
+{
+	x[index] = position.x;
+	y[index] = position.y;
+	z[index] = position.z;
+}
+
+// Build Vertices
+void CPUParticles::buildVertices(CPUVertex* vertices, float alpha) const
+{
+	for(unsigned int i = 0; i < count; ++i)
+	{
+		vertices[i].pos.x = oldX[i] + (x[i] - oldX[i]) * alpha;
+		vertices[i].pos.y = oldY[i] + (y[i] - oldY[i]) * alpha;
+		vertices[i].pos.z = oldZ[i] + (z[i] - oldZ[i]) * alpha;
+		vertices[i].normal.x = normalX[i];
+		vertices[i].normal.y = normalY[i];
+		vertices[i].normal.z = normalZ[i];
+		vertices[i].matDiffuse = matDiffuse[i];
+		vertices[i].matSpecular = matSpecular[i];
+		vertices[i].texCoord[0] = texCoord[i * 2];
+		vertices[i].texCoord[1] = texCoord[i * 2 + 1];
+	}
+}
@@ -0,0 +1,77 @@
+// ------------------------------------------------
+// Class:	CPU Particle Storage Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUPARTICLES
+#define CPUPARTICLES
+
+// INCLUDES
+#include <cstdint>
+
+// Three component vector (mirrors XMFLOAT3)
+struct CPUVector3
+{
+	float x, y, z;
+};
+
+// Interleaved vertex data for rendering (mirrors CGVertexExt)
+struct CPUVertex
+{
+	CPUVector3 pos;
+	CPUVector3 normal;
+	uint32_t matDiffuse;
+	uint32_t matSpecular;
+	float texCoord[2];
+};
+
+// Structure of arrays particle storage.
+// The solver passes only read and write the hot position arrays, the cold
+// render attributes are only touched when building vertex data.
+class CPUParticles
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable (owns its arrays)
+	CPUParticles(const CPUParticles&);
+	CPUParticles& operator=(const CPUParticles&);
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Number of particles, and the array length rounded up to a whole SIMD block
+	unsigned int count;
+	unsigned int capacity;
+
+	// Hot: current and previous positions (CPU_ALIGNMENT aligned)
+	float *x, *y, *z;
+	float *oldX, *oldY, *oldZ;
+
+	// Hot: inverse mass, 0 pins a particle in place (forces, collisions and constraints skip it)
+	float* invMass;
+
+	// Cold: render attributes
+	float *normalX, *normalY, *normalZ;
+	uint32_t* matDiffuse;
+	uint32_t* matSpecular;
+	float* texCoord; // (u, v) pairs
+
+	// Constructor & Destructor
+	CPUParticles();
+	~CPUParticles();
+
+	// Allocate storage for newCount particles (zero filled), returns false on failure
+	bool allocate(unsigned int newCount);
+	void release();
+
+	// Position accessors
+	CPUVector3 position(unsigned int index) const;
+	void setPosition(unsigned int index, const CPUVector3& position);
+
+	// Interleave into render vertices, vertices must hold count entries.
+	// Positions are blended from the previous to the current state by alpha (0 - 1).
+	void buildVertices(CPUVertex* vertices, float alpha = 1.0f) const;
+};
+
+#endif
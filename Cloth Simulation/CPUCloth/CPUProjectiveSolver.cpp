@@ -0,0 +1,677 @@
+// ------------------------------------------------
+// Class:	CPU Projective Solver Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUProjectiveSolver.h"
+#include "CPUHash.h"
+
+// Standard includes
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+// Debug includes
+#include <iostream>
+
+// Namespaces
+using namespace std;
+
+// Smallest share of work handed to a thread
+#define PARTICLE_GRAIN 1024
+#define CONSTRAINT_GRAIN 256
+
+// Lattice pieces small enough to order directly rather than dissect further
+#define DISSECTION_LEAF 64
+
+// Bumped whenever the system layout changes, so old cache files are never matched
+#define FACTOR_VERSION 1
+
+// Constructor
+CPUProjectiveSolver::CPUProjectiveSolver()
+{
+	settings.stiffness[0] = 5000.0f;
+	settings.stiffness[1] = 500.0f;
+	settings.mass = 1.0f;
+	settings.andersonWindow = 5;
+
+	width = height = 0;
+	prepared = false;
+	factorKey = 0;
+	factorTimeStep = 0.0f;
+	historyCount = historyNext = 0;
+	hasPrevious = false;
+	factorTime = 0.0;
+	factorLoaded = false;
+	lastAccepted = 0;
+	lastEnergy = 0.0;
+
+	for(int b = 0; b < 8; ++b)
+		batchStart[b] = 0;
+}
+
+// Compute Key (everything the factor depends on)
+uint64_t CPUProjectiveSolver::computeKey(const CPUParticles& particles, float timeStep) const
+{
+	struct
+	{
+		int32_t version;
+		uint32_t width, height;
+		float timeStep;
+		float stiffness[2];
+		float mass;
+	} system;
+
+	system.version = FACTOR_VERSION;
+	system.width = width;
+	system.height = height;
+	system.timeStep = timeStep;
+	system.stiffness[0] = settings.stiffness[0];
+	system.stiffness[1] = settings.stiffness[1];
+	system.mass = settings.mass;
+
+	// The inverse masses carry the anchor set (zero = pinned)
+	uint64_t seed = hashXX64(&system, sizeof(system));
+
+	return hashXX64(particles.invMass, particles.count * sizeof(float), seed);
+}
+
+// Prepare
+bool CPUProjectiveSolver::prepare(unsigned int clothWidth, unsigned int clothHeight, const CPUParticles& particles,
+	const CPUConstraintBatch* batches, float timeStep)
+{
+	typedef chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	width = clothWidth;
+	height = clothHeight;
+	prepared = false;
+	factorLoaded = false;
+
+	if(!particles.count || particles.count != width * height)
+		return false;
+
+	// Free particles (the unknowns)
+	freeIndex.assign(particles.count, -1);
+	freeParticle.clear();
+	freeMass.clear();
+
+	double particleMass = settings.mass / (double)particles.count;
+
+	for(unsigned int i = 0; i < particles.count; ++i)
+	{
+		if(particles.invMass[i] > 0.0f)
+		{
+			freeIndex[i] = (int)freeParticle.size();
+			freeParticle.push_back(i);
+			freeMass.push_back(particleMass / particles.invMass[i]);
+		}
+	}
+
+	int constraintCount = 0;
+
+	for(int b = 0; b < 8; ++b)
+	{
+		batchStart[b] = constraintCount;
+		constraintCount += batches[b].count;
+	}
+
+	// Iteration buffers
+	size_t freeCount = freeParticle.size();
+
+	targetX.assign(particles.count, 0.0f);
+	targetY.assign(particles.count, 0.0f);
+	targetZ.assign(particles.count, 0.0f);
+	projectionX.assign(constraintCount, 0.0f);
+	projectionY.assign(constraintCount, 0.0f);
+	projectionZ.assign(constraintCount, 0.0f);
+	work.assign(freeCount * 3, 0.0);
+	current.assign(freeCount * 3, 0.0);
+	plain.assign(freeCount * 3, 0.0);
+	previousPlain.assign(freeCount * 3, 0.0);
+	previousResidual.assign(freeCount * 3, 0.0);
+	residual.assign(freeCount * 3, 0.0);
+	historyPlain.assign(freeCount * 3 * settings.andersonWindow, 0.0);
+	historyResidual.assign(freeCount * 3 * settings.andersonWindow, 0.0);
+
+	factorKey = computeKey(particles, timeStep);
+	factorTimeStep = timeStep;
+
+	if(!freeCount)
+	{
+		// Everything pinned, nothing to solve
+		factor.release();
+		prepared = true;
+	}
+	else
+	{
+		// Try the cache before factoring
+		string path;
+
+		if(!cacheDirectory.empty())
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "/pd_%ux%u_%016llx.ldl", width, height, (unsigned long long)factorKey);
+			path = cacheDirectory + name;
+
+			factorLoaded = factor.load(path.c_str(), factorKey) && factor.getSize() == (int)freeCount;
+		}
+
+		prepared = factorLoaded || buildFactor(batches, timeStep);
+
+		if(prepared && !factorLoaded && !path.empty() && !factor.save(path.c_str(), factorKey))
+			cout << "Projective dynamics factor could not be cached to '" << path << "'" << endl;
+	}
+
+	factorTime = chrono::duration<double>(Clock::now() - start).count();
+
+	return prepared;
+}
+
+// Build Factor
+bool CPUProjectiveSolver::buildFactor(const CPUConstraintBatch* batches, float timeStep)
+{
+	int freeCount = (int)freeParticle.size();
+	double inertia = 1.0 / ((double)timeStep * timeStep);
+
+	// Columns as (row, value) lists: M / h^2 and the spring weights on the diagonal, -w between free pairs
+	vector<vector<pair<int, double> > > columns(freeCount);
+
+	for(int f = 0; f < freeCount; ++f)
+		columns[f].push_back(make_pair(f, freeMass[f] * inertia));
+
+	for(int b = 0; b < 8; ++b)
+	{
+		double weight = settings.stiffness[b < 4 ? 0 : 1];
+
+		for(int c = 0; c < batches[b].count; ++c)
+		{
+			int a = freeIndex[batches[b].start[c]];
+			int e = freeIndex[batches[b].end[c]];
+
+			if(a >= 0)
+				columns[a][0].second += weight;
+
+			if(e >= 0)
+				columns[e][0].second += weight;
+
+			if(a >= 0 && e >= 0)
+			{
+				columns[a].push_back(make_pair(e, -weight));
+				columns[e].push_back(make_pair(a, -weight));
+			}
+		}
+	}
+
+	vector<int> columnStart(freeCount + 1, 0);
+	vector<int> row;
+	vector<double> value;
+
+	for(int f = 0; f < freeCount; ++f)
+	{
+		sort(columns[f].begin(), columns[f].end());
+
+		for(size_t k = 0; k < columns[f].size(); ++k)
+		{
+			row.push_back(columns[f][k].first);
+			value.push_back(columns[f][k].second);
+		}
+
+		columnStart[f + 1] = (int)row.size();
+	}
+
+	// Fill reducing order over the lattice, restricted to the free particles
+	vector<int> lattice;
+	buildOrder(lattice);
+
+	vector<int> order;
+	order.reserve(freeCount);
+
+	for(size_t k = 0; k < lattice.size(); ++k)
+	{
+		if(freeIndex[lattice[k]] >= 0)
+			order.push_back(freeIndex[lattice[k]]);
+	}
+
+	return factor.factor(freeCount, columnStart, row, value, order);
+}
+
+// Build Order (nested dissection of the lattice)
+void CPUProjectiveSolver::buildOrder(vector<int>& order) const
+{
+	order.clear();
+	order.reserve(width * height);
+
+	dissect(0, width, 0, height, order);
+}
+
+// Dissect: order both halves of a block of the lattice, then the line separating them. Springs
+// only join neighbouring columns and rows, so a single line is a separator, and eliminating it
+// last keeps the fill inside each half.
+void CPUProjectiveSolver::dissect(unsigned int firstColumn, unsigned int lastColumn, unsigned int firstRow, unsigned int lastRow,
+	vector<int>& order) const
+{
+	unsigned int columns = lastColumn - firstColumn;
+	unsigned int rows = lastRow - firstRow;
+
+	if(!columns || !rows)
+		return;
+
+	if(columns * rows <= DISSECTION_LEAF || columns < 3 || rows < 3)
+	{
+		for(unsigned int j = firstRow; j < lastRow; ++j)
+		{
+			for(unsigned int i = firstColumn; i < lastColumn; ++i)
+				order.push_back((int)(j * width + i));
+		}
+
+		return;
+	}
+
+	if(columns >= rows)
+	{
+		unsigned int middle = firstColumn + columns / 2;
+
+		dissect(firstColumn, middle, firstRow, lastRow, order);
+		dissect(middle + 1, lastColumn, firstRow, lastRow, order);
+
+		for(unsigned int j = firstRow; j < lastRow; ++j)
+			order.push_back((int)(j * width + middle));
+	}
+	else
+	{
+		unsigned int middle = firstRow + rows / 2;
+
+		dissect(firstColumn, lastColumn, firstRow, middle, order);
+		dissect(firstColumn, lastColumn, middle + 1, lastRow, order);
+
+		for(unsigned int i = firstColumn; i < lastColumn; ++i)
+			order.push_back((int)(middle * width + i));
+	}
+}
+
+// Step
+void CPUProjectiveSolver::step(CPUParticles& particles, const CPUConstraintBatch* batches, const CPUVector3& acceleration,
+	float timeStep, int iterations, CPUThreadPool* threadPool)
+{
+	if(!prepared || timeStep != factorTimeStep || freeIndex.size() != particles.count)
+		return;
+
+	// Inertial target y = x + keep (x - x_old) + h^2 a, the previous positions become the old state
+	float keep = (float)verletKeep(timeStep);
+	float accelerationX = acceleration.x * timeStep * timeStep;
+	float accelerationY = acceleration.y * timeStep * timeStep;
+	float accelerationZ = acceleration.z * timeStep * timeStep;
+
+	threadPool->parallelFor(particles.count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			bool movable = freeIndex[i] >= 0;
+
+			targetX[i] = movable ? particles.x[i] + keep * (particles.x[i] - particles.oldX[i]) + accelerationX : particles.x[i];
+			targetY[i] = movable ? particles.y[i] + keep * (particles.y[i] - particles.oldY[i]) + accelerationY : particles.y[i];
+			targetZ[i] = movable ? particles.z[i] + keep * (particles.z[i] - particles.oldZ[i]) + accelerationZ : particles.z[i];
+
+			particles.oldX[i] = particles.x[i];
+			particles.oldY[i] = particles.y[i];
+			particles.oldZ[i] = particles.z[i];
+
+			particles.x[i] = targetX[i];
+			particles.y[i] = targetY[i];
+			particles.z[i] = targetZ[i];
+		}
+	});
+
+	lastAccepted = 0;
+
+	if(freeParticle.empty())
+		return;
+
+	// Start from the inertial target
+	gather(particles, current, threadPool);
+	lastEnergy = localStep(particles, batches, threadPool);
+	historyCount = historyNext = 0;
+	hasPrevious = false;
+
+	for(int iteration = 0; iteration < iterations; ++iteration)
+	{
+		globalStep(particles, batches, timeStep, threadPool);
+
+		bool accelerated = settings.andersonWindow > 0 && iteration > 0;
+
+		if(settings.andersonWindow > 0)
+			anderson(threadPool);
+		else
+			current = plain;
+
+		scatter(current, particles, threadPool);
+		double energy = localStep(particles, batches, threadPool);
+
+		// Anderson only extrapolates, keep the plain iterate when the mix would raise the energy
+		if(accelerated && energy > lastEnergy)
+		{
+			current = plain;
+			scatter(current, particles, threadPool);
+			energy = localStep(particles, batches, threadPool);
+		}
+		else if(accelerated)
+		{
+			++lastAccepted;
+		}
+
+		lastEnergy = energy;
+	}
+}
+
+// Local Step (project every spring onto its rest length, returns the energy of the current positions)
+double CPUProjectiveSolver::localStep(const CPUParticles& particles, const CPUConstraintBatch* batches, CPUThreadPool* threadPool)
+{
+	const float* x = particles.x;
+	const float* y = particles.y;
+	const float* z = particles.z;
+	double energy = 0.0;
+
+	for(int b = 0; b < 8; ++b)
+	{
+		const CPUConstraintBatch& batch = batches[b];
+		double weight = settings.stiffness[b < 4 ? 0 : 1];
+		int offset = batchStart[b];
+
+		energy += 0.5 * weight * blockSum(batch.count, [&](int first, int last)
+		{
+			double stretch = 0.0;
+
+			for(int c = first; c < last; ++c)
+			{
+				unsigned int a = batch.start[c];
+				unsigned int e = batch.end[c];
+
+				float dx = x[e] - x[a];
+				float dy = y[e] - y[a];
+				float dz = z[e] - z[a];
+				float length = sqrtf(dx * dx + dy * dy + dz * dz);
+
+				// A collapsed spring keeps its (zero) direction, the global step then pulls it apart
+				float scale = length > 0.0f ? batch.distance[c] / length : 0.0f;
+
+				projectionX[offset + c] = dx * scale;
+				projectionY[offset + c] = dy * scale;
+				projectionZ[offset + c] = dz * scale;
+
+				stretch += (double)(length - batch.distance[c]) * (length - batch.distance[c]);
+			}
+
+			return stretch;
+		}, partialSums, threadPool);
+	}
+
+	// Inertia
+	double inertia = blockSum((int)freeParticle.size(), [&](int first, int last)
+	{
+		double kinetic = 0.0;
+
+		for(int f = first; f < last; ++f)
+		{
+			unsigned int i = freeParticle[f];
+			double dx = x[i] - targetX[i];
+			double dy = y[i] - targetY[i];
+			double dz = z[i] - targetZ[i];
+
+			kinetic += freeMass[f] * (dx * dx + dy * dy + dz * dz);
+		}
+
+		return kinetic;
+	}, partialSums, threadPool);
+
+	return energy + 0.5 * inertia / ((double)factorTimeStep * factorTimeStep);
+}
+
+// Global Step (solve for the positions that best match the inertial target and the projections)
+void CPUProjectiveSolver::globalStep(const CPUParticles& particles, const CPUConstraintBatch* batches, float timeStep,
+	CPUThreadPool* threadPool)
+{
+	int freeCount = (int)freeParticle.size();
+	double inertia = 1.0 / ((double)timeStep * timeStep);
+
+	// The right hand side is built in the plain iterate and solved in place
+	double* plainX = &plain[0];
+	double* plainY = plainX + freeCount;
+	double* plainZ = plainY + freeCount;
+
+	threadPool->parallelFor(freeCount, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int f = first; f < last; ++f)
+		{
+			unsigned int i = freeParticle[f];
+
+			plainX[f] = freeMass[f] * inertia * targetX[i];
+			plainY[f] = freeMass[f] * inertia * targetY[i];
+			plainZ[f] = freeMass[f] * inertia * targetZ[i];
+		}
+	});
+
+	// Springs pull their ends towards the projected offset, pinned ends move to the right hand side.
+	// A colour at a time, so no two threads add into the same row.
+	for(int b = 0; b < 8; ++b)
+	{
+		const CPUConstraintBatch& batch = batches[b];
+		double weight = settings.stiffness[b < 4 ? 0 : 1];
+		int offset = batchStart[b];
+
+		threadPool->parallelFor(batch.count, CONSTRAINT_GRAIN, [&](int first, int last)
+		{
+			for(int c = first; c < last; ++c)
+			{
+				unsigned int a = batch.start[c];
+				unsigned int e = batch.end[c];
+				int freeA = freeIndex[a];
+				int freeE = freeIndex[e];
+
+				double px = weight * projectionX[offset + c];
+				double py = weight * projectionY[offset + c];
+				double pz = weight * projectionZ[offset + c];
+
+				if(freeA >= 0)
+				{
+					plainX[freeA] -= px - (freeE < 0 ? weight * particles.x[e] : 0.0);
+					plainY[freeA] -= py - (freeE < 0 ? weight * particles.y[e] : 0.0);
+					plainZ[freeA] -= pz - (freeE < 0 ? weight * particles.z[e] : 0.0);
+				}
+
+				if(freeE >= 0)
+				{
+					plainX[freeE] += px + (freeA < 0 ? weight * particles.x[a] : 0.0);
+					plainY[freeE] += py + (freeA < 0 ? weight * particles.y[a] : 0.0);
+					plainZ[freeE] += pz + (freeA < 0 ? weight * particles.z[a] : 0.0);
+				}
+			}
+		});
+	}
+
+	// The three axes share the factor and are solved side by side
+	threadPool->parallelFor(3, 1, [&](int first, int last)
+	{
+		for(int axis = first; axis < last; ++axis)
+			factor.solve(&plain[axis * freeCount], &work[axis * freeCount]);
+	});
+}
+
+// Anderson (type II): the next iterate is the plain result minus the combination of recent
+// changes in it that best cancels the fixed point residual (least squares over the window)
+void CPUProjectiveSolver::anderson(CPUThreadPool* threadPool)
+{
+	int length = (int)plain.size();
+	int window = settings.andersonWindow;
+
+	for(int k = 0; k < length; ++k)
+		residual[k] = plain[k] - current[k];
+
+	if(hasPrevious)
+	{
+		double* deltaPlain = &historyPlain[(size_t)historyNext * length];
+		double* deltaResidual = &historyResidual[(size_t)historyNext * length];
+
+		for(int k = 0; k < length; ++k)
+		{
+			deltaPlain[k] = plain[k] - previousPlain[k];
+			deltaResidual[k] = residual[k] - previousResidual[k];
+		}
+
+		historyNext = (historyNext + 1) % window;
+		historyCount = min(historyCount + 1, window);
+	}
+
+	previousPlain = plain;
+	previousResidual = residual;
+	hasPrevious = true;
+
+	if(!historyCount)
+	{
+		current = plain;
+		return;
+	}
+
+	// Normal equations (dF^T dF) theta = dF^T f, at most window x window
+	int count = historyCount;
+	vector<double> gram(count * count), solution(count);
+
+	for(int i = 0; i < count; ++i)
+	{
+		const double* deltaI = &historyResidual[(size_t)i * length];
+
+		for(int j = i; j < count; ++j)
+		{
+			const double* deltaJ = &historyResidual[(size_t)j * length];
+
+			gram[i * count + j] = gram[j * count + i] = blockSum(length, [&](int first, int last)
+			{
+				double partial = 0.0;
+
+				for(int k = first; k < last; ++k)
+					partial += deltaI[k] * deltaJ[k];
+
+				return partial;
+			}, partialSums, threadPool);
+		}
+
+		solution[i] = blockSum(length, [&](int first, int last)
+		{
+			double partial = 0.0;
+
+			for(int k = first; k < last; ++k)
+				partial += deltaI[k] * residual[k];
+
+			return partial;
+		}, partialSums, threadPool);
+	}
+
+	// Tikhonov regularisation keeps nearly parallel history vectors from blowing up theta
+	double trace = 0.0;
+
+	for(int i = 0; i < count; ++i)
+		trace += gram[i * count + i];
+
+	for(int i = 0; i < count; ++i)
+		gram[i * count + i] += 1e-10 * trace + 1e-300;
+
+	// Gaussian elimination with partial pivoting
+	for(int c = 0; c < count; ++c)
+	{
+		int pivot = c;
+
+		for(int r = c + 1; r < count; ++r)
+		{
+			if(fabs(gram[r * count + c]) > fabs(gram[pivot * count + c]))
+				pivot = r;
+		}
+
+		if(pivot != c)
+		{
+			for(int k = 0; k < count; ++k)
+				swap(gram[c * count + k], gram[pivot * count + k]);
+
+			swap(solution[c], solution[pivot]);
+		}
+
+		for(int r = c + 1; r < count; ++r)
+		{
+			double factor = gram[r * count + c] / gram[c * count + c];
+
+			for(int k = c; k < count; ++k)
+				gram[r * count + k] -= factor * gram[c * count + k];
+
+			solution[r] -= factor * solution[c];
+		}
+	}
+
+	for(int c = count - 1; c >= 0; --c)
+	{
+		for(int k = c + 1; k < count; ++k)
+			solution[c] -= gram[c * count + k] * solution[k];
+
+		solution[c] /= gram[c * count + c];
+	}
+
+	threadPool->parallelFor(length, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int k = first; k < last; ++k)
+		{
+			double mixed = plain[k];
+
+			for(int i = 0; i < count; ++i)
+				mixed -= solution[i] * historyPlain[(size_t)i * length + k];
+
+			current[k] = mixed;
+		}
+	});
+}
+
+// Scatter (state vector into the free particles)
+void CPUProjectiveSolver::scatter(const vector<double>& state, CPUParticles& particles, CPUThreadPool* threadPool) const
+{
+	int freeCount = (int)freeParticle.size();
+
+	threadPool->parallelFor(freeCount, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int f = first; f < last; ++f)
+		{
+			unsigned int i = freeParticle[f];
+
+			particles.x[i] = (float)state[f];
+			particles.y[i] = (float)state[freeCount + f];
+			particles.z[i] = (float)state[freeCount * 2 + f];
+		}
+	});
+}
+
+// Gather (free particles into a state vector)
+void CPUProjectiveSolver::gather(const CPUParticles& particles, vector<double>& state, CPUThreadPool* threadPool) const
+{
+	int freeCount = (int)freeParticle.size();
+
+	threadPool->parallelFor(freeCount, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int f = first; f < last; ++f)
+		{
+			unsigned int i = freeParticle[f];
+
+			state[f] = particles.x[i];
+			state[freeCount + f] = particles.y[i];
+			state[freeCount * 2 + f] = particles.z[i];
+		}
+	});
+}
+
+// Set Settings
+void CPUProjectiveSolver::setSettings(const CPUProjectiveSettings& newSettings)
+{
+	settings = newSettings;
+	settings.clamp();
+	settings.andersonWindow = max(settings.andersonWindow, 0);
+
+	// The factor (and the history buffers) depend on the settings
+	prepared = false;
+}
@@ -0,0 +1,132 @@
+// ------------------------------------------------
+// Class:	CPU Projective Solver Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUPROJECTIVESOLVER
+#define CPUPROJECTIVESOLVER
+
+// INCLUDES
+#include "CPUParticles.h"
+#include "CPUConstraintKernel.h"
+#include "CPUThreadPool.h"
+#include "CPUSparseLDL.h"
+#include "CPUSolverCommon.h"
+
+// Standard includes
+#include <string>
+#include <vector>
+
+// Settings of the projective dynamics solver
+struct CPUProjectiveSettings : CPUSpringSettings
+{
+	int andersonWindow;	// Previous iterates mixed by Anderson acceleration (0 = off)
+};
+
+// Projective Dynamics (Bouaziz et al.) for the cloth springs.
+// Each iteration projects every spring onto its rest length in parallel (local step), then
+// solves one linear system for the positions (global step). The system matrix
+//		M / h^2 + sum(w S^T A^T A S)
+// only depends on the lattice, the masses, the weights and the time step, so it is factored
+// once (sparse LDL^T in nested dissection order) and every global step is two triangular
+// solves per axis. Pinned particles are left out of the system, which is why the factor is
+// keyed by the anchor set.
+//
+// The local / global iteration converges linearly, Anderson acceleration (Peng et al.) mixes
+// the last few iterates and falls back to the plain iterate whenever the energy would rise.
+class CPUProjectiveSolver
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable
+	CPUProjectiveSolver(const CPUProjectiveSolver&);
+	CPUProjectiveSolver& operator=(const CPUProjectiveSolver&);
+
+	// Attributes
+	CPUProjectiveSettings settings;
+	unsigned int width, height;
+	std::string cacheDirectory;
+
+	// Factored system over the free particles
+	CPUSparseLDL factor;
+	bool prepared;
+	uint64_t factorKey;
+	float factorTimeStep;
+	std::vector<int> freeIndex;		// Per particle, -1 when pinned
+	std::vector<unsigned int> freeParticle;	// Per free index
+	std::vector<double> freeMass;		// Per free index
+	int batchStart[8];
+
+	// Iteration state: inertial target, projections (per constraint) and the triangular solve scratch
+	std::vector<float> targetX, targetY, targetZ;
+	std::vector<float> projectionX, projectionY, projectionZ;
+	std::vector<double> work;
+
+	// Anderson acceleration: current iterate, plain (unaccelerated) result and the history of
+	// differences in iterates and residuals (ring buffers of andersonWindow vectors)
+	std::vector<double> current, plain, previousPlain, previousResidual, residual;
+	std::vector<double> historyPlain, historyResidual;
+	int historyCount, historyNext;
+	bool hasPrevious;
+
+	// Block sums of the reductions (blockSum scratch)
+	std::vector<double> partialSums;
+
+	// Statistics
+	double factorTime;
+	bool factorLoaded;
+	int lastAccepted;
+	double lastEnergy;
+
+	// Methods
+	uint64_t computeKey(const CPUParticles& particles, float timeStep) const;
+	bool buildFactor(const CPUConstraintBatch* batches, float timeStep);
+	void buildOrder(std::vector<int>& order) const;
+	void dissect(unsigned int firstColumn, unsigned int lastColumn, unsigned int firstRow, unsigned int lastRow,
+		std::vector<int>& order) const;
+
+	double localStep(const CPUParticles& particles, const CPUConstraintBatch* batches, CPUThreadPool* threadPool);
+	void globalStep(const CPUParticles& particles, const CPUConstraintBatch* batches, float timeStep, CPUThreadPool* threadPool);
+	void anderson(CPUThreadPool* threadPool);
+
+	void scatter(const std::vector<double>& state, CPUParticles& particles, CPUThreadPool* threadPool) const;
+	void gather(const CPUParticles& particles, std::vector<double>& state, CPUThreadPool* threadPool) const;
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor
+	CPUProjectiveSolver();
+
+	// Factor the system for the current masses and time step (loaded from the cache when a
+	// matching file exists), returns false if it could not be built
+	bool prepare(unsigned int clothWidth, unsigned int clothHeight, const CPUParticles& particles,
+		const CPUConstraintBatch* batches, float timeStep);
+
+	// One implicit step of timeStep seconds under a uniform acceleration, iterations local /
+	// global rounds (prepare must have succeeded for this time step)
+	void step(CPUParticles& particles, const CPUConstraintBatch* batches, const CPUVector3& acceleration,
+		float timeStep, int iterations, CPUThreadPool* threadPool);
+
+	// Drop the factor, the next prepare builds (or loads) it again
+	void invalidate() { prepared = false; }
+
+	// Settings
+	const CPUProjectiveSettings& getSettings() const { return settings; }
+	void setSettings(const CPUProjectiveSettings& newSettings);
+
+	// Directory for cached factors ("" = no cache)
+	void setCacheDirectory(const std::string& directory) { cacheDirectory = directory; }
+	const std::string& getCacheDirectory() const { return cacheDirectory; }
+
+	// Statistics
+	bool isPrepared() const { return prepared; }
+	double getFactorTime() const { return factorTime; }	// Seconds spent in the last prepare
+	bool isFactorLoaded() const { return factorLoaded; }	// Last prepare read the cache
+	size_t getFactorNonZeros() const { return factor.getNonZeros(); }
+	int getLastAccepted() const { return lastAccepted; }	// Anderson iterates accepted in the last step
+	double getLastEnergy() const { return lastEnergy; }
+};
+
+#endif
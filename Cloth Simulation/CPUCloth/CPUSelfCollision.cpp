@@ -0,0 +1,496 @@
+// ------------------------------------------------
+// Class:	CPU Self Collision Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUSelfCollision.h"
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+// Namespaces
+using namespace std;
+
+// Smallest share of particles / buckets handed to a thread
+#define PARTICLE_GRAIN 1024
+#define BUCKET_GRAIN 4096
+
+// Buckets per block of the count scan (fixed, so the scan never depends on the thread count)
+#define SCAN_BLOCK 16384
+
+// Fewest buckets in the table
+#define MIN_BUCKETS 1024
+
+// Cell of a coordinate (floorf is a library call without SSE 4.1)
+static inline int cellOf(float coordinate)
+{
+	int cell = (int)coordinate;
+
+	return cell - (coordinate < (float)cell ? 1 : 0);
+}
+
+// Constructor
+CPUSelfCollision::CPUSelfCollision()
+{
+	latticeWidth = 1;
+	spacing = 1.0f;
+	thickness = 1.0f;
+	exclusion = 2;
+	bucketMask = 0;
+	bucketCounters = nullptr;
+	hashRadius = 1.0f;
+	contacts = 0;
+	buildTime = queryTime = solveTime = 0.0;
+	passes = builds = 0;
+}
+
+// Destructor
+CPUSelfCollision::~CPUSelfCollision()
+{
+	delete[] bucketCounters;
+}
+
+// Settings
+void CPUSelfCollision::setLattice(unsigned int width, float restSpacing)
+{
+	latticeWidth = max(width, 1u);
+	spacing = restSpacing > 0.0f ? restSpacing : 1.0f;
+}
+
+void CPUSelfCollision::setThickness(float newThickness)
+{
+	thickness = min(max(newThickness, 0.1f), 2.0f);
+}
+
+void CPUSelfCollision::setExclusion(int steps)
+{
+	exclusion = max(steps, 1);
+}
+
+// Bucket Of (the three large primes of Teschner et al., Optimized Spatial Hashing for Collision
+// Detection of Deformable Objects, 2003)
+unsigned int CPUSelfCollision::bucketOf(int cellX, int cellY, int cellZ) const
+{
+	unsigned int hash = ((unsigned int)cellX * 73856093u) ^ ((unsigned int)cellY * 19349663u) ^ ((unsigned int)cellZ * 83492791u);
+
+	return hash & bucketMask;
+}
+
+// Particle At (a particle's data as the query reads it)
+CPUSelfParticle CPUSelfCollision::particleAt(const CPUParticles& particles, const unsigned int* lattice, int index) const
+{
+	unsigned int latticeIndex = lattice ? lattice[index] : (unsigned int)index;
+
+	CPUSelfParticle particle;
+	particle.x = particles.x[index];
+	particle.y = particles.y[index];
+	particle.z = particles.z[index];
+	particle.invMass = particles.invMass[index];
+	particle.row = (int)(latticeIndex / latticeWidth);
+	particle.column = (int)(latticeIndex % latticeWidth);
+
+	return particle;
+}
+
+// Visit Near (every sorted particle within the hash radius of a particle that is not its lattice
+// neighbour, in bucket order: the 2 x 2 x 2 cells the box around the particle spans)
+template<typename Visit>
+void CPUSelfCollision::visitNear(const CPUSelfParticle& particle, Visit visit) const
+{
+	float radius = hashRadius;
+	float cellScale = 0.5f / radius;
+
+	int cellX = cellOf((particle.x - radius) * cellScale);
+	int cellY = cellOf((particle.y - radius) * cellScale);
+	int cellZ = cellOf((particle.z - radius) * cellScale);
+
+	// Neighbouring cells may share a bucket, each bucket is visited once
+	unsigned int visited[8];
+	int visitedCount = 0;
+
+	for(int c = 0; c < 8; ++c)
+	{
+		unsigned int bucket = bucketOf(cellX + (c & 1), cellY + (c >> 1 & 1), cellZ + (c >> 2));
+
+		if(find(visited, visited + visitedCount, bucket) != visited + visitedCount)
+			continue;
+
+		visited[visitedCount++] = bucket;
+
+		for(int t = bucketStart[bucket]; t < bucketStart[bucket + 1]; ++t)
+		{
+			const CPUSelfParticle& other = sorted[t];
+
+			float diffX = particle.x - other.x;
+			float diffY = particle.y - other.y;
+			float diffZ = particle.z - other.z;
+			float lengthSquared = diffX * diffX + diffY * diffY + diffZ * diffZ;
+
+			// Coincident particles (the particle itself among them) have no direction to part in
+			if(lengthSquared >= radius * radius || lengthSquared <= 0.0f)
+				continue;
+
+			// Lattice neighbours are held apart by the springs
+			if(abs(other.row - particle.row) <= exclusion && abs(other.column - particle.column) <= exclusion)
+				continue;
+
+			visit(other, t);
+		}
+	}
+}
+
+// Collide
+void CPUSelfCollision::collide(CPUParticles& particles, const unsigned int* lattice, CPUThreadPool* threadPool)
+{
+	contacts = 0;
+
+	if(!particles.count)
+		return;
+
+	typedef chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	build(particles, lattice, getDistance(), threadPool);
+
+	Clock::time_point built = Clock::now();
+
+	query(particles, lattice, threadPool);
+
+	buildTime += chrono::duration<double>(built - start).count();
+	queryTime += chrono::duration<double>(Clock::now() - built).count();
+	++passes;
+}
+
+// Build Lists
+void CPUSelfCollision::buildLists(const CPUParticles& particles, const unsigned int* lattice, float skin, CPUThreadPool* threadPool)
+{
+	if(!particles.count)
+		return;
+
+	typedef chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	build(particles, lattice, getDistance() + max(skin, 0.0f), threadPool);
+
+	Clock::time_point built = Clock::now();
+
+	int count = (int)particles.count;
+
+	candidateStart.resize(count + 1);
+
+	// Every particle's candidates (the particles within the list radius it may collide with)
+	// are counted, the counts scanned, then the candidates written in the same order
+	threadPool->parallelFor(count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			CPUSelfParticle particle = particleAt(particles, lattice, i);
+			int candidateCount = 0;
+
+			visitNear(particle, [&](const CPUSelfParticle&, int)
+			{
+				++candidateCount;
+			});
+
+			candidateStart[i + 1] = candidateCount;
+		}
+	});
+
+	candidateStart[0] = 0;
+
+	for(int i = 0; i < count; ++i)
+		candidateStart[i + 1] += candidateStart[i];
+
+	candidates.resize(candidateStart[count]);
+
+	threadPool->parallelFor(count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			CPUSelfParticle particle = particleAt(particles, lattice, i);
+			unsigned int* candidate = candidates.empty() ? nullptr : &candidates[candidateStart[i]];
+
+			visitNear(particle, [&](const CPUSelfParticle&, int t)
+			{
+				*candidate++ = sortedSlot[t];
+			});
+		}
+	});
+
+	buildTime += chrono::duration<double>(built - start).count();
+	queryTime += chrono::duration<double>(Clock::now() - built).count();
+}
+
+// Solve Lists (the pushes of every particle's candidates at the current positions)
+void CPUSelfCollision::solveLists(CPUParticles& particles, CPUThreadPool* threadPool)
+{
+	contacts = 0;
+
+	if(!particles.count || (int)candidateStart.size() != (int)particles.count + 1)
+		return;
+
+	typedef chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	float distance = getDistance();
+
+	threadPool->parallelFor((int)particles.count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			float invMass = particles.invMass[i];
+			CPUVector3 push = { 0.0f, 0.0f, 0.0f };
+			int pushCount = 0;
+
+			for(int c = invMass > 0.0f ? candidateStart[i] : candidateStart[i + 1]; c < candidateStart[i + 1]; ++c)
+			{
+				unsigned int other = candidates[c];
+
+				float diffX = particles.x[i] - particles.x[other];
+				float diffY = particles.y[i] - particles.y[other];
+				float diffZ = particles.z[i] - particles.z[other];
+				float lengthSquared = diffX * diffX + diffY * diffY + diffZ * diffZ;
+
+				if(lengthSquared >= distance * distance || lengthSquared <= 0.0f)
+					continue;
+
+				float length = sqrtf(lengthSquared);
+				float scale = (distance - length) / length * invMass / (invMass + particles.invMass[other]);
+
+				push.x += diffX * scale;
+				push.y += diffY * scale;
+				push.z += diffZ * scale;
+				++pushCount;
+			}
+
+			storePush(i, push, pushCount);
+		}
+	});
+
+	applyPushes(particles, threadPool);
+
+	solveTime += chrono::duration<double>(Clock::now() - start).count();
+	++passes;
+}
+
+// Build (counting sort of the particles into the hash buckets, cells twice the radius wide)
+void CPUSelfCollision::build(const CPUParticles& particles, const unsigned int* lattice, float radius, CPUThreadPool* threadPool)
+{
+	int count = (int)particles.count;
+
+	hashRadius = radius;
+	++builds;
+
+	// Table of at least twice as many buckets as particles, most cells then have a bucket to themselves
+	unsigned int bucketCount = MIN_BUCKETS;
+
+	while(bucketCount < particles.count * 2)
+		bucketCount *= 2;
+
+	if(bucketCount != bucketMask + 1 || !bucketCounters)
+	{
+		delete[] bucketCounters;
+		bucketCounters = new atomic<int>[bucketCount];
+		bucketMask = bucketCount - 1;
+		bucketStart.resize(bucketCount + 1);
+		blockSums.resize((bucketCount + SCAN_BLOCK - 1) / SCAN_BLOCK);
+	}
+
+	if((int)sortedSlot.size() != count)
+	{
+		particleBucket.resize(count);
+		sortedSlot.resize(count);
+		sorted.resize(count);
+		candidateStart.clear();
+		deltaX.resize(count);
+		deltaY.resize(count);
+		deltaZ.resize(count);
+		contactCounts.resize(count);
+	}
+
+	float cellScale = 0.5f / radius;
+	int blockCount = (int)blockSums.size();
+
+	// Count the particles of every bucket
+	threadPool->parallelFor((int)bucketCount, BUCKET_GRAIN, [&](int first, int last)
+	{
+		for(int b = first; b < last; ++b)
+			bucketCounters[b].store(0, memory_order_relaxed);
+	});
+
+	threadPool->parallelFor(count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			unsigned int bucket = bucketOf(cellOf(particles.x[i] * cellScale), cellOf(particles.y[i] * cellScale), cellOf(particles.z[i] * cellScale));
+
+			particleBucket[i] = bucket;
+			bucketCounters[bucket].fetch_add(1, memory_order_relaxed);
+		}
+	});
+
+	// Exclusive scan of the counts: block totals, their scan, then each block from its offset
+	// (the counters become the scatter cursors)
+	threadPool->parallelFor(blockCount, 1, [&](int first, int last)
+	{
+		for(int k = first; k < last; ++k)
+		{
+			int blockEnd = min((k + 1) * SCAN_BLOCK, (int)bucketCount);
+			int sum = 0;
+
+			for(int b = k * SCAN_BLOCK; b < blockEnd; ++b)
+				sum += bucketCounters[b].load(memory_order_relaxed);
+
+			blockSums[k] = sum;
+		}
+	});
+
+	int offset = 0;
+
+	for(int k = 0; k < blockCount; ++k)
+	{
+		int sum = blockSums[k];
+		blockSums[k] = offset;
+		offset += sum;
+	}
+
+	threadPool->parallelFor(blockCount, 1, [&](int first, int last)
+	{
+		for(int k = first; k < last; ++k)
+		{
+			int blockEnd = min((k + 1) * SCAN_BLOCK, (int)bucketCount);
+			int running = blockSums[k];
+
+			for(int b = k * SCAN_BLOCK; b < blockEnd; ++b)
+			{
+				int bucketSize = bucketCounters[b].load(memory_order_relaxed);
+
+				bucketStart[b] = running;
+				bucketCounters[b].store(running, memory_order_relaxed);
+				running += bucketSize;
+			}
+		}
+	});
+
+	bucketStart[bucketCount] = count;
+
+	// Scatter the particles into their bucket ranges
+	threadPool->parallelFor(count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+			sortedSlot[bucketCounters[particleBucket[i]].fetch_add(1, memory_order_relaxed)] = (unsigned int)i;
+	});
+
+	// Sort each bucket by slot (they hold a few particles, the scatter left them in any order)
+	// and gather the particles' data in bucket order
+	threadPool->parallelFor((int)bucketCount, BUCKET_GRAIN, [&](int first, int last)
+	{
+		for(int b = first; b < last; ++b)
+		{
+			int bucketEnd = bucketStart[b + 1];
+
+			for(int s = bucketStart[b] + 1; s < bucketEnd; ++s)
+			{
+				unsigned int slot = sortedSlot[s];
+				int t = s;
+
+				for(; t > bucketStart[b] && sortedSlot[t - 1] > slot; --t)
+					sortedSlot[t] = sortedSlot[t - 1];
+
+				sortedSlot[t] = slot;
+			}
+
+			for(int s = bucketStart[b]; s < bucketEnd; ++s)
+			{
+				unsigned int slot = sortedSlot[s];
+				unsigned int latticeIndex = lattice ? lattice[slot] : slot;
+
+				sorted[s].x = particles.x[slot];
+				sorted[s].y = particles.y[slot];
+				sorted[s].z = particles.z[slot];
+				sorted[s].invMass = particles.invMass[slot];
+				sorted[s].row = (int)(latticeIndex / latticeWidth);
+				sorted[s].column = (int)(latticeIndex % latticeWidth);
+			}
+		}
+	});
+}
+
+// Query (every movable particle gathers its pushes from the particles within the contact distance, then all move)
+void CPUSelfCollision::query(CPUParticles& particles, const unsigned int* lattice, CPUThreadPool* threadPool)
+{
+	float distance = getDistance();
+
+	threadPool->parallelFor((int)particles.count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			CPUVector3 push = { 0.0f, 0.0f, 0.0f };
+			int pushCount = 0;
+
+			if(particles.invMass[i] > 0.0f)
+			{
+				CPUSelfParticle particle = particleAt(particles, lattice, i);
+
+				visitNear(particle, [&](const CPUSelfParticle& other, int)
+				{
+					float diffX = particle.x - other.x;
+					float diffY = particle.y - other.y;
+					float diffZ = particle.z - other.z;
+					float length = sqrtf(diffX * diffX + diffY * diffY + diffZ * diffZ);
+					float scale = (distance - length) / length * particle.invMass / (particle.invMass + other.invMass);
+
+					push.x += diffX * scale;
+					push.y += diffY * scale;
+					push.z += diffZ * scale;
+					++pushCount;
+				});
+			}
+
+			storePush(i, push, pushCount);
+		}
+	});
+
+	applyPushes(particles, threadPool);
+}
+
+// Store Push (the average of a particle's pushes)
+void CPUSelfCollision::storePush(int index, const CPUVector3& push, int pushCount)
+{
+	float average = pushCount ? 1.0f / (float)pushCount : 0.0f;
+
+	deltaX[index] = push.x * average;
+	deltaY[index] = push.y * average;
+	deltaZ[index] = push.z * average;
+	contactCounts[index] = pushCount;
+}
+
+// Apply Pushes (every particle moves by its stored push)
+void CPUSelfCollision::applyPushes(CPUParticles& particles, CPUThreadPool* threadPool)
+{
+	atomic<int> pushed(0);
+
+	threadPool->parallelFor((int)particles.count, PARTICLE_GRAIN, [&](int first, int last)
+	{
+		int chunkPushed = 0;
+
+		for(int i = first; i < last; ++i)
+		{
+			if(!contactCounts[i])
+				continue;
+
+			particles.x[i] += deltaX[i];
+			particles.y[i] += deltaY[i];
+			particles.z[i] += deltaZ[i];
+			++chunkPushed;
+		}
+
+		pushed.fetch_add(chunkPushed, memory_order_relaxed);
+	});
+
+	contacts = pushed.load();
+}
@@ -0,0 +1,135 @@
+// ------------------------------------------------
+// Class:	CPU Self Collision Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUSELFCOLLISION
+#define CPUSELFCOLLISION
+
+// INCLUDES
+#include "CPUParticles.h"
+#include "CPUThreadPool.h"
+
+// Standard includes
+#include <atomic>
+#include <vector>
+
+// Particle as the self collision query reads it (a bucket's particles share cache lines)
+struct CPUSelfParticle
+{
+	float x, y, z;
+	float invMass;
+	int row, column;	// Lattice position
+};
+
+// Particle against particle contacts of the cloth with itself.
+// Every pass rebuilds a uniform spatial hash of the particles (cells two contact distances
+// wide, so every contact of a particle lies in the 2 x 2 x 2 cells nearest to it) with a
+// parallel counting sort: the particles are counted into the hash buckets, the counts are
+// scanned in blocks and the particles scattered into the bucket ranges, each bucket then
+// sorted by storage slot so the order never depends on the thread count.
+// The query finds the pairs closer than the contact distance that are not near each other on
+// the lattice (their springs already hold them apart), and every particle moves by the
+// average of its pushes (its share by inverse mass), gathered in a Jacobi pass so the
+// particles run in parallel. It walks the particles in storage order, so consecutive
+// particles (neighbours on the cloth) look up the same buckets while they are in cache.
+//
+// Detection can also be paid once for several passes (Verlet lists): buildLists keeps, for
+// every particle, the particles within the contact distance plus a skin, and solveLists only
+// resolves those at the current positions. The lists stay complete while no two particles
+// have closed in by more than the skin since they were built.
+class CPUSelfCollision
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable (owns its bucket counters)
+	CPUSelfCollision(const CPUSelfCollision&);
+	CPUSelfCollision& operator=(const CPUSelfCollision&);
+
+	// Lattice (row * width + column) and settings
+	unsigned int latticeWidth;
+	float spacing;				// Rest distance of the lattice (m)
+	float thickness;			// Contact distance over the spacing
+	int exclusion;				// Lattice steps (along rows and columns) within which pairs never collide
+
+	// Hash: buckets (a power of two, at least twice the particles), the counters the build
+	// counts and scatters through, the start of each bucket in the sorted arrays (plus the end),
+	// and the radius its cells were sized for (two radii wide)
+	unsigned int bucketMask;
+	std::atomic<int>* bucketCounters;
+	std::vector<int> bucketStart;
+	std::vector<int> blockSums;
+	float hashRadius;
+
+	// Bucket of every particle (storage order), and the particles in bucket order with their
+	// storage slots (sorted once per pass, the buckets the query visits are each one range)
+	std::vector<unsigned int> particleBucket;
+	std::vector<unsigned int> sortedSlot;
+	std::vector<CPUSelfParticle> sorted;
+
+	// Candidate lists: particle i's are candidates[candidateStart[i], candidateStart[i + 1]) (slots)
+	std::vector<int> candidateStart;
+	std::vector<unsigned int> candidates;
+
+	// Push gathered for each particle (storage order)
+	std::vector<float> deltaX, deltaY, deltaZ;
+	std::vector<int> contactCounts;
+
+	// Statistics of the last pass, and the seconds spent and passes / hash builds run since the last reset
+	int contacts;
+	double buildTime, queryTime, solveTime;
+	long long passes, builds;
+
+	// Bucket of a cell, a particle's data as the query reads it, and the sorted particles
+	// within the hash radius of a particle (visit(other, sorted index), in bucket order)
+	unsigned int bucketOf(int cellX, int cellY, int cellZ) const;
+	CPUSelfParticle particleAt(const CPUParticles& particles, const unsigned int* lattice, int index) const;
+	template<typename Visit> void visitNear(const CPUSelfParticle& particle, Visit visit) const;
+
+	// Passes: hash build (counting sort) for a radius, query, and the pushes
+	void build(const CPUParticles& particles, const unsigned int* lattice, float radius, CPUThreadPool* threadPool);
+	void query(CPUParticles& particles, const unsigned int* lattice, CPUThreadPool* threadPool);
+	void storePush(int index, const CPUVector3& push, int pushCount);
+	void applyPushes(CPUParticles& particles, CPUThreadPool* threadPool);
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor & Destructor
+	CPUSelfCollision();
+	~CPUSelfCollision();
+
+	// Lattice the particles are built on (row length and the rest distance between neighbours)
+	void setLattice(unsigned int width, float restSpacing);
+
+	// Contact distance as a fraction of the rest spacing (clamped to [0.1, 2]), and the lattice
+	// steps (>= 1) within which particles are never tested (with 1 that is the eight neighbours)
+	void setThickness(float newThickness);
+	void setExclusion(int steps);
+
+	// One pass over the particles (storage order). lattice maps storage slots to lattice
+	// indices (nullptr while the storage is row major). Pinned particles do not move.
+	void collide(CPUParticles& particles, const unsigned int* lattice, CPUThreadPool* threadPool);
+
+	// Verlet lists: detect the candidates within the contact distance plus skin (the hash build
+	// and the query), then any number of passes that only resolve them
+	void buildLists(const CPUParticles& particles, const unsigned int* lattice, float skin, CPUThreadPool* threadPool);
+	void solveLists(CPUParticles& particles, CPUThreadPool* threadPool);
+
+	// Accessors
+	float getThickness() const { return thickness; }
+	float getDistance() const { return thickness * spacing; }
+	int getExclusion() const { return exclusion; }
+	int getBucketCount() const { return (int)bucketMask + 1; }
+	int getContacts() const { return contacts; } // Particles pushed by the last pass
+	int getCandidateCount() const { return (int)candidates.size(); } // In the last lists built
+	double getBuildTime() const { return buildTime; } // Seconds in the hash build since the last reset
+	double getQueryTime() const { return queryTime; } // in the query (direct, or building the lists)
+	double getSolveTime() const { return solveTime; } // and in the passes over the lists
+	long long getPasses() const { return passes; } // Contact passes (direct or over the lists)
+	long long getBuilds() const { return builds; } // Hash builds
+	void resetTimes() { buildTime = queryTime = solveTime = 0.0; passes = builds = 0; }
+};
+
+#endif
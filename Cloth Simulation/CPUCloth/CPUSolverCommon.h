@@ -0,0 +1,71 @@
+// ------------------------------------------------
+// Header:	CPU Solver Common Helpers
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUSOLVERCOMMON
+#define CPUSOLVERCOMMON
+
+// INCLUDES
+#include "CPUThreadPool.h"
+
+// Standard includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The Verlet pass (cloth_apply_forces.hlsl) keeps 0.997 of the velocity every 1.7 ms step,
+// every solver applies the same decay per second whatever its time step
+#define VERLET_DAMPING 0.997
+#define VERLET_TIME_STEP 0.0017
+
+// Elements per reduction block (fixed, so the sums never depend on the thread count)
+#define REDUCTION_BLOCK 4096
+
+// Share of the velocity kept over one step of timeStep seconds
+inline double verletKeep(float timeStep)
+{
+	return pow(VERLET_DAMPING, (double)timeStep / VERLET_TIME_STEP);
+}
+
+// Spring material shared by the implicit, projective and block descent solvers
+struct CPUSpringSettings
+{
+	float stiffness[2];	// Spring stiffness (N/m, resolution independent) of the structural and shear springs
+	float mass;			// Cloth mass (kg), shared out over the particles and scaled by 1 / invMass
+
+	// Clamp to usable values (no negative stiffness, a small positive mass)
+	void clamp()
+	{
+		stiffness[0] = std::max(stiffness[0], 0.0f);
+		stiffness[1] = std::max(stiffness[1], 0.0f);
+		mass = std::max(mass, 1e-6f);
+	}
+};
+
+// Sum of partial(first, last) over [0, count) in fixed blocks of REDUCTION_BLOCK elements. The
+// blocks run in parallel and are added in order, so the result is the same for any thread
+// count. partialSums is scratch kept by the caller between calls.
+template<typename Partial>
+double blockSum(int count, const Partial& partial, std::vector<double>& partialSums, CPUThreadPool* threadPool)
+{
+	int blockCount = (count + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+
+	if(partialSums.size() < (size_t)blockCount)
+		partialSums.resize(blockCount);
+
+	threadPool->parallelFor(blockCount, 1, [&](int first, int last)
+	{
+		for(int b = first; b < last; ++b)
+			partialSums[b] = partial(b * REDUCTION_BLOCK, std::min(count, (b + 1) * REDUCTION_BLOCK));
+	});
+
+	double total = 0.0;
+
+	for(int b = 0; b < blockCount; ++b)
+		total += partialSums[b];
+
+	return total;
+}
+
+#endif
@@ -0,0 +1,290 @@
+// ------------------------------------------------
+// Class:	CPU Sparse LDL Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUSparseLDL.h"
+
+// Standard includes
+#include <cstdio>
+
+// Namespaces
+using namespace std;
+
+// Cache file tag and layout version
+#define LDL_MAGIC 0x314C444C53555043ull // "CPUSLDL1"
+#define LDL_VERSION 1
+
+// Cache file header
+struct CPUSparseLDLHeader
+{
+	uint64_t magic;
+	uint64_t key;
+	int32_t version;
+	int32_t size;
+	uint64_t nonZeros;
+};
+
+// Constructor
+CPUSparseLDL::CPUSparseLDL()
+{
+	size = 0;
+}
+
+// Factor
+bool CPUSparseLDL::factor(int n, const vector<int>& matrixColumnStart, const vector<int>& matrixRow,
+	const vector<double>& matrixValue, const vector<int>& order)
+{
+	release();
+
+	size = n;
+	permutation = order;
+	inverse.assign(n, 0);
+
+	for(int k = 0; k < n; ++k)
+		inverse[permutation[k]] = k;
+
+	// Symbolic: elimination tree and the entry count of every column of L
+	vector<int> parent(n), count(n), flag(n);
+
+	for(int k = 0; k < n; ++k)
+	{
+		parent[k] = -1;
+		flag[k] = k;
+		count[k] = 0;
+
+		int column = permutation[k];
+
+		for(int p = matrixColumnStart[column]; p < matrixColumnStart[column + 1]; ++p)
+		{
+			// Walk up the tree from every earlier row in this column until a visited node
+			for(int i = inverse[matrixRow[p]]; i < k && flag[i] != k; i = parent[i])
+			{
+				if(parent[i] == -1)
+					parent[i] = k;
+
+				++count[i];
+				flag[i] = k;
+			}
+		}
+	}
+
+	columnStart.assign(n + 1, 0);
+
+	for(int k = 0; k < n; ++k)
+		columnStart[k + 1] = columnStart[k] + count[k];
+
+	row.assign(columnStart[n], 0);
+	value.assign(columnStart[n], 0.0);
+	diagonal.assign(n, 0.0);
+
+	// Numeric: row k of L is found from the pattern of column k of A (a sparse triangular solve)
+	vector<double> y(n, 0.0);
+	vector<int> pattern(n);
+
+	for(int k = 0; k < n; ++k)
+	{
+		int top = n;
+		int column = permutation[k];
+
+		flag[k] = k;
+		count[k] = 0;
+
+		for(int p = matrixColumnStart[column]; p < matrixColumnStart[column + 1]; ++p)
+		{
+			int i = inverse[matrixRow[p]];
+
+			if(i > k)
+				continue;
+
+			y[i] += matrixValue[p];
+
+			int length = 0;
+
+			for(; flag[i] != k; i = parent[i])
+			{
+				pattern[length++] = i;
+				flag[i] = k;
+			}
+
+			while(length > 0)
+				pattern[--top] = pattern[--length];
+		}
+
+		diagonal[k] = y[k];
+		y[k] = 0.0;
+
+		for(; top < n; ++top)
+		{
+			int i = pattern[top];
+			double yi = y[i];
+			y[i] = 0.0;
+
+			int end = columnStart[i] + count[i];
+
+			for(int p = columnStart[i]; p < end; ++p)
+				y[row[p]] -= value[p] * yi;
+
+			double l = yi / diagonal[i];
+			diagonal[k] -= l * yi;
+
+			row[end] = k;
+			value[end] = l;
+			++count[i];
+		}
+
+		if(diagonal[k] == 0.0)
+		{
+			release();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Solve
+void CPUSparseLDL::solve(double* values, double* work) const
+{
+	for(int k = 0; k < size; ++k)
+		work[k] = values[permutation[k]];
+
+	// L y = b
+	for(int j = 0; j < size; ++j)
+	{
+		double wj = work[j];
+
+		for(int p = columnStart[j]; p < columnStart[j + 1]; ++p)
+			work[row[p]] -= value[p] * wj;
+	}
+
+	// D z = y
+	for(int j = 0; j < size; ++j)
+		work[j] /= diagonal[j];
+
+	// L^T x = z
+	for(int j = size - 1; j >= 0; --j)
+	{
+		double sum = work[j];
+
+		for(int p = columnStart[j]; p < columnStart[j + 1]; ++p)
+			sum -= value[p] * work[row[p]];
+
+		work[j] = sum;
+	}
+
+	for(int k = 0; k < size; ++k)
+		values[permutation[k]] = work[k];
+}
+
+// Save
+bool CPUSparseLDL::save(const char* path, uint64_t key) const
+{
+	FILE* file = fopen(path, "wb");
+
+	if(!file)
+		return false;
+
+	CPUSparseLDLHeader header;
+	header.magic = LDL_MAGIC;
+	header.key = key;
+	header.version = LDL_VERSION;
+	header.size = size;
+	header.nonZeros = row.size();
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(&permutation[0], sizeof(int), size, file) == (size_t)size
+		&& fwrite(&columnStart[0], sizeof(int), size + 1, file) == (size_t)size + 1
+		&& (row.empty() || fwrite(&row[0], sizeof(int), row.size(), file) == row.size())
+		&& (value.empty() || fwrite(&value[0], sizeof(double), value.size(), file) == value.size())
+		&& fwrite(&diagonal[0], sizeof(double), size, file) == (size_t)size;
+
+	written = (fclose(file) == 0) && written;
+
+	// Never leave a partial file behind for the next run to trip over
+	if(!written)
+		remove(path);
+
+	return written;
+}
+
+// Load
+bool CPUSparseLDL::load(const char* path, uint64_t key)
+{
+	release();
+
+	FILE* file = fopen(path, "rb");
+
+	if(!file)
+		return false;
+
+	CPUSparseLDLHeader header;
+	bool loaded = fread(&header, sizeof(header), 1, file) == 1 && header.magic == LDL_MAGIC
+		&& header.key == key && header.version == LDL_VERSION && header.size > 0;
+
+	if(loaded)
+	{
+		size = header.size;
+		permutation.resize(size);
+		columnStart.resize(size + 1);
+		row.resize(header.nonZeros);
+		value.resize(header.nonZeros);
+		diagonal.resize(size);
+
+		loaded = fread(&permutation[0], sizeof(int), size, file) == (size_t)size
+			&& fread(&columnStart[0], sizeof(int), size + 1, file) == (size_t)size + 1
+			&& (row.empty() || fread(&row[0], sizeof(int), row.size(), file) == row.size())
+			&& (value.empty() || fread(&value[0], sizeof(double), value.size(), file) == value.size())
+			&& fread(&diagonal[0], sizeof(double), size, file) == (size_t)size
+			&& columnStart[size] == (int)header.nonZeros;
+	}
+
+	fclose(file);
+
+	if(!loaded)
+	{
+		release();
+		return false;
+	}
+
+	// A damaged file must not index out of range: the columns must cover the entries in order,
+	// every entry must name a row of the factor and the permutation must be one
+	bool valid = columnStart[0] == 0;
+
+	for(int k = 0; valid && k < size; ++k)
+		valid = columnStart[k] <= columnStart[k + 1];
+
+	for(size_t p = 0; valid && p < row.size(); ++p)
+		valid = row[p] >= 0 && row[p] < size;
+
+	inverse.assign(size, -1);
+
+	for(int k = 0; valid && k < size; ++k)
+	{
+		valid = permutation[k] >= 0 && permutation[k] < size && inverse[permutation[k]] == -1;
+
+		if(valid)
+			inverse[permutation[k]] = k;
+	}
+
+	if(!valid)
+	{
+		release();
+		return false;
+	}
+
+	return true;
+}
+
+// Release
+void CPUSparseLDL::release()
+{
+	size = 0;
+	permutation.clear();
+	inverse.clear();
+	columnStart.clear();
+	row.clear();
+	value.clear();
+	diagonal.clear();
+}
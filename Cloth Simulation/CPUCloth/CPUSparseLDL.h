@@ -0,0 +1,58 @@
+// ------------------------------------------------
+// Class:	CPU Sparse LDL Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUSPARSELDL
+#define CPUSPARSELDL
+
+// INCLUDES
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sparse symmetric LDL^T factorisation (up looking, after Davis' LDL), P A P^T = L D L^T.
+// The matrix is passed in compressed column form with both triangles, the fill reducing
+// ordering is supplied by the caller (it knows the structure, e.g. the cloth lattice).
+// The factor can be written to and read back from a binary file, tagged with a key so a
+// stale file is never used.
+class CPUSparseLDL
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Attributes
+	int size;
+	std::vector<int> permutation;	// Row of A eliminated k-th
+	std::vector<int> inverse;		// Elimination step of each row of A
+	std::vector<int> columnStart;	// L, strictly lower part by columns (unit diagonal implied)
+	std::vector<int> row;
+	std::vector<double> value;
+	std::vector<double> diagonal;	// D
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor
+	CPUSparseLDL();
+
+	// Factorise an n x n matrix (columnStart has n + 1 entries) in the given elimination order,
+	// returns false if a zero pivot is met
+	bool factor(int n, const std::vector<int>& matrixColumnStart, const std::vector<int>& matrixRow,
+		const std::vector<double>& matrixValue, const std::vector<int>& order);
+
+	// Solve A x = b in place (values holds b on entry, x on exit), work holds size entries
+	void solve(double* values, double* work) const;
+
+	// Cache file, load fails (and leaves the factor empty) unless the key and layout match
+	bool save(const char* path, uint64_t key) const;
+	bool load(const char* path, uint64_t key);
+
+	void release();
+
+	// Accessors
+	int getSize() const { return size; }
+	size_t getNonZeros() const { return row.size(); } // Off diagonal entries of L
+};
+
+#endif
@@ -0,0 +1,118 @@
+// ------------------------------------------------
+// Class:	CPU Step Scheduler Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUStepScheduler.h"
+
+// Constructor
+CPUStepScheduler::CPUStepScheduler(float newTimeStep, int newMaxSubsteps)
+{
+	timeStep = newTimeStep > 0.0f ? newTimeStep : 0.0017f;
+	maxSubsteps = newMaxSubsteps > 0 ? newMaxSubsteps : 1;
+	frameRate = 0.0f;
+
+	reset();
+}
+
+// Whole steps due by the start of a frame at a fixed frame rate (double precision,
+// so the count is the same on every run and platform)
+static long long stepsBeforeFrame(long long frame, float frameRate, float timeStep)
+{
+	return (long long)((double)frame / ((double)frameRate * (double)timeStep));
+}
+
+// Advance
+int CPUStepScheduler::advance(float deltaTime)
+{
+	if(frameRate > 0.0f)
+		return advanceFrame(frameIndex);
+
+	if(deltaTime < 0.0f)
+		deltaTime = 0.0f;
+
+	accumulator += deltaTime;
+
+	int stepCount = (int)(accumulator / timeStep);
+	float surplus = 0.0f;
+
+	if(stepCount > maxSubsteps)
+	{
+		// Over budget: run the budget, keep the fractional step and drop the rest
+		surplus = (stepCount - maxSubsteps) * timeStep;
+
+		droppedTime += surplus;
+		accumulator -= surplus;
+		stepCount = maxSubsteps;
+	}
+
+	accumulator -= timeStep * stepCount;
+
+	// Guard against rounding leaving a negative remainder behind
+	if(accumulator < 0.0f)
+		accumulator = 0.0f;
+
+	timeDilation = deltaTime > 0.0f ? (deltaTime - surplus) / deltaTime : 1.0f;
+
+	return stepCount;
+}
+
+// Advance Frame
+int CPUStepScheduler::advanceFrame(long long frame)
+{
+	if(frameRate <= 0.0f || frame < 0)
+		return 0;
+
+	long long first = stepsBeforeFrame(frame, frameRate, timeStep);
+	long long last = stepsBeforeFrame(frame + 1, frameRate, timeStep);
+	int stepCount = (int)(last - first);
+	int wanted = stepCount;
+
+	// The budget still applies, the dropped steps are not carried to the next frame
+	if(stepCount > maxSubsteps)
+	{
+		droppedTime += (double)(stepCount - maxSubsteps) * timeStep;
+		stepCount = maxSubsteps;
+	}
+
+	// Fraction of a step between the last whole step and the end of the frame
+	double end = (double)(frame + 1) / ((double)frameRate * (double)timeStep);
+	accumulator = (float)(end - (double)last) * timeStep;
+
+	timeDilation = wanted ? (float)stepCount / (float)wanted : 1.0f;
+	frameIndex = frame + 1;
+
+	return stepCount;
+}
+
+// Reset
+void CPUStepScheduler::reset()
+{
+	frameIndex = 0;
+	accumulator = 0.0f;
+	droppedTime = 0.0;
+	timeDilation = 1.0f;
+}
+
+// Settings
+void CPUStepScheduler::setTimeStep(float newTimeStep)
+{
+	if(newTimeStep <= 0.0f)
+		return;
+
+	// Keep the same fraction of a step pending
+	accumulator *= newTimeStep / timeStep;
+	timeStep = newTimeStep;
+}
+
+void CPUStepScheduler::setMaxSubsteps(int newMaxSubsteps)
+{
+	maxSubsteps = newMaxSubsteps > 0 ? newMaxSubsteps : 1;
+}
+
+void CPUStepScheduler::setFixedFrameRate(float newFrameRate)
+{
+	frameRate = newFrameRate > 0.0f ? newFrameRate : 0.0f;
+	reset();
+}
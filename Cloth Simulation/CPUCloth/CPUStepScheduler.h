@@ -0,0 +1,66 @@
+// ------------------------------------------------
+// Class:	CPU Step Scheduler Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUSTEPSCHEDULER
+#define CPUSTEPSCHEDULER
+
+// Fixed step scheduler with a per frame substep budget.
+// Frame time is accumulated and consumed in whole steps. When a frame needs more
+// steps than the budget allows (a stall), the surplus time is dropped instead of
+// queued, so the simulation slows down (time dilation) rather than spiralling.
+//
+// With a fixed frame rate set, the measured frame time is ignored and the step count of
+// frame n is derived from n alone, so a run (or replay) steps identically every time.
+class CPUStepScheduler
+{
+private:
+// PRIVATE ----------------------------------------
+
+	// Settings
+	float timeStep;
+	int maxSubsteps;
+
+	float frameRate;		// Fixed frames per second (0 = follow the measured frame time)
+
+	// State
+	long long frameIndex;	// Next frame for fixed frame rate stepping
+	float accumulator;		// Unsimulated time (normally less than one step after advance)
+	double droppedTime;		// Total time discarded because the budget was exceeded
+	float timeDilation;		// Simulated / real time for the last frame (1 = real time)
+
+public:
+// PUBLIC  ----------------------------------------
+
+	// Constructor
+	CPUStepScheduler(float newTimeStep = 0.0017f, int newMaxSubsteps = 64);
+
+	// Add a frame's worth of time and return the number of steps to run now
+	// (deltaTime is ignored when a fixed frame rate is set)
+	int advance(float deltaTime);
+
+	// Steps for a given frame at the fixed frame rate, the next advance continues from frame + 1
+	int advanceFrame(long long frame);
+
+	// Clear the accumulator and counters
+	void reset();
+
+	// Settings
+	void setTimeStep(float newTimeStep);
+	void setMaxSubsteps(int newMaxSubsteps);
+	void setFixedFrameRate(float newFrameRate);
+	float getTimeStep() const { return timeStep; }
+	int getMaxSubsteps() const { return maxSubsteps; }
+	float getFixedFrameRate() const { return frameRate; }
+	long long getFrameIndex() const { return frameIndex; }
+
+	// Fraction of a step left in the accumulator (0 - 1), for interpolating the rendered state
+	float getAlpha() const { return accumulator < timeStep ? accumulator / timeStep : 1.0f; }
+
+	// Reporting
+	double getDroppedTime() const { return droppedTime; }
+	float getTimeDilation() const { return timeDilation; }
+};
+
+#endif
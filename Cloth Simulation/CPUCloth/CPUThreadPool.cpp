@@ -0,0 +1,203 @@
+// ------------------------------------------------
+// Class:	CPU Thread Pool Implementation
+// Author:	Jak Boulton
+// ------------------------------------------------
+
+// Include header
+#include "CPUThreadPool.h"
+
+// Standard includes
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Namespaces
+using namespace std;
+
+// Iterations a thread spins before blocking, keeps back to back jobs (one per constraint colour) cheap
+#define SPIN_COUNT 4000
+
+// Constructor
+CPUThreadPool::CPUThreadPool(int threadCount)
+{
+	task = nullptr;
+	taskCount = 0;
+	chunkSize = 0;
+	nextChunk = 0;
+	busyWorkers = 0;
+	generation = 0;
+	quit = false;
+
+	if(threadCount <= 0)
+		threadCount = physicalCoreCount();
+
+	for(int i = 1; i < threadCount; ++i)
+		workers.push_back(thread(&CPUThreadPool::workerLoop, this));
+}
+
+// Destructor
+CPUThreadPool::~CPUThreadPool()
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		quit = true;
+		++generation;
+	}
+
+	wake.notify_all();
+
+	for(size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+// Parallel For
+void CPUThreadPool::parallelFor(int count, int grain, const Task& job)
+{
+	if(count <= 0)
+		return;
+
+	grain = max(grain, 1);
+
+	// Run inline when there is nothing to share
+	if(workers.empty() || count <= grain)
+	{
+		job(0, count);
+		return;
+	}
+
+	// Roughly four chunks per thread for load balancing, rounded to the grain
+	int chunks = getThreadCount() * 4;
+	chunkSize = (count + chunks - 1) / chunks;
+	chunkSize = ((chunkSize + grain - 1) / grain) * grain;
+
+	task = &job;
+	taskCount = count;
+	nextChunk = 0;
+	busyWorkers = (int)workers.size();
+
+	{
+		lock_guard<std::mutex> lock(mutex);
+		++generation;
+	}
+
+	wake.notify_all();
+
+	// The calling thread works too
+	runChunks();
+
+	// Join (spin briefly, then block)
+	for(int spin = 0; spin < SPIN_COUNT && busyWorkers.load(memory_order_acquire); ++spin)
+		this_thread::yield();
+
+	if(busyWorkers.load(memory_order_acquire))
+	{
+		unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busyWorkers.load(memory_order_acquire) == 0; });
+	}
+
+	task = nullptr;
+}
+
+// Run Chunks
+void CPUThreadPool::runChunks()
+{
+	for(;;)
+	{
+		int first = nextChunk.fetch_add(chunkSize, memory_order_relaxed);
+
+		if(first >= taskCount)
+			return;
+
+		(*task)(first, min(first + chunkSize, taskCount));
+	}
+}
+
+// Worker Loop
+void CPUThreadPool::workerLoop()
+{
+	unsigned int seen = 0;
+
+	for(;;)
+	{
+		// Wait for the next job (spin briefly, then block)
+		for(int spin = 0; spin < SPIN_COUNT && generation.load(memory_order_acquire) == seen; ++spin)
+			this_thread::yield();
+
+		{
+			unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, seen] { return generation.load(memory_order_acquire) != seen; });
+
+			seen = generation.load(memory_order_acquire);
+
+			if(quit)
+				return;
+		}
+
+		runChunks();
+
+		// Last worker out wakes the caller
+		if(busyWorkers.fetch_sub(1, memory_order_acq_rel) == 1)
+		{
+			lock_guard<std::mutex> lock(mutex);
+			done.notify_one();
+		}
+	}
+}
+
+// Physical Core Count
+int CPUThreadPool::physicalCoreCount()
+{
+	int logical = max((int)thread::hardware_concurrency(), 1);
+
+#ifdef _WIN32
+	DWORD length = 0;
+	GetLogicalProcessorInformation(nullptr, &length);
+
+	if(length)
+	{
+		vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+		if(GetLogicalProcessorInformation(&info[0], &length))
+		{
+			int cores = 0;
+
+			for(size_t i = 0; i < info.size(); ++i)
+				if(info[i].Relationship == RelationProcessorCore)
+					++cores;
+
+			if(cores)
+				return cores;
+		}
+	}
+#else
+	// Count unique (package, core) pairs from the sysfs topology
+	set<pair<int, int> > cores;
+
+	for(int cpu = 0; cpu < logical; ++cpu)
+	{
+		ostringstream path;
+		path << "/sys/devices/system/cpu/cpu" << cpu << "/topology/";
+
+		ifstream packageFile((path.str() + "physical_package_id").c_str());
+		ifstream coreFile((path.str() + "core_id").c_str());
+
+		int package, core;
+
+		if(!(packageFile >> package) || !(coreFile >> core))
+			return logical;
+
+		cores.insert(make_pair(package, core));
+	}
+
+	if(!cores.empty())
+		return (int)cores.size();
+#endif
+
+	return logical;
+}
@@ -0,0 +1,70 @@
+// ------------------------------------------------
+// Class:	CPU Thread Pool Header
+// Author:	Jak Boulton
+// ------------------------------------------------
+#pragma once
+#ifndef CPUTHREADPOOL
+#define CPUTHREADPOOL
+
+// INCLUDES
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool. Workers are created once and parked between jobs,
+// each parallelFor is a single fork / join (the join acts as the barrier).
+class CPUThreadPool
+{
+public:
+// PUBLIC  ----------------------------------------
+
+	// Work item, processes the half open range [first, last)
+	typedef std::function<void(int first, int last)> Task;
+
+	// Constructor & Destructor (threadCount includes the calling thread, 0 = physical cores)
+	explicit CPUThreadPool(int threadCount = 0);
+	~CPUThreadPool();
+
+	// Number of threads taking part in a parallelFor (workers + caller)
+	int getThreadCount() const { return (int)workers.size() + 1; }
+
+	// Split [0, count) into chunks that are multiples of grain and run them on every thread,
+	// returns once all chunks are finished
+	void parallelFor(int count, int grain, const Task& task);
+
+	// Number of physical cores (logical processors when the topology is unknown)
+	static int physicalCoreCount();
+
+private:
+// PRIVATE ----------------------------------------
+
+	// Non-copyable
+	CPUThreadPool(const CPUThreadPool&);
+	CPUThreadPool& operator=(const CPUThreadPool&);
+
+	// Methods
+	void workerLoop();
+	void runChunks();
+
+	// Workers
+	std::vector<std::thread> workers;
+
+	// Job currently being processed
+	const Task* task;
+	int taskCount;
+	int chunkSize;
+	std::atomic<int> nextChunk;
+	std::atomic<int> busyWorkers;
+
+	// Signalling
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::atomic<unsigned int> generation;
+	bool quit;
+};
+
+#endif
@@ -0,0 +1,1389 @@
+//
+// Cloth Runner
+//
+// Headless command line front end for CPUCloth, steps a number of frames of a W x H cloth
+// and reports the simulation throughput.  Usage:
+//
+//	ClothRunner [--width W] [--height H] [--frames N] [--fps F] [--isa NAME] [--threads T]
+//	            [--solver pbd|xpbd|implicit|projective|vbd|jacobi] [--substeps S] [--iterations I]
+//	            [--structural-compliance C] [--shear-compliance C]
+//	            [--stiffness K] [--shear-stiffness K] [--damping D] [--cg-tolerance T] [--cg-iterations N]
+//	            [--max-substeps M] [--stall S] [--anchors default|row|none]
+//	            [--tethers] [--tether-scale S] [--deterministic] [--hash-interval N]
+//	            [--multigrid L] [--multigrid-sweeps S] [--converge TOL] [--converge-limit W]
+//	            [--anderson M] [--factor-cache DIR] [--relaxation W] [--chebyshev]
+//	            [--stretch] [--tolerance TOL] [--budget MS]
+//	            [--sleep] [--sleep-threshold E] [--sleep-steps K] [--order row|morton|tiled] [--compare-orders]
+//	            [--blocked K] [--props N] [--mesh FILE.obj|gsf] [--mesh-resolution N] [--field-cache DIR]
+//	            [--self-collision] [--self-thickness F] [--self-exclusion K] [--compare-self]
+//	            [--no-contact-cache] [--ccd] [--sphere-speed V]
+//	ClothRunner --verify-kernels
+//	ClothRunner --verify-determinism
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <CPUCloth/CPUCloth.h>
+#include <CPUCloth/CPUFeatures.h>
+#include <CPUCloth/CPUConstraintKernel.h>
+
+using namespace std;
+
+// Solver names (indexed by CPUSolverMode)
+static const char* solverNames[] = { "pbd", "xpbd", "implicit", "projective", "vbd", "jacobi" };
+
+// Runner options
+struct RunnerOptions
+{
+	unsigned int width;
+	unsigned int height;
+	int frames;
+	float fps;
+	CPUInstructionSet isa;
+	int threads;
+	CPUSolverMode solver;
+	int substeps;
+	int iterations;
+	float structuralCompliance;
+	float shearCompliance;
+	float stiffness;
+	float shearStiffness;
+	float damping;
+	float cgTolerance;
+	int cgIterations;
+	int maxSubsteps;
+	float stall;
+	const char* anchors;
+	bool tethers;
+	float tetherScale;
+	bool deterministic;
+	int hashInterval;
+	int multigridLevels;
+	int multigridSweeps;
+	float converge;
+	int convergeLimit;
+	int andersonWindow;
+	float relaxation;
+	bool chebyshev;
+	bool stretch;
+	float tolerance;
+	float budget;
+	bool sleep;
+	float sleepThreshold;
+	int sleepSteps;
+	CPUParticleOrder order;
+	bool compareOrders;
+	int blockedSweeps;
+	int props;
+	const char* mesh;
+	int meshResolution;
+	const char* fieldCache;
+	bool selfCollision;
+	float selfThickness;
+	int selfExclusion;
+	bool compareSelf;
+	bool contactCache;
+	bool continuousCollision;
+	float sphereSpeed;
+	const char* factorCache;
+	bool verifyKernels;
+	bool verifyDeterminism;
+};
+
+static void printUsage()
+{
+	cout << "Usage: ClothRunner [--width W] [--height H] [--frames N] [--fps F] [--isa scalar|sse42|avx2|avx512]" << endl;
+	cout << "                   [--threads T (0 = physical cores)]" << endl;
+	cout << "                   [--solver pbd|xpbd|implicit|projective|vbd|jacobi] [--substeps S (per frame, 0 = 1.7 ms steps, 1 for the implicit solvers)] [--iterations I]" << endl;
+	cout << "                   [--structural-compliance C] [--shear-compliance C]" << endl;
+	cout << "                   [--stiffness K] [--shear-stiffness K (implicit springs, N/m)] [--damping D (N s/m)]" << endl;
+	cout << "                   [--cg-tolerance T (relative residual)] [--cg-iterations N (per step)]" << endl;
+	cout << "                   [--max-substeps M (per frame)] [--stall S (one frame of S seconds mid run)]" << endl;
+	cout << "                   [--anchors default|row|none (three top particles, the whole top row or free)]" << endl;
+	cout << "                   [--tethers] [--tether-scale S (slack over the rest distance, >= 1)]" << endl;
+	cout << "                   [--deterministic (steps from the frame index)] [--hash-interval N (print a state hash every N steps)]" << endl;
+	cout << "                   [--multigrid L (levels, 1 = off)] [--multigrid-sweeps S (per level and direction)]" << endl;
+	cout << "                   [--converge TOL (sweeps until the max stretch is below TOL after the run, plain vs multigrid)]" << endl;
+	cout << "                   [--converge-limit W (give up after W fine sweeps worth of work)]" << endl;
+	cout << "                   [--anderson M (projective iterates mixed, 0 = off)] [--factor-cache DIR (projective factors kept between runs)]" << endl;
+	cout << "                   [--relaxation W (jacobi, scale on the averaged corrections, 0 - 2)]" << endl;
+	cout << "                   [--chebyshev (over-relax the pbd / xpbd / jacobi iterations of a substep)]" << endl;
+	cout << "                   [--stretch (per batch stretch of every sweep)] [--tolerance TOL (stop the sweeps at this max stretch)]" << endl;
+	cout << "                   [--budget MS (sweep time per frame, --iterations is the cap)]" << endl;
+	cout << "                   [--sleep (still tiles stop)] [--sleep-threshold E (kinetic energy per kg)] [--sleep-steps K (quiet steps before a tile sleeps)]" << endl;
+	cout << "                   [--order row|morton|tiled (particle memory order, pbd / xpbd)]" << endl;
+	cout << "                   [--compare-orders (time and count cache misses per step in every order)]" << endl;
+	cout << "                   [--blocked K (sweeps per tile between boundary sweeps, pbd / xpbd, 0 = off)]" << endl;
+	cout << "                   [--props N (spheres, capsules and boxes scattered around the cloth, and a floor)]" << endl;
+	cout << "                   [--mesh FILE.obj|FILE.gsf (collide with a baked distance field of the mesh, fitted under the cloth)]" << endl;
+	cout << "                   [--mesh-resolution N (field samples along the longest side)] [--field-cache DIR (baked fields kept between runs)]" << endl;
+	cout << "                   [--self-collision] [--self-thickness F (contact distance over the rest spacing)] [--self-exclusion K (lattice steps never tested)]" << endl;
+	cout << "                   [--compare-self (time the self collision hash build, query and list passes per step on 1 to 8 threads)]" << endl;
+	cout << "                   [--no-contact-cache (detect the contacts in every substep, not once per frame)]" << endl;
+	cout << "                   [--ccd (sweep the particles' paths against the colliders)] [--sphere-speed V (m/s, the sphere swings through the cloth)]" << endl;
+	cout << "       ClothRunner --verify-kernels" << endl;
+	cout << "       ClothRunner --verify-determinism" << endl;
+}
+
+static bool parseOptions(int argc, char** argv, RunnerOptions& options)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if(!strcmp(arg, "--help") || !strcmp(arg, "-h"))
+			return false;
+
+		// Switches
+		if(!strcmp(arg, "--verify-kernels"))
+		{
+			options.verifyKernels = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--verify-determinism"))
+		{
+			options.verifyDeterminism = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--tethers"))
+		{
+			options.tethers = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--deterministic"))
+		{
+			options.deterministic = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--chebyshev"))
+		{
+			options.chebyshev = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--stretch"))
+		{
+			options.stretch = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--sleep"))
+		{
+			options.sleep = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--compare-orders"))
+		{
+			options.compareOrders = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--self-collision"))
+		{
+			options.selfCollision = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--compare-self"))
+		{
+			options.selfCollision = true;
+			options.compareSelf = true;
+			continue;
+		}
+
+		if(!strcmp(arg, "--no-contact-cache"))
+		{
+			options.contactCache = false;
+			continue;
+		}
+
+		if(!strcmp(arg, "--ccd"))
+		{
+			options.continuousCollision = true;
+			continue;
+		}
+
+		// Options with a value
+		if(!value)
+		{
+			cout << "Missing value for '" << arg << "'" << endl;
+			return false;
+		}
+
+		if(!strcmp(arg, "--width"))
+			options.width = (unsigned int)atoi(value);
+		else if(!strcmp(arg, "--height"))
+			options.height = (unsigned int)atoi(value);
+		else if(!strcmp(arg, "--frames"))
+			options.frames = atoi(value);
+		else if(!strcmp(arg, "--fps"))
+			options.fps = (float)atof(value);
+		else if(!strcmp(arg, "--threads"))
+			options.threads = atoi(value);
+		else if(!strcmp(arg, "--substeps"))
+			options.substeps = atoi(value);
+		else if(!strcmp(arg, "--iterations"))
+			options.iterations = atoi(value);
+		else if(!strcmp(arg, "--structural-compliance"))
+			options.structuralCompliance = (float)atof(value);
+		else if(!strcmp(arg, "--shear-compliance"))
+			options.shearCompliance = (float)atof(value);
+		else if(!strcmp(arg, "--stiffness"))
+			options.stiffness = (float)atof(value);
+		else if(!strcmp(arg, "--shear-stiffness"))
+			options.shearStiffness = (float)atof(value);
+		else if(!strcmp(arg, "--damping"))
+			options.damping = (float)atof(value);
+		else if(!strcmp(arg, "--cg-tolerance"))
+			options.cgTolerance = (float)atof(value);
+		else if(!strcmp(arg, "--cg-iterations"))
+			options.cgIterations = atoi(value);
+		else if(!strcmp(arg, "--max-substeps"))
+			options.maxSubsteps = atoi(value);
+		else if(!strcmp(arg, "--stall"))
+			options.stall = (float)atof(value);
+		else if(!strcmp(arg, "--sphere-speed"))
+			options.sphereSpeed = (float)atof(value);
+		else if(!strcmp(arg, "--tether-scale"))
+			options.tetherScale = (float)atof(value);
+		else if(!strcmp(arg, "--hash-interval"))
+			options.hashInterval = atoi(value);
+		else if(!strcmp(arg, "--multigrid"))
+			options.multigridLevels = atoi(value);
+		else if(!strcmp(arg, "--multigrid-sweeps"))
+			options.multigridSweeps = atoi(value);
+		else if(!strcmp(arg, "--converge"))
+			options.converge = (float)atof(value);
+		else if(!strcmp(arg, "--converge-limit"))
+			options.convergeLimit = atoi(value);
+		else if(!strcmp(arg, "--anderson"))
+			options.andersonWindow = atoi(value);
+		else if(!strcmp(arg, "--factor-cache"))
+			options.factorCache = value;
+		else if(!strcmp(arg, "--relaxation"))
+			options.relaxation = (float)atof(value);
+		else if(!strcmp(arg, "--tolerance"))
+			options.tolerance = (float)atof(value);
+		else if(!strcmp(arg, "--budget"))
+			options.budget = (float)atof(value);
+		else if(!strcmp(arg, "--sleep-threshold"))
+			options.sleepThreshold = (float)atof(value);
+		else if(!strcmp(arg, "--sleep-steps"))
+			options.sleepSteps = atoi(value);
+		else if(!strcmp(arg, "--blocked"))
+			options.blockedSweeps = atoi(value);
+		else if(!strcmp(arg, "--props"))
+			options.props = atoi(value);
+		else if(!strcmp(arg, "--mesh"))
+			options.mesh = value;
+		else if(!strcmp(arg, "--mesh-resolution"))
+			options.meshResolution = atoi(value);
+		else if(!strcmp(arg, "--field-cache"))
+			options.fieldCache = value;
+		else if(!strcmp(arg, "--self-thickness"))
+			options.selfThickness = (float)atof(value);
+		else if(!strcmp(arg, "--self-exclusion"))
+			options.selfExclusion = atoi(value);
+		else if(!strcmp(arg, "--anchors"))
+		{
+			if(strcmp(value, "default") && strcmp(value, "row") && strcmp(value, "none"))
+			{
+				cout << "Unknown anchor set '" << value << "'" << endl;
+				return false;
+			}
+
+			options.anchors = value;
+		}
+		else if(!strcmp(arg, "--solver"))
+		{
+			if(!strcmp(value, "pbd"))
+				options.solver = CPU_SOLVER_PBD;
+			else if(!strcmp(value, "xpbd"))
+				options.solver = CPU_SOLVER_XPBD;
+			else if(!strcmp(value, "implicit"))
+				options.solver = CPU_SOLVER_IMPLICIT;
+			else if(!strcmp(value, "projective"))
+				options.solver = CPU_SOLVER_PROJECTIVE;
+			else if(!strcmp(value, "vbd"))
+				options.solver = CPU_SOLVER_VBD;
+			else if(!strcmp(value, "jacobi"))
+				options.solver = CPU_SOLVER_JACOBI;
+			else
+			{
+				cout << "Unknown solver '" << value << "'" << endl;
+				return false;
+			}
+		}
+		else if(!strcmp(arg, "--order"))
+		{
+			if(!parseParticleOrder(value, options.order))
+			{
+				cout << "Unknown particle order '" << value << "'" << endl;
+				return false;
+			}
+		}
+		else if(!strcmp(arg, "--isa"))
+		{
+			if(!parseInstructionSet(value, options.isa))
+			{
+				cout << "Unknown instruction set '" << value << "'" << endl;
+				return false;
+			}
+		}
+		else
+		{
+			cout << "Unknown option '" << arg << "'" << endl;
+			return false;
+		}
+
+		++i;
+	}
+
+	return options.width >= 2 && options.height >= 2 && options.frames > 0 && options.fps > 0.0f
+		&& options.threads >= 0 && options.substeps >= 0 && options.iterations > 0
+		&& options.maxSubsteps > 0 && options.stall >= 0.0f && options.tetherScale >= 1.0f && options.hashInterval >= 0
+		&& options.stiffness >= 0.0f && options.shearStiffness >= 0.0f && options.damping >= 0.0f
+		&& options.cgTolerance >= 0.0f && options.cgIterations > 0
+		&& options.multigridLevels > 0 && options.multigridSweeps > 0 && options.converge >= 0.0f && options.convergeLimit > 0
+		&& options.andersonWindow >= 0 && options.relaxation > 0.0f && options.relaxation < 2.0f
+		&& options.tolerance >= 0.0f && options.budget >= 0.0f && options.sleepThreshold >= 0.0f && options.sleepSteps > 0
+		&& options.blockedSweeps >= 0 && options.props >= 0 && options.meshResolution >= 2
+		&& options.selfThickness > 0.0f && options.selfExclusion > 0 && options.sphereSpeed >= 0.0f;
+}
+
+// Checks every supported SIMD kernel against the scalar kernel on a random batch (and a random lattice for Jacobi)
+static int verifyKernels()
+{
+	const int particleCount = 4099;
+	const int constraintCount = particleCount / 2;
+	const float tolerance = 1e-5f;
+
+	mt19937 random(1234);
+	uniform_real_distribution<float> position(-1.0f, 1.0f);
+	uniform_real_distribution<float> rest(0.01f, 0.5f);
+
+	// Random positions
+	vector<float> x(particleCount), y(particleCount), z(particleCount);
+
+	for(int i = 0; i < particleCount; ++i)
+	{
+		x[i] = position(random);
+		y[i] = position(random);
+		z[i] = position(random);
+	}
+
+	// Disjoint pairs (a valid coloured batch), an odd count exercises the remainder loops
+	vector<unsigned int> order(particleCount);
+
+	for(int i = 0; i < particleCount; ++i)
+		order[i] = i;
+
+	shuffle(order.begin(), order.end(), random);
+
+	vector<unsigned int> start(constraintCount), end(constraintCount);
+	vector<float> distance(constraintCount);
+
+	for(int i = 0; i < constraintCount; ++i)
+	{
+		start[i] = order[i * 2];
+		end[i] = order[i * 2 + 1];
+		distance[i] = rest(random);
+	}
+
+	// Random inverse masses, pin both ends of one constraint and one end of two others
+	vector<float> invMass(particleCount);
+
+	for(int i = 0; i < particleCount; ++i)
+		invMass[i] = rest(random) * 4.0f;
+
+	invMass[start[7]] = invMass[end[7]] = 0.0f;
+	invMass[start[100]] = invMass[end[1000]] = 0.0f;
+
+	CPUConstraintBatch batch;
+	batch.start = &start[0];
+	batch.end = &end[0];
+	batch.distance = &distance[0];
+	batch.count = constraintCount;
+
+	CPUInstructionSet supported = detectInstructionSet();
+	int failures = 0;
+
+	cout << "Detected instruction set: " << instructionSetName(supported) << endl;
+
+	// PBD, then XPBD with a non zero compliance and multipliers
+	for(int mode = 0; mode < 2; ++mode)
+	{
+		vector<float> initialLambda(constraintCount);
+
+		for(int i = 0; i < constraintCount; ++i)
+			initialLambda[i] = mode ? rest(random) * 0.1f : 0.0f;
+
+		CPUConstraintParams params;
+		params.invMass = &invMass[0];
+		params.alpha = mode ? 0.35f : 0.0f;
+
+		// Reference result, with the stretch reduction (its max must match exactly)
+		float refStretchMax, refStretchSquares;
+		vector<float> refX = x, refY = y, refZ = z, refLambda = initialLambda;
+		CPUPositions reference = { &refX[0], &refY[0], &refZ[0] };
+		params.lambda = mode ? &refLambda[0] : nullptr;
+		params.stretchMax = &refStretchMax;
+		params.stretchSquares = &refStretchSquares;
+		projectConstraintsScalar(batch, 0, constraintCount, reference, params);
+
+		cout << (mode ? "XPBD" : "PBD") << endl;
+
+		for(int isa = CPU_ISA_SCALAR; isa <= supported; ++isa)
+		{
+			float simdStretchMax, simdStretchSquares;
+			vector<float> simdX = x, simdY = y, simdZ = z, simdLambda = initialLambda;
+			CPUPositions simd = { &simdX[0], &simdY[0], &simdZ[0] };
+			params.lambda = mode ? &simdLambda[0] : nullptr;
+			params.stretchMax = &simdStretchMax;
+			params.stretchSquares = &simdStretchSquares;
+			getConstraintKernel((CPUInstructionSet)isa)(batch, 0, constraintCount, simd, params);
+
+			float maxError = 0.0f;
+
+			for(int i = 0; i < particleCount; ++i)
+			{
+				maxError = max(maxError, fabsf(simdX[i] - refX[i]));
+				maxError = max(maxError, fabsf(simdY[i] - refY[i]));
+				maxError = max(maxError, fabsf(simdZ[i] - refZ[i]));
+			}
+
+			for(int i = 0; i < constraintCount; ++i)
+				maxError = max(maxError, fabsf(simdLambda[i] - refLambda[i]));
+
+			// The lanes sum the squares in another order, so those only agree to rounding
+			maxError = max(maxError, fabsf(simdStretchMax - refStretchMax));
+			maxError = max(maxError, fabsf(simdStretchSquares - refStretchSquares) / max(refStretchSquares, 1.0f));
+
+			bool passed = maxError <= tolerance;
+			failures += passed ? 0 : 1;
+
+			cout << setw(8) << instructionSetName((CPUInstructionSet)isa) << " (" << setw(2)
+				<< instructionSetWidth((CPUInstructionSet)isa) << " lanes): max error " << maxError
+				<< (passed ? "  ok" : "  FAILED") << endl;
+		}
+	}
+
+	// Jacobi gather kernels on a 67 wide lattice of the same positions, every particle away
+	// from the first and last row has all eight neighbours (two of them switched off)
+	const int latticeWidth = 67;
+	const int neighbourColumn[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+	const int neighbourRow[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+
+	CPUJacobiSpan span;
+	span.x = &x[latticeWidth + 1];
+	span.y = &y[latticeWidth + 1];
+	span.z = &z[latticeWidth + 1];
+	span.invMass = &invMass[latticeWidth + 1];
+	span.scale = 1.5f / 6.0f;
+
+	for(int k = 0; k < 8; ++k)
+	{
+		span.offset[k] = neighbourRow[k] * latticeWidth + neighbourColumn[k];
+		span.weight[k] = (k == 2 || k == 5) ? 0.0f : 1.0f;
+		span.rest[k] = rest(random);
+	}
+
+	int spanCount = particleCount - 2 * (latticeWidth + 1);
+	vector<float> refX(spanCount), refY(spanCount), refZ(spanCount);
+
+	span.outX = &refX[0];
+	span.outY = &refY[0];
+	span.outZ = &refZ[0];
+	jacobiScalar(span, 0, spanCount);
+
+	cout << "Jacobi" << endl;
+
+	for(int isa = CPU_ISA_SCALAR; isa <= supported; ++isa)
+	{
+		vector<float> simdX(spanCount), simdY(spanCount), simdZ(spanCount);
+
+		span.outX = &simdX[0];
+		span.outY = &simdY[0];
+		span.outZ = &simdZ[0];
+		getJacobiKernel((CPUInstructionSet)isa)(span, 0, spanCount);
+
+		float maxError = 0.0f;
+
+		for(int i = 0; i < spanCount; ++i)
+		{
+			maxError = max(maxError, fabsf(simdX[i] - refX[i]));
+			maxError = max(maxError, fabsf(simdY[i] - refY[i]));
+			maxError = max(maxError, fabsf(simdZ[i] - refZ[i]));
+		}
+
+		bool passed = maxError <= tolerance;
+		failures += passed ? 0 : 1;
+
+		cout << setw(8) << instructionSetName((CPUInstructionSet)isa) << " (" << setw(2)
+			<< instructionSetWidth((CPUInstructionSet)isa) << " lanes): max error " << maxError
+			<< (passed ? "  ok" : "  FAILED") << endl;
+	}
+
+	return failures ? 1 : 0;
+}
+
+// Adds a floor plane below the cloth and count props cycling through spheres, capsules and
+// oriented boxes, scattered (with a fixed seed) over an area many times the cloth's, so only
+// the few under it are ever touched
+static void addProps(CPUCloth& cloth, int count)
+{
+	if(!count)
+		return;
+
+	mt19937 random(4321);
+	uniform_real_distribution<float> across(-3.0f, 4.0f);
+	uniform_real_distribution<float> below(-1.4f, -0.4f);
+	uniform_real_distribution<float> size(0.05f, 0.25f);
+
+	CPUPlane floor = { { 0.0f, 1.0f, 0.0f }, 1.5f };
+	cloth.addCollider(floor);
+
+	for(int p = 0; p < count; ++p)
+	{
+		CPUVector3 centre = { across(random), below(random), across(random) };
+		float radius = size(random);
+
+		if(p % 3 == 0)
+		{
+			CPUSphere sphere = { centre, radius };
+			cloth.addCollider(sphere);
+		}
+		else if(p % 3 == 1)
+		{
+			CPUCapsule capsule = { { centre.x - radius, centre.y, centre.z - radius }, { centre.x + radius, centre.y, centre.z + radius }, 0.5f * radius };
+			cloth.addCollider(capsule);
+		}
+		else
+		{
+			// Turned about the vertical axis
+			float angle = 0.7f * (float)p;
+			CPUBox box = { centre, { { cosf(angle), 0.0f, sinf(angle) }, { 0.0f, 1.0f, 0.0f }, { -sinf(angle), 0.0f, cosf(angle) } },
+				{ radius, 0.5f * radius, radius } };
+			cloth.addCollider(box);
+		}
+	}
+}
+
+// Closed octahedron around a centre (a mesh that needs no file)
+static void buildOctahedron(const CPUVector3& centre, float radius, CPUTriangleMesh& mesh)
+{
+	const float corners[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	const unsigned int faces[8][3] = { { 0, 2, 4 }, { 2, 1, 4 }, { 1, 3, 4 }, { 3, 0, 4 }, { 2, 0, 5 }, { 1, 2, 5 }, { 3, 1, 5 }, { 0, 3, 5 } };
+
+	mesh.vertices.resize(6);
+	mesh.indices.assign(&faces[0][0], &faces[0][0] + 24);
+
+	for(int v = 0; v < 6; ++v)
+	{
+		mesh.vertices[v].x = centre.x + corners[v][0] * radius;
+		mesh.vertices[v].y = centre.y + corners[v][1] * radius;
+		mesh.vertices[v].z = centre.z + corners[v][2] * radius;
+	}
+}
+
+// Adds a baked distance field as a collider (unturned, particles kept a few millimetres out)
+static void addField(CPUCloth& cloth, const CPUDistanceField& field)
+{
+	CPUFieldCollider collider = { &field, { 0.0f, 0.0f, 0.0f }, { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }, 0.005f };
+
+	cloth.addCollider(collider);
+}
+
+// Runs the same deterministic simulation on several thread counts and every supported
+// instruction set, the state hashes must match bit for bit
+static int verifyDeterminism()
+{
+	const unsigned int width = 67;
+	const unsigned int height = 45;
+	const int frames = 120;
+	const int hashInterval = 50;
+	const int threadCounts[] = { 1, 2, 3, 8 };
+	const char* modeNames[] = { "PBD", "XPBD", "PBD multigrid", "Implicit", "Projective", "VBD", "Jacobi", "PBD Chebyshev", "PBD tolerance", "PBD sleeping",
+		"PBD Morton sleeping", "PBD tiled blocked", "PBD props", "PBD mesh field", "PBD self collision",
+		"PBD continuous collision", "PBD sleeping Chebyshev" };
+	const CPUSolverMode modeSolvers[] = { CPU_SOLVER_PBD, CPU_SOLVER_XPBD, CPU_SOLVER_PBD, CPU_SOLVER_IMPLICIT, CPU_SOLVER_PROJECTIVE, CPU_SOLVER_VBD, CPU_SOLVER_JACOBI, CPU_SOLVER_PBD, CPU_SOLVER_PBD, CPU_SOLVER_PBD,
+		CPU_SOLVER_PBD, CPU_SOLVER_PBD, CPU_SOLVER_PBD, CPU_SOLVER_PBD, CPU_SOLVER_PBD, CPU_SOLVER_PBD, CPU_SOLVER_PBD };
+
+	CPUInstructionSet supported = detectInstructionSet();
+	int failures = 0;
+
+	// Baked once, without threads, the field of a mesh is the same on every run
+	CPUTriangleMesh octahedron;
+	CPUDistanceField octahedronField;
+	CPUVector3 octahedronCentre = { 0.5f, -0.45f, 0.45f };
+
+	buildOctahedron(octahedronCentre, 0.3f, octahedron);
+	octahedronField.bake(octahedron, 24);
+
+	cout << hex << setfill('0');
+
+	for(int mode = 0; mode < 17; ++mode)
+	{
+		vector<CPUStateHash> reference;
+
+		cout << modeNames[mode] << endl;
+
+		for(size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t)
+		{
+			for(int isa = CPU_ISA_SCALAR; isa <= supported; ++isa)
+			{
+				CPUCloth cloth(width, height, threadCounts[t]);
+
+				cloth.setInstructionSet((CPUInstructionSet)isa);
+				cloth.setSolverMode(modeSolvers[mode]);
+				cloth.setCompliance(CPU_CONSTRAINT_SHEAR, mode == 1 ? 1e-6f : 0.0f);
+				cloth.setIterations(mode == 1 ? 4 : (mode == 7 || mode == 8 || mode == 11 || mode == 16 ? 8 : (mode >= 4 ? 5 : 1)));
+				cloth.setChebyshev(mode == 7 || mode == 16);
+
+				// The sweeps stop on the max stretch, which every kernel reduces exactly, and the
+				// time budget must be ignored
+				cloth.setIterationTolerance(mode == 8 ? 0.03f : 0.0f);
+				cloth.setIterationBudget(mode == 8 ? 1e-5f : 0.0f);
+
+				// High enough that tiles sleep (and wake their neighbours) within the run
+				cloth.setSleepThreshold(2e-2f);
+				cloth.setSleepSteps(30);
+				cloth.setSleeping(mode == 9 || mode == 10 || mode == 16);
+				cloth.setParticleOrder(mode == 10 ? CPU_ORDER_MORTON : (mode == 11 ? CPU_ORDER_TILED : CPU_ORDER_ROW_MAJOR));
+				cloth.setBlockedSweeps(mode == 11 ? 4 : 0);
+				cloth.setJacobiRelaxation(1.5f);
+				cloth.setMultigridLevels(mode == 2 ? 4 : 1);
+				cloth.setTimeStep(mode >= 3 && mode <= 5 ? 1.0f / 60.0f : 0.0017f);
+				cloth.setTethers(true);
+				cloth.setDeterministic(60.0f);
+				cloth.setHashInterval(hashInterval);
+
+				// A few props under the cloth (and many away from it) on top of the sphere
+				addProps(cloth, mode == 12 ? 48 : 0);
+
+				if(mode == 13)
+					addField(cloth, octahedronField);
+
+				// The hanging cloth folds onto a floor, so it comes into contact with itself
+				if(mode == 14)
+				{
+					CPUPlane floor = { { 0.0f, 1.0f, 0.0f }, 0.6f };
+
+					cloth.addCollider(floor);
+					cloth.setSelfCollision(true);
+				}
+
+				// Substeps of a whole frame, swept against the sphere swinging through the cloth
+				if(mode == 15)
+				{
+					cloth.setTimeStep(1.0f / 60.0f);
+					cloth.setContinuousCollision(true);
+				}
+
+				// Uneven frame times, deterministic mode must ignore them
+				for(int frame = 0; frame < frames; ++frame)
+				{
+					if(mode == 15)
+					{
+						CPUSphere sphere = { { 0.5f, -0.5f, 0.8f * sinf((float)frame * 0.2f) }, 0.2f };
+
+						cloth.setCollider(0, sphere);
+					}
+
+					cloth.update((1.0f + 0.5f * sinf((float)frame * (float)(t + 1))) / 60.0f);
+				}
+
+				const vector<CPUStateHash>& hashes = cloth.getStateHashes();
+
+				if(reference.empty())
+					reference = hashes;
+
+				bool passed = !hashes.empty() && hashes.size() == reference.size();
+
+				for(size_t h = 0; passed && h < hashes.size(); ++h)
+					passed = hashes[h].step == reference[h].step && hashes[h].hash == reference[h].hash;
+
+				failures += passed ? 0 : 1;
+
+				cout << setw(8) << setfill(' ') << instructionSetName((CPUInstructionSet)isa) << ", " << dec << threadCounts[t]
+					<< " threads: " << hashes.size() << " hashes, last 0x" << hex << setw(16) << setfill('0')
+					<< (hashes.empty() ? 0 : hashes.back().hash) << (passed ? "  ok" : "  FAILED") << endl;
+			}
+		}
+	}
+
+	cout << dec;
+
+	return failures ? 1 : 0;
+}
+
+// Applies the runner options to a freshly built cloth
+static void configureCloth(CPUCloth& cloth, const RunnerOptions& options)
+{
+	cloth.setInstructionSet(options.isa);
+	cloth.setSolverMode(options.solver);
+	cloth.setIterations(options.iterations);
+	cloth.setCompliance(CPU_CONSTRAINT_STRUCTURAL, options.structuralCompliance);
+	cloth.setCompliance(CPU_CONSTRAINT_SHEAR, options.shearCompliance);
+	cloth.setStiffness(CPU_CONSTRAINT_STRUCTURAL, options.stiffness);
+	cloth.setStiffness(CPU_CONSTRAINT_SHEAR, options.shearStiffness);
+	cloth.setDamping(options.damping);
+	cloth.setImplicitTolerance(options.cgTolerance, options.cgIterations);
+	cloth.setMaxSubsteps(options.maxSubsteps);
+	cloth.setMultigridLevels(options.multigridLevels);
+	cloth.setMultigridSweeps(options.multigridSweeps);
+	cloth.setParticleOrder(options.order);
+	cloth.setBlockedSweeps(options.blockedSweeps);
+	cloth.setAndersonWindow(options.andersonWindow);
+	cloth.setJacobiRelaxation(options.relaxation);
+	cloth.setChebyshev(options.chebyshev);
+	cloth.setStretchMetrics(options.stretch);
+	cloth.setIterationTolerance(options.tolerance);
+	cloth.setIterationBudget(options.budget / 1000.0f);
+	cloth.setSleepThreshold(options.sleepThreshold);
+	cloth.setSleepSteps(options.sleepSteps);
+	cloth.setSleeping(options.sleep);
+	cloth.setFactorCache(options.factorCache);
+	cloth.setSelfThickness(options.selfThickness);
+	cloth.setSelfExclusion(options.selfExclusion);
+	cloth.setSelfCollision(options.selfCollision);
+	cloth.setContactCaching(options.contactCache);
+	cloth.setContinuousCollision(options.continuousCollision);
+
+	if(!strcmp(options.anchors, "row"))
+	{
+		vector<unsigned int> row(cloth.getWidth());
+
+		for(unsigned int i = 0; i < cloth.getWidth(); ++i)
+			row[i] = i;
+
+		cloth.setAnchors(&row[0], (int)row.size());
+	}
+	else if(!strcmp(options.anchors, "none"))
+	{
+		cloth.setAnchors(nullptr, 0);
+	}
+
+	cloth.setTethers(options.tethers);
+	cloth.setTetherScale(options.tetherScale);
+	cloth.setHashInterval(options.hashInterval);
+	addProps(cloth, options.props);
+
+	if(options.deterministic)
+		cloth.setDeterministic(options.fps);
+
+	// The implicit solvers take one step per frame unless told otherwise
+	bool implicit = options.solver == CPU_SOLVER_IMPLICIT || options.solver == CPU_SOLVER_PROJECTIVE || options.solver == CPU_SOLVER_VBD;
+	int substeps = (implicit && !options.substeps) ? 1 : options.substeps;
+
+	if(substeps)
+		cloth.setTimeStep(1.0f / (options.fps * substeps));
+}
+
+// Hangs the cloth for the requested frames with plain sweeps, then from that (identical,
+// deterministic) state counts the iterations plain sweeps and multigrid V-cycles need to
+// bring the max stretch below the tolerance
+static int compareConvergence(const RunnerOptions& options)
+{
+	typedef chrono::high_resolution_clock Clock;
+
+	int passes = options.multigridLevels > 1 ? 2 : 1;
+
+	cout << fixed << setprecision(3);
+
+	for(int pass = 0; pass < passes; ++pass)
+	{
+		CPUCloth cloth(options.width, options.height, options.threads);
+
+		if(!cloth.getWidth())
+			return 1;
+
+		configureCloth(cloth, options);
+		cloth.setMultigridLevels(1);
+		cloth.setDeterministic(options.fps);
+
+		for(int frame = 0; frame < options.frames; ++frame)
+			cloth.update(1.0f / options.fps);
+
+		if(pass)
+			cloth.setMultigridLevels(options.multigridLevels);
+
+		double cost = cloth.getIterationCost();
+		float initialStretch = cloth.measureStretch().max;
+		float stretch = initialStretch;
+		int iterations = 0;
+
+		Clock::time_point solveStart = Clock::now();
+
+		while(stretch > options.converge && (iterations + 1) * cost <= options.convergeLimit)
+		{
+			cloth.solveConstraints();
+			stretch = cloth.measureStretch().max;
+			++iterations;
+		}
+
+		double solveTime = chrono::duration<double>(Clock::now() - solveStart).count();
+
+		cout << (pass ? "Multigrid (" : "Plain sweeps (") << (pass ? cloth.getMultigridLevels() : 1) << " levels): max stretch "
+			<< initialStretch << " -> " << stretch << " after " << iterations << " iterations, "
+			<< iterations * cost << " fine sweeps of work, " << solveTime << " seconds"
+			<< (stretch <= options.converge ? "" : " (limit reached)") << endl;
+	}
+
+	return 0;
+}
+
+// Hardware cache miss counter of this process, inherited by the threads it starts afterwards
+// (Linux perf events), -1 where the counter is not available
+static int openCacheMissCounter()
+{
+#ifdef __linux__
+	perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.size = sizeof(attributes);
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+	attributes.disabled = 1;
+	attributes.inherit = 1;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+// Count from zero, and stop and read the count (-1 without a counter)
+static void startCounter(int counter)
+{
+#ifdef __linux__
+	if(counter >= 0)
+	{
+		ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+		ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+static long long stopCounter(int counter)
+{
+	long long count = -1;
+
+#ifdef __linux__
+	if(counter >= 0)
+	{
+		ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+
+		if(read(counter, &count, sizeof(count)) != sizeof(count))
+			count = -1;
+	}
+#endif
+
+	return count;
+}
+
+static void closeCounter(int counter)
+{
+#ifdef __linux__
+	if(counter >= 0)
+		close(counter);
+#endif
+}
+
+// Runs the same deterministic simulation with the particles in every memory order, timing
+// the steps and counting the cache misses of the run. The positions are compared in lattice
+// order, reordering must not change them.
+static int compareOrders(const RunnerOptions& options)
+{
+	typedef chrono::high_resolution_clock Clock;
+
+	vector<float> reference;
+	int failures = 0;
+
+	cout << fixed << setprecision(3);
+
+	for(int order = CPU_ORDER_ROW_MAJOR; order < CPU_ORDER_COUNT; ++order)
+	{
+		// Opened before the cloth, so its worker threads count too
+		int counter = openCacheMissCounter();
+		long long misses = -1;
+		long long steps = 0;
+		double runTime = 0.0;
+		vector<float> positions;
+
+		{
+			CPUCloth cloth(options.width, options.height, options.threads);
+
+			if(!cloth.getWidth())
+			{
+				closeCounter(counter);
+				return 1;
+			}
+
+			configureCloth(cloth, options);
+			cloth.setDeterministic(options.fps);
+			cloth.setParticleOrder((CPUParticleOrder)order);
+
+			if(cloth.getParticleOrder() != order)
+			{
+				closeCounter(counter);
+				return 1;
+			}
+
+			startCounter(counter);
+			Clock::time_point runStart = Clock::now();
+
+			for(int frame = 0; frame < options.frames; ++frame)
+				steps += cloth.update(1.0f / options.fps);
+
+			runTime = chrono::duration<double>(Clock::now() - runStart).count();
+			misses = stopCounter(counter);
+
+			// Back in lattice order
+			const CPUParticles& particles = cloth.getParticles();
+
+			positions.resize(particles.count * 3);
+
+			for(unsigned int i = 0; i < particles.count; ++i)
+			{
+				unsigned int slot = cloth.getParticleSlot(i);
+
+				positions[i * 3] = particles.x[slot];
+				positions[i * 3 + 1] = particles.y[slot];
+				positions[i * 3 + 2] = particles.z[slot];
+			}
+		}
+
+		closeCounter(counter);
+
+		if(reference.empty())
+			reference = positions;
+
+		bool same = positions == reference;
+		failures += same ? 0 : 1;
+
+		cout << setw(6) << particleOrderName((CPUParticleOrder)order) << ": " << runTime / max(steps, 1LL) * 1000.0 << " ms per step, ";
+
+		if(misses >= 0)
+			cout << (double)misses / max(steps, 1LL) << " cache misses per step";
+		else
+			cout << "cache misses not counted (no hardware counter)";
+
+		cout << (same ? "" : ", positions differ from row major") << endl;
+	}
+
+	return failures ? 1 : 0;
+}
+
+// Runs the same deterministic simulation with self collision on 1, 2, 4 and 8 threads, timing
+// the hash build, the query and the passes over the cached lists per step on their own. The state must not depend on the
+// thread count.
+static int compareSelfCollision(const RunnerOptions& options)
+{
+	const int threadCounts[] = { 1, 2, 4, 8 };
+
+	double reference[3] = { 0.0, 0.0, 0.0 };
+	uint64_t referenceHash = 0;
+	int failures = 0;
+
+	cout << fixed << setprecision(3);
+
+	for(size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t)
+	{
+		CPUCloth cloth(options.width, options.height, threadCounts[t]);
+
+		if(!cloth.getWidth())
+			return 1;
+
+		configureCloth(cloth, options);
+		cloth.setDeterministic(options.fps);
+
+		long long steps = 0;
+
+		for(int frame = 0; frame < options.frames; ++frame)
+			steps += cloth.update(1.0f / options.fps);
+
+		const CPUSelfCollision& selfCollision = cloth.getSelfCollision();
+		long long passes = max(selfCollision.getPasses(), 1LL);
+		double build = selfCollision.getBuildTime() / passes * 1000.0;
+		double query = selfCollision.getQueryTime() / passes * 1000.0;
+		double solve = selfCollision.getSolveTime() / passes * 1000.0;
+		uint64_t hash = cloth.hashState();
+
+		if(!t)
+		{
+			reference[0] = build;
+			reference[1] = query;
+			reference[2] = solve;
+			referenceHash = hash;
+		}
+
+		failures += hash == referenceHash ? 0 : 1;
+
+		cout << threadCounts[t] << " threads: hash build " << build << " ms (x" << reference[0] / max(build, 1e-9) << "), query "
+			<< query << " ms (x" << reference[1] / max(query, 1e-9) << "), list passes " << solve << " ms (x" << reference[2] / max(solve, 1e-9)
+			<< ") per step, " << (build + query + solve) * steps / max(options.frames, 1) << " ms per frame, "
+			<< selfCollision.getBuilds() << " builds for " << selfCollision.getPasses() << " passes, " << selfCollision.getContacts() << " particles pushed by the last pass"
+			<< (hash == referenceHash ? "" : ", state differs from 1 thread") << endl;
+	}
+
+	return failures ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	typedef chrono::high_resolution_clock Clock;
+
+	RunnerOptions options;
+	options.width = 128;
+	options.height = 128;
+	options.frames = 600;
+	options.fps = 60.0f;
+	options.isa = CPU_ISA_AVX512;
+	options.threads = 0;
+	options.solver = CPU_SOLVER_PBD;
+	options.substeps = 0;
+	options.iterations = 1;
+	options.structuralCompliance = 0.0f;
+	options.shearCompliance = 0.0f;
+	options.stiffness = 5000.0f;
+	options.shearStiffness = 500.0f;
+	options.damping = 2.0f;
+	options.cgTolerance = 1e-3f;
+	options.cgIterations = 100;
+	options.maxSubsteps = 64;
+	options.stall = 0.0f;
+	options.anchors = "default";
+	options.tethers = false;
+	options.tetherScale = 1.0f;
+	options.deterministic = false;
+	options.hashInterval = 0;
+	options.multigridLevels = 1;
+	options.multigridSweeps = 1;
+	options.converge = 0.0f;
+	options.convergeLimit = 2000;
+	options.andersonWindow = 5;
+	options.relaxation = 1.0f;
+	options.chebyshev = false;
+	options.stretch = false;
+	options.tolerance = 0.0f;
+	options.budget = 0.0f;
+	options.sleep = false;
+	options.sleepThreshold = 1e-3f;
+	options.sleepSteps = 60;
+	options.order = CPU_ORDER_ROW_MAJOR;
+	options.compareOrders = false;
+	options.blockedSweeps = 0;
+	options.props = 0;
+	options.mesh = "";
+	options.meshResolution = 64;
+	options.fieldCache = "";
+	options.selfCollision = false;
+	options.selfThickness = 1.0f;
+	options.selfExclusion = 2;
+	options.compareSelf = false;
+	options.contactCache = true;
+	options.continuousCollision = false;
+	options.sphereSpeed = 0.0f;
+	options.factorCache = "";
+	options.verifyKernels = false;
+	options.verifyDeterminism = false;
+
+	if(!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return 1;
+	}
+
+	if(options.verifyKernels)
+		return verifyKernels();
+
+	if(options.verifyDeterminism)
+		return verifyDeterminism();
+
+	if(options.converge > 0.0f)
+		return compareConvergence(options);
+
+	if(options.compareOrders)
+		return compareOrders(options);
+
+	if(options.compareSelf)
+		return compareSelfCollision(options);
+
+	// Build the cloth
+	Clock::time_point setupStart = Clock::now();
+	CPUCloth cloth(options.width, options.height, options.threads);
+	double setupTime = chrono::duration<double>(Clock::now() - setupStart).count();
+
+	if(!cloth.getWidth())
+		return 1;
+
+	configureCloth(cloth, options);
+
+	// Mesh collider, fitted into a box half the cloth's size under its middle
+	CPUTriangleMesh mesh;
+	CPUDistanceField meshField;
+
+	if(*options.mesh)
+	{
+		if(!loadMesh(options.mesh, mesh) || !mesh.getTriangleCount())
+		{
+			cout << "Mesh '" << options.mesh << "' could not be loaded" << endl;
+			return 1;
+		}
+
+		CPUVector3 boundsMin, boundsMax;
+		meshBounds(mesh, boundsMin, boundsMax);
+
+		float longest = max(max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), max(boundsMax.z - boundsMin.z, 1e-6f));
+		float scale = 0.5f / longest;
+
+		for(size_t v = 0; v < mesh.vertices.size(); ++v)
+		{
+			mesh.vertices[v].x = (mesh.vertices[v].x - 0.5f * (boundsMin.x + boundsMax.x)) * scale + 0.5f;
+			mesh.vertices[v].y = (mesh.vertices[v].y - boundsMax.y) * scale - 0.3f;
+			mesh.vertices[v].z = (mesh.vertices[v].z - 0.5f * (boundsMin.z + boundsMax.z)) * scale + 0.4f;
+		}
+
+		CPUThreadPool bakePool(options.threads);
+
+		meshField.bakeCached(mesh, options.meshResolution, 4, options.fieldCache, &bakePool);
+		addField(cloth, meshField);
+
+		const int* samples = meshField.getSamples();
+
+		cout << "Mesh: " << mesh.getTriangleCount() << " triangles, field " << samples[0] << " x " << samples[1] << " x " << samples[2]
+			<< (meshField.isLoaded() ? ", loaded in " : ", baked in ") << meshField.getBakeTime() << " seconds" << endl;
+	}
+
+	cout << "Cloth: " << cloth.getWidth() << " x " << cloth.getHeight() << " particles, "
+		<< cloth.getConstraintCount() << " constraints" << endl;
+	cout << "Constraint kernel: " << instructionSetName(cloth.getInstructionSet())
+		<< ", threads: " << cloth.getThreadCount() << endl;
+	cout << "Solver: " << solverNames[options.solver] << ", time step: "
+		<< cloth.getTimeStep() << " s, iterations: " << cloth.getIterations()
+		<< ", multigrid levels: " << (cloth.isMultigridActive() ? cloth.getMultigridLevels() : 1) << endl;
+	cout << "Anchors: " << cloth.getAnchorCount() << ", tethers: " << (cloth.isTethered() ? "on" : "off")
+		<< ", particle order: " << particleOrderName(cloth.getParticleOrder()) << endl;
+
+	if(cloth.getBlockedSweeps() > 0)
+	{
+		cout << "Blocked sweeps: " << cloth.getBlockedSweeps() << " per tile per round, "
+			<< 100.0 * cloth.getBoundaryConstraintCount() / max(cloth.getConstraintCount(), 1) << "% of the constraints on tile boundaries" << endl;
+	}
+
+	cout << "Setup time: " << setupTime << " seconds." << endl;
+
+	// Step the requested number of frames at a fixed frame rate
+	float frameTime = 1.0f / options.fps;
+	long long steps = 0;
+
+	Clock::time_point runStart = Clock::now();
+
+	long long solverIterations = 0;
+	long long andersonAccepted = 0;
+	double awakeShare = 0.0;
+	int lastFrames = max(options.frames / 10, 1);
+	Clock::time_point lastStart = runStart;
+
+	// The swinging sphere crosses the hanging cloth back and forth between z = -1 and 1,
+	// particles it overtakes within half its radius of its path went through it
+	int sphereId = cloth.getColliders().find(CPU_COLLIDER_SPHERE);
+	vector<float> sphereSide;
+	long long passedThrough = 0;
+
+	for(int frame = 0; frame < options.frames; ++frame)
+	{
+		if(frame == options.frames - lastFrames)
+			lastStart = Clock::now();
+
+		if(options.sphereSpeed > 0.0f && sphereId >= 0)
+		{
+			float travel = fmodf(options.sphereSpeed * frameTime * (frame + 1), 4.0f);
+			CPUSphere sphere = cloth.getColliders().get(sphereId).sphere;
+			const CPUParticles& particles = cloth.getParticles();
+
+			sphereSide.resize(particles.count);
+
+			for(unsigned int i = 0; i < particles.count; ++i)
+				sphereSide[i] = particles.z[i] - sphere.position.z;
+
+			sphere.position.x = 0.5f;
+			sphere.position.y = -0.5f;
+			sphere.position.z = travel < 2.0f ? travel - 1.0f : 3.0f - travel;
+			cloth.setCollider(sphereId, sphere);
+		}
+
+		steps += cloth.update((options.stall > 0.0f && frame == options.frames / 2) ? options.stall : frameTime);
+
+		if(options.sphereSpeed > 0.0f && sphereId >= 0)
+		{
+			const CPUParticles& particles = cloth.getParticles();
+			const CPUSphere& sphere = cloth.getColliders().get(sphereId).sphere;
+
+			for(unsigned int i = 0; i < particles.count; ++i)
+			{
+				float dx = particles.x[i] - sphere.position.x;
+				float dy = particles.y[i] - sphere.position.y;
+				float side = particles.z[i] - sphere.position.z;
+
+				if(dx * dx + dy * dy < 0.25f * sphere.radius * sphere.radius && side * sphereSide[i] < 0.0f)
+					++passedThrough;
+			}
+		}
+		awakeShare += (double)cloth.getAwakeTileCount() / cloth.getTiles().size();
+
+		// The implicit solver reports its last step, exact when it steps once per frame
+		solverIterations += cloth.getImplicitSolver().getLastIterations();
+		andersonAccepted += cloth.getProjectiveSolver().getLastAccepted();
+	}
+
+	double runTime = chrono::duration<double>(Clock::now() - runStart).count();
+	double lastTime = chrono::duration<double>(Clock::now() - lastStart).count();
+
+	// Time the per frame normal update on its own (update() already ran it once per frame)
+	const int normalRepeats = 20;
+	Clock::time_point normalStart = Clock::now();
+
+	for(int i = 0; i < normalRepeats; ++i)
+		cloth.updateNormals();
+
+	double normalTime = chrono::duration<double>(Clock::now() - normalStart).count() / normalRepeats;
+
+	// Report throughput
+	double particleSteps = (double)steps * cloth.getWidth() * cloth.getHeight();
+
+	cout << fixed << setprecision(3);
+	cout << "Frames: " << options.frames << ", substeps: " << steps << endl;
+	cout << "Dropped simulation time: " << cloth.getScheduler().getDroppedTime() << " seconds." << endl;
+	cout << "Run time: " << runTime << " seconds." << endl;
+	cout << "Frames per second: " << options.frames / runTime << endl;
+	cout << "Substeps per second: " << steps / runTime << endl;
+	cout << "Particle updates per second (millions): " << particleSteps / runTime / 1.0e6 << endl;
+	cout << "Normal update: " << normalTime * 1000.0 << " ms (" << normalTime / (runTime / options.frames) * 100.0 << "% of a frame)" << endl;
+	CPUStretchMetrics finalStretch = cloth.measureStretch();
+
+	cout << "Max relative stretch: " << finalStretch.max << " (RMS " << finalStretch.rms << ")" << endl;
+
+	if(options.stretch || options.tolerance > 0.0f || options.budget > 0.0f)
+	{
+		const CPUStretchMetrics& sweepStretch = cloth.getStretchMetrics();
+
+		cout << "Sweeps per substep: " << (steps ? (double)sweepStretch.totalSweeps / steps : 0.0) << " (cap " << cloth.getIterations()
+			<< ", last " << sweepStretch.sweeps << ")" << endl;
+
+		if(options.stretch || options.tolerance > 0.0f)
+		{
+			cout << "Last sweep stretch, max / RMS by batch:";
+
+			for(int b = 0; b < 8; ++b)
+				cout << " " << sweepStretch.batchMax[b] << "/" << sweepStretch.batchRMS[b];
+
+			cout << endl;
+		}
+	}
+
+	if(cloth.getColliders().getCount() > 1)
+	{
+		cout << "Colliders: " << cloth.getColliders().getCount() << ", tile / collider pairs past the broadphase: " << cloth.getColliderPairs()
+			<< " of " << cloth.getColliders().getCount() * cloth.getTiles().size() << endl;
+	}
+
+	if(cloth.isContinuousCollision() || options.sphereSpeed > 0.0f)
+	{
+		cout << "Continuous collision: " << (cloth.isContinuousCollision() ? "on" : "off") << ", " << (steps ? (double)cloth.getSweepTotal() / steps : 0.0)
+			<< " particles stopped by the sweeps per step";
+
+		if(options.sphereSpeed > 0.0f)
+			cout << ", particles the swinging sphere passed through: " << passedThrough;
+
+		cout << endl;
+	}
+
+	if(cloth.isSelfCollision())
+	{
+		const CPUSelfCollision& selfCollision = cloth.getSelfCollision();
+		long long passes = max(selfCollision.getPasses(), 1LL);
+
+		cout << "Self collision: contact distance " << selfCollision.getDistance() << " m, " << selfCollision.getBucketCount() << " buckets, hash build "
+			<< selfCollision.getBuildTime() / passes * 1000.0 << " ms, query " << selfCollision.getQueryTime() / passes * 1000.0
+			<< " ms, list passes " << selfCollision.getSolveTime() / passes * 1000.0 << " ms per step, " << selfCollision.getBuilds()
+			<< " hash builds for " << passes << " passes, " << selfCollision.getContacts() << " particles pushed by the last pass" << endl;
+	}
+
+	if(cloth.isContactCaching() && cloth.getContactFrames())
+	{
+		cout << "Contact caching: " << cloth.getContactFrames() << " of " << options.frames << " frames detected once, last skin "
+			<< cloth.getContactSkin() * 1000.0f << " mm (colliders) / " << cloth.getSelfSkin() * 1000.0f << " mm (self, lists for "
+			<< cloth.getSelfInterval() << " substeps), " << cloth.getContactRefreshes() << " re-detected within a frame" << endl;
+	}
+
+	if(cloth.isSleeping())
+	{
+		cout << "Awake tiles: " << cloth.getAwakeTileCount() << " of " << cloth.getTiles().size() << " (" << cloth.getTileSize() << " x "
+			<< cloth.getTileSize() << " particles), " << awakeShare / options.frames * 100.0 << "% awake on average" << endl;
+		cout << "Last " << lastFrames << " frames: " << lastTime / lastFrames * 1000.0 << " ms per frame" << endl;
+	}
+
+	if(cloth.isChebyshev())
+	{
+		cout << "Chebyshev spectral radius: " << cloth.getChebyshev().getRadius() << ", fallbacks: " << cloth.getChebyshev().getFallbacks()
+			<< ", configurations cached: " << cloth.getChebyshev().getCachedCount() << endl;
+	}
+
+	if(options.solver == CPU_SOLVER_IMPLICIT)
+	{
+		cout << "CG iterations per frame: " << (double)solverIterations / options.frames
+			<< ", last relative residual: " << scientific << cloth.getImplicitSolver().getLastResidual() << fixed << endl;
+	}
+	else if(options.solver == CPU_SOLVER_PROJECTIVE)
+	{
+		const CPUProjectiveSolver& projective = cloth.getProjectiveSolver();
+
+		cout << "Factor: " << projective.getFactorNonZeros() << " non zeros, "
+			<< (projective.isFactorLoaded() ? "loaded from the cache in " : "built in ") << projective.getFactorTime() << " seconds" << endl;
+		cout << "Anderson iterates accepted: " << andersonAccepted << " of " << (long long)cloth.getIterations() * steps
+			<< ", last energy: " << scientific << projective.getLastEnergy() << fixed << endl;
+	}
+	else if(options.solver == CPU_SOLVER_VBD)
+	{
+		const CPUBlockDescentSolver& blockDescent = cloth.getBlockDescentSolver();
+
+		cout << "Vertex colours: " << blockDescent.getColourCount() << " (barriers per iteration, against 8 constraint batches), sizes";
+
+		for(int c = 0; c < blockDescent.getColourCount(); ++c)
+			cout << " " << blockDescent.getColourSize(c);
+
+		cout << endl;
+	}
+
+	// State hashes
+	const vector<CPUStateHash>& hashes = cloth.getStateHashes();
+
+	for(size_t i = 0; i < hashes.size(); ++i)
+		cout << "Step " << hashes[i].step << " hash: 0x" << hex << setw(16) << setfill('0') << hashes[i].hash << dec << setfill(' ') << endl;
+
+	return 0;
+}
@@ -6,6 +6,9 @@
 // Include header
 #include "DXCloth.h"
 
+// Standard includes
+#include <algorithm>
+
 // Debug includes
 #include <iostream>
 
@@ -25,13 +28,14 @@ DXCloth::DXCloth(ID3D11Device *device, ID3DBlob *vsBytecode, DWORD newClothWidth
 	wind = 0.0;
 	anchored = true;
 	force = false;
-	leftOver = 0;
+	inverseMasses = nullptr;
+	anchorsChanged = false;
 
 	// Computer shaders
 	applyForces = nullptr;
 	applyConstraints = nullptr;
-	applyAnchors = nullptr;
 	checkSphereCollisions = nullptr;
+	updateNormals = nullptr;
 
 	// Timing for the setup
 	clock.reset();
@@ -40,6 +44,10 @@ DXCloth::DXCloth(ID3D11Device *device, ID3DBlob *vsBytecode, DWORD newClothWidth
 	setupBuffers(device, vsBytecode);
 	compileShaders(device);
 
+	// Top left, top right and top middle
+	DWORD32 defaultAnchors[3] = { 0, width - 1, (DWORD32)(width / 2) };
+	setAnchors(defaultAnchors, 3);
+
 	cout << "Setup time: " << clock.actualTimeElapsed() << " seconds." << endl;
 	clock.stop();
 
@@ -50,7 +58,7 @@ DXCloth::DXCloth(ID3D11Device *device, ID3DBlob *vsBytecode, DWORD newClothWidth
 // Destructor
 DXCloth::~DXCloth()
 {
-	// Empty
+	free(inverseMasses);
 }
 
 // Compile Shaders
@@ -93,34 +101,34 @@ void DXCloth::compileShaders(ID3D11Device *device)
 			throw("Failed to create 'cloth_apply_constraints.hlsl'");
 
 		// --------------------------------------------------------------------------------------------
-		// Compile Anchors Shader
-		hr = CSFactory::CompileComputeShader(L"Resources\\Shaders\\cloth_apply_anchors.hlsl", "main", device, &computeBlob);
+		// Compile Collision Shader
+		hr = CSFactory::CompileComputeShader(L"Resources\\Shaders\\cloth_collision_sphere.hlsl", "main", device, &computeBlob);
 
 		if(FAILED(hr))
-			throw("Failed to compile 'cloth_apply_anchors.hlsl'");
+			throw("Failed to compile 'cloth_collision_sphere.hlsl'");
 
 		// Create Shader
-		hr = device->CreateComputeShader(computeBlob->GetBufferPointer(), computeBlob->GetBufferSize(), nullptr, &applyAnchors);
+		hr = device->CreateComputeShader(computeBlob->GetBufferPointer(), computeBlob->GetBufferSize(), nullptr, &checkSphereCollisions);
 
 		computeBlob->Release();
 
 		if(FAILED(hr))
-			throw("Failed to create 'cloth_apply_anchors.hlsl'");
+			throw("Failed to create 'cloth_collision_sphere.hlsl'");
 
 		// --------------------------------------------------------------------------------------------
-		// Compile Collision Shader
-		hr = CSFactory::CompileComputeShader(L"Resources\\Shaders\\cloth_collision_sphere.hlsl", "main", device, &computeBlob);
+		// Compile Normals Shader
+		hr = CSFactory::CompileComputeShader(L"Resources\\Shaders\\cloth_update_normals.hlsl", "main", device, &computeBlob);
 
 		if(FAILED(hr))
-			throw("Failed to compile 'cloth_collision_sphere.hlsl'");
+			throw("Failed to compile 'cloth_update_normals.hlsl'");
 
 		// Create Shader
-		hr = device->CreateComputeShader(computeBlob->GetBufferPointer(), computeBlob->GetBufferSize(), nullptr, &checkSphereCollisions);
+		hr = device->CreateComputeShader(computeBlob->GetBufferPointer(), computeBlob->GetBufferSize(), nullptr, &updateNormals);
 
 		computeBlob->Release();
 
 		if(FAILED(hr))
-			throw("Failed to create 'cloth_collision_sphere.hlsl'");
+			throw("Failed to create 'cloth_update_normals.hlsl'");
 
 	}
 	catch(char* error)
@@ -149,9 +157,9 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 	// Setup cloth buffers
 	Particle* vertices = nullptr;
 	DWORD* indices = nullptr;
-	Anchor* anchors = nullptr;
 	Constraint* constraints = nullptr;
 	Sphere* sphere = nullptr;
+	Grid* grid = nullptr;
 
 	try
 	{
@@ -165,19 +173,25 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 		// Allocate memory for buffers
 		vertices = (Particle*) malloc (width * height * sizeof(Particle));
 		indices = (DWORD*) malloc ((width - 1) * (height - 1) * 6 * sizeof(DWORD));
-		anchors = (Anchor*) malloc (sizeof(Anchor) * 3);
+		inverseMasses = (float*) malloc (width * height * sizeof(float));
 		constraints = (Constraint*) malloc (sizeof(Constraint) * constraintCount);
 		frameTimer = (DeltaTime*)_aligned_malloc(sizeof(DeltaTime), 16);
 		forces = (Forces*) malloc (sizeof(Forces));
 		sphere = (Sphere*) malloc (sizeof(Sphere));
+		grid = (Grid*) malloc (sizeof(Grid));
 
-		if (!vertices || !indices || !anchors || !constraints || !frameTimer || !forces)
+		if (!vertices || !indices || !inverseMasses || !constraints || !frameTimer || !forces || !grid)
 			throw("Cannot create cloth buffers");
 
 		// Setup sphere position and radius
 		sphere->position	= XMFLOAT3(0.5, -0.8, 0.0);
 		sphere->radius		= 0.2f;
 
+		// Setup grid dimensions
+		grid->width			= width;
+		grid->height		= height;
+		grid->padding		= XMFLOAT2(0.0f, 0.0f);
+
 		// Variables used for setup
 		batchSize[0] = height * (width * 0.5); // Horizontal Even
 		batchSize[1] = ((width - 1) * height) - batchSize[0]; // Horizontal Odd
@@ -223,12 +237,10 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 				#pragma region SETUP VERTEX INFORMATION
 				// --------------------------------------------------------------------------------------------
 
-				vptr->vertex.pos = XMFLOAT3((float)i / (float)(width - 1), 0, (float)j / (float)(height - 1));
-				vptr->vertex.normal = XMFLOAT3(0, 1, 0);
-				vptr->vertex.texCoord = XMFLOAT2((float)i / (float)(width - 1), (float)j / (float)(height - 1));
-				vptr->vertex.matDiffuse = XMCOLOR(1.0f, 1.0f, 1.0f, 1.0f);
-				vptr->vertex.matSpecular = XMCOLOR(0.0f, 0.0f, 0.0f, 0.0f);
-				vptr->oldPosition = vptr->vertex.pos;
+				*vptr = restParticle(index);
+
+				// Free until the anchors are set
+				inverseMasses[index] = 1.0f;
 
 				// --------------------------------------------------------------------------------------------
 				#pragma endregion
@@ -374,24 +386,6 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 			}
 		}
 
-		#pragma region SETUP ANCHOR PARTICLES
-		// --------------------------------------------------------------------------------------------
-
-		// Top left
-		anchors[0].index = 0; 
-		anchors[0].position = vertices[anchors[0].index].vertex.pos;
-
-		// Top right
-		anchors[1].index = width - 1; 
-		anchors[1].position = vertices[anchors[1].index].vertex.pos;
-
-		// Top middle
-		anchors[2].index = (DWORD32)(width / 2);
-		anchors[2].position = vertices[anchors[2].index].vertex.pos;
-
-		// --------------------------------------------------------------------------------------------
-		#pragma endregion
-
 		#pragma region SETUP CONSTANT BUFFERS
 		// --------------------------------------------------------------------------------------------
 
@@ -413,10 +407,16 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 		if (!SUCCEEDED(hr))
 			throw("Sphere buffer cannot be created");
 
+		// Setup grid constant buffer
+		hr = createCBuffer<Grid>(device, grid, &gridBuffer);
+
+		if (!SUCCEEDED(hr))
+			throw("Grid buffer cannot be created");
+
 		// --------------------------------------------------------------------------------------------
 		#pragma endregion
 
-		#pragma region SETUP VERTEX / INDEX / CONSTRAINT & ANCHOR BUFFERS
+		#pragma region SETUP VERTEX / INDEX / CONSTRAINT & INVERSE MASS BUFFERS
 		// --------------------------------------------------------------------------------------------
 
 		// Setup vertex buffer
@@ -487,26 +487,26 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 			throw("Constraint buffer cannot be created");
 
 		// --------------------------------------------------------------------------------------------
-		// Setup anchor buffer
-		D3D11_BUFFER_DESC anchorDesc;
-		D3D11_SUBRESOURCE_DATA anchorData;
+		// Setup inverse mass buffer (updated from the CPU copy when the anchors change)
+		D3D11_BUFFER_DESC inverseMassDesc;
+		D3D11_SUBRESOURCE_DATA inverseMassData;
 
-		ZeroMemory(&anchorDesc, sizeof(D3D11_BUFFER_DESC));
-		ZeroMemory(&anchorData, sizeof(D3D11_SUBRESOURCE_DATA));
+		ZeroMemory(&inverseMassDesc, sizeof(D3D11_BUFFER_DESC));
+		ZeroMemory(&inverseMassData, sizeof(D3D11_SUBRESOURCE_DATA));
 
-		anchorDesc.BindFlags			= D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
-		anchorDesc.CPUAccessFlags		= 0;
-		anchorDesc.MiscFlags			= D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-		anchorDesc.StructureByteStride	= sizeof(Anchor);
-		anchorDesc.ByteWidth			= sizeof(Anchor) * 3;
-		anchorDesc.Usage				= D3D11_USAGE_DEFAULT;		
+		inverseMassDesc.BindFlags			= D3D11_BIND_SHADER_RESOURCE;
+		inverseMassDesc.CPUAccessFlags		= 0;
+		inverseMassDesc.MiscFlags			= D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		inverseMassDesc.StructureByteStride	= sizeof(float);
+		inverseMassDesc.ByteWidth			= sizeof(float) * width * height;
+		inverseMassDesc.Usage				= D3D11_USAGE_DEFAULT;
 
-		anchorData.pSysMem				= anchors;
+		inverseMassData.pSysMem				= inverseMasses;
 
-		hr = device->CreateBuffer(&anchorDesc, &anchorData, &anchorBuffer);
+		hr = device->CreateBuffer(&inverseMassDesc, &inverseMassData, &inverseMassBuffer);
 
 		if (!SUCCEEDED(hr))
-			throw("Anchor buffer cannot be created");
+			throw("Inverse mass buffer cannot be created");
 
 		// --------------------------------------------------------------------------------------------
 		#pragma endregion
@@ -529,18 +529,18 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 			throw("Cannot create vertex buffer UAV");
 
 		// --------------------------------------------------------------------------------------------
-		// Create Shader Resource View for anchors
-		D3D11_SHADER_RESOURCE_VIEW_DESC anchorSRVDesc;
+		// Create Shader Resource View for inverse masses
+		D3D11_SHADER_RESOURCE_VIEW_DESC inverseMassSRVDesc;
 
-		anchorSRVDesc.Buffer.FirstElement	= 0;
-		anchorSRVDesc.Buffer.NumElements	= 3;
-		anchorSRVDesc.Format				= DXGI_FORMAT_UNKNOWN;
-		anchorSRVDesc.ViewDimension			= D3D11_SRV_DIMENSION_BUFFER;
+		inverseMassSRVDesc.Buffer.FirstElement	= 0;
+		inverseMassSRVDesc.Buffer.NumElements	= width * height;
+		inverseMassSRVDesc.Format				= DXGI_FORMAT_UNKNOWN;
+		inverseMassSRVDesc.ViewDimension		= D3D11_SRV_DIMENSION_BUFFER;
 
-		hr = device->CreateShaderResourceView(anchorBuffer, &anchorSRVDesc, &anchorSRV);
+		hr = device->CreateShaderResourceView(inverseMassBuffer, &inverseMassSRVDesc, &inverseMassSRV);
 
 		if (!SUCCEEDED(hr))
-			throw("Cannot create anchor shader resource view");
+			throw("Cannot create inverse mass shader resource view");
 
 		// --------------------------------------------------------------------------------------------
 		// Create Shader Resource Views for constraints
@@ -569,8 +569,8 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 		// dispose of local buffer resources
 		free(vertices);
 		free(indices);
-		free(anchors);
 		free(constraints);
+		free(grid);
 	}
 	catch (char* error)
 	{
@@ -583,12 +583,15 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 		if (indices)
 			free(indices);
 
-		if (anchors)
-			free(anchors);
+		if (inverseMasses)
+			free(inverseMasses);
 
 		if (constraints)
 			free(constraints);
 
+		if (grid)
+			free(grid);
+
 		if (vertexBuffer)
 			vertexBuffer->Release();
 
@@ -601,11 +604,29 @@ void DXCloth::setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode)
 		vertexBuffer = nullptr;
 		indexBuffer = nullptr;
 		inputLayout = nullptr;
+		inverseMasses = nullptr;
 		width = 0;
 		height = 0;
 	}
 }
 
+// Rest Particle (the flat grid the cloth is built as)
+Particle DXCloth::restParticle(DWORD index) const
+{
+	DWORD i = index % width;
+	DWORD j = index / width;
+
+	Particle result;
+	result.vertex.pos = XMFLOAT3((float)i / (float)(width - 1), 0, (float)j / (float)(height - 1));
+	result.vertex.normal = XMFLOAT3(0, 1, 0);
+	result.vertex.texCoord = XMFLOAT2((float)i / (float)(width - 1), (float)j / (float)(height - 1));
+	result.vertex.matDiffuse = XMCOLOR(1.0f, 1.0f, 1.0f, 1.0f);
+	result.vertex.matSpecular = XMCOLOR(0.0f, 0.0f, 0.0f, 0.0f);
+	result.oldPosition = result.vertex.pos;
+
+	return result;
+}
+
 // Render
 void DXCloth::render(ID3D11DeviceContext* context)
 {
@@ -641,30 +662,36 @@ void DXCloth::render(ID3D11DeviceContext* context)
 // Update
 void DXCloth::update(ID3D11DeviceContext* context)
 {
+	// Apply anchor changes made since the last update
+	if(anchorsChanged)
+		uploadAnchors(context);
+
 	// Bind the UAV to the compute shader
 	context->CSSetUnorderedAccessViews(0, 1, &particlesBufferUAV, nullptr);
 
+	// Bind the inverse masses, shared by every pass
+	context->CSSetShaderResources(1, 1, &inverseMassSRV);
+
 	// Setup forces
 	forces->force = XMFLOAT4(0.0f, -9.8f, wind, 1.0f);
 
 	// Bind constant buffers
 	// Get the time since last frame
-	float deltaTime = ((float)clock.actualTimeElapsed()) + leftOver;
+	float deltaTime = (float)clock.actualTimeElapsed();
 
-	// Fixed update rate for deterministic simulation
-	float timeStep = 0.0017;
-	int stepCount = deltaTime / timeStep;
-	leftOver = deltaTime - (timeStep * stepCount);
+	// Fixed update rate for deterministic simulation, bounded so a stall
+	// (window drag, breakpoint) cannot queue hundreds of steps into one frame
+	int stepCount = scheduler.advance(deltaTime);
 
 	clock.reset();
 
-	frameTimer->deltaTime = timeStep;
+	frameTimer->deltaTime = scheduler.getTimeStep();
 
 	mapBuffer<DeltaTime>(context, frameTimer, gameTimeBuffer);
 	mapBuffer<Forces>(context, forces, forcesBuffer);
 
-	ID3D11Buffer* csCBuffers[] = {gameTimeBuffer, forcesBuffer, sphereBuffer};
-	context->CSSetConstantBuffers(0, 3, csCBuffers);
+	ID3D11Buffer* csCBuffers[] = {gameTimeBuffer, forcesBuffer, sphereBuffer, gridBuffer};
+	context->CSSetConstantBuffers(0, 4, csCBuffers);
 
 	// If forces are being applied - boolean
 	if(force)
@@ -682,22 +709,18 @@ void DXCloth::update(ID3D11DeviceContext* context)
 			// Apply constraints to the cloth
 			context->CSSetShader(applyConstraints, 0, 0);
 
-			// Bind resource views
-			ID3D11ShaderResourceView* shaderRV[] = {0, anchorSRV};
-
 			for(int i = 0; i < 8; ++i)
 			{
-				shaderRV[0] = constraintSRV[i];
-				context->CSSetShaderResources(0, 2, shaderRV);
+				context->CSSetShaderResources(0, 1, &constraintSRV[i]);
 				context->Dispatch(batchSize[i], 1, 1);
 			}
+		}
 
-			// Anchors constraints to the cloth
-			if(anchored)
-			{
-				context->CSSetShader(applyAnchors, 0, 0);
-				context->Dispatch(3, 1, 1);
-			}
+		// Normals are only needed for rendering, so once per frame rather than per substep
+		if(stepCount)
+		{
+			context->CSSetShader(updateNormals, 0, 0);
+			context->Dispatch((int)(width * height), 1, 1);
 		}
 	}
 
@@ -706,10 +729,72 @@ void DXCloth::update(ID3D11DeviceContext* context)
 	context->CSSetUnorderedAccessViews(0, 1, &noUAV, nullptr);
 }
 
+// Pin Anchors
+void DXCloth::pinAnchors(bool pinned)
+{
+	for(size_t i = 0; i < anchorIndices.size(); ++i)
+		inverseMasses[anchorIndices[i]] = pinned ? 0.0f : 1.0f;
+
+	anchorsChanged = true;
+}
+
+// Upload Anchors
+void DXCloth::uploadAnchors(ID3D11DeviceContext* context)
+{
+	context->UpdateSubresource(inverseMassBuffer, 0, nullptr, inverseMasses, 0, 0);
+
+	// Pinned anchors go back to their rest position, without velocity
+	if(anchored)
+	{
+		for(size_t i = 0; i < anchorIndices.size(); ++i)
+		{
+			Particle particle = restParticle(anchorIndices[i]);
+
+			D3D11_BOX box;
+			box.left	= anchorIndices[i] * sizeof(Particle);
+			box.right	= box.left + sizeof(Particle);
+			box.top		= 0;
+			box.bottom	= 1;
+			box.front	= 0;
+			box.back	= 1;
+
+			context->UpdateSubresource(vertexBuffer, 0, &box, &particle, 0, 0);
+		}
+	}
+
+	anchorsChanged = false;
+}
+
+// Set Anchors
+void DXCloth::setAnchors(const DWORD32* newAnchors, int newAnchorCount)
+{
+	if(!inverseMasses)
+		return;
+
+	// Release the previous set
+	if(anchored)
+		pinAnchors(false);
+
+	anchorIndices.clear();
+
+	for(int i = 0; i < newAnchorCount; ++i)
+	{
+		// Skip out of range and repeated indices
+		if(newAnchors[i] >= width * height || find(anchorIndices.begin(), anchorIndices.end(), newAnchors[i]) != anchorIndices.end())
+			continue;
+
+		anchorIndices.push_back(newAnchors[i]);
+	}
+
+	if(anchored)
+		pinAnchors(true);
+}
+
 // Controls
 void DXCloth::switchAnchors()
 {
 	anchored = !anchored;
+	pinAnchors(anchored);
 }
 
 void DXCloth::switchForces()
@@ -21,6 +21,12 @@
 // Custom Compute Shader Compiler
 #include "CSFactory.h"
 
+// Fixed step scheduler (shared with the CPU cloth)
+#include <CPUCloth\CPUStepScheduler.h>
+
+// Standard includes
+#include <vector>
+
 #pragma region Buffer Structures
 // Particle structure
 struct Particle
@@ -45,16 +51,6 @@ struct Constraint
 	float padding;
 };
 
-// Anchor information
-struct Anchor
-{
-	// Index to anchored vertex
-	DWORD32 index;
-
-	// Position
-	XMFLOAT3 position;
-};
-
 // Time information
 struct DeltaTime
 {
@@ -77,6 +73,15 @@ struct Sphere
 	XMFLOAT3 position;
 	float radius;
 };
+
+// Cloth dimensions (for the normal update)
+struct Grid
+{
+	DWORD32 width, height;
+
+	// Padding
+	XMFLOAT2 padding;
+};
 #pragma endregion
 
 // Direct X Cloth class
@@ -91,26 +96,32 @@ private:
 	// Compute Shaders
 	ID3D11ComputeShader* applyForces;
 	ID3D11ComputeShader* applyConstraints;
-	ID3D11ComputeShader* applyAnchors;
 	ID3D11ComputeShader* checkSphereCollisions;
+	ID3D11ComputeShader* updateNormals;
 
 	// Buffers
 	ID3D11Buffer* constraintBuffer;
-	ID3D11Buffer* anchorBuffer;
+	ID3D11Buffer* inverseMassBuffer;
 	ID3D11Buffer* gameTimeBuffer;
 	ID3D11Buffer* forcesBuffer;
 	ID3D11Buffer* sphereBuffer;
+	ID3D11Buffer* gridBuffer;
 
 	// UAVs and SRVs
 	ID3D11UnorderedAccessView* particlesBufferUAV;
 	ID3D11ShaderResourceView* constraintSRV[8];
-	ID3D11ShaderResourceView* anchorSRV;
+	ID3D11ShaderResourceView* inverseMassSRV;
+
+	// Anchors (pinned through a zero inverse mass while anchored is set)
+	std::vector<DWORD32> anchorIndices;
+	float* inverseMasses; // CPU copy of the inverse mass buffer
+	bool anchorsChanged; // Upload the inverse masses (and rest the anchors) on the next update
 
 	// Timing
 	CGClock clock;
 	DeltaTime* frameTimer;
 	float previousTime;
-	float leftOver;
+	CPUStepScheduler scheduler;
 
 	// Forces & Control variables
 	float wind;
@@ -123,6 +134,11 @@ private:
 
 	// Methods
 	void setupBuffers(ID3D11Device *device, ID3DBlob *vsBytecode);
+	Particle restParticle(DWORD index) const;
+
+	// Pin (zero inverse mass, restored to the rest position) or release the anchor set
+	void pinAnchors(bool pinned);
+	void uploadAnchors(ID3D11DeviceContext* context);
 
 	// Output Controls
 	void displayControls();
@@ -143,6 +159,9 @@ public:
 	// Update
 	void update(ID3D11DeviceContext* context);
 
+	// Replace the anchor set (any number of particles), the new anchors are pinned at their rest positions
+	void setAnchors(const DWORD32* newAnchors, int newAnchorCount);
+
 	// Controls
 	void switchAnchors();
 	void switchForces();
@@ -28,30 +28,14 @@ struct Constraint
 	float padding;
 };
 
-// Anchor Structure
-struct Anchor
-{
-	uint index;
-	float3 position;
-};
-
 // Particle data
 RWStructuredBuffer<Particle> particles : register(u0);
 
 // Constraint buffer
 StructuredBuffer<Constraint> constraints : register(t0);
 
-// Anchor buffer
-StructuredBuffer<Anchor> anchors : register(t1);
-
-bool checkAnchor(uint index)
-{
-	for(int i = 0; i < 3; ++i)
-		if(anchors[i].index == index)
-			return true;
-
-	return false;
-}
+// Inverse mass buffer (0 = pinned)
+StructuredBuffer<float> inverseMass : register(t1);
 
 [numthreads(1, 1, 1)]
 void main(uint3 dispatchThreadID : SV_DispatchThreadID)
@@ -64,18 +48,14 @@ void main(uint3 dispatchThreadID : SV_DispatchThreadID)
 
 	delta *= streching;
 
-	if(checkAnchor(constraints[dispatchThreadID.x].start))
-	{
-		if(!checkAnchor(constraints[dispatchThreadID.x].end))
-			particles[constraints[dispatchThreadID.x].end].position += delta;
-	}
-	else
-	{
-		if(checkAnchor(constraints[dispatchThreadID.x].end))
-			particles[constraints[dispatchThreadID.x].start].position -= delta;
-		else
-			particles[constraints[dispatchThreadID.x].start].position -= (delta * 0.5);
+	// Split the correction by inverse mass, pinned ends do not move
+	float startInvMass = inverseMass[constraints[dispatchThreadID.x].start];
+	float endInvMass = inverseMass[constraints[dispatchThreadID.x].end];
+	float invMassSum = startInvMass + endInvMass;
 
-		particles[constraints[dispatchThreadID.x].end].position += (delta * 0.5);
+	if(invMassSum > 0)
+	{
+		particles[constraints[dispatchThreadID.x].start].position -= delta * (startInvMass / invMassSum);
+		particles[constraints[dispatchThreadID.x].end].position += delta * (endInvMass / invMassSum);
 	}
 }
\ No newline at end of file
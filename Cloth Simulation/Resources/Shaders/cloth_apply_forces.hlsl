@@ -20,6 +20,9 @@ struct Particle
 // Particle data
 RWStructuredBuffer<Particle> particles : register(u0);
 
+// Inverse mass buffer (0 = pinned)
+StructuredBuffer<float> inverseMass : register(t1);
+
 // Game time constant buffer
 cbuffer Timing : register(b0)
 {
@@ -37,6 +40,13 @@ cbuffer Forces : register(b1)
 [numthreads(1, 1, 1)]
 void main( uint3 dispatchThreadID : SV_DispatchThreadID )
 {
+	// Pinned particles do not move
+	if(inverseMass[dispatchThreadID.x] == 0)
+	{
+		particles[dispatchThreadID.x].oldPosition = particles[dispatchThreadID.x].position;
+		return;
+	}
+
 	// Verlet Integration
 	float3 velocity = 
 		((particles[dispatchThreadID.x].position * 1.997) - (particles[dispatchThreadID.x].oldPosition * 0.997));
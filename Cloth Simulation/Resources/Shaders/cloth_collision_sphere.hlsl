@@ -20,6 +20,9 @@ struct Particle
 // Particle data
 RWStructuredBuffer<Particle> particles : register(u0);
 
+// Inverse mass buffer (0 = pinned)
+StructuredBuffer<float> inverseMass : register(t1);
+
 cbuffer Sphere : register(b2)
 {
 	float3 spherePos;
@@ -32,7 +35,7 @@ void main( uint3 dispatchThreadID : SV_DispatchThreadID )
 	float3 delta = particles[dispatchThreadID.x].position - spherePos;
 	float distance = length(delta);
 
-	if(distance < radius)
+	if(distance < radius && inverseMass[dispatchThreadID.x] > 0)
 	{
 		float scaler = 1 - (radius / distance);
 
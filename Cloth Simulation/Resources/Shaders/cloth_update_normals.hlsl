@@ -0,0 +1,75 @@
+// ------------------------------------
+// Compute Shader: Used to recompute cloth normals
+// Author: Jak Boulton
+// ------------------------------------
+
+// Particle Structure
+struct Particle
+{
+	// CGVertexExt
+    float3				position	: POSITION;
+	float3				normal		: NORMAL;
+	uint				matDiffuse	: DIFFUSE;
+	uint				matSpecular	: SPECULAR;
+	float2				texCoord	: TEXCOORD;
+
+	// OldPosition
+	float3				oldPosition;
+};
+
+// Particle data
+RWStructuredBuffer<Particle> particles : register(u0);
+
+// Cloth dimensions
+cbuffer Grid : register(b3)
+{
+	uint gridWidth;
+	uint gridHeight;
+
+	// Padding
+	float2 gridPadding;
+};
+
+// Twice the area weighted normal of triangle (p0, p1, p2)
+float3 faceNormal(uint p0, uint p1, uint p2)
+{
+	return cross(particles[p1].position - particles[p0].position, particles[p2].position - particles[p0].position);
+}
+
+[numthreads(1, 1, 1)]
+void main( uint3 dispatchThreadID : SV_DispatchThreadID )
+{
+	uint index = dispatchThreadID.x;
+	uint i = index % gridWidth;
+	uint j = index / gridWidth;
+
+	// Quads are split into (a, b, d) and (b, c, d) as in the index buffer,
+	// sum the (up to six) triangles touching this vertex
+	float3 normal = float3(0, 0, 0);
+
+	// Corner a of quad (i, j)
+	if(i < gridWidth - 1 && j < gridHeight - 1)
+		normal += faceNormal(index, index + gridWidth, index + 1);
+
+	// Corner d of quad (i - 1, j)
+	if(i > 0 && j < gridHeight - 1)
+	{
+		normal += faceNormal(index - 1, index - 1 + gridWidth, index);
+		normal += faceNormal(index - 1 + gridWidth, index + gridWidth, index);
+	}
+
+	// Corner b of quad (i, j - 1)
+	if(i < gridWidth - 1 && j > 0)
+	{
+		normal += faceNormal(index - gridWidth, index, index - gridWidth + 1);
+		normal += faceNormal(index, index + 1, index - gridWidth + 1);
+	}
+
+	// Corner c of quad (i - 1, j - 1)
+	if(i > 0 && j > 0)
+		normal += faceNormal(index - 1, index, index - gridWidth);
+
+	float magnitude = length(normal);
+
+	particles[index].normal = magnitude > 0 ? normal / magnitude : float3(0, 1, 0);
+}